@@ -112,6 +112,20 @@ bool BedrockCommand::areHttpsRequestsComplete() const {
     return true;
 }
 
+void BedrockCommand::awaitHTTPS(SHTTPSManager::Transaction* transaction, Continuation&& continuation) {
+    httpsRequests.push_back(transaction);
+    _continuation = move(continuation);
+    repeek = true;
+}
+
+bool BedrockCommand::resume(SQLite& db) {
+    // Move the continuation out before calling it, so that it can install a new one with `awaitHTTPS`.
+    Continuation continuation = move(_continuation);
+    _continuation = nullptr;
+    repeek = false;
+    return continuation(db);
+}
+
 void BedrockCommand::reset(BedrockCommand::STAGE stage) {
     if (stage == STAGE::PEEK) {
         jsonContent.clear();
@@ -233,6 +247,23 @@ void BedrockCommand::finalizeTimingInfo() {
     }
 }
 
+uint64_t BedrockCommand::executionTime() const {
+    uint64_t total = escalationTimeUS;
+    for (const auto& entry: timingInfo) {
+        switch (get<0>(entry)) {
+            case PEEK:
+            case PROCESS:
+            case COMMIT_WORKER:
+            case COMMIT_SYNC:
+                total += get<2>(entry) - get<1>(entry);
+                break;
+            default:
+                break;
+        }
+    }
+    return total;
+}
+
 void BedrockCommand::prePoll(fd_map& fdm)
 {
     for (auto& transaction : httpsRequests) {
@@ -260,3 +291,20 @@ void BedrockCommand::setTimeout(uint64_t timeoutDurationMS) {
     timeoutDurationMS += STimeNow();
     _timeout = timeoutDurationMS;
 }
+
+void BedrockCommand::addSpeculation(SData& request) const {
+    removeSpeculation(request);
+    for (const auto& header : speculation) {
+        request[header.first] = header.second;
+    }
+}
+
+void BedrockCommand::removeSpeculation(SData& request) {
+    for (auto it = request.nameValueMap.begin(); it != request.nameValueMap.end();) {
+        if (SStartsWith(it->first, "speculative")) {
+            it = request.nameValueMap.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
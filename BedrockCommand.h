@@ -78,9 +78,30 @@ class BedrockCommand : public SQLiteCommand {
     // Add a summary of our timing info to our response object.
     void finalizeTimingInfo();
 
+    // Returns the total time in microseconds this command has spent being worked on (peeking, processing, committing,
+    // or escalated to leader), not including any time spent waiting in a queue.
+    uint64_t executionTime() const;
+
     // Returns true if all of the httpsRequests for this command are complete (or if it has none).
     bool areHttpsRequestsComplete() const;
 
+    // A continuation is the remainder of a `peek` that was suspended waiting on an HTTPS transaction. It has the same
+    // contract as `peek`: return true if the command is complete, false if it should go on to `process`.
+    typedef function<bool(SQLite& db)> Continuation;
+
+    // Suspends `peek` until `transaction` completes. The transaction is added to `httpsRequests`, and rather than
+    // calling `peek` again, the server will call `continuation` on a worker thread once every outstanding request for
+    // this command has a response. No worker is held while the command waits. The caller should return `false` from
+    // `peek` (or from the current continuation) immediately after calling this. A continuation may itself call
+    // `awaitHTTPS` to chain further requests, and any state it needs can simply be captured in the lambda.
+    void awaitHTTPS(SHTTPSManager::Transaction* transaction, Continuation&& continuation);
+
+    // True if `peek` was suspended by `awaitHTTPS` and hasn't been resumed yet.
+    bool hasContinuation() const { return (bool)_continuation; }
+
+    // Runs (and consumes) the pending continuation in place of `peek`.
+    bool resume(SQLite& db);
+
     // If the `peek` portion of this command needs to make an HTTPS request, this is where we store it.
     list<SHTTPSManager::Transaction*> httpsRequests;
 
@@ -154,6 +175,12 @@ class BedrockCommand : public SQLiteCommand {
     // This updates the timeout for this command to the specified number of milliseconds from the current time.
     void setTimeout(uint64_t timeoutDurationMS);
 
+    // A command that needs a newer commit than the database has (by default, the one in its `commitCount` header)
+    // waits for it until `commitWaitDeadline`, and then runs anyway. By default, that's its timeout, so it just times
+    // out, but a command that can answer without the commit can stop waiting sooner.
+    virtual uint64_t commitCountToWaitFor() const { return request.calcU64("commitCount"); }
+    virtual uint64_t commitWaitDeadline() const { return _timeout; }
+
     // Return the number of commands in existence.
     static size_t getCommandCount() { return _commandCount.load(); }
 
@@ -164,6 +191,25 @@ class BedrockCommand : public SQLiteCommand {
     // Record the state we were acting under in the last call to `peek` or `process`.
     SQLiteNode::State lastPeekedOrProcessedInState = SQLiteNode::UNKNOWN;
 
+    // The result of running `process` on a follower, for leader to commit if it can. See
+    // `BedrockCore::speculateCommand`. `speculation` is added to the request headers when it's escalated, and
+    // `speculativeResponse` is returned if leader commits it.
+    STable speculation;
+    SData speculativeResponse;
+
+    // With `-speculativeWrites`, a follower can run `process` for this command before escalating it, and leader runs
+    // it again if it can't use the result. A command whose `process` does anything outside the database, like making
+    // HTTPS requests, must return false here, or it will do that twice. By default, commands that made requests in
+    // `peek` aren't speculated.
+    virtual bool canSpeculate() { return httpsRequests.empty(); }
+
+    // Replaces any `speculative*` headers in `request` (the copy of this command's request being escalated) with
+    // `speculation`.
+    void addSpeculation(SData& request) const;
+
+    // Removes any `speculative*` headers from a request. Leader only trusts these from followers.
+    static void removeSpeculation(SData& request);
+
     // If someone is waiting for this command to complete, this will be called in the destructor.
     function<void()>* destructionCallback;
 
@@ -192,6 +238,9 @@ class BedrockCommand : public SQLiteCommand {
     // This is a timestamp in *microseconds* for when this command should timeout.
     uint64_t _timeout;
 
+    // The pending continuation set by `awaitHTTPS`, if any.
+    Continuation _continuation;
+
     static atomic<size_t> _commandCount;
 
     static const string defaultPluginName;
@@ -44,6 +44,9 @@ void BedrockCommandQueue::abandonFutureCommands(int msInFuture) {
         // Whatever's left in the queue is scheduled in the future and can be erased.
         size_t numberToErase = distance(commandMapIt, queueMapIt->second.end());
         if (numberToErase) {
+            for (auto it = commandMapIt; it != queueMapIt->second.end(); it++) {
+                _eraseDeadline(queueMapIt->first, it);
+            }
             queueMapIt->second.erase(commandMapIt, queueMapIt->second.end());
         }
 
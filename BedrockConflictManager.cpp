@@ -0,0 +1,89 @@
+#include "BedrockConflictManager.h"
+
+BedrockConflictManager::LaneLock::LaneLock(BedrockConflictManager& manager, const string& commandName) :
+    _manager(manager), _lanes(manager._getLanes(commandName))
+{
+    for (size_t lane : _lanes) {
+        _manager._lanes[lane].lock();
+    }
+}
+
+BedrockConflictManager::LaneLock::~LaneLock() {
+    for (auto it = _lanes.rbegin(); it != _lanes.rend(); ++it) {
+        _manager._lanes[*it].unlock();
+    }
+}
+
+set<size_t> BedrockConflictManager::_getLanes(const string& commandName) {
+    set<size_t> lanes;
+    lock_guard<decltype(_statsMutex)> lock(_statsMutex);
+    auto statsIt = _commandStats.find(commandName);
+    if (statsIt == _commandStats.end()) {
+        return lanes;
+    }
+    for (const string& table : statsIt->second.footprint) {
+        auto tableIt = _tableConflicts.find(table);
+        if (tableIt != _tableConflicts.end() && tableIt->second >= HOT_TABLE_CONFLICT_THRESHOLD) {
+            lanes.insert(hash<string>{}(table) % LANE_COUNT);
+        }
+    }
+    return lanes;
+}
+
+void BedrockConflictManager::recordCommitAttempt(const string& commandName, const set<string>& tablesWritten,
+                                                 bool conflicted, const string& conflictTable, uint64_t conflictPage) {
+    lock_guard<decltype(_statsMutex)> lock(_statsMutex);
+    CommandStats& stats = _commandStats[commandName];
+    stats.commitAttempts++;
+    stats.footprint.insert(tablesWritten.begin(), tablesWritten.end());
+    if (conflicted) {
+        stats.conflicts++;
+        if (conflictPage && (stats.pageConflicts.size() < MAX_PAGES_PER_COMMAND || stats.pageConflicts.count(conflictPage))) {
+            stats.pageConflicts[conflictPage]++;
+        }
+        // Every transaction writes to a journal table, so conflicts there don't tell us anything about the command.
+        if (!conflictTable.empty() && !SStartsWith(conflictTable, "journal")) {
+            // The conflict may be on a table this command only read from, in which case it's still part of the
+            // footprint that we need to serialize on.
+            stats.footprint.insert(conflictTable);
+            uint64_t tableConflicts = ++_tableConflicts[conflictTable];
+            if (tableConflicts == HOT_TABLE_CONFLICT_THRESHOLD) {
+                SINFO("Table '" << conflictTable << "' has had " << tableConflicts
+                      << " commit conflicts, serializing commands that write to it.");
+            }
+        }
+    }
+}
+
+void BedrockConflictManager::recordBlockingFallback(const string& commandName) {
+    lock_guard<decltype(_statsMutex)> lock(_statsMutex);
+    _commandStats[commandName].blockingFallbacks++;
+}
+
+string BedrockConflictManager::getStatsJSON() {
+    lock_guard<decltype(_statsMutex)> lock(_statsMutex);
+    STable commands;
+    for (const auto& p : _commandStats) {
+        const CommandStats& stats = p.second;
+        STable commandInfo;
+        commandInfo["commitAttempts"] = stats.commitAttempts;
+        commandInfo["conflicts"] = stats.conflicts;
+        commandInfo["retries"] = stats.conflicts - min(stats.conflicts, stats.blockingFallbacks);
+        commandInfo["blockingFallbacks"] = stats.blockingFallbacks;
+        commandInfo["conflictRate"] = stats.commitAttempts ? (double)stats.conflicts / stats.commitAttempts : 0.0;
+        commandInfo["tables"] = SComposeJSONArray(stats.footprint);
+
+        // The pages with the most conflicts, most first.
+        multimap<uint64_t, uint64_t, greater<uint64_t>> pagesByConflicts;
+        for (const auto& page : stats.pageConflicts) {
+            pagesByConflicts.emplace(page.second, page.first);
+        }
+        STable hotPages;
+        for (auto it = pagesByConflicts.begin(); it != pagesByConflicts.end() && hotPages.size() < HOT_PAGES_REPORTED; it++) {
+            hotPages[to_string(it->second)] = it->first;
+        }
+        commandInfo["hotPages"] = SComposeJSONObject(hotPages);
+        commands[p.first] = SComposeJSONObject(commandInfo);
+    }
+    return SComposeJSONObject(commands);
+}
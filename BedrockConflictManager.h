@@ -0,0 +1,68 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+// Learns which tables each command writes to, and which tables are prone to commit conflicts. Commands whose write
+// footprint includes a conflict-prone ("hot") table can then be run through a lane for that table, so that they run
+// one at a time instead of running in parallel, conflicting, and throwing away their work to retry.
+class BedrockConflictManager {
+  public:
+    // A table is considered hot once this many commit conflicts have been reported on it.
+    static const uint64_t HOT_TABLE_CONFLICT_THRESHOLD = 10;
+
+    // Tables are hashed onto a fixed number of lanes, so unrelated hot tables may occasionally share a lane.
+    static const size_t LANE_COUNT = 64;
+
+    // Conflicts are counted on at most this many pages per command, and the ones with the most are reported as hot.
+    static const size_t MAX_PAGES_PER_COMMAND = 100;
+    static const size_t HOT_PAGES_REPORTED = 5;
+
+    // Holds the lanes for all of the hot tables in a command's footprint for the lifetime of this object. If the
+    // command isn't known to write to any hot tables, this does nothing.
+    class LaneLock {
+      public:
+        LaneLock(BedrockConflictManager& manager, const string& commandName);
+        ~LaneLock();
+
+      private:
+        BedrockConflictManager& _manager;
+
+        // Lanes are always locked in ascending order to prevent deadlocks between commands with different footprints.
+        set<size_t> _lanes;
+    };
+
+    // Record the result of trying to commit a command that wrote to `tablesWritten`. If the commit conflicted,
+    // `conflictTable` and `conflictPage` are the table and page that sqlite reported the conflict on, if known. Pages
+    // are only reported in the stats: which pages a command will touch can't be known before it runs, so commands are
+    // only serialized on tables.
+    void recordCommitAttempt(const string& commandName, const set<string>& tablesWritten, bool conflicted,
+                             const string& conflictTable, uint64_t conflictPage);
+
+    // Record that a command ran out of conflict retries and was moved to the blocking queue.
+    void recordBlockingFallback(const string& commandName);
+
+    // Returns a JSON object of per-command conflict statistics, keyed by command name.
+    string getStatsJSON();
+
+  private:
+    struct CommandStats {
+        set<string> footprint;
+        uint64_t commitAttempts = 0;
+        uint64_t conflicts = 0;
+        uint64_t blockingFallbacks = 0;
+
+        // The number of conflicts seen on each page.
+        map<uint64_t, uint64_t> pageConflicts;
+    };
+
+    // Returns the set of lanes that `commandName` should hold while running.
+    set<size_t> _getLanes(const string& commandName);
+
+    // Protects everything except the lanes themselves.
+    mutex _statsMutex;
+    map<string, CommandStats> _commandStats;
+
+    // The number of conflicts seen on each table.
+    map<string, uint64_t> _tableConflicts;
+
+    mutex _lanes[LANE_COUNT];
+};
@@ -52,9 +52,14 @@ uint64_t BedrockCore::_getRemainingTime(const unique_ptr<BedrockCommand>& comman
     return isProcessing ? min(processTimeout, adjustedTimeout) : adjustedTimeout;
 }
 
-bool BedrockCore::isTimedOut(unique_ptr<BedrockCommand>& command) {
+bool BedrockCore::isTimedOut(unique_ptr<BedrockCommand>& command, uint64_t expectedRuntimeUS) {
     try {
-        _getRemainingTime(command, false);
+        uint64_t remaining = _getRemainingTime(command, false);
+        if (remaining < expectedRuntimeUS) {
+            SINFO("Command " << command->request.methodLine << " has " << remaining / 1000 << "ms remaining but typically takes "
+                  << expectedRuntimeUS / 1000 << "ms, not starting it.");
+            STHROW("555 Timeout");
+        }
     } catch (const SException& e) {
         // Yep, timed out.
         _handleCommandException(command, e);
@@ -91,9 +96,9 @@ BedrockCore::RESULT BedrockCore::peekCommand(unique_ptr<BedrockCommand>& command
             // Make sure no writes happen while in peek command
             _db.setQueryOnly(true);
 
-            // Peek.
+            // Peek, or pick up where a previous `peek` left off if it was waiting on an HTTPS request.
             command->reset(BedrockCommand::STAGE::PEEK);
-            bool completed = command->peek(_db);
+            bool completed = command->hasContinuation() ? command->resume(_db) : command->peek(_db);
             SDEBUG("Plugin '" << command->getName() << "' peeked command '" << request.methodLine << "'");
 
             if (!completed) {
@@ -268,6 +273,106 @@ BedrockCore::RESULT BedrockCore::processCommand(unique_ptr<BedrockCommand>& comm
     return needsCommit ? RESULT::NEEDS_COMMIT : RESULT::NO_COMMIT_REQUIRED;
 }
 
+bool BedrockCore::speculateCommand(unique_ptr<BedrockCommand>& command) {
+    AutoTimer timer(command, BedrockCommand::PROCESS);
+    const SData& request = command->request;
+    SData& response = command->response;
+
+    // Anything left from a previous attempt is stale.
+    command->speculation.clear();
+    command->speculativeResponse.clear();
+
+    bool speculated = false;
+    try {
+        _db.startTiming(_getRemainingTime(command, true));
+        if (!_db.insideTransaction() && !_db.beginTransaction()) {
+            STHROW("501 Failed to begin transaction");
+        }
+        command->reset(BedrockCommand::STAGE::PROCESS);
+        const size_t httpsRequestCount = command->httpsRequests.size();
+        command->process(_db);
+
+        // If there's nothing to commit, there's nothing for leader to validate, either.
+        const string query = _db.getUncommittedQuery();
+        if (command->httpsRequests.size() != httpsRequestCount) {
+            SWARN("'" << request.methodLine << "' made HTTPS requests in speculative process, they'll be made again on "
+                  "leader. It should override canSpeculate.");
+        } else if (!query.empty()) {
+            set<string> tables = _db.getTablesRead();
+            tables.insert(_db.getTablesWritten().begin(), _db.getTablesWritten().end());
+            command->speculation["speculativeQuery"] = SEncodeBase64(query);
+            command->speculation["speculativeTables"] = SComposeList(tables, ",");
+            command->speculation["speculativeCommitCount"] = to_string(_db.getDBCountAtStart());
+            if (response.methodLine.empty()) {
+                response.methodLine = "200 OK";
+            }
+            if (!command->jsonContent.empty()) {
+                response.content = SComposeJSONObject(command->jsonContent);
+            }
+            command->speculativeResponse = response;
+            speculated = true;
+        }
+    } catch (...) {
+        // Whatever went wrong, leader will run `process` itself and return the real result.
+        SINFO("Couldn't speculatively process '" << request.methodLine << "' (" << SGetCurrentExceptionName()
+              << "), escalating normally.");
+    }
+    _db.rollback();
+    _db.resetTiming();
+
+    // The command goes to leader as if we'd never processed it.
+    response.clear();
+    command->jsonContent.clear();
+    return speculated;
+}
+
+BedrockCore::RESULT BedrockCore::applySpeculativeCommand(unique_ptr<BedrockCommand>& command) {
+    AutoTimer timer(command, BedrockCommand::PROCESS);
+    const SData& request = command->request;
+    const string query = SDecodeBase64(request["speculativeQuery"]);
+    const list<string> tableList = SParseList(request["speculativeTables"]);
+    const set<string> tables(tableList.begin(), tableList.end());
+    const uint64_t commitCount = request.calcU64("speculativeCommitCount");
+
+    // Every speculated write touches at least the tables it writes to.
+    if (tables.empty()) {
+        SWARN("Speculative '" << request.methodLine << "' has no tables, processing.");
+        return RESULT::SHOULD_PROCESS;
+    }
+
+    // We hold the commit lock from before we validate until we commit, so nothing can write to these tables in between.
+    _db.rollback();
+    if (!_db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE)) {
+        _db.rollback();
+        return RESULT::SHOULD_PROCESS;
+    }
+    if (!_db.tablesUnchangedSince(tables, commitCount)) {
+        SINFO("Speculative '" << request.methodLine << "' from commit " << commitCount << " is stale, processing.");
+        _db.rollback();
+        return RESULT::SHOULD_PROCESS;
+    }
+    if (!_db.writeUnmodified(query)) {
+        SWARN("Couldn't apply speculative '" << request.methodLine << "', processing.");
+        _db.rollback();
+        return RESULT::SHOULD_PROCESS;
+    }
+
+    // The query can only write to tables that were checked above.
+    for (const string& table : _db.getTablesWritten()) {
+        if (!tables.count(table)) {
+            SWARN("Speculative '" << request.methodLine << "' wrote to " << table << " which it didn't list, processing.");
+            _db.rollback();
+            return RESULT::SHOULD_PROCESS;
+        }
+    }
+
+    // The follower already has the real response, it just needs to know this was committed.
+    command->response.clear();
+    command->response.methodLine = "200 OK";
+    command->response["speculativeCommitted"] = "true";
+    return RESULT::NEEDS_COMMIT;
+}
+
 void BedrockCore::_handleCommandException(unique_ptr<BedrockCommand>& command, const SException& e) {
     string msg = "Error processing command '" + command->request.methodLine + "' (" + e.what() + "), ignoring.";
     if (!e.body.empty()) {
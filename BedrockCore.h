@@ -34,7 +34,9 @@ class BedrockCore : public SQLiteCore {
     // Checks if a command has already timed out. Like `peekCommand` without doing any work. Returns `true` and sets
     // the same command state as `peekCommand` would if the command has timed out. Returns `false` and does nothing if
     // the command hasn't timed out.
-    bool isTimedOut(unique_ptr<BedrockCommand>& command);
+    // If `expectedRuntimeUS` is set, a command with less than that much time remaining is treated as already timed
+    // out, as it's unlikely to finish before its caller gives up on it.
+    bool isTimedOut(unique_ptr<BedrockCommand>& command, uint64_t expectedRuntimeUS = 0);
 
     // Peek lets you pre-process a command. It will be called on each command before `process` is called on the same
     // command, and it *may be called multiple times*. Preventing duplicate actions on calling peek multiple times is
@@ -57,6 +59,19 @@ class BedrockCore : public SQLiteCore {
     // this command *will be passed to process again in the future to retry*.
     RESULT processCommand(unique_ptr<BedrockCommand>& command, bool exclusive = false);
 
+    // Runs `process` for a command on a follower, in the transaction left open by `peekCommand`, and always rolls it
+    // back. If it wrote anything, the resulting query, the tables it read or wrote, and the commit count it ran at are
+    // stored in `speculation`, the response is saved in `speculativeResponse`, and this returns true. Leader can then
+    // commit the query with `applySpeculativeCommand` instead of running `process` again.
+    bool speculateCommand(unique_ptr<BedrockCommand>& command);
+
+    // Begins an exclusive transaction containing the query from a follower's `speculateCommand`, if none of the tables
+    // it touched have been written since it ran, and returns NEEDS_COMMIT. Otherwise, returns SHOULD_PROCESS and the
+    // command should be processed normally. The exclusive transaction holds the commit lock from the check until the
+    // commit, so speculated commands are committed one at a time. Each one only replays a query, which is cheap, but
+    // with many of them, this can be the limit on write throughput.
+    RESULT applySpeculativeCommand(unique_ptr<BedrockCommand>& command);
+
   private:
     // When called in the context of handling an exception, returns the demangled (if possible) name of the exception.
     string _getExceptionName();
@@ -0,0 +1,78 @@
+#include "BedrockFutureCommitNotifier.h"
+
+BedrockFutureCommitNotifier::BedrockFutureCommitNotifier(BedrockCommandQueue& queue) : _queue(queue)
+{ }
+
+bool BedrockFutureCommitNotifier::waitFor(uint64_t value, unique_ptr<BedrockCommand>& command) {
+    lock_guard<decltype(_m)> lock(_m);
+    if (value <= _value) {
+        return false;
+    }
+    SINFO("Command (" << command->request.methodLine << ") depends on future commit (" << value
+          << "), storing for later. Waiting commands: " << _commands.size() + 1);
+    if (_commands.size() >= 100) {
+        SHMMM("Future commit commands waiting: " << _commands.size() + 1);
+    }
+    _timeouts.emplace(command->commitWaitDeadline(), value);
+    _commands.emplace(value, move(command));
+    return true;
+}
+
+void BedrockFutureCommitNotifier::notifyThrough(uint64_t value) {
+    lock_guard<decltype(_m)> lock(_m);
+    _value = max(_value, value);
+    auto it = _commands.begin();
+    while (it != _commands.end() && it->first <= value) {
+        SINFO("Returning command (" << it->second->request.methodLine << ") waiting on commit " << it->first
+              << " to queue, now have commit " << value);
+        it = _release(it);
+    }
+}
+
+void BedrockFutureCommitNotifier::releaseTimedOut(uint64_t now) {
+    lock_guard<decltype(_m)> lock(_m);
+    while (!_timeouts.empty() && _timeouts.begin()->first < now) {
+        // Find the command with this timeout among those waiting on the same commit.
+        uint64_t timeout = _timeouts.begin()->first;
+        bool found = false;
+        auto range = _commands.equal_range(_timeouts.begin()->second);
+        for (auto it = range.first; it != range.second; it++) {
+            if (it->second->commitWaitDeadline() == timeout) {
+                SINFO("Returning command (" << it->second->request.methodLine << ") waiting on commit " << it->first
+                      << " to queue, timed out at: " << now << ", timeout was: " << timeout << ".");
+                _release(it);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            _timeouts.erase(_timeouts.begin());
+        }
+    }
+}
+
+void BedrockFutureCommitNotifier::releaseAll() {
+    lock_guard<decltype(_m)> lock(_m);
+    auto it = _commands.begin();
+    while (it != _commands.end()) {
+        it = _release(it);
+    }
+}
+
+size_t BedrockFutureCommitNotifier::size() {
+    lock_guard<decltype(_m)> lock(_m);
+    return _commands.size();
+}
+
+multimap<uint64_t, unique_ptr<BedrockCommand>>::iterator
+BedrockFutureCommitNotifier::_release(multimap<uint64_t, unique_ptr<BedrockCommand>>::iterator it) {
+    auto range = _timeouts.equal_range(it->second->commitWaitDeadline());
+    for (auto timeoutIt = range.first; timeoutIt != range.second; timeoutIt++) {
+        if (timeoutIt->second == it->first) {
+            _timeouts.erase(timeoutIt);
+            break;
+        }
+    }
+    _queue.push(move(it->second));
+    return _commands.erase(it);
+}
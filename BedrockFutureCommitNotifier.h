@@ -0,0 +1,45 @@
+#pragma once
+#include <libstuff/libstuff.h>
+#include "BedrockCommandQueue.h"
+
+// Holds commands that depend on a commit count newer than the local database has, and moves each one to a command
+// queue as soon as the commit it's waiting for happens. Like `SQLiteSequentialNotifier`, waiters are indexed by the
+// value they're waiting for, so each notification only touches the commands that are actually released.
+class BedrockFutureCommitNotifier {
+  public:
+    BedrockFutureCommitNotifier(BedrockCommandQueue& queue);
+
+    // Takes ownership of `command` until the commit count reaches `value`, and returns true. If `value` has already
+    // been reached (i.e., a commit happened after the caller checked), returns false and leaves `command` with the
+    // caller.
+    bool waitFor(uint64_t value, unique_ptr<BedrockCommand>& command);
+
+    // Releases all commands waiting for a value up to and including `value`.
+    void notifyThrough(uint64_t value);
+
+    // Releases all commands whose `commitWaitDeadline` is before `now`, so a worker can time them out, or run them
+    // without the commit if they've asked to.
+    void releaseTimedOut(uint64_t now);
+
+    // Releases all commands regardless of what they're waiting for.
+    void releaseAll();
+
+    // Returns the number of commands waiting.
+    size_t size();
+
+  private:
+    // Releases the command at `it` and removes it from both maps. Expects `_m` to be locked.
+    multimap<uint64_t, unique_ptr<BedrockCommand>>::iterator _release(multimap<uint64_t, unique_ptr<BedrockCommand>>::iterator it);
+
+    BedrockCommandQueue& _queue;
+    mutex _m;
+
+    // The highest value passed to `notifyThrough`.
+    uint64_t _value = 0;
+
+    // Waiting commands, by the commit count they're waiting for.
+    multimap<uint64_t, unique_ptr<BedrockCommand>> _commands;
+
+    // The commit count each waiting command is waiting for, by its `commitWaitDeadline`.
+    multimap<uint64_t, uint64_t> _timeouts;
+};
@@ -0,0 +1,91 @@
+#include "BedrockHTTPSEventLoop.h"
+
+BedrockHTTPSEventLoop::BedrockHTTPSEventLoop(Callback&& onComplete)
+  : _onComplete(move(onComplete)),
+    _thread(&BedrockHTTPSEventLoop::_run, this)
+{ }
+
+BedrockHTTPSEventLoop::~BedrockHTTPSEventLoop() {
+    stop();
+}
+
+void BedrockHTTPSEventLoop::waitFor(unique_ptr<BedrockCommand>&& command) {
+    SAUTOPREFIX(command->request);
+    {
+        lock_guard<decltype(_m)> lock(_m);
+        _commands.insert(move(command));
+    }
+    _wakeup.push(true);
+}
+
+void BedrockHTTPSEventLoop::setShortTimeouts(bool shortTimeouts) {
+    _shortTimeouts.store(shortTimeouts);
+}
+
+void BedrockHTTPSEventLoop::stop() {
+    if (_thread.joinable()) {
+        _exit.store(true);
+        _wakeup.push(true);
+        _thread.join();
+    }
+    lock_guard<decltype(_m)> lock(_m);
+    if (_commands.size()) {
+        SWARN("Stopping with " << _commands.size() << " commands still waiting on HTTPS requests.");
+    }
+    _commands.clear();
+}
+
+size_t BedrockHTTPSEventLoop::size() {
+    lock_guard<decltype(_m)> lock(_m);
+    return _commands.size();
+}
+
+void BedrockHTTPSEventLoop::_run() {
+    SInitialize("https");
+    uint64_t nextActivity = STimeNow();
+    while (!_exit.load()) {
+        fd_map fdm;
+        {
+            lock_guard<decltype(_m)> lock(_m);
+            for (auto& command : _commands) {
+                command->prePoll(fdm);
+            }
+        }
+        _wakeup.prePoll(fdm);
+
+        const uint64_t now = STimeNow();
+        S_poll(fdm, max(nextActivity, now) - now);
+        nextActivity = STimeNow() + STIME_US_PER_S;
+
+        // Just clear this, it doesn't matter what the contents are.
+        _wakeup.postPoll(fdm);
+        _wakeup.clear();
+
+        // By default, we can poll up to 5 min.
+        const uint64_t maxWaitMS = _shortTimeouts.load() ? 5'000 : 5 * 60 * 1'000;
+        list<unique_ptr<BedrockCommand>> completed;
+        {
+            lock_guard<decltype(_m)> lock(_m);
+            auto it = _commands.begin();
+            while (it != _commands.end()) {
+                auto& command = *it;
+                command->postPoll(fdm, nextActivity, maxWaitMS);
+                if (command->areHttpsRequestsComplete()) {
+                    // Sets contain only `const` data, so the command has to be extracted to be moved out.
+                    auto nextIt = next(it);
+                    completed.push_back(move(_commands.extract(it).value()));
+                    it = nextIt;
+                } else {
+                    it++;
+                }
+            }
+        }
+
+        // Hand off completed commands without holding the lock.
+        for (auto& command : completed) {
+            SAUTOPREFIX(command->request);
+            SINFO("All HTTPS requests complete.");
+            _onComplete(move(command));
+        }
+    }
+}
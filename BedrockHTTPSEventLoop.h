@@ -0,0 +1,44 @@
+#pragma once
+#include <libstuff/libstuff.h>
+#include <libstuff/SSynchronizedQueue.h>
+#include "BedrockCommand.h"
+
+// Drives the outbound HTTPS transactions of commands waiting on them from a dedicated thread, so that a large number of
+// outstanding requests doesn't slow down the sync thread's `poll` loop, which only needs to watch peers and queues.
+// When all of a command's transactions are complete, the command is handed to the completion callback.
+class BedrockHTTPSEventLoop {
+  public:
+    typedef function<void(unique_ptr<BedrockCommand>&&)> Callback;
+
+    BedrockHTTPSEventLoop(Callback&& onComplete);
+    ~BedrockHTTPSEventLoop();
+
+    // Takes ownership of `command` until all of its `httpsRequests` are complete.
+    void waitFor(unique_ptr<BedrockCommand>&& command);
+
+    // When set, transactions time out after 5 seconds without any activity rather than 5 minutes. Used while shutting
+    // down or standing down, so a single slow remote server can't hold us up.
+    void setShortTimeouts(bool shortTimeouts);
+
+    // Stops the thread and destroys any commands still waiting, which closes their transactions. This must be called
+    // before the HTTPS managers those transactions belong to are destroyed. Called by the destructor if it hasn't been.
+    void stop();
+
+    // Returns the number of commands waiting.
+    size_t size();
+
+  private:
+    void _run();
+
+    Callback _onComplete;
+    atomic<bool> _shortTimeouts = false;
+    atomic<bool> _exit = false;
+
+    // Protects `_commands`.
+    mutex _m;
+    set<unique_ptr<BedrockCommand>> _commands;
+
+    // Interrupts `poll` so that the thread picks up newly added commands.
+    SSynchronizedQueue<bool> _wakeup;
+    thread _thread;
+};
@@ -0,0 +1,32 @@
+#include "BedrockRuntimeHistory.h"
+
+void BedrockRuntimeHistory::record(const string& commandName, uint64_t runtimeUS) {
+    lock_guard<decltype(_samplesMutex)> lock(_samplesMutex);
+    Samples& samples = _samples[commandName];
+
+    // Fill the buffer until it's full, and then start overwriting the oldest entries.
+    if (samples.values.size() < SAMPLES_PER_COMMAND) {
+        samples.values.push_back(runtimeUS);
+    } else {
+        samples.values[samples.next] = runtimeUS;
+    }
+    samples.next = (samples.next + 1) % SAMPLES_PER_COMMAND;
+
+    // Recompute the median now so that reads are cheap. This is at most SAMPLES_PER_COMMAND entries, so the copy and
+    // partial sort are negligible compared to running the command in the first place.
+    if (samples.values.size() >= MIN_SAMPLES) {
+        vector<uint64_t> sorted = samples.values;
+        auto middle = sorted.begin() + sorted.size() / 2;
+        nth_element(sorted.begin(), middle, sorted.end());
+        samples.median = *middle;
+    }
+}
+
+uint64_t BedrockRuntimeHistory::median(const string& commandName) {
+    lock_guard<decltype(_samplesMutex)> lock(_samplesMutex);
+    auto it = _samples.find(commandName);
+    if (it == _samples.end()) {
+        return 0;
+    }
+    return it->second.median;
+}
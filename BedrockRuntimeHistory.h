@@ -0,0 +1,32 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+// Keeps a rolling window of recent execution times for each command name, so that we can estimate how long a command
+// is likely to take before we start working on it. This is used to drop commands that can't possibly finish before
+// their timeout.
+class BedrockRuntimeHistory {
+  public:
+    // The number of samples to keep for each command name.
+    static const size_t SAMPLES_PER_COMMAND = 100;
+
+    // We don't report a median until we've seen at least this many samples for a command name.
+    static const size_t MIN_SAMPLES = 10;
+
+    // Record that a command with the given name took `runtimeUS` microseconds to execute.
+    void record(const string& commandName, uint64_t runtimeUS);
+
+    // Returns the median runtime in microseconds of the last SAMPLES_PER_COMMAND executions of the given command
+    // name, or 0 if we don't have enough history to make a guess.
+    uint64_t median(const string& commandName);
+
+  private:
+    // A ring buffer of samples for a single command name, along with the median computed the last time it changed.
+    struct Samples {
+        vector<uint64_t> values;
+        size_t next = 0;
+        uint64_t median = 0;
+    };
+
+    mutex _samplesMutex;
+    map<string, Samples> _samples;
+};
@@ -15,6 +15,7 @@
 #include <libstuff/SRandom.h>
 #include <libstuff/AutoTimer.h>
 #include <sqlitecluster/SQLitePeer.h>
+#include <sqlitecluster/SQLitePageCache.h>
 
 set<string>BedrockServer::_blacklistedParallelCommands;
 shared_timed_mutex BedrockServer::_blacklistedParallelCommandMutex;
@@ -31,17 +32,8 @@ bool BedrockServer::canStandDown() {
         size_t blockingQueueSize = _blockingCommandQueue.size();
         size_t syncNodeQueueSize = _syncNodeQueuedCommands.size();
 
-        // These two aren't all nicely packaged so we need to lock them ourselves.
-        size_t outstandingHTTPSCommandsSize = 0;
-        {
-            lock_guard<decltype(_httpsCommandMutex)> lock(_httpsCommandMutex);
-            outstandingHTTPSCommandsSize = _outstandingHTTPSCommands.size();
-        }
-        size_t futureCommitCommandsSize = 0;
-        {
-            lock_guard<decltype(_futureCommitCommandMutex)> lock(_futureCommitCommandMutex);
-            futureCommitCommandsSize = _futureCommitCommands.size();
-        }
+        size_t outstandingHTTPSCommandsSize = _httpsEventLoop.size();
+        size_t futureCommitCommandsSize = _futureCommitNotifier.size();
 
         SINFO("Can't stand down with " << count << " commands remaining. Queue sizes are: "
               << "mainQueueSize: " << mainQueueSize << ", "
@@ -113,14 +105,42 @@ void BedrockServer::sync()
         workerThreads = 2;
     }
 
+    // If a maximum larger than the starting number of workers is given, the pool is adaptive, and can grow up to that
+    // maximum and shrink down to `-minWorkerThreads` (which defaults to the starting number).
+    int maxWorkerThreads = max(workerThreads, args.calc("-maxWorkerThreads"));
+    int minWorkerThreads = args.isSet("-minWorkerThreads") ? max(2, min(workerThreads, args.calc("-minWorkerThreads"))) : workerThreads;
+    if (maxWorkerThreads > workerThreads) {
+        SINFO("Using adaptive worker pool with between " << minWorkerThreads << " and " << maxWorkerThreads << " threads.");
+        atomic_store(&_workerPoolController, make_shared<BedrockWorkerPoolController>(minWorkerThreads, maxWorkerThreads));
+    } else {
+        atomic_store(&_workerPoolController, shared_ptr<BedrockWorkerPoolController>(nullptr));
+    }
+    _workersToRetire = 0;
+    _lastWorkerPoolSampleTime = 0;
+
     // Initialize the DB.
     int64_t mmapSizeGB = args.isSet("-mmapSizeGB") ? stoll(args["-mmapSizeGB"]) : 0;
 
     // We use fewer FDs on test machines that have other resource restrictions in place.
     int fdLimit = args.isSet("-live") ? 25'000 : 250;
     SINFO("Setting dbPool size to: " << fdLimit);
-    _dbPool = make_shared<SQLitePool>(fdLimit, args["-db"], args.calc("-cacheSize"), args.calc("-maxJournalSize"), workerThreads, args["-synchronous"], mmapSizeGB);
+    const list<string> shards = SParseList(args["-shards"]);
+    _dbPool = make_shared<SQLitePool>(fdLimit, args["-db"], args.calc("-cacheSize"), args.calc("-maxJournalSize"), maxWorkerThreads,
+                                      args["-synchronous"], mmapSizeGB, set<string>(shards.begin(), shards.end()));
     SQLite& db = _dbPool->getBase();
+    _vacuumScheduler.start(_dbPool, args.isSet("-incrementalVacuumPages") ? args.calcU64("-incrementalVacuumPages") : 1000);
+
+    // Release commands waiting on future commits as soon as each commit happens, from whichever thread commits it.
+    db.setCommitCountCallback([this](uint64_t commitCount) {
+        _futureCommitNotifier.notifyThrough(commitCount);
+    });
+    _futureCommitNotifier.notifyThrough(db.getCommitCount());
+
+    // Keep the row changes of recent commits, for `GetChanges`.
+    if (args.calcU64("-changeFeedSize")) {
+        db.getChangeFeed().setMaxBytes((args.isSet("-changeFeedMaxMB") ? args.calcU64("-changeFeedMaxMB") : 256) * 1024 * 1024);
+        db.getChangeFeed().setMaxChanges(args.calcU64("-changeFeedSize"), db.getCommitCount());
+    }
 
     // Initialize the command processor.
     BedrockCore core(db, *this);
@@ -132,16 +152,24 @@ void BedrockServer::sync()
     atomic_store(&_syncNode, make_shared<SQLiteNode>(*this, _dbPool, args["-nodeName"], args["-nodeHost"],
                                                             args["-peerList"], args.calc("-priority"), firstTimeout,
                                                             _version, args["-commandPortPrivate"]));
+    if (args.isSet("-failureDetectorPhi")) {
+        _syncNode->setFailureDetectorThreshold(SToFloat(args["-failureDetectorPhi"]));
+    }
+    if (args.isSet("-cacheWarmBudgetMS")) {
+        _syncNode->setCacheWarmingBudget(args.calc64("-cacheWarmBudgetMS") * 1000);
+    }
 
     _clusterMessenger = make_shared<SQLiteClusterMessenger>(_syncNode);
 
     // The node is now coming up, and should eventually end up in a `LEADING` or `FOLLOWING` state. We can start adding
     // our worker threads now. We don't wait until the node is `LEADING` or `FOLLOWING`, as it's state can change while
     // it's running, and our workers will have to maintain awareness of that state anyway.
+    // Workers are kept by ID, as an adaptive pool can add and remove them while we're running.
     SINFO("Starting " << workerThreads << " worker threads.");
-    list<thread> workerThreadList;
-    for (int threadId = 0; threadId < workerThreads; threadId++) {
-        workerThreadList.emplace_back(&BedrockServer::worker, this, threadId);
+    map<int, thread> workerThreadMap;
+    int nextWorkerThreadID = 0;
+    for (; nextWorkerThreadID < workerThreads; nextWorkerThreadID++) {
+        workerThreadMap.emplace(nextWorkerThreadID, thread(&BedrockServer::worker, this, nextWorkerThreadID));
     }
 
     // Now we jump into our main command processing loop.
@@ -149,6 +177,11 @@ void BedrockServer::sync()
     unique_ptr<BedrockCommand> command(nullptr);
     bool committingCommand = false;
 
+    // Background index builds are committed a step at a time, no faster than this many rows per second.
+    const uint64_t indexBuildRowsPerSecond = args.isSet("-indexBuildRowsPerSecond") ? args.calcU64("-indexBuildRowsPerSecond") : 10'000;
+    uint64_t nextIndexBuildStep = 0;
+    bool committingIndexBuild = false;
+
     // Timer for S_poll performance logging. Created outside the loop because it's cumulative.
     AutoTimer pollTimer("sync thread poll");
     AutoTimer postPollTimer("sync thread PostPoll");
@@ -160,73 +193,16 @@ void BedrockServer::sync()
             SAUTOPREFIX(command->request);
         }
 
-        // If there were commands waiting on our commit count to come up-to-date, we'll move them back to the main
-        // command queue here. There's no place in particular that's best to do this, so we do it at the top of this
-        // main loop, as that prevents it from ever getting skipped in the event that we `continue` early from a loop
-        // iteration.
+        // Commands waiting on our commit count to come up-to-date are moved back to the main command queue by
+        // `_futureCommitNotifier` as soon as that commit happens. The ones that time out first are moved back here. We
+        // do this at the top of this main loop, as that prevents it from ever getting skipped in the event that we
+        // `continue` early from a loop iteration.
         // We also move all commands back to the main queue here if we're shutting down, just to make sure they don't
         // end up lost in the ether.
-        {
-            SAUTOLOCK(_futureCommitCommandMutex);
-
-            // First, see if anything has timed out, and move that back to the main queue.
-            if (_futureCommitCommandTimeouts.size()) {
-                uint64_t now = STimeNow();
-                auto it =  _futureCommitCommandTimeouts.begin();
-                while (it != _futureCommitCommandTimeouts.end() && it->first < now) {
-                    // Find commands depending on this commit.
-                    auto itPair =  _futureCommitCommands.equal_range(it->second);
-                    for (auto cmdIt = itPair.first; cmdIt != itPair.second; cmdIt++) {
-                        // Check for one with this timeout.
-                        if (cmdIt->second->timeout() == it->first) {
-                            // This command has the right commit count *and* timeout, return it.
-                            SINFO("Returning command (" << cmdIt->second->request.methodLine << ") waiting on commit " << cmdIt->first
-                                  << " to queue, timed out at: " << now << ", timeout was: " << it->first << ".");
-
-                            // Goes back to the main queue, where it will hit it's timeout in a worker thread.
-                            _commandQueue.push(move(cmdIt->second));
-
-                            // And delete it, it's gone.
-                             _futureCommitCommands.erase(cmdIt);
-
-                            // Done.
-                            break;
-                        }
-                    }
-                    it++;
-                }
-
-                // And remove everything we just iterated through.
-                if (it != _futureCommitCommandTimeouts.begin()) {
-                    _futureCommitCommandTimeouts.erase(_futureCommitCommandTimeouts.begin(), it);
-                }
-            }
-
-            // Anything that hasn't timed out might be ready to return because the commit count is up-to-date.
-            if (!_futureCommitCommands.empty()) {
-                uint64_t commitCount = db.getCommitCount();
-                auto it = _futureCommitCommands.begin();
-                while (it != _futureCommitCommands.end() && (it->first <= commitCount || _shutdownState.load() != RUNNING)) {
-                    // Save the timeout since we'll be moving the command, thus making this inaccessible.
-                    uint64_t commandTimeout = it->second->timeout();
-                    SINFO("Returning command (" << it->second->request.methodLine << ") waiting on commit " << it->first
-                          << " to queue, now have commit " << commitCount);
-                    _commandQueue.push(move(it->second));
-
-                    // Remove it from the timed out list as well.
-                    auto itPair = _futureCommitCommandTimeouts.equal_range(commandTimeout);
-                    for (auto timeoutIt = itPair.first; timeoutIt != itPair.second; timeoutIt++) {
-                        if (timeoutIt->second == it->first) {
-                             _futureCommitCommandTimeouts.erase(timeoutIt);
-                            break;
-                        }
-                    }
-                    it++;
-                }
-                if (it != _futureCommitCommands.begin()) {
-                    _futureCommitCommands.erase(_futureCommitCommands.begin(), it);
-                }
-            }
+        if (_shutdownState.load() != RUNNING) {
+            _futureCommitNotifier.releaseAll();
+        } else {
+            _futureCommitNotifier.releaseTimedOut(STimeNow());
         }
 
         // If we're in a state where we can initialize shutdown, then go ahead and do so.
@@ -242,8 +218,9 @@ void BedrockServer::sync()
         // activity. Once any of them has activity (or the timeout ends), poll will return.
         fd_map fdm;
 
-        // Prepare our commands for `poll` (for instance, in case they're making HTTP requests).
-        _prePollCommands(fdm);
+        // Outbound HTTPS requests are handled by `_httpsEventLoop`, we just tell it whether it should be giving up
+        // on slow requests because we're trying to shut down or stand down.
+        _httpsEventLoop.setShortTimeouts(_shutdownState.load() != RUNNING || _syncNode->getState() == SQLiteNode::STANDINGDOWN);
 
         // Pre-process any sockets the sync node is managing (i.e., communication with peer nodes).
         _syncNode->prePoll(fdm);
@@ -267,13 +244,17 @@ void BedrockServer::sync()
             // Set the default log prefix.
             SAUTOPREFIX(SData());
 
-            // Process any activity in our plugins.
+            // Process any activity in our peers and queues.
             AutoTimerTime postPollTime(postPollTimer);
-            _postPollCommands(fdm, nextActivity);
             _syncNode->postPoll(fdm, nextActivity);
             _syncNodeQueuedCommands.postPoll(fdm);
         }
 
+        // Give the adaptive worker pool a chance to resize itself, about once a second.
+        if (_workerPoolController && STimeNow() >= _lastWorkerPoolSampleTime + STIME_US_PER_S) {
+            _adjustWorkerPool(workerThreadMap, nextWorkerThreadID);
+        }
+
         // Ok, let the sync node to it's updating for as many iterations as it requires. We'll update the replication
         // state when it's finished.
         SQLiteNode::State preUpdateState = _syncNode->getState();
@@ -309,6 +290,13 @@ void BedrockServer::sync()
                     committingCommand = false;
                 }
             }
+            if (committingIndexBuild) {
+                committingIndexBuild = false;
+                if (committingCommand) {
+                    db.rollback();
+                    committingCommand = false;
+                }
+            }
 
             // We should give up an any commands, and let them be re-escalated. If commands were initiated locally,
             // we can just re-queue them, they will get re-checked once things clear up, and then they'll get
@@ -340,6 +328,11 @@ void BedrockServer::sync()
             continue;
         }
 
+        // A new leader picks up any index builds that the previous one didn't finish.
+        if (preUpdateState != SQLiteNode::LEADING && nodeState == SQLiteNode::LEADING && indexBuildRowsPerSecond && !committingCommand) {
+            SQLiteIndexBuilder::loadPendingBuilds(db);
+        }
+
         // If we've just switched to the leading state, we want to upgrade the DB. We set a global `upgradeInProgress`
         // flag to prevent workers from trying to use the DB while we do this.
         // It's also possible for the upgrade to fail on the first try, in the case that our followers weren't ready to
@@ -375,6 +368,22 @@ void BedrockServer::sync()
             }
         }
 
+        // Once the upgrade is done, step through any index builds it scheduled, one small commit at a time, so that
+        // they never hold the commit lock for long.
+        if (nodeState == SQLiteNode::LEADING && !_upgradeInProgress && !committingCommand && indexBuildRowsPerSecond &&
+            SQLiteIndexBuilder::hasPendingBuilds() && STimeNow() >= nextIndexBuildStep) {
+            const uint64_t rows = min(SQLiteIndexBuilder::ROWS_PER_STEP, indexBuildRowsPerSecond);
+            if (_buildIndexStep(db, rows)) {
+                command = nullptr;
+                committingCommand = true;
+                committingIndexBuild = true;
+                _syncNode->startCommit(SQLiteNode::ASYNC);
+                nextIndexBuildStep = STimeNow() + rows * STIME_US_PER_S / indexBuildRowsPerSecond;
+                continue;
+            }
+            nextIndexBuildStep = STimeNow() + STIME_US_PER_S;
+        }
+
         // If we started a commit, and one's not in progress, then we've finished it and we'll take that command and
         // stick it back in the appropriate queue.
         if (committingCommand && !_syncNode->commitInProgress()) {
@@ -384,6 +393,15 @@ void BedrockServer::sync()
             }
             committingCommand = false;
 
+            // An index build step has no response to send either. If it failed, the next step will try it again.
+            if (committingIndexBuild) {
+                committingIndexBuild = false;
+                if (!_syncNode->commitSucceeded()) {
+                    SINFO("Index build step failed to commit, trying again.");
+                }
+                continue;
+            }
+
             // If we were upgrading, there's no response to send, we're just done.
             if (_upgradeInProgress) {
                 if (_syncNode->commitSucceeded()) {
@@ -593,12 +611,11 @@ void BedrockServer::sync()
     }
 
     // Wait for the worker threads to finish.
-    int threadId = 0;
-    for (auto& workerThread : workerThreadList) {
-        SINFO("Joining worker thread '" << "worker" << threadId << "'");
-        threadId++;
-        workerThread.join();
+    for (auto& workerThread : workerThreadMap) {
+        SINFO("Joining worker thread '" << "worker" << workerThread.first << "'");
+        workerThread.second.join();
     }
+    _retiredWorkers.clear();
 
     // If there's anything left in the command queue here, we'll discard it, because we have no way of processing it.
     if (_commandQueue.size()) {
@@ -625,6 +642,9 @@ void BedrockServer::sync()
     // Note: This is not an atomic operation but should not matter. Nothing should use this that can happen with no
     // sync thread.
     // If there are socket threads in existance, they can be looking at this through a syncThread copy.
+    _onlineBackup.cancel();
+    _vacuumScheduler.stop();
+    _dbPool->getBase().setCommitCountCallback(nullptr);
     _dbPool = nullptr;
 
     // We're really done, store our flag so main() can be aware.
@@ -658,6 +678,14 @@ void BedrockServer::worker(int threadId)
             SINFO("Dequeued command " << command->request.methodLine << " (" << command->id << ") in worker, "
                   << commandQueue.size() << " commands in " << (threadId ? "" : "blocking") << " queue.");
 
+            // Record how long this waited in the main queue, for sizing the worker pool. The last timing entry is the
+            // one the queue just finished.
+            if (threadId && command->timingInfo.size() && get<0>(command->timingInfo.back()) == BedrockCommand::QUEUE_WORKER) {
+                _queueWaitTotalUS += get<2>(command->timingInfo.back()) - get<1>(command->timingInfo.back());
+                _queueWaitCount++;
+            }
+
+            ScopedIncrement<decltype(_busyWorkers)> busy(_busyWorkers);
             runCommand(move(command), threadId == 0);
         } catch (const BedrockCommandQueue::timeout_error& e) {
             // No commands to process after 1 second.
@@ -667,7 +695,129 @@ void BedrockServer::worker(int threadId)
                 return;
             }
         }
+
+        // If the worker pool is shrinking, this thread may be the one to go.
+        if (_shouldRetireWorker(threadId)) {
+            return;
+        }
+    }
+}
+
+bool BedrockServer::_shouldRetireWorker(int threadId) {
+    // The blocking commit thread is never retired.
+    if (!threadId) {
+        return false;
+    }
+
+    // Claim one of the outstanding retirements, if there are any left.
+    int toRetire = _workersToRetire.load();
+    while (toRetire > 0) {
+        if (_workersToRetire.compare_exchange_weak(toRetire, toRetire - 1)) {
+            SINFO("Retiring worker thread to shrink worker pool.");
+            lock_guard<decltype(_retiredWorkersMutex)> lock(_retiredWorkersMutex);
+            _retiredWorkers.push_back(threadId);
+            return true;
+        }
+    }
+    return false;
+}
+
+void BedrockServer::_adjustWorkerPool(map<int, thread>& workerThreads, int& nextWorkerThreadID) {
+    // Join any workers that have exited. They've already finished their last command, so this doesn't block.
+    list<int> retired;
+    {
+        lock_guard<decltype(_retiredWorkersMutex)> lock(_retiredWorkersMutex);
+        retired = move(_retiredWorkers);
+        _retiredWorkers.clear();
+    }
+    for (int threadId : retired) {
+        auto it = workerThreads.find(threadId);
+        if (it != workerThreads.end()) {
+            it->second.join();
+            workerThreads.erase(it);
+        }
+    }
+
+    // Work out how much CPU time the process has used since the last sample.
+    uint64_t now = STimeNow();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    uint64_t cpuUS = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * STIME_US_PER_S + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    uint64_t elapsed = now - _lastWorkerPoolSampleTime;
+    bool firstSample = !_lastWorkerPoolSampleTime;
+    uint64_t cpuElapsed = cpuUS - _lastWorkerPoolSampleCPUUS;
+    _lastWorkerPoolSampleTime = now;
+    _lastWorkerPoolSampleCPUUS = cpuUS;
+    if (firstSample) {
+        // Nothing to compare against yet.
+        return;
+    }
+
+    BedrockWorkerPoolController::Sample sample;
+    sample.workers = workerThreads.size() - min(workerThreads.size(), (size_t)max(0, _workersToRetire.load()));
+    sample.busyWorkers = _busyWorkers;
+    sample.blockedWorkers = _blockedWorkers;
+    sample.queueDepth = _commandQueue.size();
+    sample.cpuUtilization = (double)cpuElapsed / (elapsed * max(1u, thread::hardware_concurrency()));
+
+    // If nothing was dequeued at all while every worker was busy, then everything in the queue has been waiting at
+    // least since the last sample.
+    uint64_t waitCount = _queueWaitCount.exchange(0);
+    uint64_t waitTotal = _queueWaitTotalUS.exchange(0);
+    if (waitCount) {
+        sample.averageQueueWaitUS = waitTotal / waitCount;
+    } else if (sample.queueDepth && sample.busyWorkers >= sample.workers) {
+        sample.averageQueueWaitUS = elapsed;
+    }
+
+    int change = _workerPoolController->evaluate(sample);
+    if (change > 0) {
+        int threadId = nextWorkerThreadID++;
+        workerThreads.emplace(threadId, thread(&BedrockServer::worker, this, threadId));
+    } else if (change < 0) {
+        _workersToRetire++;
+    }
+}
+
+bool BedrockServer::_escalateToLeader(BedrockCommand& command) {
+    auto _clusterMessengerCopy = _clusterMessenger;
+    if (!_clusterMessengerCopy) {
+        return false;
+    }
+    bool result;
+    {
+        ScopedIncrement<decltype(_blockedWorkers)> blocked(_blockedWorkers);
+        result = _clusterMessengerCopy->runOnLeader(command);
+    }
+    _useSpeculativeResponse(command);
+    return result;
+}
+
+void BedrockServer::_useSpeculativeResponse(BedrockCommand& command) {
+    if (command.complete && command.response.isSet("speculativeCommitted") && !command.speculativeResponse.empty()) {
+        string commitCount = command.response["commitCount"];
+        command.response = move(command.speculativeResponse);
+        command.response["commitCount"] = commitCount;
+    }
+    command.speculativeResponse.clear();
+}
+
+void BedrockServer::_escalateToLeaderAsync(unique_ptr<BedrockCommand>&& command) {
+    auto _clusterMessengerCopy = _clusterMessenger;
+    if (!_clusterMessengerCopy) {
+        _commandQueue.push(move(command));
+        return;
     }
+
+    // Whether or not this worked, the command goes back in the main queue. If it's complete, a worker will reply to it,
+    // otherwise, it will be retried.
+    _clusterMessengerCopy->runOnLeaderAsync(move(command), [this](unique_ptr<BedrockCommand>&& command) {
+        _useSpeculativeResponse(*command);
+        if (!command->complete) {
+            SINFO("Couldn't escalate command " << command->request.methodLine << " to leader, queuing normally.");
+        }
+        _commandQueue.push(move(command));
+    });
 }
 
 void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlocking) {
@@ -713,7 +863,11 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
     // to be returned to the main queue, where they would have timed out in `peek`, but it was never called
     // because the commands already had a HTTPS request attached, and then they were immediately re-sent to the
     // sync queue, because of the QUORUM consistency requirement, resulting in an endless loop.
-    if (core.isTimedOut(command)) {
+    // With deadline scheduling, we also give up on commands that are unlikely to finish before their timeout, based on
+    // how long commands with the same name have recently taken. That doesn't apply to commands that are already
+    // complete (committed by the sync thread, or escalated to leader), they only have their response left to send.
+    const uint64_t expectedRuntime = _deadlineScheduling && !command->complete ? _runtimeHistory.median(command->request.methodLine) : 0;
+    if (core.isTimedOut(command, expectedRuntime)) {
         _reply(command);
         return;
     }
@@ -760,8 +914,11 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
     // `escalateImmediately` (which lets them skip the queue, which is particularly useful if they're waiting
     // for a previous commit to be delivered to this follower), OR if we're on a different version from leader.
     if (state == SQLiteNode::FOLLOWING && (_version != _leaderVersion.load() || command->escalateImmediately) && !command->complete) {
-        auto _clusterMessengerCopy = _clusterMessenger;
-        if (_clusterMessengerCopy && _clusterMessengerCopy->runOnLeader(*command)) {
+        if (_multiplexEscalation) {
+            SINFO("Immediately escalating " << command->request.methodLine << " to leader.");
+            _escalateToLeaderAsync(move(command));
+            return;
+        } else if (_escalateToLeader(*command)) {
             // command->complete is now true for this command. It will get handled a few lines below.
             SINFO("Immediately escalated " << command->request.methodLine << " to leader.");
         } else {
@@ -788,23 +945,11 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
     }
 
     // If this command is dependent on a commitCount newer than what we have (maybe it's a follow-up to a
-    // command that was escalated to leader), we'll set it aside for later processing. When the sync node
-    // finishes its update loop, it will re-queue any of these commands that are no longer blocked on our
-    // updated commit count.
-    uint64_t commitCount = db.getCommitCount();
-    uint64_t commandCommitCount = command->request.calcU64("commitCount");
-    if (commandCommitCount > commitCount) {
-        SAUTOLOCK(_futureCommitCommandMutex);
-        auto newQueueSize = _futureCommitCommands.size() + 1;
-        SINFO("Command (" << command->request.methodLine << ") depends on future commit (" << commandCommitCount
-              << "), Currently at: " << commitCount << ", storing for later. Queue size: " << newQueueSize);
-        _futureCommitCommandTimeouts.insert(make_pair(command->timeout(), commandCommitCount));
-        _futureCommitCommands.insert(make_pair(commandCommitCount, move(command)));
-
-        // Don't count this as `in progress`, it's just sitting there.
-        if (newQueueSize > 100) {
-            SHMMM("_futureCommitCommands.size() == " << newQueueSize);
-        }
+    // command that was escalated to leader), we'll set it aside for later processing. It's re-queued as soon as
+    // our commit count catches up. If that happened since we checked, we can just carry on.
+    uint64_t commandCommitCount = command->commitCountToWaitFor();
+    if (commandCommitCount > db.getCommitCount() && STimeNow() < command->commitWaitDeadline() &&
+        _futureCommitNotifier.waitFor(commandCommitCount, command)) {
         return;
     }
 
@@ -824,7 +969,14 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
 
     // More checks for parallel writing.
     canWriteParallel = canWriteParallel && (state == SQLiteNode::LEADING);
-    canWriteParallel = canWriteParallel && (command->writeConsistency == SQLiteNode::ASYNC);
+    canWriteParallel = canWriteParallel && (command->writeConsistency == SQLiteNode::ASYNC || _parallelQuorumCommits);
+
+    // If an identical read is already running, let it answer this command too.
+    string singleFlightKey = _singleFlight.getKey(*command);
+    if (!singleFlightKey.empty() && !_singleFlight.start(singleFlightKey, command)) {
+        SINFO("Identical command already in flight, waiting for its response.");
+        return;
+    }
 
     // We'll retry on conflict up to this many times.
     int retry = _maxConflictRetries.load();
@@ -833,6 +985,15 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
         state = _replicationState.load();
         canWriteParallel = canWriteParallel && (state == SQLiteNode::LEADING);
 
+        // If this command writes to tables that frequently conflict, wait for our turn on those tables before starting
+        // a transaction, so that we run serially with other commands on the same tables. The blocking thread is already
+        // serialized with everything else, so it doesn't need a lane.
+        unique_ptr<BedrockConflictManager::LaneLock> laneLock;
+        if (_conflictAwareScheduling && canWriteParallel && !isBlocking) {
+            ScopedIncrement<decltype(_blockedWorkers)> blocked(_blockedWorkers);
+            laneLock = make_unique<BedrockConflictManager::LaneLock>(_conflictManager, command->request.methodLine);
+        }
+
         // If the command has any httpsRequests from a previous `peek`, we won't peek it again unless the
         // command has specifically asked for that.
         // If peek succeeds, then it's finished, and all we need to do is respond to the command at the bottom.
@@ -843,6 +1004,22 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
             calledPeek = true;
         }
 
+        // Hand our response to any identical commands that arrived while we were peeking. If we didn't finish in
+        // peek, they'll need to run on their own.
+        if (!singleFlightKey.empty()) {
+            bool completed = peekResult == BedrockCore::RESULT::COMPLETE;
+            for (auto& waiting : _singleFlight.finish(singleFlightKey, command->request.getVerb(), completed)) {
+                if (completed) {
+                    waiting->response = command->response;
+                    waiting->complete = true;
+                    _reply(waiting);
+                } else {
+                    _commandQueue.push(move(waiting));
+                }
+            }
+            singleFlightKey.clear();
+        }
+
         if (!calledPeek || peekResult == BedrockCore::RESULT::SHOULD_PROCESS) {
             // We've just unsuccessfully peeked a command, which means we're in a state where we might want to
             // write it. We'll flag that here, to keep the node from falling out of LEADING/STANDINGDOWN
@@ -896,9 +1073,16 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
             // not set at creation time, it's set in `peek`, so we need to wait at least until after peek is
             // called to check it.
             if (command->onlyProcessOnSyncThread() || !canWriteParallel) {
+                // If we're about to escalate this, we can process it here in the transaction `peek` left open, and
+                // leader can commit the result as long as nothing it used has changed by the time it gets there.
+                if (_speculativeWrites && state == SQLiteNode::FOLLOWING && !command->onlyProcessOnSyncThread() &&
+                    command->writeConsistency == SQLiteNode::ASYNC && command->canSpeculate() &&
+                    core.speculateCommand(command)) {
+                    _speculativeCommandsSent++;
+                }
+
                 // Roll back the transaction, it'll get re-run in the sync thread.
                 core.rollback();
-                auto _clusterMessengerCopy = _clusterMessenger;
                 if (state == SQLiteNode::LEADING) {
                     // Limit the command timeout to 20s to avoid blocking the sync thread long enough to cause the cluster to give up and elect a new leader (causing a fork), which happens
                     // after 30s.
@@ -909,7 +1093,10 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
                 } else if (state == SQLiteNode::STANDINGDOWN) {
                     SINFO("Need to process command " << command->request.methodLine << " but STANDINGDOWN, moving to _standDownQueue.");
                     _standDownQueue.push(move(command));
-                } else if (_clusterMessengerCopy && _clusterMessengerCopy->runOnLeader(*command)) {
+                } else if (_multiplexEscalation) {
+                    SINFO("Escalating " << command->request.methodLine << " to leader.");
+                    _escalateToLeaderAsync(move(command));
+                } else if (_escalateToLeader(*command)) {
                     SINFO("Escalated " << command->request.methodLine << " to leader and complete, responding.");
                     _reply(command);
                 } else {
@@ -923,8 +1110,16 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
                 break;
             }
 
-            // In this case, there's nothing blocking us from processing this in a worker, so let's try it.
-            BedrockCore::RESULT result = core.processCommand(command, isBlocking);
+            // In this case, there's nothing blocking us from processing this in a worker, so let's try it. If a
+            // follower already processed it, we'll commit its result instead, if we can.
+            BedrockCore::RESULT result = BedrockCore::RESULT::SHOULD_PROCESS;
+            if (command->request.isSet("speculativeQuery")) {
+                result = core.applySpeculativeCommand(command);
+                (result == BedrockCore::RESULT::NEEDS_COMMIT ? _speculativeCommandsCommitted : _speculativeCommandsRejected)++;
+            }
+            if (result == BedrockCore::RESULT::SHOULD_PROCESS) {
+                result = core.processCommand(command, isBlocking);
+            }
             if (result == BedrockCore::RESULT::NEEDS_COMMIT) {
                 // If processCommand returned true, then we need to do a commit. Otherwise, the command is
                 // done, and we just need to respond. Before we commit, we need to grab the sync thread
@@ -937,6 +1132,7 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
                 // conflict as long as we don't commit while it's performing a transaction. This is scoped
                 // to the minimum time required.
                 bool commitSuccess = false;
+                uint64_t quorumCommitCount = 0;
                 {
                     // There used to be a mutex protecting this state change, with the idea that if we
                     // prevented state changes, we couldn't fall out of leading in the middle of processing a
@@ -956,7 +1152,18 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
                         core.rollback();
                     } else {
                         BedrockCore::AutoTimer timer(command, BedrockCommand::COMMIT_WORKER);
-                        commitSuccess = core.commit(SQLiteNode::stateName(_replicationState));
+                        commitSuccess = core.commit(SQLiteNode::stateName(_replicationState), [&](uint64_t commitCount) {
+                            if (command->writeConsistency != SQLiteNode::ASYNC) {
+                                _syncNode->startQuorumCommit(commitCount, command->writeConsistency, command->timeout());
+                                quorumCommitCount = commitCount;
+                            }
+                        });
+                        if (!commitSuccess && quorumCommitCount) {
+                            _syncNode->cancelQuorumCommit(quorumCommitCount);
+                        }
+                        _conflictManager.recordCommitAttempt(command->request.methodLine, db.getTablesWritten(),
+                                                             !commitSuccess, db.getLastConflictTable(),
+                                                             db.getLastConflictPage());
                     }
                 }
                 if (commitSuccess) {
@@ -967,8 +1174,32 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
                     SINFO("Successfully committed " << command->request.methodLine << " on worker thread. blocking: "
                           << (isBlocking ? "true" : "false"));
                     // So we must still be leading, and at this point our commit has succeeded, let's
-                    // mark it as complete. We add the currentCommit count here as well.
-                    command->response["commitCount"] = to_string(db.getCommitCount());
+                    // mark it as complete. We add the currentCommit count here as well, which for a transaction
+                    // waiting on followers is its own, as other workers may have committed since.
+                    command->response["commitCount"] = to_string(quorumCommitCount ? quorumCommitCount : db.getCommitCount());
+
+                    // If this needs followers to approve it, the sync thread hands it back to us to reply to once
+                    // they have. This worker can move on to something else in the meantime.
+                    if (quorumCommitCount) {
+                        BedrockCommand* waiting = command.release();
+                        _syncNode->waitForQuorum(quorumCommitCount, [this, waiting](SQLiteNode::QuorumResult result) {
+                            unique_ptr<BedrockCommand> command(waiting);
+                            if (result != SQLiteNode::QuorumResult::APPROVED) {
+                                SWARN("Gave up waiting for approval of " << command->request.methodLine << ".");
+                                command->response.clear();
+                                if (result == SQLiteNode::QuorumResult::TIMED_OUT) {
+                                    command->response.methodLine = "555 Timeout waiting for approval";
+                                } else if (result == SQLiteNode::QuorumResult::DENIED) {
+                                    command->response.methodLine = "500 Followers denied transaction";
+                                } else {
+                                    command->response.methodLine = "500 Leader stopped leading before approval";
+                                }
+                            }
+                            command->complete = true;
+                            _commandQueue.push(move(command));
+                        });
+                        break;
+                    }
                     command->complete = true;
                 } else {
                     SINFO("Conflict or state change committing " << command->request.methodLine
@@ -1012,6 +1243,7 @@ void BedrockServer::runCommand(unique_ptr<BedrockCommand>&& _command, bool isBlo
 
         if (!retry) {
             SINFO("Max retries hit in worker, sending '" << command->request.methodLine << "' to blocking queue with size " << _blockingCommandQueue.size());
+            _conflictManager.recordBlockingFallback(command->request.methodLine);
            _blockingCommandQueue.push(move(command));
         }
     }
@@ -1169,6 +1401,11 @@ BedrockServer::BedrockServer(const SData& args_)
         SQLite::enableTrace.store(true);
     }
 
+    // Store large journal entries compressed.
+    if (args.isSet("-journalCompressionMinBytes")) {
+        SQLite::journalCompressionMinBytes.store(args.calcU64("-journalCompressionMinBytes"));
+    }
+
     // Bypass journald.
     if (args.isSet("-logDirectlyToSyslogSocket")) {
         SSyslogFunc = &SSyslogSocketDirect;
@@ -1209,6 +1446,32 @@ BedrockServer::BedrockServer(const SData& args_)
     // Set the quorum checkpoint, or default if not specified.
     _quorumCheckpointSeconds = args.isSet("-quorumCheckpointSeconds") ? args.calc("-quorumCheckpointSeconds") : 60;
 
+    // Optionally escalate commands over a shared connection to leader instead of one connection per worker.
+    _multiplexEscalation = args.isSet("-multiplexEscalation");
+
+    // Optionally commit QUORUM and ONE commands on worker threads.
+    _parallelQuorumCommits = args.isSet("-parallelQuorumCommits");
+
+    // Optionally process commands on followers and have leader validate and commit the result.
+    _speculativeWrites = args.isSet("-speculativeWrites");
+
+    // Optionally serialize commands that are known to conflict with each other.
+    _conflictAwareScheduling = args.isSet("-conflictAwareScheduling");
+
+    // Optionally coalesce identical concurrent reads of the given commands.
+    if (args.isSet("-singleFlightCommands")) {
+        list<string> commandNames = SParseList(args["-singleFlightCommands"]);
+        _singleFlight.setCommandNames(set<string>(commandNames.begin(), commandNames.end()));
+    }
+
+    // Optionally order commands within each priority by deadline.
+    _deadlineScheduling = args.isSet("-deadlineScheduling");
+    if (_deadlineScheduling) {
+        SINFO("Enabling deadline scheduling.");
+        _commandQueue.setEarliestDeadlineFirst(true);
+        _blockingCommandQueue.setEarliestDeadlineFirst(true);
+    }
+
     // Start the sync thread, which will start the worker threads.
     SINFO("Launching sync thread '" << _syncThreadName << "'");
     _syncThread = thread(&BedrockServer::syncWrapper, this);
@@ -1226,6 +1489,9 @@ BedrockServer::~BedrockServer() {
         SWARN("Shutting down with " << _outstandingSocketThreads << " socket threads remaining.");
     }
 
+    // Any commands still waiting on HTTPS requests hold transactions owned by our plugins, so clean them up first.
+    _httpsEventLoop.stop();
+
     // Delete our plugins.
     for (auto& p : plugins) {
         delete p.second;
@@ -1383,6 +1649,12 @@ void BedrockServer::_reply(unique_ptr<BedrockCommand>& command) {
     // Finalize timing info even for commands we won't respond to (this makes this data available in logs).
     command->finalizeTimingInfo();
 
+    // Remember how long this command took to run, so we can estimate how long the next one will take. Commands that
+    // timed out didn't run to completion, so they'd skew the estimate low.
+    if (_deadlineScheduling && !SStartsWith(command->response.methodLine, "555")) {
+        _runtimeHistory.record(command->request.methodLine, command->executionTime());
+    }
+
     // Don't reply to commands with pseudo-clients (i.e., commands that we generated by other commands, or using
     // `Connection: forget`.
     if (command->initiatingClientID < 0) {
@@ -1392,6 +1664,11 @@ void BedrockServer::_reply(unique_ptr<BedrockCommand>& command) {
 
     command->response["nodeName"] = args["-nodeName"];
 
+    // Commands escalated over a multiplexed connection need to be tagged so the follower can match up the response.
+    if (command->request.isSet("escalationID")) {
+        command->response["escalationID"] = command->request["escalationID"];
+    }
+
     // If we're shutting down, tell the caller to close the connection.
     // Also, if the caller wanted us to close the connection, we'll parrot that back.
     if (_shutdownState.load() != RUNNING || command->request["Connection"] == "close") {
@@ -1549,10 +1826,18 @@ void BedrockServer::_status(unique_ptr<BedrockCommand>& command) {
         STable content;
         SQLiteNode::State state = _replicationState.load();
         list<string> pluginList;
+        map<string, uint64_t> httpsConnectionStats;
         for (auto plugin : plugins) {
             STable pluginData = plugin.second->getInfo();
             pluginData["name"] = plugin.second->getName();
             pluginList.push_back(SComposeJSONObject(pluginData));
+
+            // Sum outbound connection reuse across every plugin's HTTPS managers.
+            for (auto httpsManager : plugin.second->httpsManagers) {
+                for (const auto& stat : httpsManager->getConnectionStats()) {
+                    httpsConnectionStats[stat.first] += SToUInt64(stat.second);
+                }
+            }
         }
         content["isLeader"] = state == SQLiteNode::LEADING ? "true" : "false";
         content["plugins"]  = SComposeJSONArray(pluginList);
@@ -1599,12 +1884,54 @@ void BedrockServer::_status(unique_ptr<BedrockCommand>& command) {
         content["peerList"]                    = SComposeJSONArray(peerList);
         content["queuedCommandList"]           = SComposeJSONArray(_commandQueue.getRequestMethodLines());
         content["syncThreadQueuedCommandList"] = SComposeJSONArray(syncNodeQueuedMethods);
+        content["commandConflicts"]            = _conflictManager.getStatsJSON();
+        content["singleFlight"]                = _singleFlight.getStatsJSON();
+        STable onlineBackup = _onlineBackup.getStatus();
+        if (!onlineBackup.empty()) {
+            content["onlineBackup"] = SComposeJSONObject(onlineBackup);
+        }
+        content["journalCompression"] = SComposeJSONObject(SQLite::getJournalCompressionStats());
+        auto dbPoolCopy = _dbPool;
+        if (dbPoolCopy && dbPoolCopy->getBase().getChangeFeed().enabled()) {
+            content["changeFeed"] = SComposeJSONObject(dbPoolCopy->getBase().getChangeFeed().getStats());
+        }
+        STable freelist = _vacuumScheduler.getStatus();
+        if (!freelist.empty()) {
+            content["freelist"] = SComposeJSONObject(freelist);
+        }
+        list<string> indexBuilds;
+        for (const STable& build : _indexBuilder.getProgress()) {
+            indexBuilds.push_back(SComposeJSONObject(build));
+        }
+        if (!indexBuilds.empty()) {
+            content["indexBuilds"] = SComposeJSONArray(indexBuilds);
+        }
+        if (SQLitePageCache::isInstalled()) {
+            content["pageCache"] = SComposeJSONObject(SQLitePageCache::getStats());
+        }
+        content["speculativeCommands"]         = SComposeJSONObject(STable({
+            {"sent", to_string(_speculativeCommandsSent)},
+            {"committed", to_string(_speculativeCommandsCommitted)},
+            {"rejected", to_string(_speculativeCommandsRejected)},
+        }));
+
+        STable httpsConnections;
+        for (const auto& stat : httpsConnectionStats) {
+            httpsConnections[stat.first] = to_string(stat.second);
+        }
+        content["httpsConnections"] = SComposeJSONObject(httpsConnections);
+
+        auto workerPoolController = atomic_load(&_workerPoolController);
+        if (workerPoolController) {
+            content["workerPool"] = SComposeJSONObject(workerPoolController->getState());
+        }
 
         auto _syncNodeCopy = atomic_load(&_syncNode);
         if (_syncNodeCopy) {
             content["syncNodeAvailable"] = "true";
             // Set some information about this node.
             content["CommitCount"] = to_string(_syncNodeCopy->getCommitCount());
+            content["quorumCommitsInFlight"] = to_string(_syncNodeCopy->getQuorumCommitsInFlight());
             content["priority"] = to_string(_syncNodeCopy->getPriority());
             _syncNodeCopy = nullptr;
         } else {
@@ -1648,6 +1975,8 @@ void BedrockServer::_status(unique_ptr<BedrockCommand>& command) {
 
 bool BedrockServer::_isControlCommand(const unique_ptr<BedrockCommand>& command) {
     if (SIEquals(command->request.methodLine, "BeginBackup")            ||
+        SIEquals(command->request.methodLine, "BeginOnlineBackup")      ||
+        SIEquals(command->request.methodLine, "CancelOnlineBackup")     ||
         SIEquals(command->request.methodLine, "SuppressCommandPort")    ||
         SIEquals(command->request.methodLine, "ClearCommandPort")       ||
         SIEquals(command->request.methodLine, "ClearCrashCommands")     ||
@@ -1677,6 +2006,18 @@ void BedrockServer::_control(unique_ptr<BedrockCommand>& command) {
     if (SIEquals(command->request.methodLine, "BeginBackup")) {
         _shouldBackup = true;
         _beginShutdown("Detach", true);
+    } else if (SIEquals(command->request.methodLine, "BeginOnlineBackup")) {
+        // Unlike `BeginBackup`, this keeps following while it copies a snapshot of the DB to `path`.
+        auto dbPoolCopy = _dbPool;
+        if (command->request["path"].empty()) {
+            response.methodLine = "500 Must Specify 'path'";
+        } else if (!dbPoolCopy) {
+            response.methodLine = "401 No database";
+        } else if (!_onlineBackup.start(dbPoolCopy, command->request["path"], command->request.calcU64("pagesPerSecond"))) {
+            response.methodLine = "401 Backup already in progress";
+        }
+    } else if (SIEquals(command->request.methodLine, "CancelOnlineBackup")) {
+        _onlineBackup.cancel();
     } else if (SIEquals(command->request.methodLine, "SuppressCommandPort")) {
         blockCommandPort("MANUAL");
     } else if (SIEquals(command->request.methodLine, "ClearCommandPort")) {
@@ -1740,51 +2081,17 @@ bool BedrockServer::_upgradeDB(SQLite& db) {
     return !db.getUncommittedQuery().empty();
 }
 
-void BedrockServer::_prePollCommands(fd_map& fdm) {
-    lock_guard<decltype(_httpsCommandMutex)> lock(_httpsCommandMutex);
-    for (auto& command : _outstandingHTTPSCommands) {
-        command->prePoll(fdm);
-    }
-
-    // Make sure that waiting for an HTTPS command interrupts the current `poll` in the sync thread.
-    _newCommandsWaiting.prePoll(fdm);
-}
-
-void BedrockServer::_postPollCommands(fd_map& fdm, uint64_t nextActivity) {
-    lock_guard<decltype(_httpsCommandMutex)> lock(_httpsCommandMutex);
-
-    // Just clear this, it doesn't matter what the contents are.
-    _newCommandsWaiting.postPoll(fdm);
-    _newCommandsWaiting.clear();
-
-    // Because we modify this list as we walk across it, we use an iterator to our current position.
-    auto it = _outstandingHTTPSCommands.begin();
-    while (it != _outstandingHTTPSCommands.end()) {
-        auto& command = *it;
-
-        // By default, we can poll up to 5 min.
-        uint64_t maxWaitMs = 5 * 60 * 1'000;
-        auto _syncNodeCopy = atomic_load(&_syncNode);
-        if (_shutdownState.load() != RUNNING || (_syncNodeCopy && _syncNodeCopy->getState() == SQLiteNode::STANDINGDOWN)) {
-            // But if we're trying to shut down, we give up after 5 seconds.
-            maxWaitMs = 5'000;
-        }
-        command->postPoll(fdm, nextActivity, maxWaitMs);
-
-        // If it finished all it's requests, put it back in the main queue.
-        if (command->areHttpsRequestsComplete()) {
-            SINFO("All HTTPS requests complete, returning to main queue.");
-
-            // Because sets contain only `const` data, they can't be moved-from without these weird `extract`
-            // semantics. This invalidates our iterator, so we save the one we want before we break it.
-            auto nextIt = next(it);
-            _commandQueue.push(move(_outstandingHTTPSCommands.extract(it).value()));
-            it = nextIt;
-        } else {
-            // otherwise just move on to the next command.
-            it++;
+bool BedrockServer::_buildIndexStep(SQLite& db, uint64_t maxRows) {
+    // If we can't get the commit lock quickly, or the step fails, we'll just try again on the next one.
+    try {
+        if (db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE) && _indexBuilder.step(db, maxRows)) {
+            return true;
         }
+    } catch (const exception& e) {
+        SWARN("Index build step failed: " << e.what());
     }
+    db.rollback();
+    return false;
 }
 
 void BedrockServer::_beginShutdown(const string& reason, bool detach) {
@@ -1841,8 +2148,29 @@ void BedrockServer::broadcastCommand(const SData& command) {
         return;
     }
 
-    _clusterMessengerCopy->runOnAll(command);
-    SINFO("Completed broadcast of command " << command.methodLine << ".");
+    // Nothing here needs the responses, so there's no reason to hold up the caller waiting for them.
+    string methodLine = command.methodLine;
+    _clusterMessengerCopy->runOnAllAsync(command, [methodLine](vector<SData>&& responses) {
+        SINFO("Completed broadcast of command " << methodLine << ".");
+    });
+}
+
+uint64_t BedrockServer::broadcastCommand(const SData& command, SQLiteClusterMessenger::BroadcastCallback&& callback,
+                                         uint64_t peerTimeoutUS) {
+    auto _clusterMessengerCopy = _clusterMessenger;
+    if (!_clusterMessengerCopy) {
+        SINFO("Failed to broadcast command " << command.methodLine << " to all nodes, cluster messenger does not exist.");
+        callback({});
+        return 0;
+    }
+    return _clusterMessengerCopy->runOnAllAsync(command, move(callback), peerTimeoutUS);
+}
+
+void BedrockServer::cancelBroadcast(uint64_t broadcastID) {
+    auto _clusterMessengerCopy = _clusterMessenger;
+    if (_clusterMessengerCopy) {
+        _clusterMessengerCopy->cancelBroadcast(broadcastID);
+    }
 }
 
 void BedrockServer::onNodeLogin(SQLitePeer* peer)
@@ -1987,6 +2315,12 @@ unique_ptr<BedrockCommand> BedrockServer::buildCommandFromRequest(SData&& reques
         }
     }
 
+    // Only followers escalating over the private command port can ask leader to commit a speculated write without
+    // processing it.
+    if (!shouldTreatAsLocalhost || !_speculativeWrites) {
+        BedrockCommand::removeSpeculation(request);
+    }
+
     // Get the source ip of the command.
     char *ip = inet_ntoa(socket.addr.sin_addr);
     if (!shouldTreatAsLocalhost && ip != "127.0.0.1"s) {
@@ -2037,6 +2371,26 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
     SInitialize("socket" + to_string(_socketThreadNumber++));
     SINFO("Socket thread starting");
 
+    // A follower escalating with `-multiplexEscalation` sends many commands on one socket, each tagged with an
+    // `escalationID`. Those are queued without waiting for each other, and reply in whatever order they finish. We count
+    // them so that we don't destroy the socket while any of them might still reply on it.
+    // Their replies are sent by the worker threads that finish them, and when the socket can't take all of a reply at
+    // once, this thread sends the rest. Each one writes to `wakePipe` when it's done, so that we stop waiting in `poll`
+    // for the client to send something and start waiting to send that instead. The pipe is only opened once there's a
+    // multiplexed command.
+    mutex multiplexedMutex;
+    condition_variable multiplexedCV;
+    size_t multiplexedCommands = 0;
+    int wakePipe[2] = {-1, -1};
+    function<void()> multiplexedCallback = [&multiplexedMutex, &multiplexedCV, &multiplexedCommands, &wakePipe]() {
+        lock_guard lock(multiplexedMutex);
+        multiplexedCommands--;
+        if (write(wakePipe[1], "", 1) < 0 && errno != EAGAIN) {
+            SWARN("Couldn't wake socket thread: " << strerror(errno));
+        }
+        multiplexedCV.notify_all();
+    };
+
     // This outer loop just runs until the entire socket life cycle is done, meaning it deserializes a command,
     // waits for it to get processed, deserializes another, etc, until the socket gets closed.
     // This whole block is largely duplicated from `postPoll` and modified to work on a single non-blocking socket.
@@ -2049,12 +2403,19 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
         // socket at some point, so what we do is `poll` with a 1 second timeout, and if we ever hit the timeout and
         // are in a `shutting down` state, then we finish up and exit. In any other case, we just wait in `poll` again
         // until we get some data or a disconnection.
+        // If multiplexed commands have replied with more than the socket could send at once, we also wait to send the
+        // rest.
         int pollResult = 0;
-        struct pollfd pollStruct = { socket.s, POLLIN, 0 };
+        struct pollfd pollStructs[2] = {{ socket.s, POLLIN, 0 }, { wakePipe[0], POLLIN, 0 }};
+        struct pollfd& pollStruct = pollStructs[0];
 
         // As long as `poll` returns 0 we've timed out, indicating that we're still waiting for something to happen. In
         // that case, we'll loop again *unless* we're shutting down.
-        while (!(pollResult = poll(&pollStruct, 1, 1'000))) {
+        while (true) {
+            pollStruct.events = socket.sendBufferEmpty() ? POLLIN : (POLLIN | POLLOUT);
+            if ((pollResult = poll(pollStructs, wakePipe[0] == -1 ? 1 : 2, 1'000))) {
+                break;
+            }
             if (_shutdownState != RUNNING) {
                 SINFO("Socket thread exiting because no data and shutting down.");
                 socket.shutdown(Socket::CLOSED);
@@ -2062,6 +2423,23 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
             }
         }
 
+        // A multiplexed command replied. Go back to `poll` to wait to send whatever it couldn't.
+        if (pollResult > 0 && (pollStructs[1].revents & POLLIN)) {
+            char buffer[64];
+            while (read(wakePipe[0], buffer, sizeof(buffer)) > 0) {}
+            if (!pollStruct.revents) {
+                continue;
+            }
+        }
+        if (pollResult > 0 && (pollStruct.revents & POLLOUT)) {
+            if (!socket.send()) {
+                socket.shutdown(Socket::CLOSED);
+            }
+            if (!(pollStruct.revents & POLLIN)) {
+                continue;
+            }
+        }
+
         // If the above loop didn't close the socket due to inactivity at shutdown, let's handle the activity.
         if (socket.state != STCPManager::Socket::CLOSED) {
             if (pollResult < 0) {
@@ -2146,15 +2524,29 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
 
                         // Ok, none of above synchronization code gets called unless the command has a socket to respond on.
                         bool hasSocket = command->socket;
-                        if (hasSocket) {
+                        bool multiplexed = hasSocket && command->request.isSet("escalationID");
+                        if (multiplexed) {
+                            lock_guard lock(multiplexedMutex);
+                            if (wakePipe[0] == -1) {
+                                SASSERT(!pipe(wakePipe));
+                                for (int fd : wakePipe) {
+                                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+                                }
+                            }
+                            multiplexedCommands++;
+                            command->destructionCallback = &multiplexedCallback;
+                        } else if (hasSocket) {
                             // Set the destructor callback for when the command finishes.
                             command->destructionCallback = &callback;
                         }
 
-                        // Now we queue or run this command.
+                        // Now we queue or run this command. Multiplexed commands go to the workers, so that this thread
+                        // can go on reading more of them.
                         auto _syncNodeCopy = atomic_load(&_syncNode);
                         if (_syncNodeCopy && _syncNodeCopy->getState() == SQLiteNode::STANDINGDOWN) {
                             _standDownQueue.push(move(command));
+                        } else if (multiplexed) {
+                            _commandQueue.push(move(command));
                         } else {
                             SINFO("Running new '" << command->request.methodLine << "' command from local client, with " << _commandQueue.size() << " commands already queued.");
                             runCommand(move(command));
@@ -2163,7 +2555,7 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
                         // Now that the command is queued, we wait for it to complete (if it's has a socket, and hasn't finished by the time we get to this point).
                         // When this happens, destructionCallback fires, sets `finished` to true, and we can move on to the next request.
                         unique_lock<mutex> lock(m);
-                        if (!finished && hasSocket) {
+                        if (!finished && hasSocket && !multiplexed) {
                             cv.wait(lock, [&]{return finished.load();});
                         }
                     }
@@ -2177,6 +2569,17 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
         }
     }
 
+    // Wait for any multiplexed commands that could still reply on this socket.
+    {
+        unique_lock lock(multiplexedMutex);
+        multiplexedCV.wait(lock, [&multiplexedCommands]{return multiplexedCommands == 0;});
+    }
+    for (int fd : wakePipe) {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+
     // At this point out socket is closed and we can clean up.
     // Note that we never return early, we always want to hit this code and decrement our counter and clean up our socket.
     _outstandingSocketThreads--;
@@ -2198,12 +2601,7 @@ void BedrockServer::handleSocket(Socket&& socket, bool fromControlPort, bool fro
 }
 
 void BedrockServer::waitForHTTPS(unique_ptr<BedrockCommand>&& command) {
-    SAUTOPREFIX(command->request);
-    lock_guard<mutex> lock(_httpsCommandMutex);
-    _outstandingHTTPSCommands.insert(move(command));
-
-    // Interrupt `poll` in the sync thread.
-    _newCommandsWaiting.push(true);
+    _httpsEventLoop.waitFor(move(command));
 }
 
 const atomic<SQLiteNode::State>& BedrockServer::getState() const {
@@ -1,11 +1,20 @@
 #pragma once
 #include <libstuff/libstuff.h>
+#include <sqlitecluster/SQLiteBackup.h>
+#include <sqlitecluster/SQLiteIndexBuilder.h>
+#include <sqlitecluster/SQLiteVacuumScheduler.h>
 #include <sqlitecluster/SQLiteNode.h>
 #include <sqlitecluster/SQLiteServer.h>
 #include <sqlitecluster/SQLiteClusterMessenger.h>
 #include "BedrockPlugin.h"
 #include "BedrockCommandQueue.h"
+#include "BedrockConflictManager.h"
+#include "BedrockFutureCommitNotifier.h"
+#include "BedrockHTTPSEventLoop.h"
+#include "BedrockRuntimeHistory.h"
+#include "BedrockSingleFlight.h"
 #include "BedrockTimeoutCommandQueue.h"
+#include "BedrockWorkerPoolController.h"
 
 class SQLitePeer;
 class BedrockCore;
@@ -222,6 +231,16 @@ class BedrockServer : public SQLiteServer {
     // Send a command to all of our peers. It will be wrapped appropriately.
     void broadcastCommand(const SData& message);
 
+    // Like `broadcastCommand`, but calls `callback` with each peer's response, giving up on peers that haven't
+    // responded after `peerTimeoutUS` if it's set (see `SQLiteClusterMessenger::runOnAllAsync`). Returns an ID that can
+    // be passed to `cancelBroadcast`, or 0 if there's no one to broadcast to, in which case `callback` has already
+    // been called with no responses.
+    uint64_t broadcastCommand(const SData& message, SQLiteClusterMessenger::BroadcastCallback&& callback,
+                              uint64_t peerTimeoutUS = 0);
+
+    // Stops waiting for the responses to a broadcast started by `broadcastCommand`.
+    void cancelBroadcast(uint64_t broadcastID);
+
     // Set the detach state of the server. Setting to true will cause the server to detach from the database and go
     // into a sleep loop until this is called again with false
     void setDetach(bool detach);
@@ -306,10 +325,9 @@ class BedrockServer : public SQLiteServer {
     // becomes leader. It will return true if the DB has changed and needs to be committed.
     bool _upgradeDB(SQLite& db);
 
-    // Iterate across all of our plugins and call `prePoll` and `postPoll` on any httpsManagers they've created.
-    // TODO: Can we kill `nextActivity`?
-    void _prePollCommands(fd_map& fdm);
-    void _postPollCommands(fd_map& fdm, uint64_t nextActivity);
+    // Runs the next step of any index build scheduled with `SQLiteIndexBuilder::schedule`, touching up to `maxRows`
+    // rows. Like `_upgradeDB`, returns true if there's a transaction to commit.
+    bool _buildIndexStep(SQLite& db, uint64_t maxRows);
 
     // Resets the server state so when the sync node restarts it is as if the BedrockServer object was just created.
     void _resetServer();
@@ -324,6 +342,21 @@ class BedrockServer : public SQLiteServer {
     // Each worker thread runs this function. It gets the same data as the sync thread, plus its individual thread ID.
     void worker(int threadId);
 
+    // Called by the sync thread about once a second when the worker pool is adaptive. Joins any workers that have
+    // exited, samples worker and CPU activity, and starts or retires a worker if the pool controller asks for it.
+    void _adjustWorkerPool(map<int, thread>& workerThreads, int& nextWorkerThreadID);
+
+    // Called by a worker between commands. Returns true if this worker has been chosen to exit to shrink the pool.
+    bool _shouldRetireWorker(int threadId);
+
+    // Escalates a command to leader, counting the calling worker as blocked while it waits for the response. Returns
+    // false if there's no cluster messenger or the escalation failed.
+    bool _escalateToLeader(BedrockCommand& command);
+
+    // Escalates a command to leader over the cluster messenger's shared connection, without waiting for the response.
+    // When leader responds, or the escalation fails, the command is returned to `_commandQueue`.
+    void _escalateToLeaderAsync(unique_ptr<BedrockCommand>&& command);
+
     // Send a reply for a completed command back to the initiating client. If the `originator` of the command is set,
     // then this is an error, as the command should have been sent back to a peer.
     void _reply(unique_ptr<BedrockCommand>& command);
@@ -361,15 +394,11 @@ class BedrockServer : public SQLiteServer {
     // This stars the server shutting down.
     void _beginShutdown(const string& reason, bool detach = false);
 
-    // This is a map of commit counts in the future to commands that depend on them. We can receive a command that
-    // depends on a future commit if we're a follower that's behind leader, and a client makes two requests, one to a node
-    // more current than ourselves, and a following request to us. We'll move these commands to this special map until
-    // we catch up, and then move them back to the regular command queue.
-    multimap<uint64_t, unique_ptr<BedrockCommand>> _futureCommitCommands;
-
-    // Map of command timeouts to the indexes into _futureCommitCommands where those commands live.
-    multimap<uint64_t, uint64_t> _futureCommitCommandTimeouts;
-    recursive_mutex _futureCommitCommandMutex;
+    // Holds commands that depend on a future commit. We can receive a command that depends on a future commit if we're
+    // a follower that's behind leader, and a client makes two requests, one to a node more current than ourselves, and
+    // a following request to us. We'll hold these commands here until we catch up, and then move them back to the
+    // regular command queue.
+    BedrockFutureCommitNotifier _futureCommitNotifier{_commandQueue};
 
     // A set of command names that will always be run with QUORUM consistency level.
     // Specified by the `-synchronousCommands` command-line switch.
@@ -387,6 +416,15 @@ class BedrockServer : public SQLiteServer {
 
     // Set this to cause a backup to run in detached mode
     bool _shouldBackup;
+
+    // Started by `BeginOnlineBackup`, which backs up the DB while we stay in the cluster.
+    SQLiteBackup _onlineBackup;
+
+    // Steps through scheduled index builds from the sync thread while we're leading.
+    SQLiteIndexBuilder _indexBuilder;
+
+    // Reports free pages in `Status`, and frees them in idle periods on incremental auto_vacuum databases.
+    SQLiteVacuumScheduler _vacuumScheduler;
     atomic<bool> _detach;
 
     // Pointers to the ports on which we accept commands.
@@ -411,21 +449,95 @@ class BedrockServer : public SQLiteServer {
     // The maximum number of conflicts we'll accept before forwarding a command to the sync thread.
     atomic<int> _maxConflictRetries;
 
-    mutex _httpsCommandMutex;
+    // Set by `-deadlineScheduling`. When true, commands of equal priority are dequeued in order of their timeouts, and
+    // commands with less time remaining than they typically take to run are failed before we do any work on them.
+    bool _deadlineScheduling = false;
+
+    // Recent execution times of each command, used to estimate runtimes for `_deadlineScheduling`.
+    BedrockRuntimeHistory _runtimeHistory;
+
+    // Set by `-multiplexEscalation`. When true, followers escalate commands to leader over a shared connection,
+    // without a worker waiting for each one.
+    bool _multiplexEscalation = false;
+
+    // Set by `-parallelQuorumCommits`. When true, commands that need ONE or QUORUM consistency are committed on worker
+    // threads like ASYNC commands, and their responses are held until enough followers have approved them, so that
+    // many can wait on follower round trips at once rather than one at a time on the sync thread.
+    bool _parallelQuorumCommits = false;
+
+    // Set by `-speculativeWrites`. When true, followers run `process` for commands they escalate and send leader the
+    // result, which leader commits without running `process` itself unless something it read has since changed.
+    bool _speculativeWrites = false;
+
+    // Counts of speculative commands sent by this node as a follower, and committed or rejected by it as leader.
+    atomic<uint64_t> _speculativeCommandsSent = 0;
+    atomic<uint64_t> _speculativeCommandsCommitted = 0;
+    atomic<uint64_t> _speculativeCommandsRejected = 0;
+
+    // If leader committed a command speculated on this follower, replaces the command's response with the one we
+    // computed, with leader's commit count.
+    static void _useSpeculativeResponse(BedrockCommand& command);
 
-    // This contains all of the command that _outstandingHTTPSRequests` points at. This allows us to keep only a single
-    // copy of each command, even if it has multiple requests. Sorted with the above `compareCommandByTimeout`.
-    set<unique_ptr<BedrockCommand>> _outstandingHTTPSCommands;
+    // Set by `-conflictAwareScheduling`. When true, worker threads serialize commands that write to tables that have
+    // frequently caused commit conflicts, using lanes from `_conflictManager`.
+    bool _conflictAwareScheduling = false;
 
-    // Takes a command that has an outstanding HTTPS request and saves it in _outstandingHTTPSCommands until its HTTPS
+    // The controller for the adaptive worker pool. This is null unless `-maxWorkerThreads` is set higher than the
+    // initial number of worker threads. It's created by the sync thread and read by `Status`, so it's a shared_ptr
+    // accessed atomically, like `_syncNode`.
+    shared_ptr<BedrockWorkerPoolController> _workerPoolController;
+
+    // Counts of workers currently running a command, and of those, how many are waiting on something other than the
+    // CPU (escalating to leader, or waiting for a conflict lane).
+    atomic<size_t> _busyWorkers = 0;
+    atomic<size_t> _blockedWorkers = 0;
+
+    // Increments a counter for as long as it's in scope, so the counts above stay right if a command throws.
+    template <typename CounterType>
+    class ScopedIncrement {
+      public:
+        ScopedIncrement(CounterType& counter) : _counter(counter) {
+            ++_counter;
+        }
+        ~ScopedIncrement() {
+            --_counter;
+        }
+      private:
+        CounterType& _counter;
+    };
+
+    // Total time commands have spent waiting in `_commandQueue`, and the number of commands, since the pool was last
+    // sampled.
+    atomic<uint64_t> _queueWaitTotalUS = 0;
+    atomic<uint64_t> _queueWaitCount = 0;
+
+    // The number of workers that should exit to shrink the pool. Workers that exit add their IDs to `_retiredWorkers`
+    // so the sync thread can join them.
+    atomic<int> _workersToRetire = 0;
+    mutex _retiredWorkersMutex;
+    list<int> _retiredWorkers;
+
+    // Process CPU time and wall time at the last pool sample, for computing CPU utilization.
+    uint64_t _lastWorkerPoolSampleCPUUS = 0;
+    uint64_t _lastWorkerPoolSampleTime = 0;
+
+    // Tracks the tables each command writes to and the conflicts they cause. Statistics are collected regardless of
+    // `_conflictAwareScheduling`, and reported in `Status`.
+    BedrockConflictManager _conflictManager;
+
+    // Coalesces identical concurrent reads of the commands named in `-singleFlightCommands`.
+    BedrockSingleFlight _singleFlight;
+
+    // Commands with outstanding HTTPS requests wait here, on their own thread, until the requests are complete, and
+    // are then moved back to the main queue.
+    BedrockHTTPSEventLoop _httpsEventLoop{[this](unique_ptr<BedrockCommand>&& command) {
+        _commandQueue.push(move(command));
+    }};
+
+    // Takes a command that has an outstanding HTTPS request and saves it in `_httpsEventLoop` until its HTTPS
     // requests are complete.
     void waitForHTTPS(unique_ptr<BedrockCommand>&& command);
 
-    // This doesn't really do anything in itself, but when we need to add new sockets to a poll loop (like when we
-    // create an outgoing http request) we queue something here, so that the poll loop in `sync` gets interrupted. This
-    // allows it to start again and pick up the new socket we just created.
-    SSynchronizedQueue<bool> _newCommandsWaiting;
-
     // When we're standing down, we temporarily dump newly received commands here (this lets all existing
     // partially-completed commands, like commands with HTTPS requests) finish without risking getting caught in an
     // endless loop of always having new unfinished commands.
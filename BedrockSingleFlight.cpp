@@ -0,0 +1,74 @@
+#include "BedrockSingleFlight.h"
+
+#include "BedrockCommand.h"
+
+void BedrockSingleFlight::setCommandNames(const set<string>& commandNames) {
+    lock_guard<decltype(_m)> lock(_m);
+    _commandNames = commandNames;
+}
+
+string BedrockSingleFlight::getKey(const BedrockCommand& command) {
+    // Commands that have already been peeked are part-way through running, and can't share a response.
+    if (command.peekCount || command.httpsRequests.size()) {
+        return "";
+    }
+    {
+        lock_guard<decltype(_m)> lock(_m);
+        if (!_commandNames.count(command.request.getVerb())) {
+            return "";
+        }
+    }
+
+    // Headers that describe the connection rather than the request don't need to match.
+    static const set<string> ignoredHeaders = {"_source", "Connection", "Content-Length", "requestID"};
+    string key = command.request.methodLine + "\r\n";
+    for (const auto& header : command.request.nameValueMap) {
+        if (!ignoredHeaders.count(header.first)) {
+            key += header.first + ": " + header.second + "\r\n";
+        }
+    }
+    return key + "\r\n" + command.request.content;
+}
+
+bool BedrockSingleFlight::start(const string& key, unique_ptr<BedrockCommand>& command) {
+    lock_guard<decltype(_m)> lock(_m);
+    auto it = _inFlight.find(key);
+    if (it == _inFlight.end()) {
+        _inFlight.emplace(key, list<unique_ptr<BedrockCommand>>());
+        _executions++;
+        return true;
+    }
+    it->second.push_back(move(command));
+    return false;
+}
+
+list<unique_ptr<BedrockCommand>> BedrockSingleFlight::finish(const string& key, const string& commandName, bool completed) {
+    lock_guard<decltype(_m)> lock(_m);
+    auto it = _inFlight.find(key);
+    if (it == _inFlight.end()) {
+        SWARN("Finished single-flight command that wasn't started: " << commandName);
+        return {};
+    }
+    list<unique_ptr<BedrockCommand>> waiting = move(it->second);
+    _inFlight.erase(it);
+    if (completed) {
+        _coalesced += waiting.size();
+    } else if (_commandNames.erase(commandName)) {
+        SWARN("Command " << commandName << " didn't complete in peek, it will no longer be coalesced.");
+        _disabledCommandNames.insert(commandName);
+    }
+    return waiting;
+}
+
+string BedrockSingleFlight::getStatsJSON() {
+    lock_guard<decltype(_m)> lock(_m);
+    STable stats;
+    stats["executions"] = to_string(_executions);
+    stats["coalesced"] = to_string(_coalesced);
+    stats["inFlight"] = to_string(_inFlight.size());
+    list<string> commandNames(_commandNames.begin(), _commandNames.end());
+    stats["commandNames"] = SComposeJSONArray(commandNames);
+    list<string> disabledCommandNames(_disabledCommandNames.begin(), _disabledCommandNames.end());
+    stats["disabledCommandNames"] = SComposeJSONArray(disabledCommandNames);
+    return SComposeJSONObject(stats);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+class BedrockCommand;
+
+// Coalesces identical read commands that are running at the same time. The first of a set of identical commands runs
+// normally, and any identical commands that arrive while it's running wait for it instead of running themselves. When
+// the first command finishes `peek`, its response is given to all of the commands that waited on it.
+//
+// Only commands whose names have been passed to `setCommandNames` are coalesced. If one of those commands turns out
+// not to complete in `peek` (i.e., it's not a read), it's removed from the set, and the commands that were waiting on
+// it are run normally.
+class BedrockSingleFlight {
+  public:
+    // Set the command names (the first word of the method line) that are eligible for coalescing.
+    void setCommandNames(const set<string>& commandNames);
+
+    // Returns the key that identifies commands identical to `command`, or an empty string if `command` can't be
+    // coalesced.
+    string getKey(const BedrockCommand& command);
+
+    // If an identical command is already running, takes ownership of `command` and returns false. Otherwise, records
+    // that `command` is now running for `key` and returns true, in which case the caller must call `finish`.
+    bool start(const string& key, unique_ptr<BedrockCommand>& command);
+
+    // Ends the flight for `key`, returning all of the commands that waited on it. `completed` is whether the command
+    // that ran completed in `peek`.
+    list<unique_ptr<BedrockCommand>> finish(const string& key, const string& commandName, bool completed);
+
+    // Returns a JSON object describing how many commands have been coalesced.
+    string getStatsJSON();
+
+  private:
+    mutex _m;
+    set<string> _commandNames;
+
+    // Waiting commands for each key that currently has a command running.
+    map<string, list<unique_ptr<BedrockCommand>>> _inFlight;
+
+    // The number of commands that ran, and the number that were answered with another command's response.
+    uint64_t _executions = 0;
+    uint64_t _coalesced = 0;
+    set<string> _disabledCommandNames;
+};
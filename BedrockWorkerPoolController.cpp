@@ -0,0 +1,67 @@
+#include "BedrockWorkerPoolController.h"
+
+BedrockWorkerPoolController::BedrockWorkerPoolController(size_t minWorkers, size_t maxWorkers) :
+    _minWorkers(minWorkers), _maxWorkers(max(minWorkers, maxWorkers)), _lastDecision("none")
+{ }
+
+int BedrockWorkerPoolController::evaluate(const Sample& sample) {
+    lock_guard<decltype(_stateMutex)> lock(_stateMutex);
+    _lastSample = sample;
+
+    // Workers that are actually able to use the CPU right now.
+    size_t runnableWorkers = sample.workers - min(sample.workers, sample.blockedWorkers);
+    size_t idleWorkers = sample.workers - min(sample.workers, sample.busyWorkers);
+
+    // We want to grow if commands are waiting in the queue and either the CPU has room for another thread, or workers
+    // are stuck waiting so that more threads wouldn't actually compete with each other for the CPU.
+    bool commandsWaiting = sample.queueDepth && sample.averageQueueWaitUS > GROW_QUEUE_WAIT_US;
+    bool cpuAvailable = sample.cpuUtilization < CPU_SATURATED;
+    bool workersBlocked = sample.blockedWorkers && runnableWorkers < sample.workers / 2;
+    bool wantsGrow = commandsWaiting && (cpuAvailable || workersBlocked) && sample.workers < _maxWorkers;
+
+    // We want to shrink if commands are getting picked up immediately and there are workers sitting idle, or if the
+    // CPU is saturated and nothing is blocked, in which case extra threads are just contending with each other.
+    bool underused = sample.averageQueueWaitUS < SHRINK_QUEUE_WAIT_US && idleWorkers > 1;
+    bool oversubscribed = !cpuAvailable && !sample.blockedWorkers && !commandsWaiting;
+    bool wantsShrink = !wantsGrow && (underused || oversubscribed) && sample.workers > _minWorkers;
+
+    _growStreak = wantsGrow ? _growStreak + 1 : 0;
+    _shrinkStreak = wantsShrink ? _shrinkStreak + 1 : 0;
+
+    if (_growStreak >= GROW_SAMPLES) {
+        _growStreak = 0;
+        _lastChange = STimeNow();
+        _lastDecision = "grow";
+        SINFO("Growing worker pool from " << sample.workers << " threads. Average queue wait: "
+              << sample.averageQueueWaitUS << "us, queue depth: " << sample.queueDepth << ", busy: "
+              << sample.busyWorkers << ", blocked: " << sample.blockedWorkers << ", CPU: "
+              << (int)(sample.cpuUtilization * 100) << "%.");
+        return 1;
+    }
+    if (_shrinkStreak >= SHRINK_SAMPLES) {
+        _shrinkStreak = 0;
+        _lastChange = STimeNow();
+        _lastDecision = "shrink";
+        SINFO("Shrinking worker pool from " << sample.workers << " threads. Average queue wait: "
+              << sample.averageQueueWaitUS << "us, queue depth: " << sample.queueDepth << ", busy: "
+              << sample.busyWorkers << ", blocked: " << sample.blockedWorkers << ", CPU: "
+              << (int)(sample.cpuUtilization * 100) << "%.");
+        return -1;
+    }
+    return 0;
+}
+
+STable BedrockWorkerPoolController::getState() const {
+    lock_guard<decltype(_stateMutex)> lock(_stateMutex);
+    STable state;
+    state["workers"] = _lastSample.workers;
+    state["minWorkers"] = _minWorkers;
+    state["maxWorkers"] = _maxWorkers;
+    state["busyWorkers"] = _lastSample.busyWorkers;
+    state["blockedWorkers"] = _lastSample.blockedWorkers;
+    state["averageQueueWaitUS"] = _lastSample.averageQueueWaitUS;
+    state["cpuUtilization"] = _lastSample.cpuUtilization;
+    state["lastDecision"] = _lastDecision;
+    state["lastChange"] = _lastChange;
+    return state;
+}
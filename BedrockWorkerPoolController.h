@@ -0,0 +1,72 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+// Decides when to grow or shrink the pool of worker threads. This class only makes decisions, it doesn't manage any
+// threads itself. BedrockServer samples its workers about once a second and passes the sample to `evaluate`, which
+// returns how the pool should change.
+//
+// To avoid thrashing, a change is only made after the same pressure has been seen for several consecutive samples,
+// and shrinking requires a longer run of samples than growing, as a missing worker hurts latency more than an idle
+// one hurts anything else.
+class BedrockWorkerPoolController {
+  public:
+    struct Sample {
+        // Total number of worker threads currently running, including the blocking commit thread.
+        size_t workers = 0;
+
+        // Workers currently running a command.
+        size_t busyWorkers = 0;
+
+        // Workers currently waiting on something other than the CPU, such as escalating to leader or a lock.
+        size_t blockedWorkers = 0;
+
+        // Commands waiting in the main queue.
+        size_t queueDepth = 0;
+
+        // Mean time commands dequeued since the last sample spent waiting in the queue.
+        uint64_t averageQueueWaitUS = 0;
+
+        // Process CPU usage since the last sample, as a fraction of all available cores (0.0 - 1.0).
+        double cpuUtilization = 0.0;
+    };
+
+    // Commands waiting longer than this on average are a sign we need more workers.
+    static const uint64_t GROW_QUEUE_WAIT_US = 10'000;
+
+    // Commands waiting less than this on average are a sign we might have too many.
+    static const uint64_t SHRINK_QUEUE_WAIT_US = 1'000;
+
+    // Above this CPU utilization, adding workers just oversubscribes the CPU unless they'd replace blocked workers.
+    static constexpr double CPU_SATURATED = 0.90;
+
+    // Number of consecutive samples required before we act.
+    static const int GROW_SAMPLES = 3;
+    static const int SHRINK_SAMPLES = 15;
+
+    BedrockWorkerPoolController(size_t minWorkers, size_t maxWorkers);
+
+    // Returns +1 if a worker should be added, -1 if one should be removed, or 0 to leave the pool alone.
+    int evaluate(const Sample& sample);
+
+    // Returns the most recent sample and decision, for reporting in `Status`.
+    STable getState() const;
+
+    size_t minWorkers() const { return _minWorkers; }
+    size_t maxWorkers() const { return _maxWorkers; }
+
+  private:
+    const size_t _minWorkers;
+    const size_t _maxWorkers;
+
+    // `evaluate` is called by the sync thread, but `getState` can be called by any worker.
+    mutable mutex _stateMutex;
+
+    // How many samples in a row have wanted to grow or shrink the pool.
+    int _growStreak = 0;
+    int _shrinkStreak = 0;
+
+    // Reporting state.
+    Sample _lastSample;
+    string _lastDecision;
+    uint64_t _lastChange = 0;
+};
@@ -0,0 +1,210 @@
+#include "SDNSCache.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include <libstuff/libstuff.h>
+
+SDNSCache::SDNSCache(Resolver resolver, uint64_t positiveTTL, uint64_t negativeTTL)
+  : _resolver(move(resolver)),
+    _positiveTTL(positiveTTL),
+    _negativeTTL(negativeTTL),
+    _thread(&SDNSCache::_run, this)
+{
+}
+
+SDNSCache::~SDNSCache() {
+    {
+        lock_guard<decltype(_m)> lock(_m);
+        _exit = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+}
+
+SDNSCache& SDNSCache::shared() {
+    static SDNSCache cache;
+    return cache;
+}
+
+bool SDNSCache::getaddrinfoResolver(const string& domain, uint32_t& ip) {
+    uint64_t start = STimeNow();
+
+    // Allocate and initialize addrinfo structures.
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof hints);
+    struct addrinfo* resolved = nullptr;
+
+    // Set up the hints.
+    hints.ai_family = AF_INET; // IPv4
+    hints.ai_socktype = SOCK_STREAM;
+
+    // Do the initialization.
+    int result = getaddrinfo(domain.c_str(), nullptr, &hints, &resolved);
+    SINFO("DNS lookup took " << (STimeNow() - start) / 1000 << "ms for '" << domain << "'.");
+
+    // There was a problem.
+    if (result || !resolved) {
+        SWARN("Can't resolve " << domain << ", error no#" << result);
+        freeaddrinfo(resolved);
+        return false;
+    }
+
+    // Grab the resolved address.
+    sockaddr_in* addr = (sockaddr_in*)resolved->ai_addr;
+    ip = addr->sin_addr.s_addr;
+    char plainTextIP[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr->sin_addr, plainTextIP, INET_ADDRSTRLEN);
+    SINFO("Resolved " << domain << " to ip: " << plainTextIP << ".");
+
+    // Done resolving.
+    freeaddrinfo(resolved);
+    return true;
+}
+
+bool SDNSCache::lookup(const string& domain, uint32_t& ip) {
+    // Is the domain just a raw IP?
+    uint32_t rawIP = inet_addr(domain.c_str());
+    if (rawIP && rawIP != INADDR_NONE) {
+        ip = rawIP;
+        return true;
+    }
+
+    unique_lock<decltype(_m)> lock(_m);
+    uint64_t now = STimeNow();
+    auto it = _entries.find(domain);
+    Entry* entry = nullptr;
+    if (it == _entries.end() || it->second.expiresAt < now) {
+        entry = &_resolve(domain, lock);
+    } else {
+        entry = &it->second;
+        _hits++;
+    }
+    entry->lastUsed = now;
+    ip = entry->ip;
+    return entry->resolved;
+}
+
+void SDNSCache::resolveAsync(const string& domain, Callback&& callback) {
+    uint32_t ip = 0;
+    if (isCached(domain)) {
+        bool resolved = lookup(domain, ip);
+        callback(resolved, ip);
+        return;
+    }
+    {
+        lock_guard<decltype(_m)> lock(_m);
+        _callbacks[domain].push_back(move(callback));
+        _pending.insert(domain);
+    }
+    _cv.notify_one();
+}
+
+void SDNSCache::prefetch(const string& domain) {
+    if (isCached(domain)) {
+        return;
+    }
+    {
+        lock_guard<decltype(_m)> lock(_m);
+        _pending.insert(domain);
+    }
+    _cv.notify_one();
+}
+
+bool SDNSCache::isCached(const string& domain) {
+    uint32_t rawIP = inet_addr(domain.c_str());
+    if (rawIP && rawIP != INADDR_NONE) {
+        return true;
+    }
+    lock_guard<decltype(_m)> lock(_m);
+    auto it = _entries.find(domain);
+    return it != _entries.end() && it->second.expiresAt >= STimeNow();
+}
+
+void SDNSCache::setResolver(Resolver resolver) {
+    lock_guard<decltype(_m)> lock(_m);
+    _resolver = move(resolver);
+    _entries.clear();
+}
+
+SDNSCache::Entry& SDNSCache::_resolve(const string& domain, unique_lock<mutex>& lock) {
+    // Threads that miss on the same domain at once share one lookup.
+    if (_resolving.count(domain)) {
+        _resolvedCV.wait(lock, [&]{ return !_resolving.count(domain); });
+        _hits++;
+        return _entries[domain];
+    }
+    Resolver resolver = _resolver;
+    _resolves++;
+    _resolving.insert(domain);
+    lock.unlock();
+    uint32_t ip = 0;
+    bool resolved = resolver(domain, ip);
+    lock.lock();
+    _resolving.erase(domain);
+    _resolvedCV.notify_all();
+
+    uint64_t now = STimeNow();
+    Entry& entry = _entries[domain];
+    if (resolved) {
+        entry.resolved = true;
+        entry.ip = ip;
+        entry.expiresAt = now + _positiveTTL;
+    } else if (entry.resolved) {
+        // If the resolver is failing, it's better to keep connecting to the last address we knew about than to fail
+        // every connection. We'll try again after the negative TTL.
+        SWARN("Failed to refresh " << domain << ", continuing to use the previous address.");
+        entry.expiresAt = now + _negativeTTL;
+    } else {
+        entry.expiresAt = now + _negativeTTL;
+    }
+    entry.resolvedAt = now;
+    return entry;
+}
+
+void SDNSCache::_run() {
+    SInitialize("DNSCache");
+    unique_lock<decltype(_m)> lock(_m);
+    while (!_exit) {
+        if (!_pending.empty()) {
+            string domain = *_pending.begin();
+            _pending.erase(_pending.begin());
+            Entry entry = _resolve(domain, lock);
+            list<Callback> callbacks;
+            auto callbacksIt = _callbacks.find(domain);
+            if (callbacksIt != _callbacks.end()) {
+                callbacks = move(callbacksIt->second);
+                _callbacks.erase(callbacksIt);
+            }
+            lock.unlock();
+            for (auto& callback : callbacks) {
+                callback(entry.resolved, entry.ip);
+            }
+            lock.lock();
+            continue;
+        }
+
+        // Refresh anything that's been used since it was last resolved and is about to expire, and drop anything
+        // that's gone unused for a long time.
+        uint64_t now = STimeNow();
+        for (auto it = _entries.begin(); it != _entries.end();) {
+            const Entry& entry = it->second;
+            uint64_t ttl = entry.resolved ? _positiveTTL : _negativeTTL;
+            if (entry.lastUsed + ttl * UNUSED_TTLS_BEFORE_EVICTION < now && entry.resolvedAt + ttl < now) {
+                it = _entries.erase(it);
+                continue;
+            }
+            if (entry.lastUsed > entry.resolvedAt && entry.expiresAt < now + ttl / REFRESH_AHEAD_DIVISOR) {
+                _pending.insert(it->first);
+            }
+            it++;
+        }
+        if (_pending.empty()) {
+            if (_entries.empty()) {
+                _cv.wait(lock);
+            } else {
+                _cv.wait_for(lock, chrono::seconds(1));
+            }
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// Caches DNS lookups for outbound connections. Successful lookups are cached for `positiveTTL` and failures for
+// `negativeTTL`. Entries that are still in use are refreshed in the background shortly before they expire, so threads
+// that connect to the same hosts repeatedly only block on DNS for their very first connection. Threads that can't
+// block at all can use `resolveAsync` or `prefetch` and check `isCached` instead.
+class SDNSCache {
+  public:
+    // Resolves `domain` to an IPv4 address in network byte order, returning false if it can't be resolved.
+    typedef function<bool(const string& domain, uint32_t& ip)> Resolver;
+
+    // Called with the result of `resolveAsync`.
+    typedef function<void(bool resolved, uint32_t ip)> Callback;
+
+    SDNSCache(Resolver resolver = getaddrinfoResolver, uint64_t positiveTTL = 60'000'000, uint64_t negativeTTL = 5'000'000);
+    ~SDNSCache();
+
+    // The cache used by `S_socket`.
+    static SDNSCache& shared();
+
+    // The default resolver, a blocking `getaddrinfo` call. This honors `/etc/hosts`.
+    static bool getaddrinfoResolver(const string& domain, uint32_t& ip);
+
+    // Looks up `domain`, blocking on the resolver only if there's no unexpired entry. Raw IPs never hit the resolver.
+    bool lookup(const string& domain, uint32_t& ip);
+
+    // Calls `callback` with the result for `domain`, immediately if it's cached, otherwise from the cache's thread
+    // once it's been resolved.
+    void resolveAsync(const string& domain, Callback&& callback);
+
+    // Resolves `domain` in the background if it's not already cached.
+    void prefetch(const string& domain);
+
+    // Returns true if `lookup` can answer for `domain` without blocking.
+    bool isCached(const string& domain);
+
+    // Replaces the resolver, and drops any cached results from the old one.
+    void setResolver(Resolver resolver);
+
+    // Returns the number of lookups answered from the cache and the number sent to the resolver.
+    uint64_t getHits() const { return _hits; }
+    uint64_t getResolves() const { return _resolves; }
+
+  private:
+    struct Entry {
+        bool resolved = false;
+        uint32_t ip = 0;
+        uint64_t resolvedAt = 0;
+        uint64_t expiresAt = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    // Runs the resolver for `domain` and stores the result. `lock` must be held, and is released while the resolver
+    // runs. If another thread is already resolving `domain`, this waits for its result rather than resolving it again.
+    // Returns the stored entry.
+    Entry& _resolve(const string& domain, unique_lock<mutex>& lock);
+
+    // Services `_pending` and refreshes entries about to expire.
+    void _run();
+
+    // Entries in use are refreshed when they're within this fraction of their TTL of expiring.
+    static constexpr uint64_t REFRESH_AHEAD_DIVISOR = 5;
+
+    // Entries that go unused for this many TTLs are dropped.
+    static constexpr uint64_t UNUSED_TTLS_BEFORE_EVICTION = 10;
+
+    Resolver _resolver;
+    const uint64_t _positiveTTL;
+    const uint64_t _negativeTTL;
+    atomic<uint64_t> _hits = 0;
+    atomic<uint64_t> _resolves = 0;
+    map<string, Entry> _entries;
+
+    // Domains waiting to be resolved by `_run`, and the callbacks waiting on them.
+    set<string> _pending;
+    map<string, list<Callback>> _callbacks;
+
+    // Domains the resolver is running for right now, and a condition signaled each time one finishes.
+    set<string> _resolving;
+    condition_variable _resolvedCV;
+
+    bool _exit = false;
+    mutex _m;
+    condition_variable _cv;
+    thread _thread;
+};
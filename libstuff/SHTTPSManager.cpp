@@ -3,6 +3,7 @@
 #include <BedrockPlugin.h>
 #include <BedrockServer.h>
 #include <libstuff/libstuff.h>
+#include <libstuff/SSSLState.h>
 #include <libstuff/SX509.h>
 #include <sqlitecluster/SQLiteNode.h>
 
@@ -34,18 +35,132 @@ SStandaloneHTTPSManager::SStandaloneHTTPSManager(const string& pem, const string
 }
 
 SStandaloneHTTPSManager::~SStandaloneHTTPSManager() {
+    for (auto& hostSockets : _idleSockets) {
+        for (auto& idleSocket : hostSockets.second) {
+            delete idleSocket.second;
+        }
+    }
 }
 
 void SStandaloneHTTPSManager::closeTransaction(Transaction* transaction) {
     if (transaction == nullptr) {
         return;
     }
+    if (!transaction->activeKey.empty()) {
+        lock_guard<decltype(_poolMutex)> lock(_poolMutex);
+        auto it = _activeSockets.find(transaction->activeKey);
+        if (it != _activeSockets.end() && !--it->second) {
+            _activeSockets.erase(it);
+        }
+    }
 
-    delete transaction->s;
+    // A socket can only be reused if its transaction got a complete response and the server agreed to keep it open.
+    if (transaction->s && transaction->finished && !transaction->poolKey.empty()) {
+        _returnSocket(transaction->poolKey, transaction->s);
+    } else {
+        delete transaction->s;
+    }
     transaction->s = nullptr;
     delete transaction;
 }
 
+STable SStandaloneHTTPSManager::getConnectionStats() {
+    size_t idle = 0;
+    size_t active = 0;
+    {
+        lock_guard<decltype(_poolMutex)> lock(_poolMutex);
+        for (const auto& hostSockets : _idleSockets) {
+            idle += hostSockets.second.size();
+        }
+        for (const auto& hostSockets : _activeSockets) {
+            active += hostSockets.second;
+        }
+    }
+    return {
+        {"poolHits", to_string(_poolHits.load())},
+        {"newConnections", to_string(_newConnections.load())},
+        {"tlsFullHandshakes", to_string(_tlsFullHandshakes.load())},
+        {"tlsResumedHandshakes", to_string(_tlsResumedHandshakes.load())},
+        {"idleConnections", to_string(idle)},
+        {"activeConnections", to_string(active)},
+        {"activeLimitRejections", to_string(_activeLimitRejections.load())},
+    };
+}
+
+STCPManager::Socket* SStandaloneHTTPSManager::_checkoutSocket(const string& poolKey) {
+    list<Socket*> expired;
+    Socket* socket = nullptr;
+    {
+        lock_guard<decltype(_poolMutex)> lock(_poolMutex);
+        auto hostIt = _idleSockets.find(poolKey);
+        if (hostIt == _idleSockets.end()) {
+            return nullptr;
+        }
+        uint64_t now = STimeNow();
+        auto& idleSockets = hostIt->second;
+        while (!idleSockets.empty()) {
+            auto idleSocket = idleSockets.back();
+            idleSockets.pop_back();
+            if (idleSocket.first + POOL_IDLE_TIMEOUT_US < now) {
+                expired.push_back(idleSocket.second);
+                continue;
+            }
+
+            // The server may have closed the connection while it sat idle, which shows up as EOF (or, for a server
+            // that sent something unsolicited, as data we can't attribute to any request). Either way, it's unusable.
+            char c;
+            ssize_t peeked = ::recv(idleSocket.second->s, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+            if (peeked < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                socket = idleSocket.second;
+                break;
+            }
+            expired.push_back(idleSocket.second);
+        }
+        if (idleSockets.empty()) {
+            _idleSockets.erase(hostIt);
+        }
+    }
+
+    // Close these outside the lock, an SSL close can send a close_notify.
+    for (Socket* s : expired) {
+        delete s;
+    }
+    return socket;
+}
+
+void SStandaloneHTTPSManager::_returnSocket(const string& poolKey, Socket* socket) {
+    list<Socket*> evicted;
+    {
+        lock_guard<decltype(_poolMutex)> lock(_poolMutex);
+        auto& idleSockets = _idleSockets[poolKey];
+        uint64_t now = STimeNow();
+        while (!idleSockets.empty() && (idleSockets.size() >= POOL_MAX_IDLE_PER_HOST ||
+                                        idleSockets.front().first + POOL_IDLE_TIMEOUT_US < now)) {
+            evicted.push_back(idleSockets.front().second);
+            idleSockets.pop_front();
+        }
+        idleSockets.emplace_back(now, socket);
+    }
+    for (Socket* s : evicted) {
+        delete s;
+    }
+}
+
+void SStandaloneHTTPSManager::_saveSession(const string& poolKey, Socket* socket) {
+    auto session = make_shared<SSSLSession>();
+    if (!SSSLGetSession(socket->ssl, *session)) {
+        return;
+    }
+    lock_guard<decltype(_poolMutex)> lock(_poolMutex);
+    auto it = _sessions.find(poolKey);
+    if (it != _sessions.end() && SSSLSameSession(*it->second, *session)) {
+        _tlsResumedHandshakes++;
+    } else {
+        _tlsFullHandshakes++;
+    }
+    _sessions[poolKey] = session;
+}
+
 int SStandaloneHTTPSManager::getHTTPResponseCode(const string& methodLine) {
     // This code looks for the first space in the methodLine, and then for the first non-space
     // after that, and *then* parses the response code. If we fail to find such a code, or can't parse it as an
@@ -95,8 +210,20 @@ void SStandaloneHTTPSManager::postPoll(fd_map& fdm, SStandaloneHTTPSManager::Tra
         transaction.s->recvBuffer.consumeFront(size);
         transaction.finished = now;
 
-        // Shut down the socket, we're done with it.
-        transaction.s->shutdown(Socket::CLOSED);
+        // A new TLS connection has finished its handshake by now, remember its session for the next one.
+        if (transaction.s->ssl && !transaction.reusedConnection && !transaction.poolKey.empty()) {
+            _saveSession(transaction.poolKey, transaction.s);
+        }
+
+        // Keep the socket open for another request if the server is willing, otherwise we're done with it.
+        if (transaction.poolKey.empty() || !transaction.s->recvBuffer.empty() ||
+            transaction.s->state.load() != Socket::CONNECTED ||
+            !SStartsWith(transaction.fullResponse.methodLine, "HTTP/1.1") ||
+            SIEquals(transaction.fullResponse["Connection"], "close") ||
+            SIEquals(transaction.fullRequest["Connection"], "close")) {
+            transaction.poolKey.clear();
+            transaction.s->shutdown(Socket::CLOSED);
+        }
 
         // This is supposed to check for a "200 OK" response, which it does very poorly. It also checks for message
         // content. Why this is the what constitutes a valid response is lost to time. Any well-formed response should
@@ -141,7 +268,8 @@ SStandaloneHTTPSManager::Transaction::Transaction(SStandaloneHTTPSManager& manag
     response(0),
     manager(manager_),
     sentTime(0),
-    requestID(SThreadLogPrefix)
+    requestID(SThreadLogPrefix),
+    reusedConnection(false)
 {
     manager.validate();
 }
@@ -173,18 +301,59 @@ SStandaloneHTTPSManager::Transaction* SStandaloneHTTPSManager::_httpsSend(const
 
     // Create a new transaction. This can throw if `validate` fails. We explicitly do this *before* creating a socket.
     Transaction* transaction = new Transaction(*this);
+    bool https = SStartsWith(url, "https://");
+    transaction->poolKey = (https ? "https://" : "http://") + host;
 
-    // If this is going to be an https transaction, create a certificate and give it to the socket.
-    SX509* x509 = SStartsWith(url, "https://") ? SX509Open(_pem, _srvCrt, _caCrt) : nullptr;
-    Socket* s = nullptr;
-    try {
-        s = new Socket(host, x509);
-    } catch (const SException& exception) {
+    // Don't open another connection to a host that already has as many as we allow.
+    {
+        lock_guard<decltype(_poolMutex)> lock(_poolMutex);
+        size_t& active = _activeSockets[transaction->poolKey];
+        if (active < POOL_MAX_ACTIVE_PER_HOST) {
+            active++;
+            transaction->activeKey = transaction->poolKey;
+        } else {
+            _activeLimitRejections++;
+        }
+    }
+    if (transaction->activeKey.empty()) {
+        SWARN("Already have " << POOL_MAX_ACTIVE_PER_HOST << " connections open to " << host << ", not opening another.");
         delete transaction;
-        delete x509;
         return _createErrorTransaction();
     }
 
+    // Reuse an idle connection to this host if we have one.
+    Socket* s = _checkoutSocket(transaction->poolKey);
+    if (s) {
+        transaction->reusedConnection = true;
+        _poolHits++;
+    } else {
+        // If this is going to be an https transaction, create a certificate and give it to the socket.
+        SX509* x509 = https ? SX509Open(_pem, _srvCrt, _caCrt) : nullptr;
+        try {
+            s = new Socket(host, x509);
+        } catch (const SException& exception) {
+            closeTransaction(transaction);
+            delete x509;
+            return _createErrorTransaction();
+        }
+        _newConnections++;
+
+        // Offer the server the last session we negotiated with it, so it can skip the full handshake.
+        if (s->ssl) {
+            shared_ptr<SSSLSession> session;
+            {
+                lock_guard<decltype(_poolMutex)> lock(_poolMutex);
+                auto it = _sessions.find(transaction->poolKey);
+                if (it != _sessions.end()) {
+                    session = it->second;
+                }
+            }
+            if (session) {
+                SSSLSetSession(s->ssl, *session);
+            }
+        }
+    }
+
     transaction->s = s;
     transaction->fullRequest = request;
 
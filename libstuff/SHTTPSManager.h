@@ -4,6 +4,7 @@
 #include <libstuff/STCPManager.h>
 
 class BedrockPlugin;
+struct SSSLSession;
 
 class SStandaloneHTTPSManager : public STCPManager {
   public:
@@ -24,8 +25,27 @@ class SStandaloneHTTPSManager : public STCPManager {
         SStandaloneHTTPSManager& manager;
         uint64_t sentTime;
         const string requestID;
+
+        // The keep-alive pool this transaction's socket goes back to when it's closed. Empty if the socket shouldn't
+        // be reused, either because it wasn't created by `_httpsSend` or because the server won't keep it open.
+        string poolKey;
+
+        // True if `s` was taken from the keep-alive pool rather than newly connected.
+        bool reusedConnection;
+
+        // The host this transaction's connection counts against in `POOL_MAX_ACTIVE_PER_HOST`, until it's closed.
+        // Unlike `poolKey`, this isn't cleared when the connection can't be reused.
+        string activeKey;
     };
 
+    // Idle keep-alive connections are closed after this long, and at most this many are kept per host.
+    static constexpr uint64_t POOL_IDLE_TIMEOUT_US = 10'000'000;
+    static constexpr size_t POOL_MAX_IDLE_PER_HOST = 8;
+
+    // At most this many transactions can have a connection open to the same host at once. Any more fail straight
+    // away with a 503, rather than piling more connections onto a host that's already slow to answer.
+    static constexpr size_t POOL_MAX_ACTIVE_PER_HOST = 32;
+
     // Constructor/Destructor
     SStandaloneHTTPSManager();
     SStandaloneHTTPSManager(const string& pem, const string& srvCrt, const string& caCrt);
@@ -41,6 +61,10 @@ class SStandaloneHTTPSManager : public STCPManager {
 
     static int getHTTPResponseCode(const string& methodLine);
 
+    // Returns connection reuse counters and the number of idle and active pooled connections, for reporting in
+    // `Status`.
+    STable getConnectionStats();
+
     virtual void validate() {
         // The constructor for a transaction needs to call this on it's manager. It can then throw in cases where this
         // manager should not be allowed to create transactions. This lets us have different validation behavior for
@@ -62,6 +86,36 @@ class SStandaloneHTTPSManager : public STCPManager {
 
     // Historically we only call _onRecv for `200 OK` responses. This allows manangers to handle all responses.
     virtual bool handleAllResponses() { return false; }
+
+  private:
+    // Takes a still-usable idle socket for `poolKey` out of the pool, or returns nullptr if there isn't one.
+    Socket* _checkoutSocket(const string& poolKey);
+
+    // Puts a socket that finished its last transaction cleanly back in the pool, or deletes it if the pool is full.
+    void _returnSocket(const string& poolKey, Socket* socket);
+
+    // Records the TLS session from a newly handshaken socket so that future connections to the same host can resume
+    // it rather than doing a full handshake.
+    void _saveSession(const string& poolKey, Socket* socket);
+
+    // Idle keep-alive sockets, by `poolKey`, each with the time it became idle. Most recently used is at the back.
+    map<string, list<pair<uint64_t, Socket*>>> _idleSockets;
+
+    // The number of open transactions with a connection to each host, by `activeKey`.
+    map<string, size_t> _activeSockets;
+
+    // The most recent TLS session negotiated with each host, by `poolKey`.
+    map<string, shared_ptr<SSSLSession>> _sessions;
+
+    // Protects `_idleSockets`, `_activeSockets`, and `_sessions`, which are shared by every thread running transactions.
+    mutex _poolMutex;
+
+    // Counters reported by `getConnectionStats`.
+    atomic<uint64_t> _poolHits = 0;
+    atomic<uint64_t> _newConnections = 0;
+    atomic<uint64_t> _activeLimitRejections = 0;
+    atomic<uint64_t> _tlsFullHandshakes = 0;
+    atomic<uint64_t> _tlsResumedHandshakes = 0;
 };
 
 class SHTTPSManager : public SStandaloneHTTPSManager {
@@ -21,6 +21,14 @@ SSSLState::~SSSLState() {
     mbedtls_ssl_free(&ssl);
 }
 
+SSSLSession::SSSLSession() {
+    mbedtls_ssl_session_init(&session);
+}
+
+SSSLSession::~SSSLSession() {
+    mbedtls_ssl_session_free(&session);
+}
+
 // --------------------------------------------------------------------------
 SSSLState* SSSLOpen(int s, SX509* x509) {
     // Initialize the SSL state
@@ -204,3 +212,25 @@ bool SSSLRecvAppend(SSSLState* ssl, SFastBuffer& recvBuffer) {
     // Return whether or not the socket is still alive
     return (numRecv != -1);
 }
+
+// --------------------------------------------------------------------------
+bool SSSLSetSession(SSSLState* sslState, const SSSLSession& session) {
+    SASSERT(sslState);
+    return mbedtls_ssl_set_session(&sslState->ssl, &session.session) == 0;
+}
+
+// --------------------------------------------------------------------------
+bool SSSLGetSession(SSSLState* sslState, SSSLSession& session) {
+    SASSERT(sslState);
+    if (sslState->ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        return false;
+    }
+    return mbedtls_ssl_get_session(&sslState->ssl, &session.session) == 0;
+}
+
+// --------------------------------------------------------------------------
+bool SSSLSameSession(const SSSLSession& a, const SSSLSession& b) {
+    // An abbreviated handshake reuses the master secret of the session it resumes, whether the server found it in its
+    // session cache or in a session ticket, while a full handshake always negotiates a new one.
+    return !memcmp(a.session.master, b.session.master, sizeof(a.session.master));
+}
@@ -22,6 +22,18 @@ struct SSSLState {
     ~SSSLState();
 };
 
+// A TLS session saved from a completed handshake, which can be offered to the server on a later connection.
+struct SSSLSession {
+    mbedtls_ssl_session session;
+
+    SSSLSession();
+    ~SSSLSession();
+
+    // The session owns memory that the destructor frees, so it can't be copied.
+    SSSLSession(const SSSLSession&) = delete;
+    SSSLSession& operator=(const SSSLSession&) = delete;
+};
+
 // SSL helpers
 extern SSSLState* SSSLOpen(int s, SX509* x509);
 extern int SSSLSend(SSSLState* ssl, const char* buffer, int length);
@@ -33,3 +45,9 @@ extern bool SSSLRecvAppend(SSSLState* ssl, SFastBuffer& recvBuffer);
 extern string SSSLGetState(SSSLState* ssl);
 extern void SSSLShutdown(SSSLState* ssl);
 extern void SSSLClose(SSSLState* ssl);
+
+// Session resumption helpers. `SSSLSetSession` must be called before the handshake starts. `SSSLGetSession` returns
+// false if the handshake hasn't completed.
+extern bool SSSLSetSession(SSSLState* ssl, const SSSLSession& session);
+extern bool SSSLGetSession(SSSLState* ssl, SSSLSession& session);
+extern bool SSSLSameSession(const SSSLSession& a, const SSSLSession& b);
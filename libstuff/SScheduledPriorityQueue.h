@@ -21,6 +21,11 @@
 // If two items have the same priority, the one with the older scheduled timestamp is returned.
 //
 // Items scheduled in the future are never returned (unless they've timed out).
+//
+// Optionally, the queue can be switched to "earliest deadline first" mode with `setEarliestDeadlineFirst`. In this
+// mode, priority still takes precedence, but within a single priority, the item that is ready to run (i.e., scheduled
+// before now) with the soonest timeout is returned, rather than the one with the oldest scheduled timestamp. This
+// keeps items that are about to expire from waiting behind fresh items of the same priority.
 template<typename T>
 class SScheduledPriorityQueue {
   public:
@@ -60,6 +65,10 @@ class SScheduledPriorityQueue {
     // Add an item to the queue. The queue takes ownership of the item and the caller's copy is invalidated.
     void push(T&& item, Priority priority, Scheduled scheduled, Timeout timeout);
 
+    // Enable or disable earliest-deadline-first ordering within each priority (see the comment at the top of this
+    // file).
+    void setEarliestDeadlineFirst(bool enable);
+
   protected:
 
     // Associate the item with it's timeout so that when we dequeue an item to return, we can also remove it's entry
@@ -68,12 +77,23 @@ class SScheduledPriorityQueue {
         ItemTimeoutPair(T&& _item, Timeout _timeout) : item(move(_item)), timeout(_timeout) {}
         T item;
         Timeout timeout;
+
+        // True once the item's scheduled time has passed and it's been moved into `_deadlines`.
+        bool ready = false;
     };
 
     // Removes an item from the queue and returns it, if a suitable item is available (see the comment at the top of
     // this file for what counts as a suitable item). Throws `out_of_range` otherwise.
     T _dequeue();
 
+    typedef typename multimap<Scheduled, ItemTimeoutPair>::iterator QueueIterator;
+
+    // Removes the entry for an item that's being taken out of the queue from `_deadlines` or `_scheduledLater`.
+    void _eraseDeadline(Priority priority, QueueIterator itemIt);
+
+    // Moves items whose scheduled time has passed from `_scheduledLater` into `_deadlines`.
+    void _promoteReady(uint64_t now);
+
     // Synchronization primitives for managing access to the queue.
     mutex _queueMutex;
     condition_variable _queueCondition;
@@ -84,15 +104,28 @@ class SScheduledPriorityQueue {
     // A map of timeouts back into the respective priority queue to find the item with the given timeout.
     multimap<Timeout, pair<Priority, Scheduled>> _lookupByTimeout;
 
+    // For each priority, the items in `_queue` that are ready to run, sorted by their timeout, so that
+    // earliest-deadline-first mode can find the next item without looking at anything else.
+    map<Priority, multimap<Timeout, QueueIterator>> _deadlines;
+
+    // Items in `_queue` that weren't ready to run yet when last checked, by scheduled time, with their priority.
+    multimap<Scheduled, pair<Priority, QueueIterator>> _scheduledLater;
+
     // Functions to call on each item when inserting or removing from the queue.
     function<void(T&)> _startFunction;
     function<void(T&)> _endFunction;
+
+    // If true, items within a priority are returned by earliest timeout rather than earliest scheduled time.
+    bool _earliestDeadlineFirst = false;
 };
 
 template<typename T>
 void SScheduledPriorityQueue<T>::clear()  {
     lock_guard<decltype(_queueMutex)> lock(_queueMutex);
     _queue.clear();
+    _lookupByTimeout.clear();
+    _deadlines.clear();
+    _scheduledLater.clear();
 }
 
 template<typename T>
@@ -170,10 +203,60 @@ void SScheduledPriorityQueue<T>::push(T&& item, Priority priority, Scheduled sch
     auto& queue = _queue[priority];
     _startFunction(item);
     _lookupByTimeout.insert(make_pair(timeout, make_pair(priority, scheduled)));
-    queue.emplace(scheduled, ItemTimeoutPair(move(item), timeout));
+    auto itemIt = queue.emplace(scheduled, ItemTimeoutPair(move(item), timeout));
+    if (scheduled <= STimeNow()) {
+        itemIt->second.ready = true;
+        _deadlines[priority].emplace(timeout, itemIt);
+    } else {
+        _scheduledLater.emplace(scheduled, make_pair(priority, itemIt));
+    }
     _queueCondition.notify_one();
 }
 
+template<typename T>
+void SScheduledPriorityQueue<T>::setEarliestDeadlineFirst(bool enable) {
+    lock_guard<decltype(_queueMutex)> lock(_queueMutex);
+    _earliestDeadlineFirst = enable;
+}
+
+template<typename T>
+void SScheduledPriorityQueue<T>::_eraseDeadline(Priority priority, QueueIterator itemIt) {
+    if (!itemIt->second.ready) {
+        auto matchingScheduledIterators = _scheduledLater.equal_range(itemIt->first);
+        for (auto it = matchingScheduledIterators.first; it != matchingScheduledIterators.second; it++) {
+            if (it->second.second == itemIt) {
+                _scheduledLater.erase(it);
+                break;
+            }
+        }
+        return;
+    }
+    auto deadlinesIt = _deadlines.find(priority);
+    if (deadlinesIt == _deadlines.end()) {
+        return;
+    }
+    auto matchingDeadlineIterators = deadlinesIt->second.equal_range(itemIt->second.timeout);
+    for (auto it = matchingDeadlineIterators.first; it != matchingDeadlineIterators.second; it++) {
+        if (it->second == itemIt) {
+            deadlinesIt->second.erase(it);
+            break;
+        }
+    }
+    if (deadlinesIt->second.empty()) {
+        _deadlines.erase(deadlinesIt);
+    }
+}
+
+template<typename T>
+void SScheduledPriorityQueue<T>::_promoteReady(uint64_t now) {
+    while (!_scheduledLater.empty() && _scheduledLater.begin()->first <= now) {
+        auto& [priority, itemIt] = _scheduledLater.begin()->second;
+        itemIt->second.ready = true;
+        _deadlines[priority].emplace(itemIt->second.timeout, itemIt);
+        _scheduledLater.erase(_scheduledLater.begin());
+    }
+}
+
 template<typename T>
 T SScheduledPriorityQueue<T>::_dequeue() {
     // NOTE: We don't grab a mutex here on purpose - we use a non-recursive mutex to work with condition_variable, so
@@ -182,6 +265,7 @@ T SScheduledPriorityQueue<T>::_dequeue() {
 
     // We need to know what time it is, so that we can compare to scheduled times.
     uint64_t now = STimeNow();
+    _promoteReady(now);
 
     // If anything has timed out, pull that out of the queue, and return that first.
     if (_lookupByTimeout.size()) {
@@ -217,6 +301,7 @@ T SScheduledPriorityQueue<T>::_dequeue() {
                         T item = move(thisItemTimeoutPair.item);
 
                         // Erase this item from the main queue.
+                        _eraseDeadline(itemPriority, it);
                         priorityQueueIt->second.erase(it);
 
                         // If this priority queue is empty, erase the whole thing.
@@ -250,6 +335,16 @@ T SScheduledPriorityQueue<T>::_dequeue() {
         // And look at the first item in this particular priority queue.
         auto itemIt = queueIt->second.begin();
 
+        // In earliest-deadline-first mode, we instead take the item that will time out soonest, of the ones that are
+        // ready to run. If none are, there's nothing to return from this queue.
+        if (_earliestDeadlineFirst) {
+            auto deadlinesIt = _deadlines.find(queuePriority);
+            if (deadlinesIt == _deadlines.end()) {
+                continue;
+            }
+            itemIt = deadlinesIt->second.begin()->second;
+        }
+
         // Convenience names for legibility.
         const Scheduled thisItemScheduled = itemIt->first;
         ItemTimeoutPair& thisItemTimeoutPair = itemIt->second;
@@ -263,6 +358,7 @@ T SScheduledPriorityQueue<T>::_dequeue() {
             T item = move(thisItemTimeoutPair.item);
 
             // Delete the entry in this queue.
+            _eraseDeadline(queuePriority, itemIt);
             queueIt->second.erase(itemIt);
 
             // If the whole queue is empty, delete that too.
@@ -21,6 +21,7 @@
 
 #include <libstuff/SQResult.h>
 #include <libstuff/SData.h>
+#include <libstuff/SDNSCache.h>
 #include <libstuff/SFastBuffer.h>
 #include <libstuff/sqlite3.h>
 
@@ -1711,39 +1712,10 @@ int S_socket(const string& host, bool isTCP, bool isPort, bool isBlocking) {
             STHROW("invalid host: " + host);
         }
 
-        // Is the domain just a raw IP?
-        unsigned int ip = inet_addr(domain.c_str());
-        if (!ip || ip == INADDR_NONE) {
-            // Nope -- resolve the domain
-            uint64_t start = STimeNow();
-
-            // Allocate and initialize addrinfo structures.
-            struct addrinfo hints;
-            memset(&hints, 0, sizeof hints);
-            struct addrinfo* resolved = nullptr;
-
-            // Set up the hints.
-            hints.ai_family = AF_INET; // IPv4
-            hints.ai_socktype = SOCK_STREAM;
-
-            // Do the initialization.
-            int result = getaddrinfo(domain.c_str(), to_string(port).c_str(), &hints, &resolved);
-            SINFO("DNS lookup took " << (STimeNow() - start) / 1000 << "ms for '" << domain << "'.");
-
-            // There was a problem.
-            if (result || !resolved) {
-                freeaddrinfo(resolved);
-                STHROW("can't resolve host error no#" + result);
-            }
-            // Grab the resolved address.
-            sockaddr_in* addr = (sockaddr_in*)resolved->ai_addr;
-            ip = addr->sin_addr.s_addr;
-            char plainTextIP[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &addr->sin_addr, plainTextIP, INET_ADDRSTRLEN);
-            SINFO("Resolved " << domain << " to ip: " << plainTextIP << ".");
-
-            // Done resolving.
-            freeaddrinfo(resolved);
+        // Resolve the domain, which is usually answered from the cache.
+        uint32_t ip = 0;
+        if (!SDNSCache::shared().lookup(domain, ip)) {
+            STHROW("can't resolve host " + domain);
         }
 
         // Open a socket
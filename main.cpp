@@ -17,6 +17,7 @@
 #include <plugins/MySQL.h>
 #include <libstuff/libstuff.h>
 #include <sqlitecluster/SQLite.h>
+#include <sqlitecluster/SQLitePageCache.h>
 
 /////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -164,6 +165,11 @@ int main(int argc, char* argv[]) {
     // Disable a mutex around `malloc`, which is *EXTREMELY IMPORTANT* for multi-threaded performance. Without this
     // setting, all reads are essentially single-threaded as they'll all fight with each other for this mutex.
     SASSERT(sqlite3_config(SQLITE_CONFIG_MEMSTATUS, 0) == SQLITE_OK);
+
+    // Share one page cache budget across all DB handles, rather than giving each its own `-cacheSize`.
+    if (args.isSet("-pageCacheBudgetMB")) {
+        SQLitePageCache::install(args.calcU64("-pageCacheBudgetMB") * 1024 * 1024);
+    }
     sqlite3_initialize();
     SASSERT(sqlite3_threadsafe());
 
@@ -216,8 +222,27 @@ int main(int argc, char* argv[]) {
         cout << "-q                          Enables quiet logging" << endl;
         cout << "-clean                      Recreate a new database from scratch" << endl;
         cout << "-enableMultiWrite           Enable multi-write mode (default: true)" << endl;
+        cout << "-multiplexEscalation        Escalate commands from followers over a shared connection to leader"
+             << endl;
+        cout << "-parallelQuorumCommits      Commit QUORUM and ONE commands on worker threads and wait for approvals "
+                "in parallel"
+             << endl;
+        cout << "-speculativeWrites          Process commands on followers and have leader commit the result if "
+                "nothing it read has changed (one at a time, under the commit lock)"
+             << endl;
+        cout << "-conflictAwareScheduling    Serialize commands that write to tables with frequent commit conflicts"
+             << endl;
+        cout << "-deadlineScheduling         Run commands of equal priority in timeout order, and fail commands that "
+                "can't finish in time before running them"
+             << endl;
+        cout << "-singleFlightCommands <list> Comma-separated list of read commands for which identical concurrent "
+                "requests share one execution"
+             << endl;
         cout << "-versionOverride <version>  Pretends to be a different version when talking to peers" << endl;
         cout << "-db             <filename>  Use a database with the given name (default 'bedrock.db')" << endl;
+        cout << "-shards         <list>      Put the tables of plugins that support it in these separate files next to "
+                "-db, e.g. 'cache,jobs'. Must be the same on every node, peers with different shards won't connect"
+             << endl;
         cout
             << "-serverHost     <host:port> Listen on this host:port for cluster connections (default 'localhost:8888')"
             << endl;
@@ -226,9 +251,37 @@ int main(int argc, char* argv[]) {
         cout << "-nodeHost       <host:port> Listen on this host:port for connections from other nodes" << endl;
         cout << "-peerList       <list>      See below" << endl;
         cout << "-priority       <value>     See '-peerList Details' below (defaults to 100)" << endl;
+        cout << "-failureDetectorPhi <phi>   Disconnect peers whose heartbeats are this suspiciously late (e.g. 8), "
+                "rather than after a fixed 30s timeout"
+             << endl;
         cout << "-plugins        <list>      Enable these plugins (defaults to 'db,jobs,cache,mysql')" << endl;
         cout << "-cacheSize      <kb>        number of KB to allocate for a page cache (defaults to 1GB)" << endl;
+        cout << "-pageCacheBudgetMB <mb>     Share one page cache of this many MB between all DB handles, instead of "
+                "-cacheSize per handle"
+             << endl;
+        cout << "-cacheWarmBudgetMS <ms>     Track hot tables and spend up to this long reading them back into cache "
+                "after a restart and before leading"
+             << endl;
+        cout << "-journalCompressionMinBytes <#> Store journal entries with queries at least this long gzipped "
+                "(default 0, disabled)"
+             << endl;
+        cout << "-changeFeedSize <#>         Keep the row changes of recent commits, up to this many, for GetChanges "
+                "(default 0, disabled)"
+             << endl;
+        cout << "-changeFeedMaxMB <mb>       Also keep no more than this many MB of changes, as rows with large values "
+                "take up far more than small ones (default 256, 0 for no limit)"
+             << endl;
+        cout << "-indexBuildRowsPerSecond <#> Copy rows for background index builds no faster than this (default 10000, "
+                "0 to pause them)"
+             << endl;
+        cout << "-incrementalVacuumPages <#> On auto_vacuum=INCREMENTAL databases, free up to this many pages at a time "
+                "while idle (default 1000, 0 to disable)"
+             << endl;
         cout << "-workerThreads  <#>         Number of worker threads to start (min 1, defaults to # of cores)" << endl;
+        cout << "-maxWorkerThreads <#>       Allow the worker pool to grow up to this many threads under load" << endl;
+        cout << "-minWorkerThreads <#>       With -maxWorkerThreads, allow the pool to shrink to this many threads "
+                "(defaults to -workerThreads)"
+             << endl;
         cout << "-queryLog       <filename>  Set the query log filename (default 'queryLog.csv', SIGUSR2/SIGQUIT to "
                 "enable/disable)"
              << endl;
@@ -309,6 +362,9 @@ int main(int argc, char* argv[]) {
         SDEBUG("Resetting database");
         string db = args["-db"];
         unlink(db.c_str());
+        for (const string& shard : SParseList(args["-shards"])) {
+            unlink(SQLite::getShardFilename(db, shard).c_str());
+        }
     } else if (args.isSet("-bootstrap")) {
         // Allow for bootstraping a node with no database file in place.
         SINFO("Loading in bootstrap mode, skipping check for database existance.");
@@ -355,6 +411,9 @@ int main(int argc, char* argv[]) {
         while (!server.shutdownComplete()) {
             if (server.shouldBackup() && server.isDetached()) {
                 BackupDB(args["-db"]);
+                for (const string& shard : SParseList(args["-shards"])) {
+                    BackupDB(SQLite::getShardFilename(args["-db"], shard));
+                }
                 server.setDetach(false);
             }
             // Wait and process
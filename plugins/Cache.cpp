@@ -115,18 +115,19 @@ BedrockPlugin_Cache::~BedrockPlugin_Cache() {
 #define SLOGPREFIX "{" << getName() << "} "
 
 void BedrockPlugin_Cache::upgradeDatabase(SQLite& db) {
-    // Create or verify the cache table
+    // Create or verify the cache table. Evictions churn through a lot of pages, so this goes in its own file if the
+    // server has a `cache` shard.
     bool ignore;
     while (!db.verifyTable("cache", "CREATE TABLE cache ( "
                                     "name  TEXT NOT NULL PRIMARY KEY, "
                                     "value BLOB NOT NULL ) ",
-                           ignore)) {
+                           ignore, "cache")) {
         // Drop and rebuild the table
         SASSERT(db.write("DROP TABLE cache;"));
     }
 
     // Add a one row, one column table to keep track of the current size of the cache
-    SASSERT(db.verifyTable("cacheSize", "CREATE TABLE cacheSize ( size INTEGER )", ignore));
+    SASSERT(db.verifyTable("cacheSize", "CREATE TABLE cacheSize ( size INTEGER )", ignore, "cache"));
     SQResult result;
     SASSERT(db.read("SELECT * FROM cacheSize;", result));
     if (result.empty()) {
@@ -36,6 +36,9 @@ unique_ptr<BedrockCommand> BedrockPlugin_DB::getCommand(SQLiteCommand&& baseComm
     if (SStartsWith(SToLower(baseCommand.request.methodLine), "query:") || SIEquals(baseCommand.request.getVerb(), "Query")) {
         return make_unique<BedrockDBCommand>(move(baseCommand), this);
     }
+    if (SIEquals(baseCommand.request.getVerb(), "GetChanges")) {
+        return make_unique<BedrockGetChangesCommand>(move(baseCommand), this);
+    }
     return nullptr;
 }
 
@@ -115,3 +118,54 @@ void BedrockDBCommand::process(SQLite& db) {
     // Successfully processed
     return;
 }
+
+BedrockGetChangesCommand::BedrockGetChangesCommand(SQLiteCommand&& baseCommand, BedrockPlugin_DB* plugin) :
+  BedrockCommand(move(baseCommand), plugin),
+  afterCommit(request.calcU64("afterCommit"))
+{
+}
+
+uint64_t BedrockGetChangesCommand::commitCountToWaitFor() const {
+    // With `Connection: wait`, hold the command until there's a commit after `afterCommit`, rather than answering
+    // right away with nothing, so that callers can follow the feed without polling.
+    if (SIEquals(request["Connection"], "wait")) {
+        return max(afterCommit + 1, request.calcU64("commitCount"));
+    }
+    return request.calcU64("commitCount");
+}
+
+uint64_t BedrockGetChangesCommand::commitWaitDeadline() const {
+    // Stop waiting a second before the timeout, which leaves time to answer that nothing has changed.
+    return max(scheduledTime, timeout() - min(timeout(), (uint64_t)STIME_US_PER_S));
+}
+
+bool BedrockGetChangesCommand::peek(SQLite& db) {
+    // The full syntax of the request is:
+    //
+    //     GetChanges
+    //     afterCommit: <commit ID>        - The last commit the caller has the changes for.
+    //     tables: <table,table,...>       - (optional) Only return changes to these tables.
+    //     limit: <count>                  - (optional) Return about this many changes, in whole commits (default 1000).
+    //     Connection: wait                - (optional) Wait up to `timeout` for a commit, if there isn't one yet.
+    //
+    // It returns the changes, and `throughCommit`, the commit to pass as `afterCommit` next time. The feed only has
+    // recent commits, and a caller that's fallen further behind than that gets a 410, and needs to start again from
+    // the tables themselves.
+    BedrockPlugin::verifyAttributeInt64(request, "afterCommit", 1);
+    BedrockPlugin::verifyAttributeInt64(request, "limit", 0);
+    SQLiteChangeFeed& feed = db.getChangeFeed();
+    if (!feed.enabled()) {
+        STHROW("404 Change feed not enabled");
+    }
+    const list<string> tableList = SParseList(request["tables"]);
+    const set<string> tables(tableList.begin(), tableList.end());
+    const size_t limit = request.isSet("limit") ? max<size_t>(1, min<size_t>(request.calcU64("limit"), MAX_LIMIT)) : DEFAULT_LIMIT;
+    list<string> changes;
+    uint64_t throughCommit = 0;
+    if (!feed.get(afterCommit, tables, limit, changes, throughCommit)) {
+        STHROW("410 Changes after commit " + to_string(afterCommit) + " no longer available");
+    }
+    jsonContent["changes"] = SComposeJSONArray(changes);
+    jsonContent["throughCommit"] = to_string(throughCommit);
+    return true;
+}
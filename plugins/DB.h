@@ -19,3 +19,18 @@ class BedrockDBCommand : public BedrockCommand {
   private:
     const string query;
 };
+
+// Returns the row changes committed after `afterCommit`, from the database's change feed (see `-changeFeedSize`).
+class BedrockGetChangesCommand : public BedrockCommand {
+  public:
+    static constexpr size_t DEFAULT_LIMIT = 1000;
+    static constexpr size_t MAX_LIMIT = 10'000;
+
+    BedrockGetChangesCommand(SQLiteCommand&& baseCommand, BedrockPlugin_DB* plugin);
+    virtual bool peek(SQLite& db);
+    virtual uint64_t commitCountToWaitFor() const;
+    virtual uint64_t commitWaitDeadline() const;
+
+  private:
+    const uint64_t afterCommit;
+};
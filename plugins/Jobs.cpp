@@ -74,7 +74,7 @@ unique_ptr<BedrockCommand> BedrockPlugin_Jobs::getCommand(SQLiteCommand&& baseCo
 
 // ==========================================================================
 void BedrockPlugin_Jobs::upgradeDatabase(SQLite& db) {
-    // Create or verify the jobs table
+    // Create or verify the jobs table, in the `jobs` shard if the server has one.
     bool ignore;
     SASSERT(db.verifyTable("jobs",
                            "CREATE TABLE jobs ( "
@@ -89,7 +89,7 @@ void BedrockPlugin_Jobs::upgradeDatabase(SQLite& db) {
                                "priority    INTEGER NOT NULL DEFAULT " + SToStr(JOBS_DEFAULT_PRIORITY) + ", "
                                "parentJobID INTEGER NOT NULL DEFAULT 0, "
                                "retryAfter  TEXT NOT NULL DEFAULT \"\")",
-                           ignore));
+                           ignore, "jobs"));
     // verify and conditionally create indexes
     SASSERT(db.verifyIndex("jobsName", "jobs", "( name )", false, !BedrockPlugin_Jobs::isLive));
     SASSERT(db.verifyIndex("jobsParentJobIDState", "jobs", "( parentJobID, state ) WHERE parentJobID != 0", false, !BedrockPlugin_Jobs::isLive));
@@ -10,6 +10,12 @@
 
 // Tracing can only be enabled or disabled globally, not per object.
 atomic<bool> SQLite::enableTrace(false);
+atomic<size_t> SQLite::journalCompressionMinBytes(0);
+atomic<uint64_t> SQLite::_journalEntriesCompressed(0);
+atomic<uint64_t> SQLite::_journalBytesBeforeCompression(0);
+atomic<uint64_t> SQLite::_journalBytesAfterCompression(0);
+atomic<uint64_t> SQLite::_journalCompressionUS(0);
+atomic<uint64_t> SQLite::_journalDecompressionUS(0);
 
 sqlite3* SQLite::getDBHandle() {
     return _db;
@@ -38,7 +44,7 @@ string SQLite::initializeFilename(const string& filename) {
     }
 }
 
-SQLite::SharedData& SQLite::initializeSharedData(sqlite3* db, const string& filename, const vector<string>& journalNames) {
+SQLite::SharedData& SQLite::initializeSharedData(sqlite3* db, const string& filename, const vector<string>& journalNames, const set<string>& shards) {
     static struct SharedDataLookupMapType {
         map<string, SharedData*> m;
         ~SharedDataLookupMapType() {
@@ -66,21 +72,36 @@ SQLite::SharedData& SQLite::initializeSharedData(sqlite3* db, const string& file
             SASSERT(!SQuery(db, "", "PRAGMA journal_mode = WAL2;", result));
         }
 
-        // Read the highest commit count from the database, and store it in commitCount.
-        string query = "SELECT MAX(maxIDs) FROM (" + _getJournalQuery(journalNames, {"SELECT MAX(id) as maxIDs FROM"}, true) + ")";
-        SASSERT(!SQuery(db, "getting commit count", query, result));
-        uint64_t commitCount = result.empty() ? 0 : SToUInt64(result[0][0]);
+        // Read the highest commit count and its hash from the journal metadata if we can, and otherwise from the
+        // journals themselves, in which case we rebuild the metadata for next time.
+        uint64_t commitCount = 0;
+        string lastCommittedHash;
+        if (!loadJournalMetadata(db, journalNames, commitCount, lastCommittedHash)) {
+            SINFO("Journal metadata missing or out of date, reading journals.");
+            string query = "SELECT MAX(maxIDs) FROM (" + _getJournalQuery(journalNames, {"SELECT MAX(id) as maxIDs FROM"}, true) + ")";
+            SASSERT(!SQuery(db, "getting commit count", query, result));
+            commitCount = result.empty() ? 0 : SToUInt64(result[0][0]);
+
+            // And then read the hash for that transaction.
+            string ignore;
+            getCommit(db, journalNames, commitCount, ignore, lastCommittedHash);
+            if (!rebuildJournalMetadata(db, journalNames)) {
+                SWARN("Couldn't rebuild journal metadata.");
+            }
+        }
         sharedData->commitCount = commitCount;
-
-        // And then read the hash for that transaction.
-        string lastCommittedHash, ignore;
-        getCommit(db, journalNames, commitCount, ignore, lastCommittedHash);
+        sharedData->tableCommitCountsStart = commitCount;
         sharedData->lastCommittedHash.store(lastCommittedHash);
 
         // If we have a commit count, we should have a hash as well.
         if (commitCount && lastCommittedHash.empty()) {
             SERROR("Loaded commit count " << commitCount << " with empty hash.");
         }
+        initializeShards(db, journalNames, shards);
+        sharedData->outstandingFramesToCheckpoint["main"] = 0;
+        for (const string& shard : shards) {
+            sharedData->outstandingFramesToCheckpoint[shard] = 0;
+        }
 
         // Insert our SharedData object into the global map.
         sharedDataLookupMap.m.emplace(filename, sharedData);
@@ -91,7 +112,7 @@ SQLite::SharedData& SQLite::initializeSharedData(sqlite3* db, const string& file
     }
 }
 
-sqlite3* SQLite::initializeDB(const string& filename, int64_t mmapSizeGB) {
+sqlite3* SQLite::initializeDB(const string& filename, int64_t mmapSizeGB, const set<string>& shards) {
     // Open the DB in read-write mode.
     SINFO((SFileExists(filename) ? "Opening" : "Creating") << " database '" << filename << "'.");
     sqlite3* db;
@@ -101,9 +122,58 @@ sqlite3* SQLite::initializeDB(const string& filename, int64_t mmapSizeGB) {
     // any tables to be effective.
     SASSERT(!SQuery(db, "new file format for DESC indexes", "PRAGMA legacy_file_format = OFF"));
 
+    // Shard names are used unquoted as schema names, so they're limited to identifier characters.
+    for (const string& shard : shards) {
+        SASSERT(filename != ":memory:");
+        SASSERT(!shard.empty() && !SIEquals(shard, "main") && !SIEquals(shard, "temp") &&
+                all_of(shard.begin(), shard.end(), [](char c) { return isalnum(c) || c == '_'; }));
+        SASSERT(!SQuery(db, "attaching shard", "ATTACH DATABASE " + SQ(getShardFilename(filename, shard)) + " AS " + shard + ";"));
+    }
+
     return db;
 }
 
+string SQLite::getShardFilename(const string& filename, const string& shard) {
+    if (SEndsWith(filename, ".db")) {
+        return filename.substr(0, filename.size() - 3) + "-" + shard + ".db";
+    }
+    return filename + "-" + shard;
+}
+
+void SQLite::initializeShards(sqlite3* db, const vector<string>& journalNames, const set<string>& shards) {
+    for (const string& shard : shards) {
+        // Like `journalMetadata`, each row is padded to its own page, so that commits through different journal tables
+        // don't conflict over them.
+        SQResult result;
+        SASSERT(!SQuery(db, "getting shard page size", "PRAGMA " + shard + ".page_size;", result));
+        const string padding = SQ(SToUInt64(result[0][0]) / 2);
+        const string schema = "( id INTEGER PRIMARY KEY, commitID INTEGER NOT NULL, padding BLOB )";
+        SASSERT(!SQuery(db, "initializing shard marks", "BEGIN IMMEDIATE"));
+        SASSERT(!SQuery(db, "initializing shard marks", "CREATE TABLE IF NOT EXISTS journalShardMarks_" + shard + " " + schema + ";"));
+        SASSERT(!SQuery(db, "initializing shard marks", "CREATE TABLE IF NOT EXISTS " + shard + ".journalShardMarks " + schema + ";"));
+        for (size_t i = 0; i < journalNames.size(); i++) {
+            SASSERT(!SQuery(db, "initializing shard marks", "INSERT OR IGNORE INTO journalShardMarks_" + shard + " VALUES (" + SQ(i) + ", 0, zeroblob(" + padding + "));"));
+            SASSERT(!SQuery(db, "initializing shard marks", "INSERT OR IGNORE INTO " + shard + ".journalShardMarks VALUES (" + SQ(i) + ", 0, zeroblob(" + padding + "));"));
+        }
+        SASSERT(!SQuery(db, "initializing shard marks", "COMMIT"));
+
+        // We can't tell which of the two is missing part of the commit, or recover it from the other, so we refuse to
+        // start rather than replicate from a database that's quietly lost some of its writes.
+        if (!shardMarksMatch(db, shard)) {
+            SERROR("Shard '" << shard << "' of '" << sqlite3_db_filename(db, "main") << "' doesn't match the journal. "
+                   "A commit was only partly written, restore this node from a backup or a peer.");
+        }
+        SINFO("Attached shard '" << shard << "' from '" << sqlite3_db_filename(db, shard.c_str()) << "'.");
+    }
+}
+
+bool SQLite::shardMarksMatch(sqlite3* db, const string& shard) {
+    SQResult result;
+    return !SQuery(db, "checking shard marks", "SELECT COUNT(*) FROM journalShardMarks_" + shard + " AS m "
+                   "FULL JOIN " + shard + ".journalShardMarks AS s USING (id) WHERE m.commitID IS NOT s.commitID;", result) &&
+           result[0][0] == "0";
+}
+
 vector<string> SQLite::initializeJournal(sqlite3* db, int minJournalTables) {
     // Make sure we don't try and create more journals than we can name.
     SASSERT(minJournalTables < 10'000);
@@ -142,12 +212,81 @@ vector<string> SQLite::initializeJournal(sqlite3* db, int minJournalTables) {
             break;
         }
     }
+
+    SQVerifyTable(db, "journalMetadata", "CREATE TABLE journalMetadata ( id INTEGER PRIMARY KEY, journal TEXT, minID INTEGER, maxID INTEGER, hash TEXT, padding BLOB )");
     return journalNames;
 }
 
+bool SQLite::loadJournalMetadata(sqlite3* db, const vector<string>& journalNames, uint64_t& commitCount, string& hash) {
+    // Read everything from one snapshot, so another process can't commit between our checks.
+    if (SQuery(db, "reading journal metadata", "BEGIN")) {
+        return false;
+    }
+    SQResult result;
+    string topJournal;
+    commitCount = 0;
+    hash.clear();
+    bool valid = !SQuery(db, "reading journal metadata", "SELECT id, journal, maxID, hash FROM journalMetadata ORDER BY id;", result) &&
+                 result.size() == journalNames.size();
+    for (size_t i = 0; valid && i < result.size(); i++) {
+        valid = SToUInt64(result[i][0]) == i && result[i][1] == journalNames[i];
+        if (valid && SToUInt64(result[i][2]) > commitCount) {
+            commitCount = SToUInt64(result[i][2]);
+            hash = result[i][3];
+            topJournal = journalNames[i];
+        }
+    }
+
+    // The highest commit needs to be in its journal with the same hash, and there can't be anything after it. These
+    // are a point lookup in each journal, compared to the several range queries on each that reading them takes.
+    SQResult check;
+    if (valid && commitCount) {
+        valid = !SQuery(db, "checking journal metadata", "SELECT hash FROM " + topJournal + " WHERE id = " + SQ(commitCount) + ";", check) &&
+                !check.empty() && check[0][0] == hash;
+    }
+    if (valid) {
+        valid = !SQuery(db, "checking journal metadata", _getJournalQuery(journalNames, {"SELECT id FROM", "WHERE id = " + SQ(commitCount + 1)}), check) &&
+                check.empty();
+    }
+    SQuery(db, "reading journal metadata", "ROLLBACK");
+    return valid;
+}
+
+bool SQLite::rebuildJournalMetadata(sqlite3* db, const vector<string>& journalNames) {
+    // Each row is padded to over half a page so that no two rows share a page. Concurrent commits write to different
+    // journal tables, so this way they update different pages of this table too, and can't conflict over it.
+    SQResult result;
+    if (SQuery(db, "getting page size", "PRAGMA page_size;", result) || result.empty()) {
+        return false;
+    }
+    const uint64_t padding = SToUInt64(result[0][0]) / 2;
+    if (SQuery(db, "rebuilding journal metadata", "BEGIN IMMEDIATE")) {
+        return false;
+    }
+    bool success = !SQuery(db, "rebuilding journal metadata", "DELETE FROM journalMetadata;");
+    for (size_t i = 0; success && i < journalNames.size(); i++) {
+        const string& name = journalNames[i];
+        success = !SQuery(db, "rebuilding journal metadata", "INSERT INTO journalMetadata SELECT " + SQ(i) + ", " + SQ(name) + ", "
+                          "MIN(id), MAX(id), (SELECT hash FROM " + name + " ORDER BY id DESC LIMIT 1), zeroblob(" + SQ(padding) + ") "
+                          "FROM " + name + ";");
+    }
+    if (success) {
+        success = !SQuery(db, "rebuilding journal metadata", "COMMIT");
+    } else {
+        SQuery(db, "rebuilding journal metadata", "ROLLBACK");
+    }
+    return success;
+}
+
 uint64_t SQLite::initializeJournalSize(sqlite3* db, const vector<string>& journalNames) {
     // We keep track of the number of rows in the journal, so that we can delete old entries when we're over our size
-    // limit.
+    // limit. `initializeSharedData` has already checked or rebuilt the journal metadata, so use that if it's complete.
+    SQResult result;
+    if (!SQuery(db, "reading journal metadata", "SELECT COUNT(*), MIN(minID), MAX(maxID) FROM journalMetadata;", result) &&
+        SToUInt64(result[0][0]) == journalNames.size()) {
+        return SToUInt64(result[0][2]) - SToUInt64(result[0][1]);
+    }
+
     // We want the min of all journal tables.
     string minQuery = _getJournalQuery(journalNames, {"SELECT MIN(id) AS id FROM"}, true);
     minQuery = "SELECT MIN(id) AS id FROM (" + minQuery + ")";
@@ -157,7 +296,6 @@ uint64_t SQLite::initializeJournalSize(sqlite3* db, const vector<string>& journa
     maxQuery = "SELECT MAX(id) AS id FROM (" + maxQuery + ")";
 
     // Look up the min and max values in the database.
-    SQResult result;
     SASSERT(!SQuery(db, "getting commit min", minQuery, result));
     uint64_t min = SToUInt64(result[0][0]);
     SASSERT(!SQuery(db, "getting commit max", maxQuery, result));
@@ -173,11 +311,17 @@ void SQLite::commonConstructorInitialization() {
     SASSERT(_cacheSize > 0);
     SASSERT(_maxJournalSize > 0);
 
-    // WAL is what allows simultaneous read/writing.
+    // WAL is what allows simultaneous read/writing. Without a schema name, this sets every attached shard as well.
     SASSERT(!SQuery(_db, "enabling write ahead logging (wal2)", "PRAGMA journal_mode = wal2;"));
 
+    // The rest of these are set separately for each file.
+    list<string> schemas = {"main"};
+    schemas.insert(schemas.end(), _shards.begin(), _shards.end());
+
     if (_mmapSizeGB) {
-        SASSERT(!SQuery(_db, "enabling memory-mapped I/O", "PRAGMA mmap_size=" + to_string(_mmapSizeGB * 1024 * 1024 * 1024) + ";"));
+        for (const string& schema : schemas) {
+            SASSERT(!SQuery(_db, "enabling memory-mapped I/O", "PRAGMA " + schema + ".mmap_size=" + to_string(_mmapSizeGB * 1024 * 1024 * 1024) + ";"));
+        }
     }
 
     // Enable tracing for performance analysis.
@@ -185,7 +329,9 @@ void SQLite::commonConstructorInitialization() {
 
     // Update the cache. -size means KB; +size means pages
     SINFO("Setting cache_size to " << _cacheSize << "KB");
-    SQuery(_db, "increasing cache size", "PRAGMA cache_size = -" + SQ(_cacheSize) + ";");
+    for (const string& schema : schemas) {
+        SQuery(_db, "increasing cache size", "PRAGMA " + schema + ".cache_size = -" + SQ(_cacheSize) + ";");
+    }
 
     // Register the authorizer callback which allows callers to whitelist particular data in the DB.
     sqlite3_set_authorizer(_db, _sqliteAuthorizerCallback, this);
@@ -199,23 +345,26 @@ void SQLite::commonConstructorInitialization() {
 
     // Check if synchronous has been set and run query to use a custom synchronous setting
     if (!_synchronous.empty()) {
-        SASSERT(!SQuery(_db, "setting custom synchronous commits", "PRAGMA synchronous = " + SQ(_synchronous)  + ";"));
+        for (const string& schema : schemas) {
+            SASSERT(!SQuery(_db, "setting custom synchronous commits", "PRAGMA " + schema + ".synchronous = " + SQ(_synchronous)  + ";"));
+        }
     } else {
         DBINFO("Using SQLite default PRAGMA synchronous");
     }
 }
 
 SQLite::SQLite(const string& filename, int cacheSize, int maxJournalSize,
-               int minJournalTables, const string& synchronous, int64_t mmapSizeGB) :
+               int minJournalTables, const string& synchronous, int64_t mmapSizeGB, const set<string>& shards) :
     _filename(initializeFilename(filename)),
     _maxJournalSize(maxJournalSize),
-    _db(initializeDB(_filename, mmapSizeGB)),
+    _db(initializeDB(_filename, mmapSizeGB, shards)),
     _journalNames(initializeJournal(_db, minJournalTables)),
-    _sharedData(initializeSharedData(_db, _filename, _journalNames)),
+    _sharedData(initializeSharedData(_db, _filename, _journalNames, shards)),
     _journalSize(initializeJournalSize(_db, _journalNames)),
     _cacheSize(cacheSize),
     _synchronous(synchronous),
-    _mmapSizeGB(mmapSizeGB)
+    _mmapSizeGB(mmapSizeGB),
+    _shards(shards)
 {
     commonConstructorInitialization();
 }
@@ -223,13 +372,14 @@ SQLite::SQLite(const string& filename, int cacheSize, int maxJournalSize,
 SQLite::SQLite(const SQLite& from) :
     _filename(from._filename),
     _maxJournalSize(from._maxJournalSize),
-    _db(initializeDB(_filename, from._mmapSizeGB)), // Create a *new* DB handle from the same filename, don't copy the existing handle.
+    _db(initializeDB(_filename, from._mmapSizeGB, from._shards)), // Create a *new* DB handle from the same filename, don't copy the existing handle.
     _journalNames(from._journalNames),
     _sharedData(from._sharedData),
     _journalSize(from._journalSize),
     _cacheSize(from._cacheSize),
     _synchronous(from._synchronous),
-    _mmapSizeGB(from._mmapSizeGB)
+    _mmapSizeGB(from._mmapSizeGB),
+    _shards(from._shards)
 {
     commonConstructorInitialization();
 }
@@ -251,7 +401,10 @@ int SQLite::_progressHandlerCallback(void* arg) {
 
 int SQLite::_walHookCallback(void* sqliteObject, sqlite3* db, const char* name, int walFileSize) {
     SQLite* sqlite = static_cast<SQLite*>(sqliteObject);
-    sqlite->_sharedData.outstandingFramesToCheckpoint = walFileSize;
+    auto frames = sqlite->_sharedData.outstandingFramesToCheckpoint.find(name);
+    if (frames != sqlite->_sharedData.outstandingFramesToCheckpoint.end()) {
+        frames->second = walFileSize;
+    }
     return SQLITE_OK;
 }
 
@@ -288,6 +441,9 @@ SQLite::~SQLite() {
         SINFO("Rollback in destructor complete.");
     }
 
+    // Sessions have to be deleted before the handle they're attached to is closed.
+    _stopRecordingChanges();
+
     // Finally, Close the DB.
     DBINFO("Closing database '" << _filename << ".");
     SASSERTWARN(_uncommittedQuery.empty());
@@ -327,6 +483,11 @@ bool SQLite::beginTransaction(TRANSACTION_TYPE type) {
     // the above `BEGIN CONCURRENT` and the `getCommitCount` call in a lock, which is worse.
     _dbCountAtStart = getCommitCount();
     _queryCache.clear();
+    _tablesRead.clear();
+    _tablesWritten.clear();
+    _shardsWritten.clear();
+    _uncommittedChanges.clear();
+    _startRecordingChanges();
     _queryCount = 0;
     _cacheHits = 0;
     _beginElapsed = STimeNow() - before;
@@ -338,18 +499,44 @@ bool SQLite::beginTransaction(TRANSACTION_TYPE type) {
     return _insideTransaction;
 }
 
-bool SQLite::verifyTable(const string& tableName, const string& sql, bool& created) {
+string SQLite::quoteIdentifier(const string& name) {
+    return "\"" + SReplace(name, "\"", "\"\"") + "\"";
+}
+
+string SQLite::schemaOf(const string& tableName) {
+    // This is the same order sqlite looks for a table whose name doesn't specify one.
+    list<string> schemas = {"main"};
+    schemas.insert(schemas.end(), _shards.begin(), _shards.end());
+    for (const string& schema : schemas) {
+        if (!read("SELECT 1 FROM " + schema + ".sqlite_master WHERE type='table' AND tbl_name=" + SQ(tableName) + ";").empty()) {
+            return schema;
+        }
+    }
+    return "";
+}
+
+bool SQLite::verifyTable(const string& tableName, const string& sql, bool& created, const string& shard) {
     // sqlite trims semicolon, so let's not supply it else we get confused later
     SASSERT(!SEndsWith(sql, ";"));
 
     // First, see if it's there
     SQResult result;
-    SASSERT(read("SELECT sql FROM sqlite_master WHERE type='table' AND tbl_name=" + SQ(tableName) + ";", result));
+    const string schema = schemaOf(tableName);
+    if (!schema.empty()) {
+        SASSERT(read("SELECT sql FROM " + schema + ".sqlite_master WHERE type='table' AND tbl_name=" + SQ(tableName) + ";", result));
+    }
     const string& collapsedSQL = SCollapse(sql);
     if (result.empty()) {
-        // Table doesn't already exist, create it
-        SINFO("Creating '" << tableName << "': " << collapsedSQL);
-        SASSERT(write(collapsedSQL + ";"));
+        // Table doesn't already exist, create it. sqlite stores it without the shard name, so the schema still
+        // compares equal to `sql` in the check below.
+        string createSQL = collapsedSQL;
+        if (_shards.count(shard)) {
+            const string prefix = "CREATE TABLE " + tableName;
+            SASSERT(SStartsWith(createSQL, prefix));
+            createSQL = "CREATE TABLE " + shard + "." + createSQL.substr(prefix.size() - tableName.size());
+        }
+        SINFO("Creating '" << tableName << "': " << createSQL);
+        SASSERT(write(createSQL + ";"));
         created = true;
         return true; // New table was created to spec
     } else {
@@ -374,7 +561,8 @@ bool SQLite::verifyTable(const string& tableName, const string& sql, bool& creat
 bool SQLite::verifyIndex(const string& indexName, const string& tableName, const string& indexSQLDefinition, bool isUnique, bool createIfNotExists) {
     SINFO("Verifying index '" << indexName << "'. isUnique? " << to_string(isUnique));
     SQResult result;
-    SASSERT(read("SELECT sql FROM sqlite_master WHERE type='index' AND tbl_name=" + SQ(tableName) + " AND name=" + SQ(indexName) + ";", result));
+    const string schema = schemaOf(tableName);
+    SASSERT(read("SELECT sql FROM " + (schema.empty() ? "main" : schema) + ".sqlite_master WHERE type='index' AND tbl_name=" + SQ(tableName) + " AND name=" + SQ(indexName) + ";", result));
 
     string createSQL = "CREATE" + string(isUnique ? " UNIQUE " : " ") + "INDEX " + indexName + " ON " + tableName + " " + indexSQLDefinition;
     if (result.empty()) {
@@ -382,8 +570,11 @@ bool SQLite::verifyIndex(const string& indexName, const string& tableName, const
             SINFO("Index '" << indexName << "' does not exist on table '" << tableName << "'.");
             return false;
         }
-        SINFO("Creating index '" << indexName << "' on table '" << tableName << "': " << indexSQLDefinition << ". Executing '" << createSQL << "'.");
-        SASSERT(write(createSQL + ";"));
+
+        // An index has to be in the same file as its table, and the table can only be named without one.
+        const string qualifiedSQL = schema.empty() || schema == "main" ? createSQL : SReplace(createSQL, "INDEX " + indexName, "INDEX " + schema + "." + indexName);
+        SINFO("Creating index '" << indexName << "' on table '" << tableName << "': " << indexSQLDefinition << ". Executing '" << qualifiedSQL << "'.");
+        SASSERT(write(qualifiedSQL + ";"));
         return true;
     } else {
         // Index exists, verify it is correct. Ignore spaces.
@@ -394,8 +585,9 @@ bool SQLite::verifyIndex(const string& indexName, const string& tableName, const
 
 bool SQLite::addColumn(const string& tableName, const string& column, const string& columnType) {
     // Add a column to the table if it does not exist.  Totally freak out on error.
+    const string schema = schemaOf(tableName);
     const string& sql =
-        SCollapse(read("SELECT sql FROM sqlite_master WHERE type='table' AND tbl_name='" + tableName + "';"));
+        SCollapse(read("SELECT sql FROM " + (schema.empty() ? "main" : schema) + ".sqlite_master WHERE type='table' AND tbl_name='" + tableName + "';"));
     if (!SContains(sql, " " + column + " ")) {
         // Add column
         SINFO("Adding " << column << " " << columnType << " to " << tableName);
@@ -582,6 +774,18 @@ bool SQLite::_writeIdempotent(const string& query, bool alwaysKeepQueries) {
 bool SQLite::prepare() {
     SASSERT(_insideTransaction);
 
+    // Compressing a large query is the slowest part of this, so do it before we lock out other commits.
+    uint64_t before = STimeNow();
+    const string journalQueryValue = _journalQueryValue(_uncommittedQuery);
+
+    // As is reading back the rows this transaction changed, for the change feed. Failing that only costs the feed its
+    // history up to this commit, which isn't worth failing the commit over.
+    if (_recordingChanges && !_collectChanges()) {
+        SWARN("Couldn't collect changes for the change feed: " << sqlite3_errmsg(_db));
+        _recordingChanges = false;
+    }
+    _prepareElapsed += STimeNow() - before;
+
     // We lock this here, so that we can guarantee the order in which commits show up in the database.
     if (!_mutexLocked) {
         _sharedData.commitLock.lock();
@@ -597,16 +801,27 @@ bool SQLite::prepare() {
     // Queue up the journal entry
     string lastCommittedHash = getCommittedHash(); // This is why we need the lock.
     _uncommittedHash = SToHex(SHashSHA1(lastCommittedHash + _uncommittedQuery));
-    uint64_t before = STimeNow();
+    before = STimeNow();
 
     // Crete our query.
-    _journalName = _journalNames[_sharedData.nextJournalCount++ % _journalNames.size()];
-    string query = "INSERT INTO " + _journalName + " VALUES (" + SQ(commitCount + 1) + ", " + SQ(_uncommittedQuery) + ", " + SQ(_uncommittedHash) + " )";
+    _journalIndex = _sharedData.nextJournalCount++ % _journalNames.size();
+    _journalName = _journalNames[_journalIndex];
+    string query = "INSERT INTO " + _journalName + " VALUES (" + SQ(commitCount + 1) + ", " + journalQueryValue + ", " + SQ(_uncommittedHash) + " )";
 
     // These are the values we're currently operating on, until we either commit or rollback.
     _sharedData.prepareTransactionInfo(commitCount + 1, _uncommittedQuery, _uncommittedHash, _dbCountAtStart);
 
     int result = SQuery(_db, "updating journal", query);
+    if (!result) {
+        result = SQuery(_db, "updating journal metadata", "UPDATE journalMetadata SET minID = IFNULL(minID, " + SQ(commitCount + 1) + "), "
+                        "maxID = " + SQ(commitCount + 1) + ", hash = " + SQ(_uncommittedHash) + " WHERE id = " + SQ(_journalIndex) + ";");
+    }
+    for (const string& shard : _shardsWritten) {
+        if (!result) {
+            result = SQuery(_db, "updating shard marks", "UPDATE journalShardMarks_" + shard + " SET commitID = " + SQ(commitCount + 1) + " WHERE id = " + SQ(_journalIndex) + "; "
+                            "UPDATE " + shard + ".journalShardMarks SET commitID = " + SQ(commitCount + 1) + " WHERE id = " + SQ(_journalIndex) + ";");
+        }
+    }
     _prepareElapsed += STimeNow() - before;
     if (result) {
         // Couldn't insert into the journal; roll back the original commit
@@ -623,6 +838,9 @@ bool SQLite::prepare() {
 }
 
 int SQLite::commit(const string& description, function<void()>* preCheckpointCallback) {
+    _lastConflictTable.clear();
+    _lastConflictPage = 0;
+
     // If commits have been disabled, return an error without attempting the commit.
     if (!_sharedData._commitEnabled) {
         return COMMIT_DISABLED;
@@ -649,6 +867,7 @@ int SQLite::commit(const string& description, function<void()>* preCheckpointCal
         SASSERT(!SQuery(_db, "getting commit max", "SELECT MAX(id) AS id FROM " + _journalName, result));
         uint64_t max = SToUInt64(result[0][0]);
         newJournalSize = max - min;
+        SASSERT(!SQuery(_db, "updating journal metadata", "UPDATE journalMetadata SET minID = " + SQ(min) + " WHERE id = " + SQ(_journalIndex) + ";"));
 
         // Log timing info.
         _writeElapsed += STimeNow() - before;
@@ -661,6 +880,9 @@ int SQLite::commit(const string& description, function<void()>* preCheckpointCal
     int startPages, dummy;
     sqlite3_db_status(_db, SQLITE_DBSTATUS_CACHE_WRITE, &startPages, &dummy, 0);
 
+    // Clear the error log so that if this commit conflicts, we know any conflict message is from this commit.
+    _mostRecentSQLiteErrorLog.clear();
+
     uint64_t before = STimeNow();
     uint64_t beforeCommit = STimeNow();
     result = SQuery(_db, "committing db transaction", "COMMIT");
@@ -683,7 +905,12 @@ int SQLite::commit(const string& description, function<void()>* preCheckpointCal
 
         _commitElapsed += STimeNow() - before;
         _journalSize = newJournalSize;
-        _sharedData.incrementCommit(_uncommittedHash);
+        if (_sharedData.changeFeed.enabled()) {
+            _sharedData.changeFeed.add(_sharedData.commitCount + 1, move(_uncommittedChanges), _recordingChanges);
+        }
+        _recordingChanges = false;
+        _sharedData.incrementCommit(_uncommittedHash, _tablesWritten);
+        _sampleTablesRead();
         _insideTransaction = false;
         _uncommittedHash.clear();
         _uncommittedQuery.clear();
@@ -698,16 +925,7 @@ int SQLite::commit(const string& description, function<void()>* preCheckpointCal
 
         // If we are the first to set it (i.e., test_and_set returned `false` as the previous value), we'll start a checkpoint.
         if (!_sharedData.checkpointInProgress.test_and_set()) {
-            if (_sharedData.outstandingFramesToCheckpoint) {
-                auto start = STimeNow();
-                int framesCheckpointed = 0;
-                sqlite3_wal_checkpoint_v2(_db, 0, SQLITE_CHECKPOINT_PASSIVE, NULL, &framesCheckpointed);
-                auto end = STimeNow();
-                SINFO("Checkpointed " << framesCheckpointed << " (total) frames of " << _sharedData.outstandingFramesToCheckpoint << " in " << (end - start) << "us.");
-
-                // It might not actually be 0, but we'll just let sqlite tell us what it is next time _walHookCallback runs.
-                _sharedData.outstandingFramesToCheckpoint = 0;
-            }
+            _checkpoint();
             _sharedData.checkpointInProgress.clear();
         }
         SINFO(description << " COMMIT complete in " << time << ". Wrote " << (endPages - startPages)
@@ -717,7 +935,27 @@ int SQLite::commit(const string& description, function<void()>* preCheckpointCal
         _cacheHits = 0;
         _dbCountAtStart = 0;
     } else {
-        SINFO("Commit failed, waiting for rollback.");
+        // sqlite logs the page that conflicted, and the object it belongs to as either "table <name>;" or
+        // "index <table>.<index>;". If it can't tell which object the page belongs to, it logs "table UNKNOWN;".
+        const string pagePrefix = "conflict at page ";
+        size_t pageStart = _mostRecentSQLiteErrorLog.find(pagePrefix);
+        if (pageStart != string::npos) {
+            _lastConflictPage = SToUInt64(_mostRecentSQLiteErrorLog.substr(pageStart + pagePrefix.size(), 20));
+        }
+        for (const string& prefix : {"part of db table "s, "part of db index "s}) {
+            size_t start = _mostRecentSQLiteErrorLog.find(prefix);
+            if (start != string::npos) {
+                start += prefix.size();
+                size_t end = _mostRecentSQLiteErrorLog.find_first_of(".;", start);
+                _lastConflictTable = _mostRecentSQLiteErrorLog.substr(start, end == string::npos ? end : end - start);
+                if (_lastConflictTable == "UNKNOWN") {
+                    _lastConflictTable.clear();
+                }
+                break;
+            }
+        }
+        SINFO("Commit failed" << (_lastConflictTable.empty() ? ""s : " on table " + _lastConflictTable)
+              << (_lastConflictPage ? " at page " + to_string(_lastConflictPage) : ""s) << ", waiting for rollback.");
     }
 
     // if we got SQLITE_BUSY_SNAPSHOT, then we're *still* holding commitLock, and it will need to be unlocked by
@@ -746,6 +984,10 @@ void SQLite::rollback() {
         }
 
         // Finally done with this.
+        _sampleTablesRead();
+        _stopRecordingChanges();
+        _recordingChanges = false;
+        _uncommittedChanges.clear();
         _insideTransaction = false;
         _uncommittedHash.clear();
         if (_uncommittedQuery.size()) {
@@ -794,7 +1036,7 @@ bool SQLite::getCommit(sqlite3* db, const vector<string> journalNames, uint64_t
     SQResult result;
     SASSERT(!SQuery(db, "getting commit", internalQuery, result));
     if (!result.empty()) {
-        query = result[0][0];
+        query = decompressJournalQuery(result[0][0]);
         hash = result[0][1];
     } else {
         query = "";
@@ -822,7 +1064,60 @@ bool SQLite::getCommits(uint64_t fromIndex, uint64_t toIndex, SQResult& result)
     query = "SELECT hash, query FROM (" + query  + ") ORDER BY id";
 
     // These queries run with no transaction wrapping them. This makes them effectively the "first" query.
-    return !SQuery(_db, "getting commits [first query of transaction]", query, result);
+    if (SQuery(_db, "getting commits [first query of transaction]", query, result)) {
+        return false;
+    }
+    for (auto& row : result.rows) {
+        row[1] = decompressJournalQuery(row[1]);
+    }
+    return true;
+}
+
+string SQLite::_journalQueryValue(const string& query) {
+    const size_t minBytes = journalCompressionMinBytes.load();
+    if (minBytes && query.size() >= minBytes) {
+        const uint64_t start = STimeNow();
+        const string compressed = SGZip(query);
+        _journalCompressionUS += STimeNow() - start;
+
+        // The journal's `query` column has text affinity, but that leaves blobs alone, so this stays binary.
+        if (!compressed.empty() && compressed.size() < query.size()) {
+            _journalEntriesCompressed++;
+            _journalBytesBeforeCompression += query.size();
+            _journalBytesAfterCompression += compressed.size();
+            return "X'" + SToHex(compressed) + "'";
+        }
+    }
+    return SQ(query);
+}
+
+string SQLite::decompressJournalQuery(const string& storedQuery) {
+    // No SQL starts with the gzip magic number, so anything that does was compressed by `_journalQueryValue`. Journals
+    // can have a mix of both, as the setting can change at any time.
+    if (storedQuery.size() < 2 || storedQuery[0] != '\x1f' || storedQuery[1] != '\x8b') {
+        return storedQuery;
+    }
+    const uint64_t start = STimeNow();
+    const string query = SGUnzip(storedQuery);
+    _journalDecompressionUS += STimeNow() - start;
+    if (query.empty()) {
+        SWARN("Couldn't decompress journal query of " << storedQuery.size() << " bytes.");
+    }
+    return query;
+}
+
+STable SQLite::getJournalCompressionStats() {
+    const uint64_t bytes = _journalBytesBeforeCompression;
+    const uint64_t storedBytes = _journalBytesAfterCompression;
+    return {
+        {"minBytes", to_string(journalCompressionMinBytes)},
+        {"compressed", to_string(_journalEntriesCompressed)},
+        {"bytes", to_string(bytes)},
+        {"storedBytes", to_string(storedBytes)},
+        {"ratio", SToStr(storedBytes ? (double)bytes / storedBytes : 0.0)},
+        {"compressUS", to_string(_journalCompressionUS)},
+        {"decompressUS", to_string(_journalDecompressionUS)},
+    };
 }
 
 int64_t SQLite::getLastInsertRowID() {
@@ -850,6 +1145,128 @@ void SQLite::setRewriteHandler(bool (*handler)(int, const char*, string&)) {
     _rewriteHandler = handler;
 }
 
+void SQLite::_startRecordingChanges() {
+    _stopRecordingChanges();
+    _recordingChanges = false;
+    if (!_sharedData.changeFeed.enabled()) {
+        return;
+    }
+    list<string> schemas = {"main"};
+    schemas.insert(schemas.end(), _shards.begin(), _shards.end());
+    for (const string& schema : schemas) {
+        sqlite3_session* session = nullptr;
+        if (sqlite3session_create(_db, schema.c_str(), &session) != SQLITE_OK) {
+            SWARN("Couldn't create session on " << schema << " for the change feed.");
+            _stopRecordingChanges();
+            return;
+        }
+        _sessions.push_back(session);
+        sqlite3session_table_filter(session, _changeFeedTableFilter, nullptr);
+        sqlite3session_attach(session, nullptr);
+    }
+    _recordingChanges = true;
+}
+
+void SQLite::_stopRecordingChanges() {
+    for (sqlite3_session* session : _sessions) {
+        sqlite3session_delete(session);
+    }
+    _sessions.clear();
+}
+
+int SQLite::_changeFeedTableFilter(void* context, const char* tableName) {
+    // Like the authorizer, leave out the tables every transaction writes to.
+    return !SStartsWith(tableName, "journal") && !SStartsWith(tableName, "sqlite_");
+}
+
+bool SQLite::_collectChanges() {
+    // A session keeps the original values of each row the transaction changed, and reads the current ones from the
+    // table when the changeset is generated, so a row changed more than once appears once, as the transaction left it.
+    map<string, vector<string>> columnNames;
+    bool success = true;
+    for (sqlite3_session* session : _sessions) {
+        int size = 0;
+        void* changeset = nullptr;
+        sqlite3_changeset_iter* it = nullptr;
+        if (sqlite3session_changeset(session, &size, &changeset) != SQLITE_OK ||
+            sqlite3changeset_start(&it, size, changeset) != SQLITE_OK) {
+            sqlite3_free(changeset);
+            success = false;
+            break;
+        }
+        while (sqlite3changeset_next(it) == SQLITE_ROW) {
+            const char* tableName = nullptr;
+            int columnCount = 0, op = 0, indirect = 0, primaryKeyCount = 0;
+            unsigned char* primaryKey = nullptr;
+            sqlite3changeset_op(it, &tableName, &columnCount, &op, &indirect);
+            sqlite3changeset_pk(it, &primaryKey, &primaryKeyCount);
+
+            // Name the columns, falling back to their positions if the table has somehow changed shape.
+            vector<string>& names = columnNames[tableName];
+            if (names.empty()) {
+                SQResult result;
+                SQuery(_db, "reading columns for the change feed", "SELECT name FROM pragma_table_info(" + SQ(tableName) + ");", result);
+                for (size_t i = 0; i < result.size(); i++) {
+                    names.push_back(result[i][0]);
+                }
+            }
+            STable key, oldValues, newValues;
+            for (int i = 0; i < columnCount; i++) {
+                sqlite3_value* oldValue = nullptr;
+                sqlite3_value* newValue = nullptr;
+                if (op != SQLITE_INSERT) {
+                    sqlite3changeset_old(it, i, &oldValue);
+                }
+                if (op != SQLITE_DELETE) {
+                    sqlite3changeset_new(it, i, &newValue);
+                }
+                const string name = (int)names.size() == columnCount ? names[i] : to_string(i);
+                if (op == SQLITE_UPDATE && primaryKey[i] && oldValue) {
+                    key[name] = _changeFeedValue(oldValue);
+                }
+                if (oldValue && (op == SQLITE_DELETE || newValue)) {
+                    oldValues[name] = _changeFeedValue(oldValue);
+                }
+                if (newValue) {
+                    newValues[name] = _changeFeedValue(newValue);
+                }
+            }
+            STable change = {{"table", tableName}, {"op", op == SQLITE_INSERT ? "insert" : op == SQLITE_DELETE ? "delete" : "update"}};
+            if (op == SQLITE_UPDATE) {
+                change["key"] = SComposeJSONObject(key, true);
+            }
+            if (op != SQLITE_INSERT) {
+                change["old"] = SComposeJSONObject(oldValues, true);
+            }
+            if (op != SQLITE_DELETE) {
+                change["new"] = SComposeJSONObject(newValues, true);
+            }
+            _uncommittedChanges.push_back({tableName, SComposeJSONObject(change)});
+        }
+        success = sqlite3changeset_finalize(it) == SQLITE_OK;
+        sqlite3_free(changeset);
+        if (!success) {
+            break;
+        }
+    }
+    _stopRecordingChanges();
+    if (!success) {
+        _uncommittedChanges.clear();
+    }
+    return success;
+}
+
+string SQLite::_changeFeedValue(sqlite3_value* value) {
+    switch (sqlite3_value_type(value)) {
+        case SQLITE_NULL:
+            return "null";
+        case SQLITE_BLOB:
+            return SToHex(string(static_cast<const char*>(sqlite3_value_blob(value)), sqlite3_value_bytes(value)));
+        default:
+            return string(reinterpret_cast<const char*>(sqlite3_value_text(value)), sqlite3_value_bytes(value));
+    }
+}
+
 int SQLite::_sqliteAuthorizerCallback(void* pUserData, int actionCode, const char* detail1, const char* detail2,
                                       const char* detail3, const char* detail4)
 {
@@ -864,6 +1281,41 @@ int SQLite::_authorize(int actionCode, const char* detail1, const char* detail2,
         return SQLITE_DENY;
     }
 
+    // Keep track of which tables this transaction writes to.
+    if ((actionCode == SQLITE_INSERT || actionCode == SQLITE_UPDATE || actionCode == SQLITE_DELETE) && detail1 &&
+        !SStartsWith(detail1, "journal") && !SStartsWith(detail1, "sqlite_")) {
+        _tablesWritten.insert(detail1);
+    }
+
+    // And which shards, including changes to their schemas. These all name the database in `detail3`, except for
+    // `ALTER TABLE`, which names it in `detail1`.
+    if (!_shards.empty()) {
+        const char* database = actionCode == SQLITE_ALTER_TABLE ? detail1 : detail3;
+        switch (actionCode) {
+            case SQLITE_INSERT:
+            case SQLITE_UPDATE:
+            case SQLITE_DELETE:
+            case SQLITE_CREATE_INDEX:
+            case SQLITE_CREATE_TABLE:
+            case SQLITE_CREATE_TRIGGER:
+            case SQLITE_CREATE_VIEW:
+            case SQLITE_DROP_INDEX:
+            case SQLITE_DROP_TABLE:
+            case SQLITE_DROP_TRIGGER:
+            case SQLITE_DROP_VIEW:
+            case SQLITE_ALTER_TABLE:
+                if (database && _shards.count(database) && !(detail1 && SStartsWith(detail1, "journal"))) {
+                    _shardsWritten.insert(database);
+                }
+                break;
+        }
+    }
+
+    // And which tables it reads from.
+    if (actionCode == SQLITE_READ && detail1 && !SStartsWith(detail1, "journal") && !SStartsWith(detail1, "sqlite_")) {
+        _tablesRead.insert(detail1);
+    }
+
     // Here's where we can check for non-deterministic functions for the cache.
     if (actionCode == SQLITE_FUNCTION && detail2) {
         if (!strcmp(detail2, "random") ||
@@ -1002,6 +1454,85 @@ void SQLite::setCommitEnabled(bool enable) {
     _sharedData.setCommitEnabled(enable);
 }
 
+void SQLite::setCommitCountCallback(function<void(uint64_t)>&& callback) {
+    _sharedData.setCommitCountCallback(move(callback));
+}
+
+bool SQLite::tablesUnchangedSince(const set<string>& tables, uint64_t commitCount) {
+    return _sharedData.tablesUnchangedSince(tables, commitCount);
+}
+
+map<string, uint64_t> SQLite::popTableReadSamples() {
+    return _sharedData.popTableReadSamples();
+}
+
+void SQLite::_checkpoint() {
+    for (auto& [schema, outstandingFrames] : _sharedData.outstandingFramesToCheckpoint) {
+        if (!outstandingFrames) {
+            continue;
+        }
+        auto start = STimeNow();
+        int framesCheckpointed = 0;
+        sqlite3_wal_checkpoint_v2(_db, schema.c_str(), SQLITE_CHECKPOINT_PASSIVE, NULL, &framesCheckpointed);
+        auto end = STimeNow();
+        SINFO("Checkpointed " << framesCheckpointed << " (total) frames of " << outstandingFrames << " in '" << schema << "' in " << (end - start) << "us.");
+
+        // It might not actually be 0, but we'll just let sqlite tell us what it is next time _walHookCallback runs.
+        outstandingFrames = 0;
+    }
+}
+
+STable SQLite::getFreelistStats(const string& schema) {
+    static const vector<string> modes = {"none", "full", "incremental"};
+    SASSERT(schema == "main" || _shards.count(schema));
+    SQResult pageCount, freePages, autoVacuum;
+    SASSERT(!SQuery(_db, "reading page count", "PRAGMA " + schema + ".page_count;", pageCount));
+    SASSERT(!SQuery(_db, "reading freelist count", "PRAGMA " + schema + ".freelist_count;", freePages));
+    SASSERT(!SQuery(_db, "reading auto_vacuum", "PRAGMA " + schema + ".auto_vacuum;", autoVacuum));
+    const size_t mode = SToUInt64(autoVacuum[0][0]);
+    return {
+        {"pageCount", pageCount[0][0]},
+        {"freePages", freePages[0][0]},
+        {"autoVacuum", mode < modes.size() ? modes[mode] : autoVacuum[0][0]},
+    };
+}
+
+bool SQLite::incrementalVacuum(uint64_t pages, uint64_t& freed) {
+    SASSERT(!_insideTransaction);
+    freed = 0;
+
+    // Holding the checkpoint flag keeps committing handles from starting a checkpoint while we write, and we do our
+    // own afterward, so the WAL doesn't keep the pages we've moved.
+    if (_sharedData.checkpointInProgress.test_and_set()) {
+        return false;
+    }
+    unique_lock<decltype(_sharedData.commitLock)> lock(_sharedData.commitLock, try_to_lock);
+    if (!lock.owns_lock()) {
+        _sharedData.checkpointInProgress.clear();
+        return false;
+    }
+    SQResult before, after;
+    bool success = !SQuery(_db, "reading freelist count", "PRAGMA freelist_count;", before) &&
+                   !SQuery(_db, "incremental vacuum", "PRAGMA incremental_vacuum(" + SQ(pages) + ");") &&
+                   !SQuery(_db, "reading freelist count", "PRAGMA freelist_count;", after);
+    lock.unlock();
+    if (success) {
+        freed = SToUInt64(before[0][0]) - min(SToUInt64(before[0][0]), SToUInt64(after[0][0]));
+        if (freed) {
+            _checkpoint();
+        }
+    }
+    _sharedData.checkpointInProgress.clear();
+    return success;
+}
+
+void SQLite::_sampleTablesRead() {
+    if (++_transactionsSinceSample >= TABLE_READ_SAMPLE_INTERVAL && !_tablesRead.empty()) {
+        _transactionsSinceSample = 0;
+        _sharedData.sampleTablesRead(_tablesRead);
+    }
+}
+
 int SQLite::getPreparedStatements(const string& query, list<sqlite3_stmt*>& statements) {
     // We need a pointer to a prepared statement.
     sqlite3_stmt* ppStmt = nullptr;
@@ -1050,11 +1581,56 @@ void SQLite::SharedData::setCommitEnabled(bool enable) {
     _commitEnabled = enable;
 }
 
-void SQLite::SharedData::incrementCommit(const string& commitHash) {
+void SQLite::SharedData::incrementCommit(const string& commitHash, const set<string>& tablesWritten) {
+    uint64_t newCommitCount;
+    function<void(uint64_t)> callback;
+    {
+        lock_guard<decltype(_internalStateMutex)> lock(_internalStateMutex);
+        commitCount++;
+        newCommitCount = commitCount;
+        for (const string& table : tablesWritten) {
+            _tableCommitCounts[table] = newCommitCount;
+        }
+        commitTransactionInfo(commitCount);
+        lastCommittedHash.store(commitHash);
+        callback = _commitCountCallback;
+    }
+    if (callback) {
+        callback(newCommitCount);
+    }
+}
+
+bool SQLite::SharedData::tablesUnchangedSince(const set<string>& tables, uint64_t commitCount) {
+    lock_guard<decltype(_internalStateMutex)> lock(_internalStateMutex);
+    if (commitCount < tableCommitCountsStart) {
+        return false;
+    }
+    for (const string& table : tables) {
+        auto it = _tableCommitCounts.find(table);
+        if (it != _tableCommitCounts.end() && it->second > commitCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SQLite::SharedData::sampleTablesRead(const set<string>& tables) {
+    lock_guard<decltype(_internalStateMutex)> lock(_internalStateMutex);
+    for (const string& table : tables) {
+        _tableReadSamples[table]++;
+    }
+}
+
+map<string, uint64_t> SQLite::SharedData::popTableReadSamples() {
+    lock_guard<decltype(_internalStateMutex)> lock(_internalStateMutex);
+    map<string, uint64_t> samples;
+    swap(samples, _tableReadSamples);
+    return samples;
+}
+
+void SQLite::SharedData::setCommitCountCallback(function<void(uint64_t)>&& callback) {
     lock_guard<decltype(_internalStateMutex)> lock(_internalStateMutex);
-    commitCount++;
-    commitTransactionInfo(commitCount);
-    lastCommittedHash.store(commitHash);
+    _commitCountCallback = move(callback);
 }
 
 void SQLite::SharedData::prepareTransactionInfo(uint64_t commitID, const string& query, const string& hash, uint64_t dbCountAtTransactionStart) {
@@ -1,6 +1,7 @@
 #pragma once
 #include <libstuff/sqlite3.h>
 #include <libstuff/SPerformanceTimer.h>
+#include "SQLiteChangeFeed.h"
 
 class SQLite {
   public:
@@ -55,8 +56,13 @@ class SQLite {
     //                   passed, no tables are created.
     //
     // mmapSizeGB: address space to use for memory-mapped IO, in GB.
+    //
+    // shards: names of additional database files that are attached to every handle, alongside the main file. Each has
+    //         its own WAL and is checkpointed separately, so tables placed in one (see `verifyTable`) don't share
+    //         pages, WAL growth or checkpoints with the rest of the database. The journal stays in the main file.
+    //         Every node in a cluster needs the same set, as the statements that create tables in them name them.
     SQLite(const string& filename, int cacheSize, int maxJournalSize, int minJournalTables,
-           const string& synchronous = "", int64_t mmapSizeGB = 0);
+           const string& synchronous = "", int64_t mmapSizeGB = 0, const set<string>& shards = {});
 
     // Compatibility constructor. Remove when AuthTester::getStripeSQLiteDB no longer uses this outdated version.
     SQLite(const string& filename, int cacheSize, int maxJournalSize, int minJournalTables, int synchronous) :
@@ -71,6 +77,24 @@ class SQLite {
     // Returns the canonicalized filename for this database
     const string& getFilename() { return _filename; }
 
+    // Returns the names of the shards attached to this database.
+    const set<string>& getShards() const { return _shards; }
+
+    // Returns the schema ("main" or a shard) that holds `tableName`, or an empty string if there's no such table.
+    string schemaOf(const string& tableName);
+
+    // Returns `name` quoted for use as a table, column, or index name in a query.
+    static string quoteIdentifier(const string& name);
+
+    // Returns the name of the file that holds `shard` for the database in `filename`, `bedrock-cache.db` for the
+    // `cache` shard of `bedrock.db`.
+    static string getShardFilename(const string& filename, const string& shard);
+
+    // Each shard, and the main file, record the last commit through each journal table that wrote to that shard, in
+    // the same transaction. sqlite only commits each attached file atomically on its own, so after a crash part way
+    // through a commit, one may have it and not the other. Returns false if the two records in `db` don't match.
+    static bool shardMarksMatch(sqlite3* db, const string& shard);
+
     sqlite3* getDBHandle();
 
     // Performs a read-only query (eg, SELECT). This can be done inside or outside a transaction. Returns true on
@@ -93,7 +117,9 @@ class SQLite {
     // Verifies a table exists and has a particular definition. If the database is left with the right schema, it
     // returns true. If it had to create a new table (ie, the table was missing), it also sets created to true. If the
     // table is already there with the wrong schema, it returns false.
-    bool verifyTable(const string& name, const string& sql, bool& created);
+    // If `shard` names one of this database's shards, a missing table is created there rather than in the main file.
+    // A table that already exists is left wherever it is.
+    bool verifyTable(const string& name, const string& sql, bool& created, const string& shard = "");
 
     // Verifies an index exists on the given table with the given definition. Optionally create it if it doesn't exist.
     // Be careful, creating an index can be expensive on large tables!
@@ -223,6 +249,17 @@ class SQLite {
     // Enable/disable SQL statement tracing.
     static atomic<bool> enableTrace;
 
+    // Journal entries with queries at least this many bytes long are stored gzipped, or none are if it's 0. The hash
+    // chain is still computed over the original text, which is what `getCommit` and `getCommits` return.
+    static atomic<size_t> journalCompressionMinBytes;
+
+    // Returns the number of journal entries stored compressed since the process started, their total size before and
+    // after, the resulting ratio, and the microseconds spent compressing them and decompressing entries read back.
+    static STable getJournalCompressionStats();
+
+    // Returns a query read directly from a journal table as it was originally written, decompressing it if needed.
+    static string decompressJournalQuery(const string& storedQuery);
+
     // public read-only accessor for _dbCountAtStart.
     uint64_t getDBCountAtStart() const;
 
@@ -233,6 +270,11 @@ class SQLite {
     // no commits can happen "late" from slow threads that could otherwise write to a DB being shutdown.
     void setCommitEnabled(bool enable);
 
+    // Sets a function to be called with the new commit count after every commit to this database file, by any handle.
+    // It's called while the commit lock is held, so it needs to be quick and can't use the database. Pass `nullptr` to
+    // remove it.
+    void setCommitCountCallback(function<void(uint64_t)>&& callback);
+
     // This gets a set of sqlite3 prepared statements from a query string, to allow for the methods here to be called
     // without actually running a query:
     // https://www.sqlite.org/c3ref/stmt.html
@@ -246,6 +288,44 @@ class SQLite {
     // Set this DB handle to be query-only to prevent accidental writes in places we don't expect them.
     void setQueryOnly(bool enabled);
 
+    // Returns the set of tables written to by the current (or most recent) transaction, as reported by the authorizer.
+    // Journal tables are excluded, as every transaction writes to one of them.
+    const set<string>& getTablesWritten() const { return _tablesWritten; }
+
+    // Returns the set of tables read by the current (or most recent) transaction, with the same exclusions as
+    // `getTablesWritten`.
+    const set<string>& getTablesRead() const { return _tablesRead; }
+
+    // Returns true if no commit to this database file since `commitCount` has written to any of `tables`. Returns false
+    // if `commitCount` is older than this process's tracking of table writes, as we can't know either way.
+    bool tablesUnchangedSince(const set<string>& tables, uint64_t commitCount);
+
+    // One in this many transactions on each handle adds the tables it read to a count shared by all handles for the same
+    // file, which `popTableReadSamples` returns and resets. This is a cheap approximation of which tables are hot.
+    static constexpr uint64_t TABLE_READ_SAMPLE_INTERVAL = 64;
+    map<string, uint64_t> popTableReadSamples();
+
+    // Returns `pageCount`, `freePages`, and `autoVacuum` (none, full, or incremental) for the main database file, or
+    // for the file of the given shard.
+    STable getFreelistStats(const string& schema = "main");
+
+    // Releases up to `pages` free pages from the end of the file with `PRAGMA incremental_vacuum`, and checkpoints
+    // them. This only frees anything in databases created with `auto_vacuum = INCREMENTAL`. So that it never competes
+    // with real work, it does nothing and returns false if another handle is committing or checkpointing. Otherwise,
+    // sets `freed` to the number of pages released and returns true. Must not be called inside a transaction.
+    bool incrementalVacuum(uint64_t pages, uint64_t& freed);
+
+    // If the last call to `commit` failed with a conflict, returns the name of the table that conflicted, if sqlite was
+    // able to identify it. Conflicts on an index are reported as the table the index belongs to.
+    const string& getLastConflictTable() const { return _lastConflictTable; }
+
+    // If the last call to `commit` failed with a conflict, returns the page that conflicted, or 0 if it's not known.
+    uint64_t getLastConflictPage() const { return _lastConflictPage; }
+
+    // The row changes made by recent commits to this database file, shared by all its handles. Transactions only
+    // record their changes while it's enabled.
+    SQLiteChangeFeed& getChangeFeed() { return _sharedData.changeFeed; }
+
   private:
     // This structure contains all of the data that's shared between a set of SQLite objects that share the same
     // underlying database file.
@@ -259,11 +339,25 @@ class SQLite {
 
         // Update the shared state of the DB to include the newest commit with the newest hash. This needs to be done
         // after completing a commit and before releasing the commit lock.
-        void incrementCommit(const string& commitHash);
+        // `tablesWritten` are recorded against the new commit count for `tablesUnchangedSince`.
+        void incrementCommit(const string& commitHash, const set<string>& tablesWritten);
+
+        // Set the function that `incrementCommit` calls with the new commit count.
+        void setCommitCountCallback(function<void(uint64_t)>&& callback);
 
         // This removes and returns all committed transactions.
         map<uint64_t, tuple<string, string, uint64_t>> popCommittedTransactions();
 
+        // See `SQLite::tablesUnchangedSince`.
+        bool tablesUnchangedSince(const set<string>& tables, uint64_t commitCount);
+
+        // See `SQLite::popTableReadSamples`.
+        void sampleTablesRead(const set<string>& tables);
+        map<string, uint64_t> popTableReadSamples();
+
+        // The commit count at which we started recording `_tableCommitCounts`.
+        uint64_t tableCommitCountsStart = 0;
+
         // This is the last committed hash by *any* thread for this file.
         atomic<string> lastCommittedHash;
 
@@ -296,9 +390,13 @@ class SQLite {
         // We use this flag to prevent to threads running checkpoints t the same time.
         atomic_flag checkpointInProgress = ATOMIC_FLAG_INIT;
 
-        // This records the most recent count of the number of frames to checkpoint. We may be able to remove this with
-        // no ill effects, but currently we use it to set a floor on the number of frames we will try and checkpoint.
-        atomic<size_t> outstandingFramesToCheckpoint = 0;
+        // This records the most recent count of the number of frames to checkpoint in each schema's WAL, so that we only
+        // checkpoint the files that have been written to. Its keys are "main" and each shard, and are set once when it's
+        // initialized, so only the counts change after that.
+        map<string, atomic<size_t>> outstandingFramesToCheckpoint;
+
+        // See `getChangeFeed`.
+        SQLiteChangeFeed changeFeed;
 
       private:
         // The data required to replicate transactions, in two lists, depending on whether this has only been prepared
@@ -306,6 +404,15 @@ class SQLite {
         map<uint64_t, tuple<string, string, uint64_t>> _preparedTransactions;
         map<uint64_t, tuple<string, string, uint64_t>> _committedTransactions;
 
+        // Called with the new commit count by `incrementCommit`.
+        function<void(uint64_t)> _commitCountCallback;
+
+        // The most recent commit count to write to each table since `tableCommitCountsStart`.
+        map<string, uint64_t> _tableCommitCounts;
+
+        // The number of sampled transactions that read each table.
+        map<string, uint64_t> _tableReadSamples;
+
         // This mutex is locked when we need to change the state of the _shareData object. It is shared between a
         // variety of operations (i.e., updating _committedTransactions, etc).
         recursive_mutex _internalStateMutex;
@@ -313,10 +420,21 @@ class SQLite {
 
     // Initializers to support RAII-style allocation in constructors.
     static string initializeFilename(const string& filename);
-    static SharedData& initializeSharedData(sqlite3* db, const string& filename, const vector<string>& journalNames);
-    static sqlite3* initializeDB(const string& filename, int64_t mmapSizeGB);
+    static SharedData& initializeSharedData(sqlite3* db, const string& filename, const vector<string>& journalNames, const set<string>& shards);
+    static sqlite3* initializeDB(const string& filename, int64_t mmapSizeGB, const set<string>& shards);
     static vector<string> initializeJournal(sqlite3* db, int minJournalTables);
     static uint64_t initializeJournalSize(sqlite3* db, const vector<string>& journalNames);
+
+    // `journalMetadata` has a row for each journal table with its min and max IDs and the hash of its last commit,
+    // updated in the same transaction as the journal, so that startup doesn't have to query every journal table.
+    // `loadJournalMetadata` returns false unless it has a row for every journal table and its highest commit matches
+    // the journals, in which case `rebuildJournalMetadata` rebuilds it from a scan of the journals.
+    static bool loadJournalMetadata(sqlite3* db, const vector<string>& journalNames, uint64_t& commitCount, string& hash);
+    static bool rebuildJournalMetadata(sqlite3* db, const vector<string>& journalNames);
+
+    // Creates the tables each shard's marks (see `shardMarksMatch`) are kept in, with a row for every journal table,
+    // and checks that they match.
+    static void initializeShards(sqlite3* db, const vector<string>& journalNames, const set<string>& shards);
     void commonConstructorInitialization();
 
     // The filename of this DB, canonicalized to its full path on disk.
@@ -334,8 +452,9 @@ class SQLite {
     // Pointer to our SharedData object, which is shared between all SQLite DB objects for the same file.
     SharedData& _sharedData;
 
-    // The name of the journal table that this particular DB handle with write to.
+    // The name of the journal table that this particular DB handle with write to, and its index in `_journalNames`.
     string _journalName;
+    size_t _journalIndex = 0;
 
     // The current size of the journal, in rows. TODO: Why isn't this in SharedData?
     uint64_t _journalSize;
@@ -466,7 +585,51 @@ class SQLite {
     int _cacheSize;
     const string _synchronous;
     int64_t _mmapSizeGB;
+    const set<string> _shards;
 
     // This is a string (which may be empty) containing the most recent logged error by SQLite in this thread.
     static thread_local string _mostRecentSQLiteErrorLog;
+
+    // Runs a passive checkpoint of each schema with outstanding WAL frames. The caller must have set
+    // `checkpointInProgress`.
+    void _checkpoint();
+
+    // Adds `_tablesRead` to the shared samples if this transaction is one to sample.
+    void _sampleTablesRead();
+    uint64_t _transactionsSinceSample = 0;
+
+    // Tables read and written in the current transaction, and the table and page that caused the last commit
+    // conflict.
+    set<string> _tablesRead;
+    set<string> _tablesWritten;
+    string _lastConflictTable;
+    uint64_t _lastConflictPage = 0;
+
+    // The shards written to by the current transaction, whose marks `prepare` updates.
+    set<string> _shardsWritten;
+
+    // While the change feed is enabled, each transaction has a session for the main file and one for each shard, from
+    // which `prepare` collects `_uncommittedChanges` for `commit` to add to the feed. `_recordingChanges` is false for
+    // a transaction that started before the feed was enabled.
+    void _startRecordingChanges();
+    void _stopRecordingChanges();
+    bool _collectChanges();
+    static int _changeFeedTableFilter(void* context, const char* tableName);
+
+    // A column value as a string for the change feed's JSON: blobs as hex, and NULL as `null`.
+    static string _changeFeedValue(sqlite3_value* value);
+    list<sqlite3_session*> _sessions;
+    bool _recordingChanges = false;
+    list<SQLiteChangeFeed::Change> _uncommittedChanges;
+
+    // Returns the SQL value to store in the journal for `query`, compressed if `journalCompressionMinBytes` says so
+    // and it comes out smaller.
+    static string _journalQueryValue(const string& query);
+
+    // Counters for `getJournalCompressionStats`.
+    static atomic<uint64_t> _journalEntriesCompressed;
+    static atomic<uint64_t> _journalBytesBeforeCompression;
+    static atomic<uint64_t> _journalBytesAfterCompression;
+    static atomic<uint64_t> _journalCompressionUS;
+    static atomic<uint64_t> _journalDecompressionUS;
 };
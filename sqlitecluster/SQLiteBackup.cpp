@@ -0,0 +1,205 @@
+#include "SQLiteBackup.h"
+
+#include <cstdio>
+#include <unistd.h>
+
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLitePool.h>
+
+SQLiteBackup::~SQLiteBackup() {
+    cancel();
+}
+
+bool SQLiteBackup::start(shared_ptr<SQLitePool> dbPool, const string& path, uint64_t pagesPerSecond) {
+    lock_guard<decltype(_m)> lock(_m);
+    if (_running) {
+        return false;
+    }
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    _status = {
+        {"path", path},
+        {"state", "running"},
+        {"pagesPerSecond", to_string(pagesPerSecond)},
+        {"startTime", to_string(STimeNow())},
+    };
+    _cancel = false;
+    _running = true;
+    _thread = thread(&SQLiteBackup::_run, this, dbPool, path, pagesPerSecond);
+    return true;
+}
+
+void SQLiteBackup::cancel() {
+    // `_run` locks `_m` to update `_status`, so we can't hold it while we wait.
+    thread runThread;
+    {
+        lock_guard<decltype(_m)> lock(_m);
+        _cancel = true;
+        runThread = move(_thread);
+    }
+    if (runThread.joinable()) {
+        runThread.join();
+    }
+}
+
+STable SQLiteBackup::getStatus() const {
+    lock_guard<decltype(_m)> lock(_m);
+    return _status;
+}
+
+bool SQLiteBackup::_readJournalPosition(sqlite3* db, uint64_t& commitCount, string& hash) {
+    SQResult tables;
+    if (SQuery(db, "listing journal tables", "SELECT name FROM sqlite_master WHERE type = 'table' AND "
+               "(name = 'journal' OR name GLOB 'journal[0-9][0-9][0-9][0-9]');", tables)) {
+        return false;
+    }
+    vector<string> journalNames;
+    commitCount = 0;
+    for (size_t i = 0; i < tables.size(); i++) {
+        journalNames.push_back(tables[i][0]);
+        SQResult result;
+        if (SQuery(db, "getting journal max", "SELECT MAX(id) FROM " + tables[i][0] + ";", result)) {
+            return false;
+        }
+        commitCount = max(commitCount, SToUInt64(result[0][0]));
+    }
+    if (journalNames.empty()) {
+        return false;
+    }
+    string query;
+    return SQLite::getCommit(db, journalNames, commitCount, query, hash) || !commitCount;
+}
+
+void SQLiteBackup::_run(shared_ptr<SQLitePool> dbPool, string path, uint64_t pagesPerSecond) {
+    SInitialize("backup");
+    const string tempPath = path + ".tmp";
+    auto setStatus = [this](const STable& values) {
+        lock_guard<decltype(_m)> lock(_m);
+        for (const auto& [name, value] : values) {
+            _status[name] = value;
+        }
+    };
+    SQLiteScopedHandle dbScope(*dbPool, dbPool->getIndex());
+    SQLite& db = dbScope.db();
+    sqlite3* source = db.getDBHandle();
+
+    // Each shard is copied to its own file next to `path`, named the same way as the ones next to the database.
+    map<string, string> destinations = {{"main", path}};
+    for (const string& shard : db.getShards()) {
+        destinations[shard] = SQLite::getShardFilename(path, shard);
+    }
+    auto fail = [&](const string& reason) {
+        SWARN("Online backup to " << path << " failed: " << reason);
+        setStatus({{"state", _cancel ? "canceled" : "failed"}, {"error", reason}});
+        for (const auto& [schema, destination] : destinations) {
+            unlink((destination + ".tmp").c_str());
+        }
+    };
+
+    // Everything the backup copies comes from this transaction's snapshot, including the journal position we read.
+    db.beginTransaction();
+    uint64_t commitCount = 0;
+    string hash;
+    if (!_readJournalPosition(source, commitCount, hash)) {
+        db.rollback();
+        fail("couldn't read journal position");
+        _running = false;
+        return;
+    }
+    setStatus({{"commitCount", to_string(commitCount)}, {"hash", hash}});
+    SINFO("Starting online backup of commit " << commitCount << " to " << path << ".");
+
+    // Each shard's snapshot starts when we first read from it, so a commit could land between that and the journal
+    // read above. If one that wrote to a shard did, its marks won't match the journal's.
+    string error;
+    for (const string& shard : db.getShards()) {
+        if (error.empty() && !SQLite::shardMarksMatch(source, shard)) {
+            error = "shard '" + shard + "' changed while starting the snapshot";
+        }
+    }
+
+    const uint64_t start = STimeNow();
+    uint64_t pagesCopied = 0;
+    uint64_t pagesCopiedBefore = 0;
+    for (const auto& [schema, destinationPath] : destinations) {
+        const string destinationTempPath = destinationPath + ".tmp";
+        unlink(destinationTempPath.c_str());
+        sqlite3* destination = nullptr;
+        sqlite3_backup* backup = nullptr;
+        if (!error.empty()) {
+            break;
+        } else if (sqlite3_open_v2(destinationTempPath.c_str(), &destination, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr)) {
+            error = "couldn't open " + destinationTempPath;
+        } else if (!(backup = sqlite3_backup_init(destination, "main", source, schema.c_str()))) {
+            error = sqlite3_errmsg(destination);
+        }
+
+        while (error.empty()) {
+            if (_cancel) {
+                error = "canceled";
+                break;
+            }
+            const int result = sqlite3_backup_step(backup, pagesPerSecond ? min<uint64_t>(PAGES_PER_STEP, pagesPerSecond) : PAGES_PER_STEP);
+            const uint64_t pageCount = sqlite3_backup_pagecount(backup);
+            pagesCopied = pagesCopiedBefore + pageCount - sqlite3_backup_remaining(backup);
+            setStatus({{"pagesCopied", to_string(pagesCopied)}, {"pageCount", to_string(pagesCopiedBefore + pageCount)}});
+            if (result == SQLITE_DONE) {
+                break;
+            } else if (result != SQLITE_OK && result != SQLITE_BUSY && result != SQLITE_LOCKED) {
+                error = sqlite3_errstr(result);
+                break;
+            } else if (result != SQLITE_OK) {
+                // Whatever has the source locked needs a moment, so don't spin retrying it.
+                usleep(BUSY_RETRY_US);
+                continue;
+            }
+
+            // Sleep until we're back under our rate, a bit at a time so that we notice if we're canceled.
+            if (pagesPerSecond) {
+                const uint64_t resumeAt = start + pagesCopied * 1'000'000 / pagesPerSecond;
+                while (!_cancel && STimeNow() < resumeAt) {
+                    usleep(min<uint64_t>(resumeAt - STimeNow(), 100'000));
+                }
+            }
+        }
+        if (backup) {
+            sqlite3_backup_finish(backup);
+        }
+        if (destination) {
+            sqlite3_close(destination);
+        }
+        pagesCopiedBefore = pagesCopied;
+    }
+    db.rollback();
+    if (!error.empty()) {
+        fail(error);
+        _running = false;
+        return;
+    }
+
+    // Make sure the copy is at the same position in the journal as the snapshot it was made from.
+    uint64_t copiedCommitCount = 0;
+    string copiedHash;
+    sqlite3* copy = nullptr;
+    bool verified = !sqlite3_open_v2(tempPath.c_str(), &copy, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) &&
+                    _readJournalPosition(copy, copiedCommitCount, copiedHash) && copiedCommitCount == commitCount &&
+                    copiedHash == hash;
+    sqlite3_close(copy);
+    string renameFailed;
+    for (const auto& [schema, destinationPath] : destinations) {
+        if (verified && renameFailed.empty() && rename((destinationPath + ".tmp").c_str(), destinationPath.c_str())) {
+            renameFailed = destinationPath + ".tmp";
+        }
+    }
+    if (!verified) {
+        fail("copy is at commit " + to_string(copiedCommitCount) + ", expected " + to_string(commitCount));
+    } else if (!renameFailed.empty()) {
+        fail("couldn't rename " + renameFailed);
+    } else {
+        SINFO("Finished online backup of commit " << commitCount << " to " << path << ", " << pagesCopied
+              << " pages in " << (STimeNow() - start) / 1000 << "ms.");
+        setStatus({{"state", "complete"}, {"endTime", to_string(STimeNow())}});
+    }
+    _running = false;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+class SQLitePool;
+struct sqlite3;
+
+// Copies a consistent snapshot of a live database to a file in the background, without taking the node out of the
+// cluster. The copy is made with `sqlite3_backup_step` from a read transaction held open for the whole backup, so
+// commits continue while it runs, and none of them end up in the copy. The commit count and hash of the snapshot are
+// read from its journal when it starts, and checked against the journal of the finished copy before it's moved into
+// place, so the resulting file can be restored and will resume replication from exactly that commit.
+//
+// Holding a read transaction open keeps the WAL from being checkpointed past it, so throttling a backup of a large
+// database far enough to take hours will grow the WAL for that long.
+class SQLiteBackup {
+  public:
+    // The number of pages copied by each call to `sqlite3_backup_step`.
+    static constexpr int PAGES_PER_STEP = 256;
+
+    // How long to wait before retrying a step that couldn't lock the source.
+    static constexpr uint64_t BUSY_RETRY_US = 10'000;
+
+    ~SQLiteBackup();
+
+    // Starts backing up the database in `dbPool` to `path`, copying no more than `pagesPerSecond` pages per second, or
+    // as fast as possible if that's 0. Returns false if a backup is already running. If the database has shards, each is
+    // copied from the same snapshot to its own file next to `path`.
+    bool start(shared_ptr<SQLitePool> dbPool, const string& path, uint64_t pagesPerSecond);
+
+    // Stops a running backup, and waits for it to clean up. Nothing is left at the backup's path.
+    void cancel();
+
+    // Returns the state of the current or most recent backup: its path, state (running, complete, canceled or
+    // failed), the commit count and hash it's a copy of, and how many of its pages have been copied.
+    STable getStatus() const;
+
+  private:
+    void _run(shared_ptr<SQLitePool> dbPool, string path, uint64_t pagesPerSecond);
+
+    // Reads the highest commit in the journal tables of `db`, and its hash.
+    static bool _readJournalPosition(sqlite3* db, uint64_t& commitCount, string& hash);
+
+    mutable mutex _m;
+    STable _status;
+    atomic<bool> _running = false;
+    atomic<bool> _cancel = false;
+    thread _thread;
+};
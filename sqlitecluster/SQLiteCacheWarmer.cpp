@@ -0,0 +1,132 @@
+#include "SQLiteCacheWarmer.h"
+
+#include <cstdio>
+
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLitePool.h>
+
+SQLiteCacheWarmer::SQLiteCacheWarmer(shared_ptr<SQLitePool> dbPool, const string& path, uint64_t budgetUS)
+  : _dbPool(dbPool), _path(path), _budgetUS(budgetUS)
+{ }
+
+SQLiteCacheWarmer::~SQLiteCacheWarmer() {
+    _exit = true;
+    lock_guard<decltype(_threadMutex)> lock(_threadMutex);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void SQLiteCacheWarmer::save(SQLite& db) {
+    // Halve the old scores so that tables that have gone cold eventually drop off the list.
+    for (auto it = _heat.begin(); it != _heat.end();) {
+        it->second /= 2;
+        if (it->second) {
+            it++;
+        } else {
+            it = _heat.erase(it);
+        }
+    }
+    for (const auto& [table, count] : db.popTableReadSamples()) {
+        // Samples don't say which schema a table's in, as sqlite finds it by name, so we look it up the same way.
+        const string schema = db.schemaOf(table);
+        if (!schema.empty()) {
+            _heat[schema + "." + table] += count;
+        }
+    }
+    if (_heat.empty()) {
+        return;
+    }
+
+    vector<pair<uint64_t, string>> ranked;
+    for (const auto& [table, heat] : _heat) {
+        ranked.emplace_back(heat, table);
+    }
+    sort(ranked.begin(), ranked.end(), greater<>());
+    if (ranked.size() > MAX_TABLES) {
+        ranked.resize(MAX_TABLES);
+    }
+    list<string> tables;
+    for (const auto& entry : ranked) {
+        tables.push_back(entry.second);
+    }
+
+    // Write a temporary file and rename it over the old one, so a crash mid-write doesn't lose the previous list.
+    const string tempPath = _path + ".tmp";
+    if (!SFileSave(tempPath, SComposeList(tables, "\n")) || rename(tempPath.c_str(), _path.c_str())) {
+        SWARN("Couldn't save cache heat file " << _path);
+    }
+}
+
+list<string> SQLiteCacheWarmer::loadTables() const {
+    list<string> tables;
+    if (SFileExists(_path)) {
+        SParseList(SFileLoad(_path), tables, '\n');
+    }
+    return tables;
+}
+
+void SQLiteCacheWarmer::start() {
+    lock_guard<decltype(_threadMutex)> lock(_threadMutex);
+    if (_running) {
+        return;
+    }
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    _running = true;
+    _thread = thread(&SQLiteCacheWarmer::_warm, this);
+}
+
+void SQLiteCacheWarmer::_warm() {
+    SInitialize("CacheWarmer");
+    const uint64_t start = STimeNow();
+    size_t btreesScanned = 0;
+    list<string> tables = loadTables();
+    if (!tables.empty()) {
+        SQLiteScopedHandle dbScope(*_dbPool, _dbPool->getIndex());
+        SQLite& db = dbScope.db();
+        db.beginTransaction();
+        db.startTiming(_budgetUS);
+        try {
+            for (const string& entry : tables) {
+                // Tables in the file can have been dropped since it was written, or be in a shard that's no longer
+                // attached.
+                const size_t dot = entry.find('.');
+                if (dot == string::npos) {
+                    continue;
+                }
+                const string schema = entry.substr(0, dot);
+                const string table = entry.substr(dot + 1);
+                if ((schema != "main" && !db.getShards().count(schema)) ||
+                    db.read("SELECT COUNT(*) FROM " + SQLite::quoteIdentifier(schema) + ".sqlite_master "
+                            "WHERE type = 'table' AND name = " + SQ(table) + ";") != "1") {
+                    continue;
+                }
+
+                // Counting through each index reads every page of that btree, and the table itself last. Partial
+                // indexes can't be used with `INDEXED BY` for a query without their `WHERE`, so they're skipped.
+                const string quotedTable = SQLite::quoteIdentifier(schema) + "." + SQLite::quoteIdentifier(table);
+                SQResult indexes;
+                db.read("SELECT name FROM pragma_index_list(" + SQ(table) + ", " + SQ(schema) + ") WHERE partial = 0;", indexes);
+                for (size_t i = 0; i < indexes.size() && !_exit; i++) {
+                    db.read("SELECT COUNT(*) FROM (SELECT 1 FROM " + quotedTable + " INDEXED BY "
+                            + SQLite::quoteIdentifier(indexes[i][0]) + ");");
+                    btreesScanned++;
+                }
+                if (_exit) {
+                    break;
+                }
+                db.read("SELECT COUNT(*) FROM " + quotedTable + " NOT INDEXED;");
+                btreesScanned++;
+            }
+        } catch (const SQLite::timeout_error& e) {
+            SINFO("Cache warming ran out of time after " << btreesScanned << " btrees.");
+        }
+        db.resetTiming();
+        db.rollback();
+    }
+    SINFO("Cache warming scanned " << btreesScanned << " btrees from " << tables.size() << " tables in "
+          << (STimeNow() - start) / 1000 << "ms.");
+    _running = false;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+class SQLite;
+class SQLitePool;
+
+// Keeps a node's page cache warm across restarts and leader handoffs. While the node runs, `save` periodically merges
+// the tables sampled by `SQLite::popTableReadSamples` into a decaying heat score and writes the hottest tables, each
+// as `schema.table` so that tables in shards can be found again, to a small file next to the database. `start` reads that file back and scans each listed table and its indexes, hottest
+// first, on a background thread, so that the pages a new leader is about to need are already in the OS page cache and
+// sqlite's own cache rather than being faulted in one at a time by the first commands it runs.
+//
+// This works at the table level, not the page level: sqlite doesn't expose which pages are in its cache, and a table
+// that's hot is usually hot throughout its upper btree levels, which is most of what a cold start pays for.
+class SQLiteCacheWarmer {
+  public:
+    // The maximum number of tables recorded in the heat file.
+    static constexpr size_t MAX_TABLES = 32;
+
+    // How often the node should call `save`.
+    static constexpr uint64_t SAVE_INTERVAL_US = 60'000'000;
+
+    // Warming reads from `dbPool` and stops after `budgetUS`. The heat file is stored at `path`.
+    SQLiteCacheWarmer(shared_ptr<SQLitePool> dbPool, const string& path, uint64_t budgetUS);
+    ~SQLiteCacheWarmer();
+
+    // Merges the latest read samples from `db` into the heat scores and rewrites the heat file.
+    void save(SQLite& db);
+
+    // Starts warming the tables listed in the heat file in the background, if it's not already doing so.
+    void start();
+
+    // Returns true while a warming pass started by `start` is still running.
+    bool isRunning() const { return _running; }
+
+    // Returns the tables in the heat file, as `schema.table`, hottest first.
+    list<string> loadTables() const;
+
+  private:
+    // Scans each table from `loadTables` and its indexes until they're done or the budget runs out.
+    void _warm();
+
+    shared_ptr<SQLitePool> _dbPool;
+    const string _path;
+    const uint64_t _budgetUS;
+
+    // Decayed count of sampled reads for each table, by `schema.table`. Only accessed from `save`, which is called from the sync thread.
+    map<string, uint64_t> _heat;
+
+    atomic<bool> _running = false;
+    atomic<bool> _exit = false;
+    mutex _threadMutex;
+    thread _thread;
+};
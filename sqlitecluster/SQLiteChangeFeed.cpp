@@ -0,0 +1,88 @@
+#include "SQLiteChangeFeed.h"
+
+void SQLiteChangeFeed::setMaxChanges(size_t maxChanges, uint64_t commitCount) {
+    lock_guard<decltype(_m)> lock(_m);
+    if (!_maxChanges.load()) {
+        _clear();
+        _completeAfter = commitCount;
+        _lastCommit = commitCount;
+    }
+    _maxChanges = maxChanges;
+    _trim();
+}
+
+void SQLiteChangeFeed::setMaxBytes(uint64_t maxBytes) {
+    lock_guard<decltype(_m)> lock(_m);
+    _maxBytes = maxBytes;
+    _trim();
+}
+
+void SQLiteChangeFeed::add(uint64_t commitID, list<Change>&& changes, bool complete) {
+    lock_guard<decltype(_m)> lock(_m);
+    if (!_maxChanges.load()) {
+        return;
+    }
+    if (!complete) {
+        _clear();
+        _completeAfter = commitID;
+    } else {
+        for (Change& change : changes) {
+            change.json = "{\"commitID\":" + to_string(commitID) + "," + change.json.substr(1);
+            _bytes += change.table.size() + change.json.size();
+            _changes.emplace_back(commitID, move(change));
+        }
+    }
+    _lastCommit = commitID;
+    _trim();
+}
+
+bool SQLiteChangeFeed::get(uint64_t afterCommit, const set<string>& tables, size_t limit, list<string>& changes,
+                           uint64_t& throughCommit) {
+    lock_guard<decltype(_m)> lock(_m);
+    if (!_maxChanges.load() || afterCommit < _completeAfter) {
+        return false;
+    }
+    throughCommit = max(afterCommit, _lastCommit);
+    auto it = upper_bound(_changes.begin(), _changes.end(), afterCommit,
+                          [](uint64_t commitID, const pair<uint64_t, Change>& change) { return commitID < change.first; });
+    for (; it != _changes.end(); it++) {
+        // Only stop between commits, so a reader never sees part of one.
+        if (!changes.empty() && changes.size() >= limit && it->first != prev(it)->first) {
+            throughCommit = prev(it)->first;
+            break;
+        }
+        if (tables.empty() || tables.count(it->second.table)) {
+            changes.push_back(it->second.json);
+        }
+    }
+    return true;
+}
+
+STable SQLiteChangeFeed::getStats() {
+    lock_guard<decltype(_m)> lock(_m);
+    return {
+        {"maxChanges", to_string(_maxChanges.load())},
+        {"changes", to_string(_changes.size())},
+        {"maxBytes", to_string(_maxBytes)},
+        {"bytes", to_string(_bytes)},
+        {"completeAfter", to_string(_completeAfter)},
+        {"lastCommit", to_string(_lastCommit)},
+    };
+}
+
+void SQLiteChangeFeed::_trim() {
+    while (_changes.size() > _maxChanges.load() || (_maxBytes && _bytes > _maxBytes)) {
+        // Drop whole commits, so the feed stays complete after the last one dropped.
+        const uint64_t commitID = _changes.front().first;
+        while (!_changes.empty() && _changes.front().first == commitID) {
+            _bytes -= _changes.front().second.table.size() + _changes.front().second.json.size();
+            _changes.pop_front();
+        }
+        _completeAfter = commitID;
+    }
+}
+
+void SQLiteChangeFeed::_clear() {
+    _changes.clear();
+    _bytes = 0;
+}
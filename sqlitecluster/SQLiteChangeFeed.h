@@ -0,0 +1,68 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+#include <deque>
+
+// The row changes made by recent commits, in commit order. Each `SQLite` handle records what its transaction changes
+// with the session extension, and adds it here when the transaction commits, while it still holds the commit lock.
+// Followers apply the same commits in the same order, so every node ends up with the same feed.
+//
+// The feed is kept in memory and bounded, so it's only complete after some commit: the one it was enabled at, or the
+// last one it dropped to make room. Readers resume from the last commit they've seen, and have to start over from the
+// tables themselves if that's before the feed is complete.
+class SQLiteChangeFeed {
+  public:
+    struct Change {
+        string table;
+
+        // A JSON object with `table`, `op` (insert, update or delete), and the row's values: `new` for an insert,
+        // `old` for a delete, and for an update, `key` for the primary key columns, and `old` and `new` for the
+        // columns that changed. `add` puts the `commitID` first, as it isn't known until the commit lock is held.
+        string json;
+    };
+
+    // Starts keeping up to `maxChanges` changes, complete from the commit after `commitCount`. 0 stops.
+    void setMaxChanges(size_t maxChanges, uint64_t commitCount);
+
+    // Also keeps no more than about `maxBytes` of changes, so that a few commits that change large rows can't use up
+    // memory when `maxChanges` is sized for small ones. 0, the default, is no limit.
+    void setMaxBytes(uint64_t maxBytes);
+
+    // True if changes are being kept, so transactions should record them.
+    bool enabled() const { return _maxChanges.load(); }
+
+    // Adds the changes made by commit `commitID`. Called for every commit, in order, while it's enabled. If `complete`
+    // is false, the transaction didn't record its changes (because it started before the feed was enabled), so the
+    // feed is only complete after this commit.
+    void add(uint64_t commitID, list<Change>&& changes, bool complete);
+
+    // Sets `changes` to the changes to `tables` (or to every table, if empty) committed after `afterCommit`, stopping
+    // at the end of the first commit that makes it at least `limit` long, and sets `throughCommit` to the last commit
+    // that's covered. Returns false, with no changes, if the feed isn't complete after `afterCommit`.
+    bool get(uint64_t afterCommit, const set<string>& tables, size_t limit, list<string>& changes, uint64_t& throughCommit);
+
+    // Returns how many changes are kept, and the commits they cover.
+    STable getStats();
+
+  private:
+    // Drops the oldest commits until there are no more than `_maxChanges` changes or `_maxBytes` bytes. Expects `_m`
+    // to be locked.
+    void _trim();
+
+    // Removes every change. Expects `_m` to be locked.
+    void _clear();
+
+    mutex _m;
+    atomic<size_t> _maxChanges = 0;
+    uint64_t _maxBytes = 0;
+
+    // The changes, with their commit IDs, and the size of their tables and JSON together.
+    deque<pair<uint64_t, Change>> _changes;
+    uint64_t _bytes = 0;
+
+    // Every change committed after this is in `_changes`.
+    uint64_t _completeAfter = 0;
+
+    // The last commit added, whether or not it changed anything.
+    uint64_t _lastCommit = 0;
+};
@@ -7,9 +7,18 @@
 #include <fcntl.h>
 
 SQLiteClusterMessenger::SQLiteClusterMessenger(const shared_ptr<const SQLiteNode> node)
- : _node(node), _socketPool()
+ : _node(node), _socketPool(), _escalationChannel(node)
 { }
 
+SQLiteClusterMessenger::~SQLiteClusterMessenger() {
+    // Any broadcasts still running are canceled.
+    _broadcastThreadExit = true;
+    _broadcastsChanged.push(true);
+    if (_broadcastThread.joinable()) {
+        _broadcastThread.join();
+    }
+}
+
 void SQLiteClusterMessenger::setErrorResponse(BedrockCommand& command) {
     command.response.methodLine = "500 Internal Server Error";
     command.response.nameValueMap.clear();
@@ -22,6 +31,7 @@ void SQLiteClusterMessenger::shutdownBy(uint64_t shutdownTimestamp) {
     // If it was already set, we don't do anything.
     if(!_shutdownSet.test_and_set()) {
         _shutDownBy = shutdownTimestamp;
+        _escalationChannel.shutdownBy(shutdownTimestamp);
     }
 }
 
@@ -81,26 +91,156 @@ SQLiteClusterMessenger::WaitForReadyResult SQLiteClusterMessenger::waitForReady(
     }
 }
 
-vector<SData> SQLiteClusterMessenger::runOnAll(const SData& cmd) {
-    list<thread> threads;
-    const list<STable> peerInfo = _node->getPeerInfo();
-    vector<SData> results(peerInfo.size());
-    atomic<size_t> index = 0;
-
-    for (const auto& data : peerInfo) {
-        string name = data.at("name");
-        threads.emplace_back([this, &cmd, name, &results, &index](){
-            BedrockCommand command(SQLiteCommand(SData(cmd)), nullptr);
-            runOnPeer(command, name);
-            size_t i = index.fetch_add(1);
-            results[i] = command.response;
-        });
+vector<SData> SQLiteClusterMessenger::runOnAll(const SData& cmd, uint64_t peerTimeoutUS) {
+    mutex m;
+    condition_variable cv;
+    bool finished = false;
+    vector<SData> results;
+    runOnAllAsync(cmd, [&m, &cv, &finished, &results](vector<SData>&& responses) {
+        lock_guard<mutex> lock(m);
+        results = move(responses);
+        finished = true;
+        cv.notify_all();
+    }, peerTimeoutUS);
+
+    unique_lock<mutex> lock(m);
+    cv.wait(lock, [&finished]{return finished;});
+    return results;
+}
+
+uint64_t SQLiteClusterMessenger::runOnAllAsync(const SData& cmd, BroadcastCallback&& callback, uint64_t peerTimeoutUS) {
+    auto broadcast = make_unique<Broadcast>();
+    broadcast->request = cmd.serialize();
+    broadcast->callback = move(callback);
+    if (peerTimeoutUS) {
+        broadcast->timeout = STimeNow() + peerTimeoutUS;
+    } else {
+        broadcast->timeout = BedrockCommand(SQLiteCommand(SData(cmd)), nullptr).timeout();
+    }
+
+    // Look up where to send it. Connecting, which may need a DNS lookup, is left to the broadcast thread.
+    for (const auto& data : _node->getPeerInfo()) {
+        const SQLitePeer* peer = _node->getPeerByName(data.at("name"));
+        string host, path;
+        if (!peer || !SParseURI("http://" + peer->commandAddress.load(), host, path) || !SHostIsValid(host)) {
+            host.clear();
+        }
+        broadcast->hosts.push_back(host);
+        broadcast->responses.emplace_back();
+        broadcast->sockets.emplace_back();
+    }
+
+    uint64_t id;
+    {
+        lock_guard<decltype(_broadcastMutex)> lock(_broadcastMutex);
+        if (!_broadcastThread.joinable()) {
+            _broadcastThread = thread(&SQLiteClusterMessenger::_runBroadcasts, this);
+        }
+        id = broadcast->id = _nextBroadcastID++;
+        _newBroadcasts.push_back(move(broadcast));
     }
-    for (auto& t : threads) {
-        t.join();
+    _broadcastsChanged.push(true);
+    return id;
+}
+
+void SQLiteClusterMessenger::cancelBroadcast(uint64_t broadcastID) {
+    {
+        lock_guard<decltype(_broadcastMutex)> lock(_broadcastMutex);
+        _canceledBroadcasts.insert(broadcastID);
     }
+    _broadcastsChanged.push(true);
+}
 
-    return results;
+void SQLiteClusterMessenger::_runBroadcasts() {
+    SInitialize("broadcast");
+    list<unique_ptr<Broadcast>> broadcasts;
+    while (true) {
+        // Pick up any new broadcasts.
+        list<unique_ptr<Broadcast>> started;
+        set<uint64_t> canceled;
+        {
+            lock_guard<decltype(_broadcastMutex)> lock(_broadcastMutex);
+            started.swap(_newBroadcasts);
+            canceled.swap(_canceledBroadcasts);
+        }
+
+        // Connect to each of their peers and send the request. Any peer we can't connect to has already failed.
+        for (auto& broadcast : started) {
+            for (size_t i = 0; i < broadcast->hosts.size(); i++) {
+                auto& socket = broadcast->sockets[i];
+                if (!broadcast->hosts[i].empty()) {
+                    try {
+                        socket = make_unique<SHTTPSManager::Socket>(broadcast->hosts[i]);
+                        socket->setSendBuffer(broadcast->request);
+                    } catch (const SException& e) {
+                        SINFO("[BROADCAST] Couldn't connect to peer " << i << " at " << broadcast->hosts[i] << ".");
+                        socket = nullptr;
+                    }
+                }
+                if (!socket) {
+                    broadcast->responses[i].methodLine = "500 Internal Server Error";
+                }
+            }
+        }
+        broadcasts.splice(broadcasts.end(), started);
+
+        // Wait for activity on any of our sockets.
+        fd_map fdm;
+        _broadcastsChanged.prePoll(fdm);
+        for (auto& broadcast : broadcasts) {
+            for (auto& socket : broadcast->sockets) {
+                if (socket) {
+                    STCPManager::prePoll(fdm, *socket);
+                }
+            }
+        }
+        S_poll(fdm, 100'000);
+        _broadcastsChanged.postPoll(fdm);
+        _broadcastsChanged.clear();
+
+        // Collect any responses, and finish any peers that have failed, timed out, or been canceled.
+        uint64_t now = STimeNow();
+        bool exiting = _broadcastThreadExit || (_shutDownBy && now > _shutDownBy);
+        for (auto it = broadcasts.begin(); it != broadcasts.end();) {
+            Broadcast& broadcast = **it;
+            bool isCanceled = exiting || canceled.count(broadcast.id);
+            bool done = true;
+            for (size_t i = 0; i < broadcast.sockets.size(); i++) {
+                auto& socket = broadcast.sockets[i];
+                if (!socket) {
+                    continue;
+                }
+                STCPManager::postPoll(fdm, *socket);
+                SData& response = broadcast.responses[i];
+                if (response.deserialize(socket->recvBuffer)) {
+                    socket = nullptr;
+                } else if (socket->state.load() == STCPManager::Socket::CLOSED) {
+                    response.methodLine = "500 Internal Server Error";
+                    socket = nullptr;
+                } else if (isCanceled) {
+                    SINFO("[BROADCAST] Broadcast " << broadcast.id << " canceled before peer " << i << " responded.");
+                    response.methodLine = "500 Canceled";
+                    socket = nullptr;
+                } else if (broadcast.timeout < now) {
+                    SINFO("[BROADCAST] Broadcast " << broadcast.id << " timed out waiting for peer " << i << ".");
+                    response.methodLine = "555 Timeout";
+                    socket = nullptr;
+                } else {
+                    done = false;
+                }
+            }
+            if (done) {
+                broadcast.callback(move(broadcast.responses));
+                it = broadcasts.erase(it);
+            } else {
+                it++;
+            }
+        }
+
+        if (_broadcastThreadExit && broadcasts.empty()) {
+            return;
+        }
+    }
 }
 
 bool SQLiteClusterMessenger::runOnPeer(BedrockCommand& command, const string& peerName) {
@@ -138,6 +278,7 @@ bool SQLiteClusterMessenger::_sendCommandOnSocket(SHTTPSManager::Socket& socket,
     // This is what we need to send.
     SData request = command.request;
     request.nameValueMap["ID"] = command.id;
+    command.addSpeculation(request);
     SFastBuffer buf(request.serialize());
 
     // We only have one FD to poll.
@@ -307,6 +448,10 @@ bool SQLiteClusterMessenger::runOnLeader(BedrockCommand& command) {
     return true;
 }
 
+void SQLiteClusterMessenger::runOnLeaderAsync(unique_ptr<BedrockCommand>&& command, SQLiteEscalationChannel::Callback&& callback) {
+    _escalationChannel.escalate(move(command), move(callback));
+}
+
 bool SQLiteClusterMessenger::commandWillCloseSocket(BedrockCommand& command) {
     // See if either the client or the leader specified `Connection: close`.
     // Technically, we shouldn't need to care if the client wants to close the connection, we could still re-use the connection from this server to leader, except that we've already sent
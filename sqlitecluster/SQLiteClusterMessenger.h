@@ -1,6 +1,8 @@
 #include <libstuff/libstuff.h>
 #include <libstuff/SHTTPSManager.h>
 #include <libstuff/SMultiHostSocketPool.h>
+#include <libstuff/SSynchronizedQueue.h>
+#include <sqlitecluster/SQLiteEscalationChannel.h>
 
 class SQLiteNode;
 class BedrockCommand;
@@ -19,6 +21,7 @@ class SQLiteClusterMessenger {
     };
 
     SQLiteClusterMessenger(const shared_ptr<const SQLiteNode> node);
+    ~SQLiteClusterMessenger();
 
     // Attempts to make a TCP connection to the leader, and run the given command there, setting the appropriate
     // response from leader in the command, and marking it as complete if possible.
@@ -27,12 +30,30 @@ class SQLiteClusterMessenger {
     // no connection to leader could be made).
     bool runOnLeader(BedrockCommand& command);
 
-    // Attempts to run command on every peer. This is done in threads, so the
-    // order in which the peers run the command is not deterministic. Returns a
-    // vector of response objects from each command after they are run. It is
-    // up to the caller to inspect the responses and determine which if any of
-    // the commands to retry.
-    vector<SData> runOnAll(const SData& command);
+    // Like `runOnLeader`, but doesn't block. The command is sent over a persistent connection shared with other
+    // escalated commands, and `callback` is called with the command, from another thread, when it's done. The command
+    // is complete under the same conditions that `runOnLeader` would return true.
+    void runOnLeaderAsync(unique_ptr<BedrockCommand>&& command, SQLiteEscalationChannel::Callback&& callback);
+
+    // Called with one response per peer when `runOnAllAsync` finishes.
+    typedef function<void(vector<SData>&& responses)> BroadcastCallback;
+
+    // Attempts to run command on every peer. The command is sent to all peers at once, so the order in which the peers
+    // run the command is not deterministic. Returns a vector of response objects from each command after they are run,
+    // in the same order as the peers in `getPeerInfo`. It is up to the caller to inspect the responses and determine
+    // which if any of the commands to retry.
+    // If `peerTimeoutUS` is set, any peer that hasn't responded in that many microseconds is given up on, and its
+    // response is `555 Timeout`. Otherwise, peers are given as long as the command's `timeout`.
+    vector<SData> runOnAll(const SData& command, uint64_t peerTimeoutUS = 0);
+
+    // Like `runOnAll`, but returns immediately. The command is sent and the responses collected by a thread shared by
+    // all broadcasts, which calls `callback` with the responses when every peer has responded or timed out. Returns an
+    // ID, never 0, that can be passed to `cancelBroadcast`.
+    uint64_t runOnAllAsync(const SData& command, BroadcastCallback&& callback, uint64_t peerTimeoutUS = 0);
+
+    // Stops waiting for a broadcast started by `runOnAllAsync`. Its callback is called with the responses received so
+    // far, and `500 Canceled` for every peer that hadn't responded yet.
+    void cancelBroadcast(uint64_t broadcastID);
 
     // Attempts to make a TCP connection to a specified peer, and run the given
     // command there, setting the appropriate response from the peer in the
@@ -49,6 +70,25 @@ class SQLiteClusterMessenger {
     void shutdownBy(uint64_t shutdownTimestamp);
 
   private:
+    // A broadcast started by `runOnAllAsync`. These are only accessed by the broadcast thread after they're started.
+    struct Broadcast {
+        uint64_t id;
+        string request;
+        uint64_t timeout;
+        BroadcastCallback callback;
+        vector<SData> responses;
+
+        // The host to connect to for each peer, or empty if it doesn't have a valid address.
+        vector<string> hosts;
+
+        // One socket per peer, connected by the broadcast thread when it starts the broadcast. Each is reset when that
+        // peer has finished.
+        vector<unique_ptr<STCPManager::Socket>> sockets;
+    };
+
+    // The body of the broadcast thread.
+    void _runBroadcasts();
+
     // This takes a pollfd with either POLLIN or POLLOUT set, and waits for the socket to be ready to read or write,
     // respectively. It returns true if ready, or false if error or timeout. The timeout is specified as a timestamp in
     // microseconds.
@@ -79,4 +119,20 @@ class SQLiteClusterMessenger {
 
     // For managing many connections to leader, we have a socket pool.
     SMultiHostSocketPool _socketPool;
+
+    // For `runOnLeaderAsync`.
+    SQLiteEscalationChannel _escalationChannel;
+
+    // Broadcasts waiting to be started by the broadcast thread, and broadcasts that have been canceled.
+    mutex _broadcastMutex;
+    list<unique_ptr<Broadcast>> _newBroadcasts;
+    set<uint64_t> _canceledBroadcasts;
+    uint64_t _nextBroadcastID = 1;
+
+    // Wakes the broadcast thread when a broadcast is started or canceled.
+    SSynchronizedQueue<bool> _broadcastsChanged;
+    atomic<bool> _broadcastThreadExit = false;
+
+    // Started on first use.
+    thread _broadcastThread;
 };
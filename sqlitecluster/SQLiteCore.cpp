@@ -6,7 +6,7 @@
 SQLiteCore::SQLiteCore(SQLite& db) : _db(db)
 { }
 
-bool SQLiteCore::commit(const string& description) {
+bool SQLiteCore::commit(const string& description, const function<void(uint64_t)>& beforeCommit) {
     // This should always succeed.
     SASSERT(_db.prepare());
 
@@ -15,6 +15,9 @@ bool SQLiteCore::commit(const string& description) {
         SWARN("Commit called with nothing to commit.");
         return true;
     }
+    if (beforeCommit) {
+        beforeCommit(_db.getCommitCount() + 1);
+    }
 
     // Perform the actual commit, rollback if it fails.
     int errorCode = _db.commit(description);
@@ -8,7 +8,9 @@ class SQLiteCore {
 
     // Commit the outstanding transaction on the DB.
     // Returns true on successful commit, false on conflict.
-    bool commit(const string& description);
+    // If set, `beforeCommit` is called with the commit count the transaction will have once it's prepared, while no
+    // other thread can commit.
+    bool commit(const string& description, const function<void(uint64_t)>& beforeCommit = nullptr);
 
     // Roll back a transaction if we've decided not to commit it.
     void rollback();
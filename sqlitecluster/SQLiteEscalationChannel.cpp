@@ -0,0 +1,188 @@
+#include "SQLiteEscalationChannel.h"
+
+#include <BedrockCommand.h>
+#include <sqlitecluster/SQLiteNode.h>
+
+SQLiteEscalationChannel::SQLiteEscalationChannel(const shared_ptr<const SQLiteNode> node) : _node(node)
+{ }
+
+SQLiteEscalationChannel::~SQLiteEscalationChannel() {
+    _exit = true;
+    _newEscalations.push(true);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+
+    // Nothing can use these commands now, so they're just discarded.
+    lock_guard<decltype(_escalationMutex)> lock(_escalationMutex);
+    if (_escalations.size()) {
+        SWARN("[HTTPESC] Discarding " << _escalations.size() << " escalated commands.");
+    }
+}
+
+void SQLiteEscalationChannel::escalate(unique_ptr<BedrockCommand>&& command, Callback&& callback) {
+    {
+        lock_guard<decltype(_escalationMutex)> lock(_escalationMutex);
+        if (!_thread.joinable()) {
+            _thread = thread(&SQLiteEscalationChannel::_run, this);
+        }
+        Escalation escalation;
+        escalation.command = move(command);
+        escalation.callback = move(callback);
+        escalation.queuedTime = STimeNow();
+        _escalations.emplace(to_string(_nextEscalationID++), move(escalation));
+    }
+    _newEscalations.push(true);
+}
+
+void SQLiteEscalationChannel::shutdownBy(uint64_t shutdownTimestamp) {
+    uint64_t expected = 0;
+    _shutDownBy.compare_exchange_strong(expected, shutdownTimestamp);
+}
+
+size_t SQLiteEscalationChannel::size() {
+    lock_guard<decltype(_escalationMutex)> lock(_escalationMutex);
+    return _escalations.size();
+}
+
+void SQLiteEscalationChannel::_finish(const string& id, bool failed) {
+    Escalation escalation;
+    {
+        lock_guard<decltype(_escalationMutex)> lock(_escalationMutex);
+        auto it = _escalations.find(id);
+        if (it == _escalations.end()) {
+            SWARN("[HTTPESC] Response for unknown escalation " << id << ", ignoring.");
+            return;
+        }
+        escalation = move(it->second);
+        _escalations.erase(it);
+    }
+
+    BedrockCommand& command = *escalation.command;
+    if (escalation.sent) {
+        command.escalationTimeUS = STimeNow() - command.escalationTimeUS;
+        if (failed) {
+            command.response.methodLine = "500 Internal Server Error";
+            command.response.nameValueMap.clear();
+            command.response.content.clear();
+        } else {
+            command.escalated = true;
+        }
+        command.complete = true;
+    }
+    escalation.callback(move(escalation.command));
+}
+
+void SQLiteEscalationChannel::_run() {
+    SInitialize("escalation");
+    unique_ptr<STCPManager::Socket> socket;
+    string socketAddress;
+    while (!_exit) {
+        // If we've lost our connection, or leader has changed, any command we've sent can't get a response.
+        string leaderAddress = _node->leaderCommandAddress();
+        if (socket && (socket->state.load() == STCPManager::Socket::CLOSED || leaderAddress != socketAddress)) {
+            SINFO("[HTTPESC] Lost connection to leader at " << socketAddress << ".");
+            list<string> sent;
+            {
+                lock_guard<decltype(_escalationMutex)> lock(_escalationMutex);
+                for (auto& p : _escalations) {
+                    if (p.second.sent) {
+                        sent.push_back(p.first);
+                    }
+                }
+            }
+            for (const string& id : sent) {
+                _finish(id, true);
+            }
+            socket = nullptr;
+        }
+
+        // Open a new connection if we need one.
+        list<pair<string, string>> toSend;
+        {
+            lock_guard<decltype(_escalationMutex)> lock(_escalationMutex);
+            bool haveUnsent = any_of(_escalations.begin(), _escalations.end(), [](const auto& p) { return !p.second.sent; });
+            if (haveUnsent && !socket && !leaderAddress.empty()) {
+                string host, path;
+                if (SParseURI("http://" + leaderAddress, host, path) && SHostIsValid(host)) {
+                    try {
+                        socket = make_unique<STCPManager::Socket>(host);
+                        socketAddress = leaderAddress;
+                        SINFO("[HTTPESC] Opening connection to leader at " << leaderAddress << ".");
+                    } catch (const SException& e) {
+                        SINFO("[HTTPESC] Couldn't connect to leader at " << leaderAddress << ".");
+                    }
+                }
+            }
+
+            // Send everything we can.
+            if (socket && socket->state.load() == STCPManager::Socket::CONNECTED) {
+                for (auto& p : _escalations) {
+                    if (!p.second.sent) {
+                        SData request = p.second.command->request;
+                        request["ID"] = p.second.command->id;
+                        request["escalationID"] = p.first;
+                        p.second.command->addSpeculation(request);
+                        toSend.emplace_back(p.first, request.serialize());
+                        p.second.command->escalationTimeUS = STimeNow();
+                        p.second.sent = true;
+                    }
+                }
+            }
+        }
+        for (const auto& p : toSend) {
+            socket->send(p.second);
+        }
+
+        // Wait for something to happen.
+        fd_map fdm;
+        _newEscalations.prePoll(fdm);
+        if (socket) {
+            STCPManager::prePoll(fdm, *socket);
+        }
+        S_poll(fdm, 100'000);
+        _newEscalations.postPoll(fdm);
+        _newEscalations.clear();
+
+        // Match any responses to their commands.
+        if (socket) {
+            STCPManager::postPoll(fdm, *socket);
+            while (true) {
+                SData response;
+                int size = response.deserialize(socket->recvBuffer);
+                if (!size) {
+                    break;
+                }
+                socket->recvBuffer.consumeFront(size);
+                string id = response["escalationID"];
+                response.nameValueMap.erase("escalationID");
+                {
+                    lock_guard<decltype(_escalationMutex)> lock(_escalationMutex);
+                    auto it = _escalations.find(id);
+                    if (it != _escalations.end()) {
+                        it->second.command->response = move(response);
+                    }
+                }
+                _finish(id, false);
+            }
+        }
+
+        // Give up on anything that's been waiting too long.
+        uint64_t now = STimeNow();
+        bool shuttingDown = _shutDownBy && now > _shutDownBy;
+        list<pair<string, bool>> expired;
+        {
+            lock_guard<decltype(_escalationMutex)> lock(_escalationMutex);
+            for (auto& p : _escalations) {
+                if (shuttingDown || p.second.command->timeout() < now ||
+                    (!p.second.sent && p.second.queuedTime + SEND_TIMEOUT_US < now)) {
+                    expired.emplace_back(p.first, p.second.sent);
+                }
+            }
+        }
+        for (const auto& p : expired) {
+            SINFO("[HTTPESC] Giving up on escalation " << p.first << (p.second ? " waiting for a response." : " waiting to send."));
+            _finish(p.first, true);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <libstuff/libstuff.h>
+#include <libstuff/STCPManager.h>
+#include <libstuff/SSynchronizedQueue.h>
+
+class SQLiteNode;
+class BedrockCommand;
+
+// A single persistent connection from a follower to leader that carries many escalated commands at once. Each command
+// is tagged with an `escalationID` header, which leader copies into its response, so responses can be matched to
+// commands in whatever order leader finishes them. All socket I/O happens on one thread owned by this object, so no
+// worker thread waits on leader.
+class SQLiteEscalationChannel {
+  public:
+    // Called with a command when it's done with the channel. `command->complete` is set if leader responded, or if the
+    // command failed after it was sent, exactly as it would be by `SQLiteClusterMessenger::runOnLeader`. If it's not
+    // set, the command was never sent and can be retried.
+    typedef function<void(unique_ptr<BedrockCommand>&& command)> Callback;
+
+    // Commands that can't be sent within this many microseconds (for instance, because there's no leader) are returned
+    // to be retried.
+    static const uint64_t SEND_TIMEOUT_US = 5'000'000;
+
+    SQLiteEscalationChannel(const shared_ptr<const SQLiteNode> node);
+    ~SQLiteEscalationChannel();
+
+    // Takes ownership of `command` and sends it to leader. `callback` is called from the channel's thread.
+    void escalate(unique_ptr<BedrockCommand>&& command, Callback&& callback);
+
+    // Give up on any commands still outstanding at this timestamp.
+    void shutdownBy(uint64_t shutdownTimestamp);
+
+    // Returns the number of commands currently owned by the channel.
+    size_t size();
+
+  private:
+    struct Escalation {
+        unique_ptr<BedrockCommand> command;
+        Callback callback;
+        uint64_t queuedTime;
+        bool sent = false;
+    };
+
+    // The body of the channel's thread.
+    void _run();
+
+    // Removes the escalation with `id` and calls its callback. Expects `_escalationMutex` to *not* be locked.
+    void _finish(const string& id, bool failed);
+
+    const shared_ptr<const SQLiteNode> _node;
+
+    mutex _escalationMutex;
+    map<string, Escalation> _escalations;
+    uint64_t _nextEscalationID = 0;
+
+    // Wakes the channel's thread when there's a new command to send.
+    SSynchronizedQueue<bool> _newEscalations;
+
+    atomic<uint64_t> _shutDownBy = 0;
+    atomic<bool> _exit = false;
+
+    // Started on first use.
+    thread _thread;
+};
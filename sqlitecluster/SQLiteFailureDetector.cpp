@@ -0,0 +1,51 @@
+#include "SQLiteFailureDetector.h"
+
+#include <cmath>
+
+void SQLiteFailureDetector::heartbeat(uint64_t now) {
+    lock_guard<decltype(_m)> lock(_m);
+    if (_lastHeartbeat && now > _lastHeartbeat) {
+        const double interval = now - _lastHeartbeat;
+        _intervals.push_back(now - _lastHeartbeat);
+        _sum += interval;
+        _sumOfSquares += interval * interval;
+        if (_intervals.size() > WINDOW_SIZE) {
+            const double oldest = _intervals.front();
+            _intervals.pop_front();
+            _sum -= oldest;
+            _sumOfSquares -= oldest * oldest;
+        }
+    }
+    _lastHeartbeat = now;
+}
+
+double SQLiteFailureDetector::phi(uint64_t now) const {
+    lock_guard<decltype(_m)> lock(_m);
+    if (_intervals.size() < MIN_SAMPLES || now <= _lastHeartbeat) {
+        return 0;
+    }
+    const double count = _intervals.size();
+    const double mean = _sum / count;
+    const double variance = max(_sumOfSquares / count - mean * mean, 0.0);
+    const double stddev = max(sqrt(variance), (double)MIN_STDDEV_US);
+
+    // As in Akka, the acceptable pause is treated as part of the expected interval.
+    const double expected = mean + ACCEPTABLE_PAUSE_US;
+
+    // This is the logistic approximation of the normal CDF used by Akka and Cassandra, which avoids computing `erf`
+    // and is accurate to about 0.01%. `e / (1 + e)` is the probability that a heartbeat arrives later than now.
+    const double y = ((now - _lastHeartbeat) - expected) / stddev;
+    const double e = exp(-y * (1.5976 + 0.070566 * y * y));
+    if (now - _lastHeartbeat > expected) {
+        return -log10(e / (1.0 + e));
+    }
+    return -log10(1.0 - 1.0 / (1.0 + e));
+}
+
+void SQLiteFailureDetector::reset() {
+    lock_guard<decltype(_m)> lock(_m);
+    _lastHeartbeat = 0;
+    _intervals.clear();
+    _sum = 0;
+    _sumOfSquares = 0;
+}
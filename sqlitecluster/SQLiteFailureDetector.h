@@ -0,0 +1,41 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+// A phi-accrual failure detector (Hayashibara et al.) for a single peer. Rather than declaring a peer dead after a fixed
+// timeout, it tracks the distribution of intervals between heartbeats from the peer, and reports `phi`, a suspicion
+// level that grows the longer the current silence is compared to what's normal for that peer. A phi of 1 means about
+// a 10% chance that declaring the peer dead now would be a mistake, 2 about 1%, 3 about 0.1%, and so on. This lets a
+// steady LAN peer be declared dead within about ten seconds, while a peer on a jittery link gets more slack.
+class SQLiteFailureDetector {
+  public:
+    // The number of intervals kept to estimate the distribution.
+    static constexpr size_t WINDOW_SIZE = 100;
+
+    // The number of intervals required before `phi` will report anything but 0.
+    static constexpr size_t MIN_SAMPLES = 5;
+
+    // The standard deviation is never assumed to be less than this, so that a very regular peer isn't declared dead
+    // after a single late heartbeat.
+    static constexpr uint64_t MIN_STDDEV_US = 500'000;
+
+    // Heartbeats are answered by the sync thread, which can be busy for a few seconds at a time with an exclusive
+    // commit or a blocking command. Silence is only suspicious once it's this much longer than the usual interval, so
+    // that a busy peer isn't mistaken for a failed one.
+    static constexpr uint64_t ACCEPTABLE_PAUSE_US = 5'000'000;
+
+    // Records a heartbeat arriving at `now`.
+    void heartbeat(uint64_t now);
+
+    // Returns the suspicion level at `now`.
+    double phi(uint64_t now) const;
+
+    // Forgets all history, for when the connection to the peer is reset.
+    void reset();
+
+  private:
+    mutable mutex _m;
+    uint64_t _lastHeartbeat = 0;
+    list<uint64_t> _intervals;
+    double _sum = 0;
+    double _sumOfSquares = 0;
+};
@@ -0,0 +1,226 @@
+#include "SQLiteIndexBuilder.h"
+
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+
+atomic<bool> SQLiteIndexBuilder::_pendingBuilds(false);
+
+bool SQLiteIndexBuilder::schedule(SQLite& db, const string& indexName, const string& tableName, const string& indexSQLDefinition) {
+    // The names end up in the schema exactly as `CREATE INDEX` would store them, and in the names of the shadow table
+    // and its triggers, so they're limited to plain identifiers.
+    if (!_isIdentifier(indexName) || !_isIdentifier(tableName)) {
+        SWARN("Can't build index '" << indexName << "' on '" << tableName << "', names must be letters, digits and underscores.");
+        return false;
+    }
+    const string schema = db.schemaOf(tableName);
+    if (schema.empty()) {
+        SWARN("Can't build index '" << indexName << "', no table '" << tableName << "'.");
+        return false;
+    }
+    const string shadowName = _shadowName(indexName);
+    SQResult result;
+    SASSERT(db.read("SELECT tbl_name FROM " + schema + ".sqlite_master WHERE type = 'index' AND name = " + SQ(indexName) + ";", result));
+    if (!result.empty() && result[0][0] == tableName) {
+        return db.verifyIndex(indexName, tableName, indexSQLDefinition, false);
+    } else if (!result.empty() && result[0][0] == shadowName) {
+        // Already being built, make sure it's the same index.
+        SASSERT(db.read("SELECT tableName, definition FROM indexBuilds WHERE name = " + SQ(indexName) + ";", result));
+        return !result.empty() && result[0][0] == tableName && SReplace(result[0][1], " ", "") == SReplace(indexSQLDefinition, " ", "");
+    } else if (!result.empty()) {
+        SWARN("Can't build index '" << indexName << "', it already exists on '" << result[0][0] << "'.");
+        return false;
+    }
+
+    // The shadow only needs the columns the index uses. We pick out every identifier in the definition that names a
+    // column, which may include a few that don't need to be there, but will never miss one.
+    set<string> identifiers;
+    string identifier;
+    for (char c : indexSQLDefinition + " ") {
+        if (isalnum(c) || c == '_') {
+            identifier += tolower(c);
+        } else if (!identifier.empty()) {
+            identifiers.insert(identifier);
+            identifier.clear();
+        }
+    }
+
+    // A duplicate wouldn't be found until the index was moved onto the real table, after it had all been built.
+    if (identifiers.count("unique")) {
+        SWARN("Can't build index '" << indexName << "', unique indexes can't be built in the background.");
+        return false;
+    }
+    SQResult columns;
+    if (!db.read("PRAGMA " + schema + ".table_info(" + tableName + ");", columns) || columns.empty()) {
+        SWARN("Can't build index '" << indexName << "', no table '" << tableName << "'.");
+        return false;
+    }
+    list<string> columnNames;
+    list<string> columnDefinitions;
+    for (size_t i = 0; i < columns.size(); i++) {
+        const string& name = columns[i][1];
+        if (!identifiers.count(SToLower(name))) {
+            continue;
+        }
+
+        // The index's keys have to be stored the same way they are in the real table, so each column needs the same
+        // type affinity and collation.
+        const char* type = nullptr;
+        const char* collation = nullptr;
+        if (sqlite3_table_column_metadata(db.getDBHandle(), schema.c_str(), tableName.c_str(), name.c_str(), &type, &collation, nullptr, nullptr, nullptr)) {
+            STHROW("500 Couldn't read column '" + name + "' of '" + tableName + "'");
+        }
+        columnNames.push_back(SQLite::quoteIdentifier(name));
+        columnDefinitions.push_back(SQLite::quoteIdentifier(name) + " " + (type ? type : "") + " COLLATE " + (collation ? collation : "BINARY"));
+    }
+
+    if (columnNames.empty()) {
+        SWARN("Can't build index '" << indexName << "', it doesn't use any columns of '" << tableName << "'.");
+        return false;
+    }
+
+    // Every row up to the current highest rowid gets copied. Anything inserted after this is mirrored by the triggers.
+    if (!db.read("SELECT IFNULL(MIN(rowid), 1), IFNULL(MAX(rowid), 0) FROM " + tableName + ";", result)) {
+        SWARN("Can't build index '" << indexName << "', '" << tableName << "' isn't a rowid table.");
+        return false;
+    }
+    const int64_t lastRowID = SToInt64(result[0][0]) - 1;
+    const int64_t targetRowID = SToInt64(result[0][1]);
+
+    const string columnList = SComposeList(columnNames, ", ");
+    const string newValues = "NEW.rowid, NEW." + SComposeList(columnNames, ", NEW.");
+    bool ignore;
+    SASSERT(db.verifyTable("indexBuilds", "CREATE TABLE indexBuilds ( "
+                                          "name        TEXT NOT NULL PRIMARY KEY, "
+                                          "tableName   TEXT NOT NULL, "
+                                          "definition  TEXT NOT NULL, "
+                                          "state       TEXT NOT NULL, "
+                                          "lastRowID   INTEGER NOT NULL, "
+                                          "targetRowID INTEGER NOT NULL, "
+                                          "created     INTEGER NOT NULL )", ignore));
+    // The shadow table, its index, and the triggers all go in the same file as the table, as the index has to end up
+    // there, and triggers can only use tables in their own file.
+    bool success = db.write("CREATE TABLE " + schema + "." + shadowName + " ( " + SComposeList(columnDefinitions, ", ") + " );") &&
+                   db.write("CREATE INDEX " + schema + "." + indexName + " ON " + shadowName + " " + indexSQLDefinition + ";") &&
+                   db.write("CREATE TRIGGER " + schema + "." + shadowName + "_insert AFTER INSERT ON " + tableName + " BEGIN "
+                            "INSERT OR REPLACE INTO " + shadowName + " (rowid, " + columnList + ") VALUES (" + newValues + "); END;") &&
+                   db.write("CREATE TRIGGER " + schema + "." + shadowName + "_update AFTER UPDATE ON " + tableName + " BEGIN "
+                            "DELETE FROM " + shadowName + " WHERE rowid = OLD.rowid; "
+                            "INSERT OR REPLACE INTO " + shadowName + " (rowid, " + columnList + ") VALUES (" + newValues + "); END;") &&
+                   db.write("CREATE TRIGGER " + schema + "." + shadowName + "_delete AFTER DELETE ON " + tableName + " BEGIN "
+                            "DELETE FROM " + shadowName + " WHERE rowid = OLD.rowid; END;") &&
+                   db.write("INSERT INTO indexBuilds VALUES (" + SQ(indexName) + ", " + SQ(tableName) + ", " + SQ(indexSQLDefinition) + ", "
+                            "'copying', " + SQ(lastRowID) + ", " + SQ(targetRowID) + ", " + SQ(STimeNow()) + ");");
+    if (success) {
+        _pendingBuilds = true;
+        SINFO("Scheduled background build of index '" << indexName << "' on '" << tableName << "' through rowid " << targetRowID << ".");
+    }
+    return success;
+}
+
+void SQLiteIndexBuilder::loadPendingBuilds(SQLite& db) {
+    db.beginTransaction(SQLite::TRANSACTION_TYPE::SHARED);
+    _pendingBuilds = !db.read("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'indexBuilds';").empty() &&
+                     !db.read("SELECT 1 FROM indexBuilds LIMIT 1;").empty();
+    db.rollback();
+}
+
+bool SQLiteIndexBuilder::step(SQLite& db, uint64_t maxRows) {
+    maxRows = max<uint64_t>(maxRows, 1);
+    SQResult builds;
+    if (db.read("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'indexBuilds';").empty() ||
+        !db.read("SELECT name, tableName, definition, state, lastRowID, targetRowID FROM indexBuilds ORDER BY created, name;", builds)) {
+        builds.clear();
+    }
+
+    // A build that finishes in this step isn't done until it's committed, so we only clear this once there's nothing
+    // left at all.
+    if (builds.empty()) {
+        _pendingBuilds = false;
+    }
+
+    bool success = true;
+    if (!builds.empty()) {
+        const string indexName = builds[0][0];
+        const string tableName = builds[0][1];
+        const string state = builds[0][3];
+        const int64_t lastRowID = SToInt64(builds[0][4]);
+        const int64_t targetRowID = SToInt64(builds[0][5]);
+        const string shadowName = _shadowName(indexName);
+        const string schema = db.schemaOf(shadowName);
+        if (schema.empty()) {
+            success = false;
+        } else if (state == "copying" && lastRowID < targetRowID) {
+            SQResult columns;
+            list<string> columnNames;
+            if (db.read("PRAGMA " + schema + ".table_info(" + shadowName + ");", columns)) {
+                for (size_t i = 0; i < columns.size(); i++) {
+                    columnNames.push_back(SQLite::quoteIdentifier(columns[i][1]));
+                }
+            }
+            const string columnList = SComposeList(columnNames, ", ");
+            const string end = db.read("SELECT rowid FROM " + tableName + " WHERE rowid > " + SQ(lastRowID) + " AND rowid <= " + SQ(targetRowID) + " "
+                                       "ORDER BY rowid LIMIT 1 OFFSET " + SQ(maxRows - 1) + ";");
+            const int64_t endRowID = end.empty() ? targetRowID : SToInt64(end);
+            success = !columnNames.empty() &&
+                      db.write("INSERT OR REPLACE INTO " + shadowName + " (rowid, " + columnList + ") SELECT rowid, " + columnList + " "
+                               "FROM " + tableName + " WHERE rowid > " + SQ(lastRowID) + " AND rowid <= " + SQ(endRowID) + ";") &&
+                      db.write("UPDATE indexBuilds SET lastRowID = " + SQ(endRowID) + " WHERE name = " + SQ(indexName) + ";");
+            builds[0][4] = to_string(endRowID);
+        } else if (state == "copying") {
+            // Everything's copied and the triggers have kept it current, so the index now has exactly the entries it
+            // would have on the real table. Point it there, and reload the schema so that this connection sees it.
+            const string createSQL = "CREATE INDEX " + indexName + " ON " + tableName + " " + builds[0][2];
+            success = db.writeUnmodified("PRAGMA writable_schema = ON;") &&
+                      db.writeUnmodified("UPDATE " + schema + ".sqlite_master SET tbl_name = " + SQ(tableName) + ", sql = " + SQ(createSQL) + " "
+                                         "WHERE type = 'index' AND name = " + SQ(indexName) + ";") &&
+                      db.writeUnmodified("PRAGMA writable_schema = RESET;") &&
+                      db.write("DROP TRIGGER " + schema + "." + shadowName + "_insert;") &&
+                      db.write("DROP TRIGGER " + schema + "." + shadowName + "_update;") &&
+                      db.write("DROP TRIGGER " + schema + "." + shadowName + "_delete;") &&
+                      db.write("UPDATE indexBuilds SET state = 'cleaning' WHERE name = " + SQ(indexName) + ";");
+            if (!success) {
+                SQuery(db.getDBHandle(), "resetting schema", "PRAGMA writable_schema = RESET;");
+            } else {
+                SINFO("Moved index '" << indexName << "' onto '" << tableName << "'.");
+            }
+            builds[0][3] = "cleaning";
+        } else if (db.read("SELECT 1 FROM " + shadowName + " LIMIT 1;").empty()) {
+            success = db.write("DROP TABLE " + schema + "." + shadowName + ";") &&
+                      db.write("DELETE FROM indexBuilds WHERE name = " + SQ(indexName) + ";");
+            SINFO("Finished building index '" << indexName << "' on '" << tableName << "'.");
+            builds.rows.erase(builds.rows.begin());
+        } else {
+            // Dropping the shadow table frees all of its pages at once, so we empty it in steps first.
+            success = db.write("DELETE FROM " + shadowName + " WHERE rowid IN "
+                               "(SELECT rowid FROM " + shadowName + " ORDER BY rowid LIMIT " + SQ(maxRows) + ");");
+        }
+        if (!success) {
+            SWARN("Step of index build '" << indexName << "' failed.");
+        }
+    }
+
+    list<STable> progress;
+    for (size_t i = 0; i < builds.size(); i++) {
+        progress.push_back({
+            {"name", builds[i][0]},
+            {"table", builds[i][1]},
+            {"state", builds[i][3]},
+            {"lastRowID", builds[i][4]},
+            {"targetRowID", builds[i][5]},
+        });
+    }
+    {
+        lock_guard<decltype(_m)> lock(_m);
+        _progress = move(progress);
+    }
+    return success && !db.getUncommittedQuery().empty();
+}
+
+list<STable> SQLiteIndexBuilder::getProgress() const {
+    lock_guard<decltype(_m)> lock(_m);
+    return _progress;
+}
+
+bool SQLiteIndexBuilder::_isIdentifier(const string& name) {
+    return !name.empty() && all_of(name.begin(), name.end(), [](unsigned char c) { return isalnum(c) || c == '_'; });
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+class SQLite;
+
+// Builds indexes on large tables a few rows at a time, instead of with one `CREATE INDEX` that holds the commit lock
+// for as long as it takes to scan and sort the whole table.
+//
+// `schedule` creates an empty shadow table with just the columns the index uses, creates the index on *that* table,
+// and adds triggers that mirror every change to the real table into the shadow. Each `step` then copies the next
+// range of existing rows into the shadow, so the index is built incrementally as a normal btree insert. Once every
+// row that existed when the build was scheduled has been copied, the index is moved onto the real table by pointing
+// its schema entry at it. This works because an index's records are the indexed values followed by the rowid, and the
+// shadow has the same rowids, column types, and collations as the real table, so the btree is identical to one
+// `CREATE INDEX` would have built. The shadow table is then emptied a step at a time and dropped.
+//
+// Every step is an ordinary transaction whose queries only use values read on leader, so followers replay it exactly,
+// and the progress of each build is kept in the `indexBuilds` table, so a new leader picks up where the old one left
+// off. Only non-unique indexes on rowid tables can be built this way.
+class SQLiteIndexBuilder {
+  public:
+    // The most rows a single step copies or deletes.
+    static constexpr uint64_t ROWS_PER_STEP = 1000;
+
+    // Schedules building `indexName` on `tableName`, in the same format as `SQLite::verifyIndex`. Must be called
+    // inside a transaction, normally from `upgradeDatabase`. Returns true if the index already exists with this
+    // definition, or its build is scheduled, and false if it exists with a different definition or can't be built.
+    // The table can be in the main file or a shard.
+    static bool schedule(SQLite& db, const string& indexName, const string& tableName, const string& indexSQLDefinition);
+
+    // Returns false if there's no build to step through, so that callers can skip starting a transaction to find
+    // that out. This is set by `schedule` and `loadPendingBuilds`, and cleared by a `step` that finds nothing to do.
+    static bool hasPendingBuilds() { return _pendingBuilds; }
+
+    // Sets `hasPendingBuilds` from the builds recorded in the database, for a node that's just become leader and may
+    // need to pick up builds started by the previous one. Must be called outside of a transaction.
+    static void loadPendingBuilds(SQLite& db);
+
+    // Runs the next step of the oldest scheduled build in the current transaction, touching no more than `maxRows`
+    // rows. Returns false if there was nothing to do, or the step failed.
+    bool step(SQLite& db, uint64_t maxRows);
+
+    // Returns the state of each build as of the last call to `step`.
+    list<STable> getProgress() const;
+
+  private:
+    static string _shadowName(const string& indexName) { return "indexBuild_" + indexName; }
+
+    // Returns true if `name` is only letters, digits and underscores.
+    static bool _isIdentifier(const string& name);
+
+    static atomic<bool> _pendingBuilds;
+
+    mutable mutex _m;
+    list<STable> _progress;
+};
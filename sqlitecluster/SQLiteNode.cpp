@@ -60,6 +60,7 @@
 
 // Initializations for static vars.
 const uint64_t SQLiteNode::RECV_TIMEOUT{STIME_US_PER_S * 30};
+const uint64_t SQLiteNode::HEARTBEAT_INTERVAL{STIME_US_PER_S};
 
 const string SQLiteNode::CONSISTENCY_LEVEL_NAMES[] = {"ASYNC",
                                                     "ONE",
@@ -132,6 +133,7 @@ SQLiteNode::SQLiteNode(SQLiteServer& server, shared_ptr<SQLitePool> dbPool, cons
 SQLiteNode::~SQLiteNode() {
     // Make sure it's a clean shutdown
     SASSERTWARN(!commitInProgress());
+    _failQuorumCommits();
 
     // Clean up all the sockets and peers
     for (Socket* socket : _unauthenticatedIncomingSockets) {
@@ -402,10 +404,18 @@ void SQLiteNode::_sendOutstandingTransactions(const set<uint64_t>& commitOnlyIDs
         uint64_t dbCountAtStart = get<2>(i.second);
         string idHeader = to_string(id);
 
+        // Transactions committed by workers that need approval get an ID that followers will respond to.
+        bool needsApproval = false;
+        {
+            lock_guard<decltype(_quorumCommitMutex)> lock(_quorumCommitMutex);
+            needsApproval = _quorumCommits.count(id);
+        }
+
         // If this is marked as "commitOnly", we won't send the BEGIN for it.
         if (commitOnlyIDs.find(id) == commitOnlyIDs.end()) {
-            // Any commit where we can send a BEGIN and a COMMIT without waiting for acknowledgement is ASYNC.
-            idHeader = "ASYNC_" + idHeader;
+            // Any commit where we can send a BEGIN and a COMMIT without waiting for acknowledgement is ASYNC, unless
+            // a worker is waiting for approvals of it after the fact.
+            idHeader = (needsApproval ? "QUORUM_" : "ASYNC_") + idHeader;
             SData transaction("BEGIN_TRANSACTION");
             transaction["NewCount"] = to_string(id);
             transaction["NewHash"] = hash;
@@ -419,7 +429,7 @@ void SQLiteNode::_sendOutstandingTransactions(const set<uint64_t>& commitOnlyIDs
             }
 
             // Allows us to easily figure out how far behind followers are by analyzing the logs.
-            SINFO("Sending COMMIT for ASYNC transaction " << id << " to followers");
+            SINFO("Sending COMMIT for " << (needsApproval ? "QUORUM" : "ASYNC") << " transaction " << id << " to followers");
             _sendToAllPeers(transaction, true); // subscribed only
         } else {
             SINFO("Sending COMMIT for QUORUM transaction " << id << " to followers");
@@ -478,6 +488,17 @@ list<STable> SQLiteNode::getPeerInfo() const {
 bool SQLiteNode::update() {
     unique_lock<decltype(_stateMutex)> uniqueLock(_stateMutex);
 
+    // Periodically record which tables are hot, so we can warm them after a restart.
+    if (_cacheWarmer && STimeNow() > _nextCacheHeatSave) {
+        _cacheWarmer->save(_db);
+        _nextCacheHeatSave = STimeNow() + SQLiteCacheWarmer::SAVE_INTERVAL_US;
+    }
+
+    // Give up on any worker transactions that can't be approved in time, so their commands don't wait forever.
+    if (_quorumCommitsInFlight) {
+        _expireQuorumCommits();
+    }
+
     // Process the database state machine
     switch (_state) {
     /// - SEARCHING: Wait for a period and try to connect to all known
@@ -784,6 +805,11 @@ bool SQLiteNode::update() {
         // If everyone's responded with approval and we form a majority, then finish standup.
         bool majorityConnected = numLoggedInFullPeers * 2 >= numFullPeers;
         if (allResponded && majorityConnected) {
+            // Give the cache warmer until our usual timeout to finish, rather than leading with a cold cache.
+            if (_cacheWarmer && _cacheWarmer->isRunning() && STimeNow() < _stateTimeout) {
+                return false; // Don't re-update
+            }
+
             // Complete standup
             SINFO("All peers approved standup, going LEADING.");
             _changeState(LEADING);
@@ -1069,6 +1095,10 @@ bool SQLiteNode::update() {
                 // Try again.
                 SINFO("Can't switch from STANDINGDOWN to SEARCHING yet, server prevented state change.");
                 return false;
+            } else if (_quorumCommitsInFlight) {
+                SINFO("Can't switch from STANDINGDOWN to SEARCHING yet, waiting for approval of " << _quorumCommitsInFlight
+                      << " worker transactions.");
+                return false;
             }
             // Standdown complete
             SINFO("STANDDOWN complete, SEARCHING");
@@ -1165,7 +1195,9 @@ void SQLiteNode::_onMESSAGE(SQLitePeer* peer, const SData& message) {
             return;
         } else if (SIEquals(message.methodLine, "PONG")) {
             // Latency must be > 0 because we treat 0 as "not connected".
-            peer->latency = max(STimeNow() - message.calc64("Timestamp"), 1ul);
+            uint64_t now = STimeNow();
+            peer->latency = max(now - message.calc64("Timestamp"), 1ul);
+            peer->failureDetector.heartbeat(now);
             SINFO("Received PONG from peer '" << peer->name << "' (" << peer->latency/1000 << "ms latency)");
             return;
         }
@@ -1206,6 +1238,11 @@ void SQLiteNode::_onMESSAGE(SQLitePeer* peer, const SData& message) {
                 STHROW("you're *not* supposed to be a 0-priority permafollower");
             }
 
+            // Every node has to have the same shards, or transactions that write to one couldn't be replicated.
+            if (message["Shards"] != SComposeList(_db.getShards())) {
+                STHROW("mismatched shards, expected '" + SComposeList(_db.getShards()) + "'");
+            }
+
             // It's an error to have to peers configured with the same priority, except 0 and -1
             SASSERT(_priority == -1 || _priority == 0 || message.calc("Priority") != _priority);
             PINFO("Peer logged in at '" << message["State"] << "', priority #" << message["Priority"] << " commit #"
@@ -1611,6 +1648,19 @@ void SQLiteNode::_onMESSAGE(SQLitePeer* peer, const SData& message) {
                 STHROW("not leading");
             }
             SQLitePeer::Response response = SIEquals(message.methodLine, "APPROVE_TRANSACTION") ? SQLitePeer::Response::APPROVE : SQLitePeer::Response::DENY;
+            if (SStartsWith(message["ID"], "QUORUM_")) {
+                // This is for a transaction a worker has already committed. If it was denied, the follower is about to
+                // reconnect, and we'll wait for the rest of the cluster unless there aren't enough followers left.
+                PINFO("Peer " << response << " worker transaction #" << message["NewCount"] << " (" << message["NewHash"] << ")");
+                if (!peer->permaFollower) {
+                    if (response == SQLitePeer::Response::APPROVE) {
+                        _handleQuorumApproval(peer, message.calcU64("NewCount"));
+                    } else {
+                        _handleQuorumDenial(peer, message.calcU64("NewCount"));
+                    }
+                }
+                return;
+            }
             try {
                 // We ignore late approvals of commits that have already been finalized. They could have been committed
                 // already, in which case `_lastSentTransactionID` will have incremented, or they could have been rolled
@@ -1666,6 +1716,7 @@ void SQLiteNode::_onConnect(SQLitePeer* peer) {
     login["State"] = stateName(_state);
     login["Version"] = _version;
     login["Permafollower"] = _originalPriority ? "false" : "true";
+    login["Shards"] = SComposeList(_db.getShards());
     _sendToPeer(peer, login);
 }
 
@@ -1825,6 +1876,11 @@ void SQLiteNode::_changeState(SQLiteNode::State newState) {
             // TODO: Maybe it would be better to re-send the message indicating we're standing up when we see someone
             // hasn't responded.
             timeout = STIME_US_PER_S * 5 + SRandom::rand64() % STIME_US_PER_S * 5;
+
+            // Use the time it takes peers to approve to warm the cache we're about to start leading with.
+            if (_cacheWarmer) {
+                _cacheWarmer->start();
+            }
         } else if (newState == SEARCHING || newState == SUBSCRIBING || newState == SYNCHRONIZING) {
             timeout = RECV_TIMEOUT + SRandom::rand64() % STIME_US_PER_S * 5;
         } else {
@@ -1850,6 +1906,9 @@ void SQLiteNode::_changeState(SQLiteNode::State newState) {
             // We send any unsent transactions here before we finish switching states, we need to make sure these are
             // all sent to the new leader before we complete the transition.
             _sendOutstandingTransactions();
+
+            // Nobody will approve anything we're still waiting on now.
+            _failQuorumCommits();
         }
 
         // Clear some state if we can
@@ -2487,6 +2546,27 @@ void SQLiteNode::postPoll(fd_map& fdm, uint64_t& nextActivity) {
                 } catch (const out_of_range& e) {
                     // Ok, just no messages.
                 }
+
+                // With the failure detector enabled, we keep a steady stream of PINGs going to every peer, and drop
+                // any peer whose PONGs have stopped arriving for long enough to be suspicious. This is checked after
+                // handling messages so that a PONG that just arrived counts.
+                const double threshold = _failureDetectorThreshold.load();
+                if (threshold > 0 && peer->connected()) {
+                    const uint64_t now = STimeNow();
+                    const double phi = peer->failureDetector.phi(now);
+                    if (phi > threshold) {
+                        SHMMM("Peer '" << peer->name << "' suspected failed (phi=" << phi << "), reconnecting.");
+                        SData reconnect("RECONNECT");
+                        reconnect["Reason"] = "failure suspected";
+                        peer->sendMessage(reconnect.serialize());
+                        peer->shutdownSocket();
+                    } else {
+                        if (now >= peer->lastPingTime + HEARTBEAT_INTERVAL) {
+                            _sendPING(peer);
+                        }
+                        nextActivity = min(nextActivity, peer->lastPingTime + HEARTBEAT_INTERVAL);
+                    }
+                }
             }
             break;
         }
@@ -2507,10 +2587,213 @@ void SQLiteNode::_sendPING(SQLitePeer* peer) {
     // Send a PING message, including our current timestamp
     SASSERT(peer);
     SData ping("PING");
-    ping["Timestamp"] = SToStr(STimeNow());
+    uint64_t now = STimeNow();
+    ping["Timestamp"] = SToStr(now);
+    peer->lastPingTime = now;
     peer->sendMessage(ping.serialize());
 }
 
+void SQLiteNode::setFailureDetectorThreshold(double phi) {
+    _failureDetectorThreshold.store(phi);
+}
+
+void SQLiteNode::startQuorumCommit(uint64_t commitCount, ConsistencyLevel consistency, uint64_t deadline) {
+    lock_guard<decltype(_quorumCommitMutex)> lock(_quorumCommitMutex);
+    QuorumCommit& commit = _quorumCommits[commitCount];
+    commit.consistency = consistency;
+    commit.deadline = deadline;
+    _quorumCommitsInFlight++;
+}
+
+void SQLiteNode::cancelQuorumCommit(uint64_t commitCount) {
+    lock_guard<decltype(_quorumCommitMutex)> lock(_quorumCommitMutex);
+    auto it = _quorumCommits.find(commitCount);
+    if (it != _quorumCommits.end()) {
+        if (!it->second.resolved) {
+            _quorumCommitsInFlight--;
+        }
+        _quorumCommits.erase(it);
+    }
+}
+
+void SQLiteNode::waitForQuorum(uint64_t commitCount, function<void(QuorumResult)>&& callback) {
+    unique_lock<decltype(_quorumCommitMutex)> lock(_quorumCommitMutex);
+    auto it = _quorumCommits.find(commitCount);
+    if (it == _quorumCommits.end()) {
+        SWARN("Waiting for quorum on transaction #" << commitCount << " that wasn't started.");
+        lock.unlock();
+        callback(QuorumResult::NOT_LEADING);
+        return;
+    }
+
+    // With no full peers, there's nobody to wait for.
+    if (!it->second.resolved && _hasEnoughApprovals(it->second)) {
+        it->second.resolved = true;
+        it->second.result = QuorumResult::APPROVED;
+        _quorumCommitsInFlight--;
+    }
+    if (it->second.resolved) {
+        QuorumResult result = it->second.result;
+        _quorumCommits.erase(it);
+        lock.unlock();
+        callback(result);
+        return;
+    }
+    it->second.callback = move(callback);
+}
+
+size_t SQLiteNode::getQuorumCommitsInFlight() const {
+    return _quorumCommitsInFlight;
+}
+
+void SQLiteNode::setCacheWarmingBudget(uint64_t budgetUS) {
+    _cacheWarmer = make_unique<SQLiteCacheWarmer>(_dbPool, _db.getFilename() + "-hot", budgetUS);
+    _nextCacheHeatSave = STimeNow() + SQLiteCacheWarmer::SAVE_INTERVAL_US;
+    _cacheWarmer->start();
+}
+
+bool SQLiteNode::_hasEnoughApprovals(const QuorumCommit& commit) const {
+    size_t numFullPeers = 0;
+    for (auto peer : _peerList) {
+        if (!peer->permaFollower) {
+            numFullPeers++;
+        }
+    }
+    if (commit.consistency == ONE) {
+        return !numFullPeers || commit.approvals.size();
+    }
+    return commit.approvals.size() * 2 >= numFullPeers;
+}
+
+bool SQLiteNode::_canBeApproved(const QuorumCommit& commit) const {
+    // Only followers we're subscribed to are sent the transaction, so nobody else is going to approve it.
+    size_t numFullPeers = 0;
+    size_t numPossible = 0;
+    for (auto peer : _peerList) {
+        if (!peer->permaFollower) {
+            numFullPeers++;
+            if (commit.approvals.count(peer) || (peer->subscribed && !commit.denials.count(peer))) {
+                numPossible++;
+            }
+        }
+    }
+    if (commit.consistency == ONE) {
+        return !numFullPeers || numPossible;
+    }
+    return numPossible * 2 >= numFullPeers;
+}
+
+bool SQLiteNode::_resolveQuorumCommit(QuorumCommit& commit, QuorumResult result, list<function<void(QuorumResult)>>& callbacks) {
+    if (!commit.resolved) {
+        commit.resolved = true;
+        commit.result = result;
+        _quorumCommitsInFlight--;
+    }
+
+    // Anything resolved that a worker's waiting on is done. The rest are picked up in `waitForQuorum`.
+    if (commit.callback) {
+        callbacks.push_back(move(commit.callback));
+        return true;
+    }
+    return false;
+}
+
+void SQLiteNode::_handleQuorumApproval(SQLitePeer* peer, uint64_t commitCount) {
+    list<function<void(QuorumResult)>> callbacks;
+    {
+        lock_guard<decltype(_quorumCommitMutex)> lock(_quorumCommitMutex);
+        for (auto it = _quorumCommits.begin(); it != _quorumCommits.end() && it->first <= commitCount;) {
+            QuorumCommit& commit = it->second;
+            if (!commit.resolved) {
+                commit.approvals.insert(peer);
+            }
+            if ((commit.resolved || _hasEnoughApprovals(commit)) && _resolveQuorumCommit(commit, QuorumResult::APPROVED, callbacks)) {
+                SINFO("Worker transaction #" << it->first << " approved.");
+                it = _quorumCommits.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+    for (auto& callback : callbacks) {
+        callback(QuorumResult::APPROVED);
+    }
+}
+
+void SQLiteNode::_handleQuorumDenial(SQLitePeer* peer, uint64_t commitCount) {
+    function<void(QuorumResult)> callback;
+    {
+        lock_guard<decltype(_quorumCommitMutex)> lock(_quorumCommitMutex);
+        auto it = _quorumCommits.find(commitCount);
+        if (it == _quorumCommits.end() || it->second.resolved) {
+            return;
+        }
+        QuorumCommit& commit = it->second;
+        commit.denials.insert(peer);
+        if (_canBeApproved(commit)) {
+            return;
+        }
+        SWARN("Worker transaction #" << commitCount << " denied by " << commit.denials.size() << " followers.");
+        list<function<void(QuorumResult)>> callbacks;
+        if (_resolveQuorumCommit(commit, QuorumResult::DENIED, callbacks)) {
+            callback = move(callbacks.front());
+            _quorumCommits.erase(it);
+        }
+    }
+    if (callback) {
+        callback(QuorumResult::DENIED);
+    }
+}
+
+void SQLiteNode::_expireQuorumCommits() {
+    list<pair<function<void(QuorumResult)>, QuorumResult>> results;
+    {
+        lock_guard<decltype(_quorumCommitMutex)> lock(_quorumCommitMutex);
+        const uint64_t now = STimeNow();
+        for (auto it = _quorumCommits.begin(); it != _quorumCommits.end();) {
+            QuorumCommit& commit = it->second;
+            list<function<void(QuorumResult)>> callbacks;
+            bool erase = false;
+            if (!commit.resolved && commit.deadline && now > commit.deadline) {
+                SWARN("Timed out waiting for approval of worker transaction #" << it->first << ".");
+                erase = _resolveQuorumCommit(commit, QuorumResult::TIMED_OUT, callbacks);
+            } else if (!commit.resolved && !_canBeApproved(commit)) {
+                SWARN("Too few followers left to approve worker transaction #" << it->first << ".");
+                erase = _resolveQuorumCommit(commit, QuorumResult::DENIED, callbacks);
+            }
+            if (erase) {
+                results.emplace_back(move(callbacks.front()), commit.result);
+                it = _quorumCommits.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+    for (auto& result : results) {
+        result.first(result.second);
+    }
+}
+
+void SQLiteNode::_failQuorumCommits() {
+    list<function<void(QuorumResult)>> callbacks;
+    {
+        lock_guard<decltype(_quorumCommitMutex)> lock(_quorumCommitMutex);
+        for (auto it = _quorumCommits.begin(); it != _quorumCommits.end();) {
+            if (!it->second.resolved) {
+                SWARN("Giving up on approval of worker transaction #" << it->first << ".");
+            }
+            if (_resolveQuorumCommit(it->second, QuorumResult::NOT_LEADING, callbacks)) {
+                it = _quorumCommits.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+    for (auto& callback : callbacks) {
+        callback(QuorumResult::NOT_LEADING);
+    }
+}
+
 SQLitePeer* SQLiteNode::getPeerByName(const string& name) const {
     // TODO: Store peers in sorted order by name and binary search the list here.
     for (const auto& peer : _peerList) {
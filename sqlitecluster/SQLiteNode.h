@@ -3,6 +3,7 @@
 #include <libstuff/SSynchronizedQueue.h>
 #include <libstuff/STCPManager.h>
 #include <sqlitecluster/SQLite.h>
+#include <sqlitecluster/SQLiteCacheWarmer.h>
 #include <sqlitecluster/SQLitePool.h>
 #include <sqlitecluster/SQLiteSequentialNotifier.h>
 
@@ -63,6 +64,14 @@ class SQLiteNode : public STCPManager {
         NUM_CONSISTENCY_LEVELS
     };
 
+    // How a transaction passed to `waitForQuorum` was resolved.
+    enum class QuorumResult {
+        APPROVED,
+        DENIED,     // Enough followers denied it, or dropped off, that it can no longer be approved.
+        TIMED_OUT,  // Its deadline passed before it was approved.
+        NOT_LEADING // We stopped leading before it was approved.
+    };
+
     // Possible states of a node in a DB cluster
     enum State {
         UNKNOWN,
@@ -79,6 +88,9 @@ class SQLiteNode : public STCPManager {
     // Receive timeout for cluster messages.
     static const uint64_t RECV_TIMEOUT;
 
+    // How often we PING each peer when the failure detector is enabled. The PONGs are its heartbeats.
+    static const uint64_t HEARTBEAT_INTERVAL;
+
     // Get and SQLiteNode State from it's name.
     static State stateFromName(const string& name);
 
@@ -145,6 +157,31 @@ class SQLiteNode : public STCPManager {
     // Handle any read/write events that occurred.
     void postPoll(fd_map& fdm, uint64_t& nextActivity);
 
+    // Enables the phi-accrual failure detector: peers are PINGed every `HEARTBEAT_INTERVAL`, and any peer whose
+    // suspicion level exceeds `phi` is disconnected, rather than waiting for `RECV_TIMEOUT`. 0 disables it.
+    void setFailureDetectorThreshold(double phi);
+
+    // These let worker threads commit ONE and QUORUM transactions themselves, rather than one at a time through
+    // `startCommit`, and then wait for followers to approve them. Call `startQuorumCommit` after preparing a transaction
+    // and before committing it, with the commit count it will have, so that it's sent to followers as needing approval.
+    // If it doesn't commit, call `cancelQuorumCommit`. If it does, `waitForQuorum` calls `callback` with `APPROVED`
+    // once enough followers have approved it, or with why not if it's denied, `deadline` passes, or we stop leading
+    // first, which may be before it returns. A follower only approves a transaction once it has every transaction
+    // before it, so an approval counts for all earlier transactions as well, and any number of these can be waiting
+    // at once.
+    void startQuorumCommit(uint64_t commitCount, ConsistencyLevel consistency, uint64_t deadline);
+    void cancelQuorumCommit(uint64_t commitCount);
+    void waitForQuorum(uint64_t commitCount, function<void(QuorumResult)>&& callback);
+
+    // Returns the number of transactions started with `startQuorumCommit` that haven't been approved yet.
+    // Does not block.
+    size_t getQuorumCommitsInFlight() const;
+
+    // Enables cache warming with a warmer that spends up to `budgetUS` on each pass. This starts a pass immediately, to
+    // warm the cache after a restart, and starts another each time we begin standing up, which we wait for (up to our
+    // usual STANDINGUP timeout) before we start leading. See `SQLiteCacheWarmer`. Call before the first `update`.
+    void setCacheWarmingBudget(uint64_t budgetUS);
+
     // Constructor/Destructor
     SQLiteNode(SQLiteServer& server, shared_ptr<SQLitePool> dbPool, const string& name, const string& host,
                const string& peerList, int priority, uint64_t firstTimeout, const string& version,
@@ -285,6 +322,11 @@ class SQLiteNode : public STCPManager {
     // replication threads as required. It's passed in via the constructor.
     shared_ptr<SQLitePool> _dbPool;
 
+    // Only set if cache warming is enabled by `setCacheWarmingBudget`. Declared after `_dbPool` so it stops using it
+    // before the pool is destroyed.
+    unique_ptr<SQLiteCacheWarmer> _cacheWarmer;
+    uint64_t _nextCacheHeatSave = 0;
+
     // Set to true to indicate we're attempting to shut down.
     atomic<bool> _isShuttingDown;
 
@@ -320,6 +362,50 @@ class SQLiteNode : public STCPManager {
     // Server that implements `SQLiteServer` interface.
     SQLiteServer& _server;
 
+    // The suspicion level at which a peer is disconnected. See `setFailureDetectorThreshold`.
+    atomic<double> _failureDetectorThreshold = 0;
+
+    // A transaction committed by a worker thread that's waiting for follower approval. See `startQuorumCommit`.
+    struct QuorumCommit {
+        ConsistencyLevel consistency;
+        uint64_t deadline = 0;
+        set<SQLitePeer*> approvals;
+        set<SQLitePeer*> denials;
+        bool resolved = false;
+        QuorumResult result = QuorumResult::APPROVED;
+        function<void(QuorumResult)> callback;
+    };
+
+    // Records `peer`'s approval of `commitCount` against it and every earlier transaction in `_quorumCommits`, and
+    // calls back for any that now have enough approvals.
+    void _handleQuorumApproval(SQLitePeer* peer, uint64_t commitCount);
+
+    // Records `peer`'s denial of `commitCount`, and fails it if it can no longer get enough approvals.
+    void _handleQuorumDenial(SQLitePeer* peer, uint64_t commitCount);
+
+    // Fails everything in `_quorumCommits` that's past its deadline, or that can no longer get enough approvals
+    // because followers have dropped off. Called on each `update()`.
+    void _expireQuorumCommits();
+
+    // Calls back for everything in `_quorumCommits` with `NOT_LEADING`. For when we stop leading.
+    void _failQuorumCommits();
+
+    // Returns true if `commit` has enough approvals for its consistency level. Call with `_quorumCommitMutex` locked.
+    bool _hasEnoughApprovals(const QuorumCommit& commit) const;
+
+    // Returns true if `commit` could still get enough approvals from the followers we're subscribed to that haven't
+    // denied it. Call with `_quorumCommitMutex` locked.
+    bool _canBeApproved(const QuorumCommit& commit) const;
+
+    // Marks `commit` resolved with `result`, and moves its callback to `callbacks` if anyone's waiting for it, in
+    // which case it returns true and it should be erased. Call with `_quorumCommitMutex` locked.
+    bool _resolveQuorumCommit(QuorumCommit& commit, QuorumResult result, list<function<void(QuorumResult)>>& callbacks);
+
+    // Transactions from `startQuorumCommit`, by commit count.
+    map<uint64_t, QuorumCommit> _quorumCommits;
+    mutable mutex _quorumCommitMutex;
+    atomic<size_t> _quorumCommitsInFlight = 0;
+
     // Stopwatch to track if we're giving up on the server preventing a standdown.
     SStopwatch _standDownTimeout;
 
@@ -0,0 +1,355 @@
+#include "SQLitePageCache.h"
+
+#include <unordered_map>
+
+struct SQLitePageCache::Page {
+    // This must be first, sqlite hands it back to us and we cast it to a `Page`.
+    sqlite3_pcache_page page;
+    unsigned key = 0;
+    bool pinned = true;
+
+    // Neighbors in the cache's list of unpinned pages. `newer` is toward `Cache::newest`.
+    Page* newer = nullptr;
+    Page* older = nullptr;
+};
+
+struct SQLitePageCache::Cache {
+    mutex m;
+    size_t pageSize = 0;
+    size_t extraSize = 0;
+    size_t allocationSize = 0;
+    bool purgeable = true;
+    unordered_map<unsigned, Page*> pages;
+
+    // The list of unpinned pages, which are the only ones we can evict.
+    Page* newest = nullptr;
+    Page* oldest = nullptr;
+
+    // How much of the budget this cache has reserved. This is only used by purgeable caches, as temporary and
+    // in-memory databases aren't held to the budget.
+    uint64_t reservedBytes = 0;
+
+    // These are only changed with `m` locked, but `getStats` reads them without it.
+    atomic<uint64_t> bytes = 0;
+    atomic<uint64_t> pageCount = 0;
+    atomic<uint64_t> hits = 0;
+    atomic<uint64_t> misses = 0;
+    atomic<uint64_t> evictions = 0;
+
+    void unlink(Page* page) {
+        (page->newer ? page->newer->older : newest) = page->older;
+        (page->older ? page->older->newer : oldest) = page->newer;
+        page->newer = page->older = nullptr;
+    }
+
+    void pushNewest(Page* page) {
+        page->older = newest;
+        page->newer = nullptr;
+        (newest ? newest->newer : oldest) = page;
+        newest = page;
+    }
+};
+
+uint64_t SQLitePageCache::_budgetBytes = 0;
+atomic<uint64_t> SQLitePageCache::_reservedBytes(0);
+atomic<uint64_t> SQLitePageCache::_destroyedHits(0);
+atomic<uint64_t> SQLitePageCache::_destroyedMisses(0);
+atomic<uint64_t> SQLitePageCache::_destroyedEvictions(0);
+shared_mutex SQLitePageCache::_cachesMutex;
+vector<SQLitePageCache::Cache*> SQLitePageCache::_caches;
+atomic<size_t> SQLitePageCache::_nextVictim(0);
+
+void SQLitePageCache::install(uint64_t budgetBytes) {
+    SASSERT(budgetBytes);
+    _budgetBytes = budgetBytes;
+    static const sqlite3_pcache_methods2 methods = {
+        1,
+        nullptr,
+        _init,
+        _shutdown,
+        _create,
+        _cacheSize,
+        _pageCount,
+        _fetch,
+        _unpin,
+        _rekey,
+        _truncate,
+        _destroy,
+        _shrink,
+    };
+    SASSERT(sqlite3_config(SQLITE_CONFIG_PCACHE2, &methods) == SQLITE_OK);
+    SINFO("Installed shared page cache with a budget of " << budgetBytes / 1024 / 1024 << "MB.");
+}
+
+bool SQLitePageCache::isInstalled() {
+    return _budgetBytes;
+}
+
+STable SQLitePageCache::getStats() {
+    size_t caches;
+    uint64_t bytes = 0;
+    uint64_t pages = 0;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    {
+        shared_lock<decltype(_cachesMutex)> lock(_cachesMutex);
+        caches = _caches.size();
+        hits = _destroyedHits;
+        misses = _destroyedMisses;
+        evictions = _destroyedEvictions;
+        for (const Cache* cache : _caches) {
+            bytes += cache->bytes;
+            pages += cache->pageCount;
+            hits += cache->hits;
+            misses += cache->misses;
+            evictions += cache->evictions;
+        }
+    }
+    return {
+        {"budgetBytes", to_string(_budgetBytes)},
+        {"reservedBytes", to_string(_reservedBytes)},
+        {"bytes", to_string(bytes)},
+        {"pages", to_string(pages)},
+        {"caches", to_string(caches)},
+        {"hits", to_string(hits)},
+        {"misses", to_string(misses)},
+        {"evictions", to_string(evictions)},
+    };
+}
+
+bool SQLitePageCache::_reserve(Cache& cache, uint64_t bytes) {
+    if (cache.bytes + bytes <= cache.reservedBytes) {
+        return true;
+    }
+
+    // Reserve a whole batch if there's room for it, and otherwise only what's needed.
+    const uint64_t needed = cache.bytes + bytes - cache.reservedBytes;
+    const uint64_t batch = max(needed, cache.allocationSize * RESERVATION_PAGES);
+    uint64_t reserved = _reservedBytes;
+    while (true) {
+        const uint64_t amount = reserved + batch <= _budgetBytes ? batch : needed;
+        if (reserved + amount > _budgetBytes) {
+            return false;
+        }
+        if (_reservedBytes.compare_exchange_weak(reserved, reserved + amount)) {
+            cache.reservedBytes += amount;
+            return true;
+        }
+    }
+}
+
+uint64_t SQLitePageCache::_release(Cache& cache, uint64_t spareBytes) {
+    if (cache.reservedBytes <= cache.bytes + spareBytes) {
+        return 0;
+    }
+    const uint64_t released = cache.reservedBytes - cache.bytes - spareBytes;
+    cache.reservedBytes -= released;
+    _reservedBytes -= released;
+    return released;
+}
+
+void SQLitePageCache::_freePage(Cache& cache, Page* page) {
+    if (!page->pinned) {
+        cache.unlink(page);
+    }
+    cache.pages.erase(page->key);
+    cache.bytes -= cache.allocationSize;
+    cache.pageCount--;
+    free(page);
+
+    // Keep a batch spare for the next pages, but don't hold on to more than that.
+    const uint64_t batch = cache.allocationSize * RESERVATION_PAGES;
+    if (cache.reservedBytes > cache.bytes + 2 * batch) {
+        _release(cache, batch);
+    }
+}
+
+uint64_t SQLitePageCache::_evict(Cache& cache, uint64_t bytes) {
+    uint64_t freed = 0;
+    while (freed < bytes && cache.oldest) {
+        _freePage(cache, cache.oldest);
+        cache.evictions++;
+        freed += cache.allocationSize;
+    }
+    return freed;
+}
+
+void SQLitePageCache::_evictFromOthers(Cache& cache, uint64_t bytes) {
+    shared_lock<decltype(_cachesMutex)> lock(_cachesMutex);
+    uint64_t released = 0;
+    for (size_t i = 0; i < _caches.size() && released < bytes; i++) {
+        Cache* victim = _caches[_nextVictim++ % _caches.size()];
+        if (victim == &cache) {
+            continue;
+        }
+
+        // If it's locked, its owner is using it, and it's not a good place to evict from anyway. Whatever it has
+        // reserved and isn't using is given back as well, even if it has no pages to evict.
+        unique_lock<decltype(victim->m)> victimLock(victim->m, try_to_lock);
+        if (victimLock.owns_lock()) {
+            const uint64_t reserved = victim->reservedBytes;
+            _evict(*victim, bytes - released);
+            _release(*victim, 0);
+            released += reserved - victim->reservedBytes;
+        }
+    }
+}
+
+int SQLitePageCache::_init(void* arg) {
+    return SQLITE_OK;
+}
+
+void SQLitePageCache::_shutdown(void* arg) {
+}
+
+sqlite3_pcache* SQLitePageCache::_create(int pageSize, int extraSize, int purgeable) {
+    Cache* cache = new Cache;
+    cache->pageSize = pageSize;
+    cache->extraSize = extraSize;
+    cache->allocationSize = sizeof(Page) + pageSize + extraSize;
+    cache->purgeable = purgeable;
+    unique_lock<decltype(_cachesMutex)> lock(_cachesMutex);
+    _caches.push_back(cache);
+    return reinterpret_cast<sqlite3_pcache*>(cache);
+}
+
+void SQLitePageCache::_cacheSize(sqlite3_pcache* cache, int pages) {
+    // The budget is shared, so we ignore per-connection sizes.
+}
+
+int SQLitePageCache::_pageCount(sqlite3_pcache* pcache) {
+    Cache& cache = *reinterpret_cast<Cache*>(pcache);
+    lock_guard<decltype(cache.m)> lock(cache.m);
+    return cache.pages.size();
+}
+
+sqlite3_pcache_page* SQLitePageCache::_fetch(sqlite3_pcache* pcache, unsigned key, int createFlag) {
+    Cache& cache = *reinterpret_cast<Cache*>(pcache);
+    unique_lock<decltype(cache.m)> lock(cache.m);
+    auto pageIt = cache.pages.find(key);
+    if (pageIt != cache.pages.end()) {
+        Page* page = pageIt->second;
+        if (!page->pinned) {
+            cache.unlink(page);
+            page->pinned = true;
+        }
+        cache.hits++;
+        return &page->page;
+    }
+
+    // sqlite retries with `createFlag` 2 when 1 fails, which we don't want to count twice.
+    if (createFlag != 2) {
+        cache.misses++;
+    }
+    if (!createFlag) {
+        return nullptr;
+    }
+
+    // Make room for the new page, from our own pages first. We don't fail if we can't, as that makes sqlite spill
+    // dirty pages to disk, which is far worse than briefly going over budget with pages that are all pinned anyway.
+    // Temporary and in-memory databases aren't held to the budget, as their pages can't be evicted. Pages we evict
+    // from our own cache stay reserved for us, so they make room without touching the budget.
+    if (cache.purgeable && !_reserve(cache, cache.allocationSize)) {
+        _evict(cache, cache.allocationSize);
+        if (!_reserve(cache, cache.allocationSize)) {
+            // Only this connection uses this cache, so nothing else can add this page while we're unlocked.
+            lock.unlock();
+            _evictFromOthers(cache, cache.allocationSize * RESERVATION_PAGES);
+            lock.lock();
+            if (!_reserve(cache, cache.allocationSize)) {
+                cache.reservedBytes += cache.allocationSize;
+                _reservedBytes += cache.allocationSize;
+            }
+        }
+    }
+
+    Page* page = static_cast<Page*>(malloc(cache.allocationSize));
+    if (!page) {
+        return nullptr;
+    }
+    new (page) Page;
+    page->key = key;
+    page->page.pBuf = reinterpret_cast<char*>(page) + sizeof(Page);
+    page->page.pExtra = reinterpret_cast<char*>(page->page.pBuf) + cache.pageSize;
+
+    // sqlite expects the start of the extra space to be zeroed on new pages, the same as its own cache does.
+    *static_cast<void**>(page->page.pExtra) = nullptr;
+    cache.pages[key] = page;
+    cache.bytes += cache.allocationSize;
+    cache.pageCount++;
+    return &page->page;
+}
+
+void SQLitePageCache::_unpin(sqlite3_pcache* pcache, sqlite3_pcache_page* pcachePage, int discard) {
+    Cache& cache = *reinterpret_cast<Cache*>(pcache);
+    Page* page = reinterpret_cast<Page*>(pcachePage);
+    lock_guard<decltype(cache.m)> lock(cache.m);
+    if (discard || !cache.purgeable) {
+        _freePage(cache, page);
+        return;
+    }
+    if (page->pinned) {
+        page->pinned = false;
+        cache.pushNewest(page);
+    }
+
+    // If we went over budget while all our pages were pinned, this is our first chance to get back within it.
+    const uint64_t reserved = _reservedBytes;
+    if (reserved > _budgetBytes) {
+        _evict(cache, reserved - _budgetBytes);
+        _release(cache, 0);
+    }
+}
+
+void SQLitePageCache::_rekey(sqlite3_pcache* pcache, sqlite3_pcache_page* pcachePage, unsigned oldKey, unsigned newKey) {
+    Cache& cache = *reinterpret_cast<Cache*>(pcache);
+    Page* page = reinterpret_cast<Page*>(pcachePage);
+    lock_guard<decltype(cache.m)> lock(cache.m);
+    auto existing = cache.pages.find(newKey);
+    if (existing != cache.pages.end()) {
+        _freePage(cache, existing->second);
+    }
+    cache.pages.erase(oldKey);
+    page->key = newKey;
+    cache.pages[newKey] = page;
+}
+
+void SQLitePageCache::_truncate(sqlite3_pcache* pcache, unsigned limit) {
+    Cache& cache = *reinterpret_cast<Cache*>(pcache);
+    lock_guard<decltype(cache.m)> lock(cache.m);
+    list<Page*> truncated;
+    for (const auto& [key, page] : cache.pages) {
+        if (key >= limit) {
+            truncated.push_back(page);
+        }
+    }
+    for (Page* page : truncated) {
+        _freePage(cache, page);
+    }
+}
+
+void SQLitePageCache::_destroy(sqlite3_pcache* pcache) {
+    Cache* cache = reinterpret_cast<Cache*>(pcache);
+    {
+        // Once it's out of `_caches`, nothing else can lock it. Its counts are moved over at the same time, so that
+        // `getStats` never sees them twice or not at all.
+        unique_lock<decltype(_cachesMutex)> lock(_cachesMutex);
+        _caches.erase(find(_caches.begin(), _caches.end(), cache));
+        _destroyedHits += cache->hits;
+        _destroyedMisses += cache->misses;
+        _destroyedEvictions += cache->evictions;
+    }
+    while (!cache->pages.empty()) {
+        _freePage(*cache, cache->pages.begin()->second);
+    }
+    _release(*cache, 0);
+    delete cache;
+}
+
+void SQLitePageCache::_shrink(sqlite3_pcache* pcache) {
+    Cache& cache = *reinterpret_cast<Cache*>(pcache);
+    lock_guard<decltype(cache.m)> lock(cache.m);
+    _evict(cache, cache.bytes);
+    _release(cache, 0);
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <libstuff/libstuff.h>
+#include <libstuff/sqlite3.h>
+
+// A page cache for sqlite (installed with `SQLITE_CONFIG_PCACHE2`) that holds every connection in the process to one
+// memory budget, instead of giving each connection its own `cache_size`. Each connection still has its own pages, as
+// sqlite requires, but when a connection needs a page and the budget is used up, it evicts its own least recently
+// used pages first, and then those of other connections. Connections that are busy keep a large cache while idle ones
+// shrink, so many pooled handles can share a budget that would otherwise have to be divided evenly between them.
+//
+// Each connection's pages are protected by their own mutex, which is only contended when another connection is
+// evicting from it, and each connection keeps its own counters, which `getStats` adds up. Room in the budget is
+// reserved RESERVATION_PAGES at a time, so most page fetches don't touch anything shared by every connection.
+class SQLitePageCache {
+  public:
+    // Installs the cache with a budget of `budgetBytes`. This must be called before `sqlite3_initialize`. While it's
+    // installed, `PRAGMA cache_size` has no effect.
+    static void install(uint64_t budgetBytes);
+
+    // Returns true if `install` has been called.
+    static bool isInstalled();
+
+    // Returns the budget, current usage, and hit, miss, and eviction counts.
+    static STable getStats();
+
+    // How many pages' worth of the budget a connection reserves at once.
+    static constexpr uint64_t RESERVATION_PAGES = 16;
+
+  private:
+    struct Page;
+    struct Cache;
+
+    // Reserves room in the budget for `cache` to hold `bytes` more than it does now, if it hasn't already. Returns
+    // false if the budget is used up. `cache` must be locked.
+    static bool _reserve(Cache& cache, uint64_t bytes);
+
+    // Returns whatever `cache` has reserved beyond its pages and `spareBytes` to the budget, and returns how much that
+    // was. `cache` must be locked.
+    static uint64_t _release(Cache& cache, uint64_t spareBytes);
+
+    // Frees pages from the least recently used end of `cache` until it's freed `bytes` or it has no more unpinned
+    // pages, and returns how many bytes it freed. `cache` must be locked.
+    static uint64_t _evict(Cache& cache, uint64_t bytes);
+
+    // Evicts pages from other caches, skipping any that are locked, until they've returned `bytes` to the budget.
+    static void _evictFromOthers(Cache& cache, uint64_t bytes);
+
+    // Removes `page` from `cache` and frees it. `cache` must be locked.
+    static void _freePage(Cache& cache, Page* page);
+
+    // The `sqlite3_pcache_methods2` implementation.
+    static int _init(void* arg);
+    static void _shutdown(void* arg);
+    static sqlite3_pcache* _create(int pageSize, int extraSize, int purgeable);
+    static void _cacheSize(sqlite3_pcache* cache, int pages);
+    static int _pageCount(sqlite3_pcache* cache);
+    static sqlite3_pcache_page* _fetch(sqlite3_pcache* cache, unsigned key, int createFlag);
+    static void _unpin(sqlite3_pcache* cache, sqlite3_pcache_page* page, int discard);
+    static void _rekey(sqlite3_pcache* cache, sqlite3_pcache_page* page, unsigned oldKey, unsigned newKey);
+    static void _truncate(sqlite3_pcache* cache, unsigned limit);
+    static void _destroy(sqlite3_pcache* cache);
+    static void _shrink(sqlite3_pcache* cache);
+
+    static uint64_t _budgetBytes;
+
+    // How much of the budget is reserved by all caches together.
+    static atomic<uint64_t> _reservedBytes;
+
+    // The counts from caches that have been destroyed, so that the totals in `getStats` don't go backwards.
+    static atomic<uint64_t> _destroyedHits;
+    static atomic<uint64_t> _destroyedMisses;
+    static atomic<uint64_t> _destroyedEvictions;
+
+    // All caches, so that any of them can evict from the others. This is only locked exclusively to add or remove a
+    // cache. `_nextVictim` is where the next search for pages to evict starts, so that eviction is spread across caches.
+    static shared_mutex _cachesMutex;
+    static vector<Cache*> _caches;
+    static atomic<size_t> _nextVictim;
+};
@@ -1,5 +1,6 @@
 #include "SQLitePeer.h"
 
+#include <libstuff/SDNSCache.h>
 #include <libstuff/SData.h>
 #include <libstuff/SRandom.h>
 
@@ -14,6 +15,7 @@ SQLitePeer::SQLitePeer(const string& name_, const string& host_, const STable& p
     params(params_),
     permaFollower(isPermafollower(params)),
     latency(0),
+    lastPingTime(0),
     loggedIn(false),
     nextReconnect(0),
     priority(0),
@@ -37,6 +39,8 @@ bool SQLitePeer::connected() const {
 void SQLitePeer::reset() {
     lock_guard<decltype(peerMutex)> lock(peerMutex);
     latency = 0;
+    lastPingTime = 0;
+    failureDetector.reset();
     loggedIn = false;
     priority = 0;
     delete socket;
@@ -102,6 +106,17 @@ SQLitePeer::PeerPostPollStatus SQLitePeer::postPoll(fd_map& fdm, uint64_t& nextA
     } else {
         // Not connected, is it time to try again?
         if (STimeNow() > nextReconnect) {
+            // This runs on the sync thread, which shouldn't block on DNS. If we don't have an address for this peer
+            // yet, resolve it in the background and try again shortly.
+            const string domain = SGetDomain(host);
+            if (!SDNSCache::shared().isCached(domain)) {
+                SINFO("Resolving " << domain << " before connecting");
+                SDNSCache::shared().prefetch(domain);
+                nextReconnect = STimeNow() + 100'000;
+                nextActivity = min(nextActivity, nextReconnect.load());
+                return PeerPostPollStatus::OK;
+            }
+
             // Try again
             SINFO("Retrying the connection");
             reset();
@@ -197,6 +212,7 @@ STable SQLitePeer::getData() const {
         {"host", host},
         {"state", (SQLiteNode::stateName(state) + (connected() ? "" : " (DISCONNECTED)"))},
         {"latency", to_string(latency)},
+        {"phi", to_string(failureDetector.phi(STimeNow()))},
         {"nextReconnect", to_string(nextReconnect)},
         {"id", to_string(id)},
         {"loggedIn", (loggedIn ? "true" : "false")},
@@ -1,4 +1,5 @@
 #include <libstuff/libstuff.h>
+#include <sqlitecluster/SQLiteFailureDetector.h>
 #include <sqlitecluster/SQLiteNode.h>
 
 // Represents a single peer in the database cluster
@@ -77,6 +78,7 @@ class SQLitePeer {
     // An address on which this peer can accept commands. (a.k.a. "private command port")
     atomic<string> commandAddress;
     atomic<uint64_t> latency;
+    atomic<uint64_t> lastPingTime;
     atomic<bool> loggedIn;
     atomic<uint64_t> nextReconnect;
     atomic<int> priority;
@@ -86,6 +88,9 @@ class SQLitePeer {
     atomic<Response> transactionResponse;
     atomic<string> version;
 
+    // Fed by the PONGs this peer sends back, and used to decide when it's stopped responding.
+    SQLiteFailureDetector failureDetector;
+
   private:
     // For initializing the permafollower value from the params list.
     static bool isPermafollower(const STable& params);
@@ -2,31 +2,44 @@
 #include "SQLite.h"
 #include "SQLitePool.h"
 
+thread_local SQLitePool::ThreadHandle SQLitePool::_threadHandle;
+mutex SQLitePool::_poolsMutex;
+map<uint64_t, SQLitePool*> SQLitePool::_pools;
+atomic<uint64_t> SQLitePool::_nextPoolID(1);
+
 SQLitePool::SQLitePool(size_t maxDBs,
                        const string& filename,
                        int cacheSize,
                        int maxJournalSize,
                        int minJournalTables,
                        const string& synchronous,
-                       int64_t mmapSizeGB)
+                       int64_t mmapSizeGB,
+                       const set<string>& shards)
 : _maxDBs(max(maxDBs, 1ul)),
-  _baseDB(filename, cacheSize, maxJournalSize, minJournalTables, synchronous, mmapSizeGB),
+  _id(_nextPoolID++),
+  _baseDB(filename, cacheSize, maxJournalSize, minJournalTables, synchronous, mmapSizeGB, shards),
+  _states(make_unique<atomic<HandleState>[]>(_maxDBs)),
+  _nextFree(make_unique<atomic<uint32_t>[]>(_maxDBs)),
   _objects(_maxDBs, nullptr)
 {
+    lock_guard<mutex> lock(_poolsMutex);
+    _pools[_id] = this;
 }
 
 SQLitePool::~SQLitePool() {
-    lock_guard<mutex> lock(_sync);
-    if (_inUseHandles.size()) {
-        SWARN("Destroying SQLitePool with DBs in use.");
+    {
+        lock_guard<mutex> lock(_poolsMutex);
+        _pools.erase(_id);
     }
-    for (auto dbHandle : _availableHandles) {
-        delete _objects[dbHandle];
-        _objects[dbHandle] = nullptr;
+    for (size_t index = 0; index < _allocatedHandles; index++) {
+        if (_states[index] == HandleState::IN_USE) {
+            SWARN("Destroying SQLitePool with DBs in use.");
+            break;
+        }
     }
-    for (auto dbHandle : _inUseHandles) {
-        delete _objects[dbHandle];
-        _objects[dbHandle] = nullptr;
+    for (auto& dbHandle : _objects) {
+        delete dbHandle;
+        dbHandle = nullptr;
     }
 }
 
@@ -35,34 +48,74 @@ SQLite& SQLitePool::getBase() {
 }
 
 size_t SQLitePool::getIndex(bool createHandle) {
-    while (true) {
+    // Take back the handle this thread last returned, unless another thread has taken it since.
+    if (_threadHandle.poolID == _id) {
+        _threadHandle.poolID = 0;
+        if (_claim(_threadHandle.index, HandleState::KEPT)) {
+            SDEBUG("Returning this thread's DB handle");
+            return _threadHandle.index;
+        }
+    }
+
+    size_t index;
+    if (!_tryGetIndex(index, createHandle)) {
+        // Wait for a handle. `_release` only notifies if it sees `_waiters` set, so that has to be set before we
+        // check again for one.
         unique_lock<mutex> lock(_sync);
-        if (_availableHandles.size()) {
-            // Return an existing handle.
-            auto frontIt = _availableHandles.begin();
-            size_t index = *frontIt;
-            _inUseHandles.insert(index);
-            _availableHandles.erase(frontIt);
+        _waiters++;
+        while (!_tryGetIndex(index, createHandle)) {
+            SINFO("Waiting for DB handle");
+            _wait.wait(lock);
+        }
+        _waiters--;
+    }
+    return index;
+}
+
+bool SQLitePool::_claim(size_t index, HandleState expected) {
+    return _states[index].compare_exchange_strong(expected, HandleState::IN_USE);
+}
+
+bool SQLitePool::_tryGetIndex(size_t& index, bool createHandle) {
+    // Pop the free list.
+    uint64_t head = _freeHead;
+    while (head & 0xFFFFFFFF) {
+        size_t top = (head & 0xFFFFFFFF) - 1;
+        uint64_t newHead = (((head >> 32) + 1) << 32) | _nextFree[top];
+        if (_freeHead.compare_exchange_weak(head, newHead)) {
+            _states[top] = HandleState::IN_USE;
+            index = top;
             SDEBUG("Returning existing DB handle");
-            return index;
-        } else if (_availableHandles.size() + _inUseHandles.size() < (_maxDBs - 1)) {
-            size_t index = _availableHandles.size() + _inUseHandles.size();
-            _inUseHandles.insert(index);
-
-            // Create a new handle unless we're not supposed to. We unlock here as we're no longer in a position to
-            // change which indices are in use.
-            lock.unlock();
+            return true;
+        }
+    }
+
+    // Reserve a new index if we have room.
+    size_t allocated = _allocatedHandles;
+    while (allocated < _maxDBs - 1) {
+        if (_allocatedHandles.compare_exchange_weak(allocated, allocated + 1)) {
+            index = allocated;
+            _states[index] = HandleState::IN_USE;
+
+            // Create a new handle unless we're not supposed to.
             if (createHandle) {
                 initializeIndex(index);
             }
             SINFO("Returning new DB handle: " << index);
-            return index;
-        } else {
-            // Wait for a handle.
-            SINFO("Waiting for DB handle");
-            _wait.wait(lock);
+            return true;
+        }
+    }
+
+    // Take a handle that another thread is keeping. This is the only part of this that's not constant time, but we
+    // only get here when the pool is fully allocated and nothing is free.
+    for (size_t i = 0; i < _allocatedHandles; i++) {
+        if (_claim(i, HandleState::KEPT)) {
+            index = i;
+            SDEBUG("Returning DB handle kept by another thread");
+            return true;
         }
     }
+    return false;
 }
 
 SQLite& SQLitePool::initializeIndex(size_t index) {
@@ -77,13 +130,50 @@ SQLite& SQLitePool::initializeIndex(size_t index) {
 }
 
 void SQLitePool::returnToPool(size_t index) {
-    {
+    // Keep this handle for this thread's next `getIndex` if we aren't keeping one already.
+    if (!_threadHandle.poolID) {
+        _states[index] = HandleState::KEPT;
+        _threadHandle.poolID = _id;
+        _threadHandle.index = index;
+
+        // If a thread is waiting, it might have looked for kept handles before we marked this one, so give it up.
+        // Checking `_waiters` after marking it means that either we see the waiter, or it sees this handle.
+        if (!_waiters) {
+            SDEBUG("DB handle kept by this thread.");
+            return;
+        }
+        _threadHandle.poolID = 0;
+        if (!_claim(index, HandleState::KEPT)) {
+            // The waiter already took it.
+            return;
+        }
+    }
+    _release(index);
+}
+
+void SQLitePool::_release(size_t index) {
+    _states[index] = HandleState::FREE;
+    uint64_t head = _freeHead;
+    do {
+        _nextFree[index] = head & 0xFFFFFFFF;
+    } while (!_freeHead.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | (index + 1)));
+    SDEBUG("DB handle returned to pool.");
+
+    if (_waiters) {
         lock_guard<mutex> lock(_sync);
-        _availableHandles.insert(index);
-        _inUseHandles.erase(index);
-        SDEBUG("DB handle returned to pool.");
+        _wait.notify_one();
+    }
+}
+
+SQLitePool::ThreadHandle::~ThreadHandle() {
+    // Give the kept handle back to its pool, if the pool still exists.
+    if (poolID) {
+        lock_guard<mutex> lock(_poolsMutex);
+        auto poolIt = _pools.find(poolID);
+        if (poolIt != _pools.end() && poolIt->second->_claim(index, HandleState::KEPT)) {
+            poolIt->second->_release(index);
+        }
     }
-    _wait.notify_one();
 }
 
 SQLiteScopedHandle::SQLiteScopedHandle(SQLitePool& pool, size_t index) : _pool(pool), _index(index)
@@ -6,7 +6,7 @@ class SQLitePool {
   public:
     // Create a pool of DB handles.
     SQLitePool(size_t maxDBs, const string& filename, int cacheSize, int maxJournalSize, int minJournalTables,
-               const string& synchronous = "", int64_t mmapSizeGB = 0);
+               const string& synchronous = "", int64_t mmapSizeGB = 0, const set<string>& shards = {});
     ~SQLitePool();
 
     // Get the base object (the first one created, which uses the `journal` table). Note that if called by multiple
@@ -19,6 +19,9 @@ class SQLitePool {
     // create a new one and return it's index.
     // However, if `creteHandle` is false, this will *not* create the handle, but just reserve the index, and allow the
     // handle to be created later with `initializeIndex` on this slot.
+    // Each thread keeps the last handle it returned, and gets it back from its next call without any synchronization,
+    // unless another thread has needed it in the meantime. Otherwise, this takes a handle from a lock-free list of free
+    // handles, and only locks if it has to wait.
     size_t getIndex(bool createHandle = true);
 
     // Takes an allocated index and creates the appropriate DB handle if required.
@@ -28,20 +31,60 @@ class SQLitePool {
     void returnToPool(size_t index);
 
   private:
-    // Synchronization variables.
+    // Each handle is either on the free list, in use, or kept by the thread that last returned it.
+    enum class HandleState : uint8_t {
+        FREE,
+        IN_USE,
+        KEPT
+    };
+
+    // The handle a thread kept when it last returned one, which it gives back to the free list when the thread exits.
+    struct ThreadHandle {
+        ~ThreadHandle();
+        uint64_t poolID = 0;
+        size_t index = 0;
+    };
+    static thread_local ThreadHandle _threadHandle;
+
+    // Pools that are still alive, so that exiting threads don't give handles back to a pool that's been destroyed.
+    static mutex _poolsMutex;
+    static map<uint64_t, SQLitePool*> _pools;
+    static atomic<uint64_t> _nextPoolID;
+
+    // Marks `index` as in use if it was in `expected` state.
+    bool _claim(size_t index, HandleState expected);
+
+    // Takes a handle that's free or kept by another thread, or reserves a new one, without waiting. Returns false if
+    // none are available.
+    bool _tryGetIndex(size_t& index, bool createHandle);
+
+    // Pushes `index` onto the free list and wakes a waiting thread if there is one.
+    void _release(size_t index);
+
+    // Synchronization variables. These are only used by threads that have to wait for a handle.
     mutex _sync;
     condition_variable _wait;
+    atomic<size_t> _waiters = 0;
 
     // Internal limit on the number of handles we'll allow. This exists to make sure we don't go over any
     // system-imposed limits on FDs.
     size_t _maxDBs;
 
+    // Identifies this pool to `_threadHandle`.
+    const uint64_t _id;
+
     // Our base object that all others are based upon.
     SQLite _baseDB;
 
-    // These are indexes into `_objects`.
-    set<size_t> _availableHandles;
-    set<size_t> _inUseHandles;
+    // The number of indexes handed out so far. Indexes below this have a handle or are reserved for one.
+    atomic<size_t> _allocatedHandles = 0;
+
+    // The state of each index, and the free list, which is a stack linked through `_nextFree`. `_freeHead` holds the
+    // top index plus one (0 when empty) in its low 32 bits, and a counter in its high 32 bits that changes on every
+    // push and pop, so a thread that read a stale head can't swap it back in.
+    unique_ptr<atomic<HandleState>[]> _states;
+    unique_ptr<atomic<uint32_t>[]> _nextFree;
+    atomic<uint64_t> _freeHead = 0;
 
     // This is a vector of pointers to all possibly allocated objects.
     vector<SQLite*> _objects;
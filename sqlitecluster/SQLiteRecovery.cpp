@@ -0,0 +1,178 @@
+#include "SQLiteRecovery.h"
+
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+
+SQLiteRecovery::SQLiteRecovery(const string& sourcePath) {
+    // A database file starts with this, and a dump starts with a JSON object.
+    const string header = "SQLite format 3";
+    ifstream file(sourcePath, ios::binary);
+    string start(header.size(), '\0');
+    if (!file.read(&start[0], start.size()) && !file.gcount()) {
+        _error = "couldn't read " + sourcePath;
+    } else if (start == header) {
+        _sourceDB = _openJournalDB(sourcePath, _journalNames, _error);
+    } else {
+        _dump.open(sourcePath);
+        if (!_dump) {
+            _error = "couldn't open " + sourcePath;
+        }
+    }
+}
+
+SQLiteRecovery::~SQLiteRecovery() {
+    if (_sourceDB) {
+        sqlite3_close(_sourceDB);
+    }
+}
+
+uint64_t SQLiteRecovery::replay(SQLite& db, uint64_t toCommit) {
+    if (!_sourceDB && !_dump.is_open()) {
+        return 0;
+    }
+    _error.clear();
+    const uint64_t commitCount = db.getCommitCount();
+    if (toCommit && toCommit < commitCount) {
+        _error = "database is already at commit " + to_string(commitCount) + ", past " + to_string(toCommit);
+        return 0;
+    }
+
+    // If the source still has our current commit, it has to be the same one, or we're on different forks.
+    string query, hash;
+    if (commitCount && _read(commitCount, query, hash) && hash != db.getCommittedHash()) {
+        _error = "source has hash " + hash + " for commit " + to_string(commitCount) + ", database has " + db.getCommittedHash();
+        return 0;
+    }
+
+    uint64_t replayed = 0;
+    for (uint64_t id = commitCount + 1; !toCommit || id <= toCommit; id++) {
+        if (!_read(id, query, hash)) {
+            if (toCommit) {
+                _error = "source doesn't have commit " + to_string(id);
+            }
+            break;
+        }
+        if (!db.beginTransaction() || !db.writeUnmodified(query) || !db.prepare()) {
+            _error = "couldn't apply commit " + to_string(id) + ": " + db.getLastError();
+            if (db.insideTransaction()) {
+                db.rollback();
+            }
+            break;
+        }
+
+        // Every hash depends on every commit before it, so this checks the whole history up to here.
+        if (db.getUncommittedHash() != hash) {
+            _error = "commit " + to_string(id) + " produced hash " + db.getUncommittedHash() + ", journal has " + hash;
+            db.rollback();
+            break;
+        }
+        const int result = db.commit("recovery");
+        if (result != SQLITE_OK) {
+            _error = "couldn't commit " + to_string(id) + ": " + sqlite3_errstr(result);
+            db.rollback();
+            break;
+        }
+        replayed++;
+    }
+    return replayed;
+}
+
+bool SQLiteRecovery::_read(uint64_t id, string& query, string& hash) {
+    auto it = _pending.find(id);
+    if (it == _pending.end() && _sourceDB) {
+        _pending.clear();
+        if (!_readJournalRange(_sourceDB, _journalNames, id, id + BATCH_SIZE - 1, _pending)) {
+            return false;
+        }
+        it = _pending.find(id);
+    } else if (it == _pending.end()) {
+        // A dump is in order, so we read forward until we get to it, or past it, in which case we keep that one for
+        // next time.
+        _pending.erase(_pending.begin(), _pending.lower_bound(id));
+        string line;
+        while (_pending.empty() && getline(_dump, line)) {
+            STable commit = SParseJSONObject(line);
+            if (SToUInt64(commit["id"]) >= id) {
+                _pending[SToUInt64(commit["id"])] = {commit["query"], commit["hash"]};
+            }
+        }
+        it = _pending.find(id);
+    }
+    if (it == _pending.end()) {
+        return false;
+    }
+    query = it->second.first;
+    hash = it->second.second;
+    return true;
+}
+
+sqlite3* SQLiteRecovery::_openJournalDB(const string& path, vector<string>& journalNames, string& error) {
+    sqlite3* db = nullptr;
+    SQResult tables;
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr)) {
+        error = "couldn't open " + path;
+    } else if (SQuery(db, "listing journal tables", "SELECT name FROM sqlite_master WHERE type = 'table' AND "
+                      "(name = 'journal' OR name GLOB 'journal[0-9][0-9][0-9][0-9]');", tables) || tables.empty()) {
+        error = "no journal tables in " + path;
+    }
+    if (!error.empty()) {
+        sqlite3_close(db);
+        return nullptr;
+    }
+    for (size_t i = 0; i < tables.size(); i++) {
+        journalNames.push_back(tables[i][0]);
+    }
+    return db;
+}
+
+bool SQLiteRecovery::_readJournalRange(sqlite3* db, const vector<string>& journalNames, uint64_t fromCommit,
+                                       uint64_t toCommit, map<uint64_t, pair<string, string>>& commits) {
+    list<string> queries;
+    for (const string& name : journalNames) {
+        queries.push_back("SELECT id, query, hash FROM " + name + " WHERE id BETWEEN " + SQ(fromCommit) + " AND " + SQ(toCommit));
+    }
+    SQResult result;
+    if (SQuery(db, "reading journal range", SComposeList(queries, " UNION ALL ") + ";", result)) {
+        return false;
+    }
+    for (size_t i = 0; i < result.size(); i++) {
+        commits[SToUInt64(result[i][0])] = {SQLite::decompressJournalQuery(result[i][1]), result[i][2]};
+    }
+    return true;
+}
+
+bool SQLiteRecovery::exportJournal(const string& dbPath, const string& dumpPath, uint64_t fromCommit, string& error) {
+    vector<string> journalNames;
+    sqlite3* db = _openJournalDB(dbPath, journalNames, error);
+    if (!db) {
+        return false;
+    }
+
+    // Read everything from one snapshot, so that the range we export stays in the journal while we do.
+    list<string> bounds;
+    for (const string& name : journalNames) {
+        bounds.push_back("SELECT MIN(id) AS minID, MAX(id) AS maxID FROM " + name);
+    }
+    SQResult result;
+    ofstream dump(dumpPath, ios::trunc);
+    bool success = dump && !SQuery(db, "exporting journal", "BEGIN") &&
+                   !SQuery(db, "exporting journal", "SELECT MIN(minID), MAX(maxID) FROM (" + SComposeList(bounds, " UNION ALL ") + ");", result);
+    if (!success) {
+        error = "couldn't read journal of " + dbPath;
+    }
+    const uint64_t lastCommit = success ? SToUInt64(result[0][1]) : 0;
+    for (uint64_t id = max(fromCommit, success ? SToUInt64(result[0][0]) : 0); success && id && id <= lastCommit; id += BATCH_SIZE) {
+        map<uint64_t, pair<string, string>> commits;
+        success = _readJournalRange(db, journalNames, id, id + BATCH_SIZE - 1, commits);
+        for (const auto& [commitID, commit] : commits) {
+            dump << SComposeJSONObject({{"id", to_string(commitID)}, {"hash", commit.second}, {"query", commit.first}}, true) << "\n";
+        }
+        if (!success || !dump) {
+            error = "couldn't export commits from " + to_string(id);
+            success = false;
+        }
+    }
+    SQuery(db, "exporting journal", "ROLLBACK");
+    sqlite3_close(db);
+    return success;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+#include <fstream>
+
+class SQLite;
+struct sqlite3;
+
+// Rolls a restored backup forward by replaying commits from a journal, the same way a follower applies commits it
+// synchronizes from a peer, and checking every resulting hash against the one the journal recorded. Stopping at a
+// commit before a bad write leaves a database that's exactly what every node had at that commit.
+//
+// The journal can come from another copy of the database (typically the one being recovered from, as its journal has
+// the history since the backup), or from a dump written by `exportJournal`, which has one JSON object with `id`,
+// `hash` and `query` per line.
+class SQLiteRecovery {
+  public:
+    // How many commits are read from a database source at once.
+    static constexpr uint64_t BATCH_SIZE = 1000;
+
+    // Opens the journal at `sourcePath`. Check `getError` before replaying.
+    SQLiteRecovery(const string& sourcePath);
+    ~SQLiteRecovery();
+
+    // Replays commits onto `db` from the one after its current commit through `toCommit`, or through the last one in
+    // the source if that's 0. Stops at the first commit that's missing from the source or doesn't produce the hash it
+    // should, leaving `db` at the commit before it. Returns the number of commits replayed. Sets the error if it
+    // stopped short of `toCommit`, or if the source doesn't share `db`'s history.
+    uint64_t replay(SQLite& db, uint64_t toCommit);
+
+    // The reason the source couldn't be opened, or the last replay stopped early. Empty if neither happened.
+    const string& getError() const { return _error; }
+
+    // Writes every journal entry in the database at `dbPath` with an ID of at least `fromCommit` to `dumpPath`, in
+    // order. Returns false and sets `error` on failure.
+    static bool exportJournal(const string& dbPath, const string& dumpPath, uint64_t fromCommit, string& error);
+
+  private:
+    // Reads commit `id` from the source, setting `query` and `hash`. Returns false if the source doesn't have it.
+    bool _read(uint64_t id, string& query, string& hash);
+
+    // Opens `path` read-only and lists its journal tables.
+    static sqlite3* _openJournalDB(const string& path, vector<string>& journalNames, string& error);
+
+    // Reads commits `fromCommit` through `toCommit` from the journal tables of `db` into `commits`, keyed by ID.
+    static bool _readJournalRange(sqlite3* db, const vector<string>& journalNames, uint64_t fromCommit,
+                                  uint64_t toCommit, map<uint64_t, pair<string, string>>& commits);
+
+    string _error;
+
+    // Exactly one of these is the source.
+    sqlite3* _sourceDB = nullptr;
+    vector<string> _journalNames;
+    ifstream _dump;
+
+    // Commits read ahead from the source, but not yet replayed.
+    map<uint64_t, pair<string, string>> _pending;
+};
@@ -0,0 +1,83 @@
+#include "SQLiteVacuumScheduler.h"
+
+#include <sqlitecluster/SQLitePool.h>
+
+SQLiteVacuumScheduler::~SQLiteVacuumScheduler() {
+    stop();
+}
+
+void SQLiteVacuumScheduler::start(shared_ptr<SQLitePool> dbPool, uint64_t pagesPerStep) {
+    stop();
+    lock_guard<decltype(_m)> lock(_m);
+    _exit = false;
+    _status.clear();
+    _thread = thread(&SQLiteVacuumScheduler::_run, this, dbPool, pagesPerStep);
+}
+
+void SQLiteVacuumScheduler::stop() {
+    thread runThread;
+    {
+        lock_guard<decltype(_m)> lock(_m);
+        _exit = true;
+        runThread = move(_thread);
+    }
+    _cv.notify_all();
+    if (runThread.joinable()) {
+        runThread.join();
+    }
+}
+
+STable SQLiteVacuumScheduler::getStatus() const {
+    lock_guard<decltype(_m)> lock(_m);
+    return _status;
+}
+
+void SQLiteVacuumScheduler::_run(shared_ptr<SQLitePool> dbPool, uint64_t pagesPerStep) {
+    SInitialize("vacuum");
+    uint64_t pagesFreed = 0;
+    uint64_t steps = 0;
+    uint64_t lastCommitCount = 0;
+    uint64_t lastCommitTime = STimeNow();
+    while (true) {
+        {
+            unique_lock<decltype(_m)> lock(_m);
+            if (_cv.wait_for(lock, chrono::microseconds(CHECK_INTERVAL_US), [this] { return _exit; })) {
+                return;
+            }
+        }
+
+        SQLiteScopedHandle dbScope(*dbPool, dbPool->getIndex());
+        SQLite& db = dbScope.db();
+        STable stats = db.getFreelistStats();
+        if (db.getCommitCount() != lastCommitCount) {
+            lastCommitCount = db.getCommitCount();
+            lastCommitTime = STimeNow();
+        }
+
+        // Only step when nothing has committed for a while, and it's worth doing.
+        uint64_t freed = 0;
+        if (pagesPerStep && stats["autoVacuum"] == "incremental" && SToUInt64(stats["freePages"]) &&
+            STimeNow() - lastCommitTime >= IDLE_US && db.incrementalVacuum(pagesPerStep, freed) && freed) {
+            pagesFreed += freed;
+            steps++;
+            SINFO("Incremental vacuum freed " << freed << " pages, " << pagesFreed << " in total.");
+            stats = db.getFreelistStats();
+        }
+
+        const uint64_t pageCount = SToUInt64(stats["pageCount"]);
+        stats["freePercent"] = SToStr(pageCount ? 100.0 * SToUInt64(stats["freePages"]) / pageCount : 0.0);
+        stats["pagesFreed"] = to_string(pagesFreed);
+        stats["steps"] = to_string(steps);
+
+        // Shards are separate files, each with its own free pages, which we report but leave alone.
+        STable shards;
+        for (const string& shard : db.getShards()) {
+            shards[shard] = SComposeJSONObject(db.getFreelistStats(shard));
+        }
+        if (!shards.empty()) {
+            stats["shards"] = SComposeJSONObject(shards);
+        }
+        lock_guard<decltype(_m)> lock(_m);
+        _status = move(stats);
+    }
+}
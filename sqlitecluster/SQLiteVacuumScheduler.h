@@ -0,0 +1,43 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+class SQLitePool;
+
+// Tracks how much of the database file is free pages, and, for databases created with `auto_vacuum = INCREMENTAL`,
+// gives them back to the filesystem a small step at a time while the node is idle, rather than with a `VACUUM` that
+// rewrites the whole file and blocks everything else while it does.
+//
+// Note that auto_vacuum databases can't run `BEGIN CONCURRENT` transactions concurrently, as every page allocation
+// updates the pointer map, so this is intended for databases where that matters less than the file size. In the
+// default mode, free pages are still reused for new data, and the stats here show how many there are.
+class SQLiteVacuumScheduler {
+  public:
+    // How often the scheduler looks at the database.
+    static constexpr uint64_t CHECK_INTERVAL_US = 1'000'000;
+
+    // How long there must have been no commits before we consider the database idle.
+    static constexpr uint64_t IDLE_US = 5'000'000;
+
+    ~SQLiteVacuumScheduler();
+
+    // Starts watching the database in `dbPool`, freeing up to `pagesPerStep` pages each time it's found to be idle, or
+    // none if that's 0.
+    void start(shared_ptr<SQLitePool> dbPool, uint64_t pagesPerStep);
+
+    // Stops the scheduler and waits for any step in progress to finish.
+    void stop();
+
+    // Returns the page and free page counts as of the last check, the percentage of the file that's free, the
+    // auto_vacuum mode, and how many pages have been freed, in how many steps. The page counts of any shards are listed
+    // under `shards`.
+    STable getStatus() const;
+
+  private:
+    void _run(shared_ptr<SQLitePool> dbPool, uint64_t pagesPerStep);
+
+    mutable mutex _m;
+    condition_variable _cv;
+    bool _exit = false;
+    thread _thread;
+    STable _status;
+};
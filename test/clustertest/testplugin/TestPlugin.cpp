@@ -6,6 +6,7 @@
 
 #include <libstuff/SQResult.h>
 #include <libstuff/SX509.h>
+#include <sqlitecluster/SQLiteIndexBuilder.h>
 
 mutex BedrockPlugin_TestPlugin::dataLock;
 map<string, string> BedrockPlugin_TestPlugin::arbitraryData;
@@ -81,6 +82,7 @@ unique_ptr<BedrockCommand> BedrockPlugin_TestPlugin::getCommand(SQLiteCommand&&
         "broadcastwithtimeouts",
         "storeboradcasttimeouts",
         "getbroadcasttimeouts",
+        "broadcastandwait",
         "sendrequest",
         "slowquery",
         "httpstimeout",
@@ -89,11 +91,13 @@ unique_ptr<BedrockCommand> BedrockPlugin_TestPlugin::getCommand(SQLiteCommand&&
         "generateassertpeek",
         "preventattach",
         "chainedrequest",
+        "awaitrequests",
         "ineffectiveUpdate",
         "exceptioninprocess",
         "generatesegfaultprocess",
         "idcollision",
         "slowprocessquery",
+        "scheduleindexbuild",
     };
     for (auto& cmdName : supportedCommands) {
         if (SStartsWith(baseCommand.request.methodLine, cmdName)) {
@@ -192,6 +196,31 @@ bool TestPluginCommand::peek(SQLite& db) {
         response["stored_peekedAt"] = plugin().arbitraryData["peekedAt"];
         response["stored_not_special"] = plugin().arbitraryData["not_special"];
         return true;
+    } else if (SStartsWith(request.methodLine, "broadcastandwait")) {
+        // Broadcasts a `testcommand` and waits for it to finish, giving up on peers after `peerTimeout` ms, or canceling
+        // the broadcast after `cancelAfter` ms. Responds with the method line of each peer's response.
+        mutex m;
+        condition_variable cv;
+        bool finished = false;
+        vector<SData> responses;
+        uint64_t broadcastID = plugin().server.broadcastCommand(SData("testcommand"), [&](vector<SData>&& peerResponses) {
+            lock_guard<mutex> lock(m);
+            responses = move(peerResponses);
+            finished = true;
+            cv.notify_all();
+        }, request.calcU64("peerTimeout") * 1000);
+        unique_lock<mutex> lock(m);
+        if (request.isSet("cancelAfter") &&
+            !cv.wait_for(lock, chrono::milliseconds(request.calc("cancelAfter")), [&finished]{return finished;})) {
+            plugin().server.cancelBroadcast(broadcastID);
+        }
+        cv.wait(lock, [&finished]{return finished;});
+        list<string> methodLines;
+        for (const SData& peerResponse : responses) {
+            methodLines.push_back(peerResponse.methodLine);
+        }
+        response.content = SComposeJSONArray(methodLines);
+        return true;
     } else if (SStartsWith(request.methodLine, "sendrequest")) {
         if (plugin().server.getState() != SQLiteNode::LEADING && plugin().server.getState() != SQLiteNode::STANDINGDOWN) {
             // Only start HTTPS requests on leader, otherwise, we'll escalate.
@@ -302,6 +331,13 @@ bool TestPluginCommand::peek(SQLite& db) {
             // case
             return false;
         }
+    } else if (SStartsWith(request.methodLine, "awaitrequests")) {
+        // Does the same thing as `chainedrequest`, but with `awaitHTTPS`, so none of the progress needs to be kept in
+        // member variables.
+        if (plugin().server.getState() != SQLiteNode::LEADING && plugin().server.getState() != SQLiteNode::STANDINGDOWN) {
+            return false;
+        }
+        return awaitHosts(SParseList(request["urls"]), "");
     } else if (request.methodLine == "testescalate") {
         string serverState = SQLiteNode::stateName(plugin().server.getState());
         string statString = "Peeking testescalate (" + serverState + ")\n";
@@ -312,6 +348,22 @@ bool TestPluginCommand::peek(SQLite& db) {
     return false;
 }
 
+bool TestPluginCommand::awaitHosts(list<string> hosts, const string& results) {
+    if (hosts.empty()) {
+        response.content = results;
+        return true;
+    }
+    SData newRequest("GET / HTTP/1.1");
+    string host = hosts.front();
+    hosts.pop_front();
+    newRequest["Host"] = host;
+    SHTTPSManager::Transaction* transaction = plugin().httpsManager->send("https://" + host + "/", newRequest);
+    awaitHTTPS(transaction, [this, transaction, hosts, results](SQLite& db) {
+        return awaitHosts(hosts, results + transaction->fullRequest["Host"] + ":" + to_string(transaction->response) + "\n");
+    });
+    return false;
+}
+
 void TestPluginCommand::process(SQLite& db) {
     if (request.calc("ProcessSleep")) {
         usleep(request.calc("ProcessSleep") * 1000);
@@ -424,6 +476,10 @@ void TestPluginCommand::process(SQLite& db) {
         string statString = "Processing testescalate (" + serverState + ")\n";
         fileAppend(request["tempFile"], statString);
         return;
+    } else if (SStartsWith(request.methodLine, "scheduleindexbuild")) {
+        if (!SQLiteIndexBuilder::schedule(db, request["name"], request["table"], request["definition"])) {
+            STHROW("500 Couldn't schedule index build");
+        }
     }
 }
 
@@ -46,6 +46,10 @@ class TestPluginCommand : public BedrockCommand {
   private:
     BedrockPlugin_TestPlugin& plugin() { return static_cast<BedrockPlugin_TestPlugin&>(*_plugin); }
 
+    // Requests each of `hosts` in turn, suspending with `awaitHTTPS` between them, and completes with one line per host
+    // appended to `results`.
+    bool awaitHosts(list<string> hosts, const string& results);
+
     bool pendingResult;
     string chainedHTTPResponseContent;
     string urls;
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <signal.h>
 
 #include <libstuff/SData.h>
 #include <test/clustertest/BedrockClusterTester.h>
@@ -8,7 +9,9 @@ struct BroadcastCommandTest : tpunit::TestFixture {
         : tpunit::TestFixture("BroadcastCommand",
                               BEFORE_CLASS(BroadcastCommandTest::setup),
                               AFTER_CLASS(BroadcastCommandTest::teardown),
-                              TEST(BroadcastCommandTest::test)
+                              TEST(BroadcastCommandTest::test),
+                              TEST(BroadcastCommandTest::unresponsivePeer),
+                              TEST(BroadcastCommandTest::stoppedPeer)
                              ) { }
 
     BedrockClusterTester* tester;
@@ -71,4 +74,59 @@ struct BroadcastCommandTest : tpunit::TestFixture {
         ASSERT_EQUAL("whatever", results2[0]["stored_not_special"]);
     }
 
+    // Runs `broadcastandwait` on leader with the given options, and returns how many peers gave each response.
+    map<string, int> broadcastAndWait(const string& option, const string& ms, uint64_t& elapsed) {
+        SData cmd("broadcastandwait");
+        cmd[option] = ms;
+        uint64_t start = STimeNow();
+        string content = tester->getTester(0).executeWaitVerifyContent(cmd);
+        elapsed = STimeNow() - start;
+        map<string, int> counts;
+        for (const string& methodLine : SParseJSONArray(content)) {
+            counts[methodLine]++;
+        }
+        return counts;
+    }
+
+    void unresponsivePeer()
+    {
+        // A stopped process still accepts connections, but never responds to them.
+        BedrockTester& follower2 = tester->getTester(2);
+        kill(follower2.getPID(), SIGSTOP);
+
+        // With a per-peer timeout, the broadcast finishes when it's reached, with the response from the peer that
+        // answered.
+        uint64_t elapsed = 0;
+        map<string, int> counts = broadcastAndWait("peerTimeout", "2000", elapsed);
+        ASSERT_EQUAL(counts["200 OK"], 1);
+        ASSERT_EQUAL(counts["555 Timeout"], 1);
+        ASSERT_GREATER_THAN(elapsed, 2'000'000);
+        ASSERT_LESS_THAN(elapsed, 10'000'000);
+
+        // Canceling it finishes it straight away, again keeping the response it already has.
+        counts = broadcastAndWait("cancelAfter", "1000", elapsed);
+        ASSERT_EQUAL(counts["200 OK"], 1);
+        ASSERT_EQUAL(counts["500 Canceled"], 1);
+        ASSERT_GREATER_THAN(elapsed, 1'000'000);
+        ASSERT_LESS_THAN(elapsed, 10'000'000);
+
+        kill(follower2.getPID(), SIGCONT);
+        ASSERT_TRUE(follower2.waitForState("FOLLOWING"));
+    }
+
+    void stoppedPeer()
+    {
+        // A peer we can't connect to fails straight away, rather than waiting out the timeout.
+        BedrockTester& follower2 = tester->getTester(2);
+        follower2.stopServer();
+        uint64_t elapsed = 0;
+        map<string, int> counts = broadcastAndWait("peerTimeout", "5000", elapsed);
+        ASSERT_EQUAL(counts["200 OK"], 1);
+        ASSERT_EQUAL(counts["500 Internal Server Error"], 1);
+        ASSERT_LESS_THAN(elapsed, 5'000'000);
+
+        follower2.startServer();
+        ASSERT_TRUE(follower2.waitForState("FOLLOWING"));
+    }
+
 } __BroadcastCommandTest;
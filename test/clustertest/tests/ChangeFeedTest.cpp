@@ -0,0 +1,78 @@
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct ChangeFeedTest : tpunit::TestFixture {
+    ChangeFeedTest()
+        : tpunit::TestFixture("ChangeFeed",
+                              BEFORE_CLASS(ChangeFeedTest::setup),
+                              AFTER_CLASS(ChangeFeedTest::teardown),
+                              TEST(ChangeFeedTest::waitForCommit),
+                              TEST(ChangeFeedTest::waitTimesOut)) { }
+
+    BedrockClusterTester* tester = nullptr;
+
+    void setup() {
+        tester = new BedrockClusterTester(ClusterSize::ONE_NODE_CLUSTER, {}, {{"-changeFeedSize", "1000"}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    // Returns the last commit in the feed.
+    uint64_t lastCommit() {
+        STable status = tester->getTester(0).executeWaitVerifyContentTable(SData("Status"));
+        return SToUInt64(SParseJSONObject(status["changeFeed"])["lastCommit"]);
+    }
+
+    void waitForCommit() {
+        BedrockTester& node = tester->getTester(0);
+        const uint64_t afterCommit = lastCommit();
+
+        // Ask for the next commit before there is one.
+        atomic<bool> done(false);
+        STable response;
+        thread waiter([&]() {
+            SData request("GetChanges");
+            request["afterCommit"] = to_string(afterCommit);
+            request["tables"] = "test";
+            request["Connection"] = "wait";
+            request["timeout"] = "30000";
+            response = node.executeWaitVerifyContentTable(request);
+            done = true;
+        });
+
+        // It doesn't answer until something's committed.
+        sleep(2);
+        ASSERT_FALSE(done);
+        SData write("Query");
+        write["query"] = "INSERT INTO test (id, value) VALUES (5000001, 'followed');";
+        node.executeWaitVerifyContent(write);
+        waiter.join();
+
+        list<string> changes = SParseJSONArray(response["changes"]);
+        ASSERT_EQUAL(changes.size(), 1);
+        STable change = SParseJSONObject(changes.front());
+        ASSERT_EQUAL(change["op"], "insert");
+        ASSERT_EQUAL(SParseJSONObject(change["new"])["value"], "followed");
+        ASSERT_GREATER_THAN(SToUInt64(response["throughCommit"]), afterCommit);
+    }
+
+    void waitTimesOut() {
+        BedrockTester& node = tester->getTester(0);
+        const uint64_t afterCommit = lastCommit();
+
+        // With nothing committed, it answers with no changes about a second before the timeout, rather than timing out.
+        SData request("GetChanges");
+        request["afterCommit"] = to_string(afterCommit);
+        request["Connection"] = "wait";
+        request["timeout"] = "4000";
+        const uint64_t start = STimeNow();
+        STable response = node.executeWaitVerifyContentTable(request);
+        const uint64_t elapsed = STimeNow() - start;
+        ASSERT_GREATER_THAN(elapsed, 2'000'000);
+        ASSERT_LESS_THAN(elapsed, 4'000'000);
+        ASSERT_TRUE(SParseJSONArray(response["changes"]).empty());
+        ASSERT_EQUAL(SToUInt64(response["throughCommit"]), afterCommit);
+    }
+} __ChangeFeedTest;
@@ -286,6 +286,19 @@ struct ConflictSpamTest : tpunit::TestFixture {
         resultCount.pop_front();
         ASSERT_EQUAL(cmdID.load(), SToInt(resultCount.front()));
 
+        // Leader should have recorded the commit attempts and write footprint of the command we spammed.
+        {
+            STable status = SParseJSONObject(tester->getTester(0).executeWaitVerifyContent(SData("Status")));
+            STable conflicts = SParseJSONObject(status["commandConflicts"]);
+            ASSERT_TRUE(conflicts.find("idcollision b2") != conflicts.end());
+            STable stats = SParseJSONObject(conflicts["idcollision b2"]);
+            ASSERT_TRUE(SToUInt64(stats["commitAttempts"]) > 0);
+            list<string> tables = SParseJSONArray(stats["tables"]);
+            ASSERT_EQUAL(tables.size(), 1ul);
+            ASSERT_EQUAL(tables.front(), "test");
+            ASSERT_TRUE(stats.find("hotPages") != stats.end());
+        }
+
         int fail = totalRequestFailures.load();
         if (fail > 0) {
             cout << "[ConflictSpamTest] Total failures: " << fail << endl;
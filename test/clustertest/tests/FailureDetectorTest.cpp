@@ -0,0 +1,81 @@
+#include <signal.h>
+
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct FailureDetectorTest : tpunit::TestFixture {
+    FailureDetectorTest()
+        : tpunit::TestFixture("FailureDetector",
+                              BEFORE_CLASS(FailureDetectorTest::setup),
+                              AFTER_CLASS(FailureDetectorTest::teardown),
+                              TEST(FailureDetectorTest::busyLeader),
+                              TEST(FailureDetectorTest::hungLeader)) { }
+
+    BedrockClusterTester* tester = nullptr;
+
+    void setup() {
+        tester = new BedrockClusterTester(ClusterSize::THREE_NODE_CLUSTER, {}, {{"-failureDetectorPhi", "8"}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    // Returns true if `node` reports `state` every time we check it for the next `durationUS` us, or false as soon as
+    // it reports anything else.
+    bool staysInState(BedrockTester& node, const string& state, uint64_t durationUS) {
+        uint64_t start = STimeNow();
+        while (STimeNow() < start + durationUS) {
+            string current = SParseJSONObject(node.executeWaitVerifyContent(SData("Status")))["state"];
+            if (current != state) {
+                cout << "[FailureDetectorTest] Expected " << state << " but node was " << current << "." << endl;
+                return false;
+            }
+            usleep(100'000);
+        }
+        return true;
+    }
+
+    void busyLeader() {
+        BedrockTester& leader = tester->getTester(0);
+        BedrockTester& follower = tester->getTester(1);
+        ASSERT_TRUE(leader.waitForState("LEADING"));
+        ASSERT_TRUE(follower.waitForState("FOLLOWING"));
+
+        // Let the followers collect enough heartbeats to know what normal looks like.
+        sleep(10);
+
+        // A leader whose sync thread is busy for a few seconds (with a long exclusive commit, say) doesn't answer PINGs
+        // in that time either, but it's not failed, and the followers should wait for it.
+        kill(leader.getPID(), SIGSTOP);
+        bool followedWhileStopped = staysInState(follower, "FOLLOWING", 4'000'000);
+        kill(leader.getPID(), SIGCONT);
+        ASSERT_TRUE(followedWhileStopped);
+        ASSERT_TRUE(staysInState(follower, "FOLLOWING", 5'000'000));
+        ASSERT_TRUE(leader.waitForState("LEADING"));
+    }
+
+    void hungLeader() {
+        BedrockTester& leader = tester->getTester(0);
+        BedrockTester& follower = tester->getTester(1);
+        ASSERT_TRUE(leader.waitForState("LEADING"));
+        ASSERT_TRUE(follower.waitForState("FOLLOWING"));
+
+        // Let the followers collect enough heartbeats to know what normal looks like.
+        sleep(10);
+
+        // A stopped process is the worst case for failover: its sockets stay open, so nothing looks disconnected, and
+        // with fixed timeouts the followers would wait out the full 30 second receive timeout before giving up on it.
+        uint64_t start = STimeNow();
+        kill(leader.getPID(), SIGSTOP);
+        bool failedOver = follower.waitForState("LEADING", 20'000'000);
+        uint64_t elapsed = STimeNow() - start;
+        kill(leader.getPID(), SIGCONT);
+        ASSERT_TRUE(failedOver);
+        cout << "[FailureDetectorTest] Failed over from a hung leader in " << elapsed / 1000 << "ms." << endl;
+        ASSERT_LESS_THAN(elapsed, 20'000'000);
+
+        // The old leader should notice it's been replaced and rejoin as a follower.
+        ASSERT_TRUE(leader.waitForState("FOLLOWING"));
+    }
+} __FailureDetectorTest;
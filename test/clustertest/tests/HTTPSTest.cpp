@@ -22,6 +22,7 @@ struct HTTPSTest : tpunit::TestFixture {
                               BEFORE_CLASS(HTTPSTest::setup),
                               AFTER_CLASS(HTTPSTest::teardown),
                               TEST(HTTPSTest::testMultipleRequests),
+                              TEST(HTTPSTest::testAwaitRequests),
                               TEST(HTTPSTest::test)) { }
 
     BedrockClusterTester* tester;
@@ -43,6 +44,25 @@ struct HTTPSTest : tpunit::TestFixture {
         ASSERT_EQUAL(lines.size(), 3);
     }
 
+    void testAwaitRequests() {
+        // Send many more commands than there are worker threads, each of which makes two serial requests. These only
+        // complete in reasonable time if waiting commands don't occupy workers.
+        BedrockTester& brtester = tester->getTester(0);
+        vector<SData> requests;
+        for (int i = 0; i < 100; i++) {
+            SData request("awaitrequests");
+            request["urls"] = "www.google.com,www.google.com";
+            requests.push_back(request);
+        }
+        auto results = brtester.executeWaitMultipleData(requests, 50);
+        for (auto& result : results) {
+            ASSERT_EQUAL(SToInt(result.methodLine), 200);
+            auto lines = SParseList(result.content, '\n');
+            ASSERT_EQUAL(lines.size(), 2);
+            ASSERT_TRUE(SStartsWith(lines.front(), "www.google.com:"));
+        }
+    }
+
     void test() {
         // Send one request to verify that it works.
         BedrockTester& brtester = tester->getTester(0);
@@ -0,0 +1,80 @@
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct IndexBuildTest : tpunit::TestFixture {
+    IndexBuildTest()
+        : tpunit::TestFixture("IndexBuild",
+                              BEFORE_CLASS(IndexBuildTest::setup),
+                              AFTER_CLASS(IndexBuildTest::teardown),
+                              TEST(IndexBuildTest::test),
+                              TEST(IndexBuildTest::rejected)) { }
+
+    BedrockClusterTester* tester = nullptr;
+
+    void setup() {
+        tester = new BedrockClusterTester(ClusterSize::THREE_NODE_CLUSTER, {}, {{"-indexBuildRowsPerSecond", "5000"}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    void test() {
+        BedrockTester& leader = tester->getTester(0);
+        SData write("Query");
+        write["query"] = "INSERT INTO test (id, value) WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c "
+                         "WHERE x < 20000) SELECT x, 'value' || (x % 100) FROM c;";
+        leader.executeWaitVerifyContent(write);
+
+        SData schedule("scheduleindexbuild");
+        schedule["name"] = "testValue";
+        schedule["table"] = "test";
+        schedule["definition"] = "( value )";
+        leader.executeWaitVerifyContent(schedule);
+
+        // Change rows on both sides of the build's progress while it copies them.
+        for (int i = 0; i < 20; i++) {
+            SData change("Query");
+            change["query"] = "UPDATE test SET value = 'updated' WHERE id = " + SQ(i * 1000 + 1) + "; "
+                              "DELETE FROM test WHERE id = " + SQ(i * 1000 + 2) + "; "
+                              "INSERT INTO test VALUES (" + SQ(100000 + i) + ", 'inserted');";
+            leader.executeWaitVerifyContent(change);
+            usleep(100'000);
+        }
+
+        // Wait for it to finish everywhere.
+        ASSERT_TRUE(leader.waitForStatusTerm("indexBuilds", "", 30'000'000));
+        for (int i = 0; i < 3; i++) {
+            ASSERT_TRUE(tester->getTester(i).waitForValue("SELECT COUNT(*) FROM sqlite_master WHERE name LIKE 'indexBuild_%';", "0", 30'000'000));
+        }
+
+        // Each node has the index on the real table, and it matches the table exactly.
+        for (int i = 0; i < 3; i++) {
+            BedrockTester& node = tester->getTester(i);
+            ASSERT_EQUAL(node.readDB("SELECT sql FROM sqlite_master WHERE name = 'testValue';"), "CREATE INDEX testValue ON test ( value )");
+            ASSERT_EQUAL(node.readDB("PRAGMA integrity_check;"), "ok");
+            ASSERT_EQUAL(node.readDB("SELECT COUNT(*) FROM test INDEXED BY testValue WHERE value = 'updated';"), "20");
+            ASSERT_EQUAL(node.readDB("SELECT COUNT(*) FROM test INDEXED BY testValue WHERE value = 'inserted';"), "20");
+            ASSERT_EQUAL(node.readDB("SELECT COUNT(*) FROM test INDEXED BY testValue WHERE value = 'value2';"), "180");
+        }
+    }
+
+    void rejected() {
+        BedrockTester& leader = tester->getTester(0);
+
+        // Names that would need quoting, and unique indexes, are refused before anything is created.
+        SData schedule("scheduleindexbuild");
+        schedule["name"] = "testBadName";
+        schedule["table"] = "test; DROP TABLE test";
+        schedule["definition"] = "( value )";
+        leader.executeWaitVerifyContent(schedule, "500 Couldn't schedule index build");
+        schedule["name"] = "test Value";
+        schedule["table"] = "test";
+        leader.executeWaitVerifyContent(schedule, "500 Couldn't schedule index build");
+        schedule["name"] = "testUnique";
+        schedule["definition"] = "( value ) UNIQUE";
+        leader.executeWaitVerifyContent(schedule, "500 Couldn't schedule index build");
+        ASSERT_EQUAL(leader.readDB("SELECT COUNT(*) FROM sqlite_master WHERE name LIKE 'indexBuild_%' OR name LIKE 'testBad%' OR name = 'testUnique';"), "0");
+        ASSERT_EQUAL(leader.readDB("SELECT COUNT(*) FROM sqlite_master WHERE name = 'test';"), "1");
+    }
+} __IndexBuildTest;
@@ -0,0 +1,42 @@
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct MultiplexedEscalationTest : tpunit::TestFixture {
+    MultiplexedEscalationTest()
+        : tpunit::TestFixture("MultiplexedEscalation",
+                              BEFORE_CLASS(MultiplexedEscalationTest::setup),
+                              AFTER_CLASS(MultiplexedEscalationTest::teardown),
+                              TEST(MultiplexedEscalationTest::test)) { }
+
+    BedrockClusterTester* tester = nullptr;
+
+    void setup() {
+        tester = new BedrockClusterTester(ClusterSize::THREE_NODE_CLUSTER, {}, {{"-multiplexEscalation", "true"}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    void test() {
+        // Send more concurrent writes to a follower than it has worker threads. These all share one connection to
+        // leader, and each has to get its own response back.
+        BedrockTester& follower = tester->getTester(1);
+        vector<SData> requests;
+        for (int i = 0; i < 200; i++) {
+            SData request("idcollision");
+            request["writeConsistency"] = "ASYNC";
+            request["value"] = "multiplexed" + to_string(i);
+            requests.push_back(request);
+        }
+        auto results = follower.executeWaitMultipleData(requests, 50);
+        ASSERT_EQUAL(results.size(), requests.size());
+        for (auto& result : results) {
+            ASSERT_EQUAL(SToInt(result.methodLine), 200);
+            ASSERT_FALSE(result.isSet("escalationID"));
+        }
+
+        // Every write made it to leader exactly once.
+        ASSERT_EQUAL(tester->getTester(0).readDB("SELECT COUNT(*) FROM test WHERE value LIKE 'multiplexed%';"), "200");
+    }
+} __MultiplexedEscalationTest;
@@ -0,0 +1,90 @@
+#include <libstuff/SData.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct OnlineBackupTest : tpunit::TestFixture {
+    OnlineBackupTest()
+        : tpunit::TestFixture("OnlineBackup",
+                              BEFORE_CLASS(OnlineBackupTest::setup),
+                              AFTER_CLASS(OnlineBackupTest::teardown),
+                              TEST(OnlineBackupTest::test)) { }
+
+    BedrockClusterTester* tester = nullptr;
+    string backupPath;
+
+    void setup() {
+        tester = new BedrockClusterTester();
+        backupPath = tester->getTester(1).getArg("-db") + ".backup";
+    }
+
+    void teardown() {
+        unlink(backupPath.c_str());
+        delete tester;
+    }
+
+    void write(BedrockTester& leader, const string& prefix, int count) {
+        vector<SData> requests;
+        for (int i = 0; i < count; i++) {
+            SData request("idcollision");
+            request["writeConsistency"] = "ASYNC";
+            request["value"] = prefix + to_string(i);
+            requests.push_back(request);
+        }
+        for (auto& result : leader.executeWaitMultipleData(requests)) {
+            ASSERT_EQUAL(SToInt(result.methodLine), 200);
+        }
+    }
+
+    void test() {
+        BedrockTester& leader = tester->getTester(0);
+        BedrockTester& follower = tester->getTester(1);
+        write(leader, "beforebackup", 200);
+
+        // Throttle the backup so that it's still running while we write more.
+        SData backup("BeginOnlineBackup");
+        backup["path"] = backupPath;
+        backup["pagesPerSecond"] = "50";
+        follower.executeWaitVerifyContent(backup, "200 OK", true);
+        follower.executeWaitVerifyContent(backup, "401 Backup already in progress", true);
+        write(leader, "duringbackup", 200);
+
+        STable status;
+        STable backupStatus;
+        for (int retries = 0; retries < 600; retries++) {
+            status = SParseJSONObject(follower.executeWaitVerifyContent(SData("Status")));
+            backupStatus = SParseJSONObject(status["onlineBackup"]);
+            if (backupStatus["state"] != "running") {
+                break;
+            }
+
+            // The follower keeps following the whole time.
+            ASSERT_EQUAL(status["state"], "FOLLOWING");
+            usleep(100'000);
+        }
+        ASSERT_EQUAL(backupStatus["state"], "complete");
+        ASSERT_EQUAL(backupStatus["pagesCopied"], backupStatus["pageCount"]);
+
+        // The follower has every write, but the backup only has those before it started, and its journal ends at the
+        // commit it reported.
+        ASSERT_EQUAL(follower.readDB("SELECT COUNT(*) FROM test WHERE value LIKE 'duringbackup%';"), "200");
+        sqlite3* db = nullptr;
+        ASSERT_FALSE(sqlite3_open_v2(backupPath.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr));
+        SQResult result;
+        ASSERT_FALSE(SQuery(db, "", "SELECT COUNT(*) FROM test WHERE value LIKE 'beforebackup%';", result));
+        ASSERT_EQUAL(result[0][0], "200");
+        ASSERT_FALSE(SQuery(db, "", "SELECT COUNT(*) FROM test WHERE value LIKE 'duringbackup%';", result));
+        ASSERT_NOT_EQUAL(result[0][0], "200");
+        ASSERT_FALSE(SQuery(db, "", "SELECT name FROM sqlite_master WHERE type = 'table' AND "
+                            "(name = 'journal' OR name GLOB 'journal[0-9][0-9][0-9][0-9]');", result));
+        vector<string> journalNames;
+        for (size_t i = 0; i < result.size(); i++) {
+            journalNames.push_back(result[i][0]);
+        }
+        string query;
+        string hash;
+        ASSERT_TRUE(SQLite::getCommit(db, journalNames, SToUInt64(backupStatus["commitCount"]), query, hash));
+        ASSERT_EQUAL(hash, backupStatus["hash"]);
+        sqlite3_close_v2(db);
+    }
+} __OnlineBackupTest;
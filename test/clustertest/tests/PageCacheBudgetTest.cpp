@@ -0,0 +1,55 @@
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct PageCacheBudgetTest : tpunit::TestFixture {
+    PageCacheBudgetTest()
+        : tpunit::TestFixture("PageCacheBudget",
+                              BEFORE_CLASS(PageCacheBudgetTest::setup),
+                              AFTER_CLASS(PageCacheBudgetTest::teardown),
+                              TEST(PageCacheBudgetTest::test)) { }
+
+    BedrockClusterTester* tester = nullptr;
+
+    void setup() {
+        tester = new BedrockClusterTester(ClusterSize::ONE_NODE_CLUSTER, {}, {{"-pageCacheBudgetMB", "1"}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    // Waits for up to `timeoutUS` us for the node's page cache to be within its budget. Returns false if it never is.
+    bool waitForWithinBudget(BedrockTester& node, uint64_t timeoutUS) {
+        uint64_t start = STimeNow();
+        while (STimeNow() < start + timeoutUS) {
+            STable stats = SParseJSONObject(SParseJSONObject(node.executeWaitVerifyContent(SData("Status")))["pageCache"]);
+            if (SToUInt64(stats["bytes"]) <= SToUInt64(stats["budgetBytes"])) {
+                return true;
+            }
+            usleep(100'000);
+        }
+        return false;
+    }
+
+    void test() {
+        BedrockTester& node = tester->getTester(0);
+
+        // Write a few MB, several times the budget, and read it all back.
+        SData write("Query");
+        write["writeConsistency"] = "ASYNC";
+        write["query"] = "INSERT INTO test (id, value) WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c "
+                         "WHERE x < 20000) SELECT x + 1000000, hex(randomblob(100)) FROM c;";
+        node.executeWaitVerifyContent(write);
+        ASSERT_EQUAL(node.readDB("SELECT COUNT(*) FROM test WHERE id > 1000000;"), "20000");
+
+        STable status = SParseJSONObject(node.executeWaitVerifyContent(SData("Status")));
+        STable stats = SParseJSONObject(status["pageCache"]);
+        ASSERT_EQUAL(stats["budgetBytes"], to_string(1024 * 1024));
+        ASSERT_GREATER_THAN(SToUInt64(stats["hits"]), 0);
+        ASSERT_GREATER_THAN(SToUInt64(stats["evictions"]), 0);
+
+        // Nothing is running now, so once the last command's pages are released, nothing is pinned and we should be
+        // within budget.
+        ASSERT_TRUE(waitForWithinBudget(node, 10'000'000));
+    }
+} __PageCacheBudgetTest;
@@ -0,0 +1,51 @@
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct ParallelQuorumTest : tpunit::TestFixture {
+    ParallelQuorumTest()
+        : tpunit::TestFixture("ParallelQuorum",
+                              BEFORE_CLASS(ParallelQuorumTest::setup),
+                              AFTER_CLASS(ParallelQuorumTest::teardown),
+                              TEST(ParallelQuorumTest::test)) { }
+
+    BedrockClusterTester* tester = nullptr;
+
+    void setup() {
+        tester = new BedrockClusterTester(ClusterSize::THREE_NODE_CLUSTER, {}, {{"-parallelQuorumCommits", "true"}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    void test() {
+        BedrockTester& leader = tester->getTester(0);
+        vector<SData> requests;
+        for (int i = 0; i < 100; i++) {
+            SData request("idcollision");
+            request["writeConsistency"] = i % 2 ? "QUORUM" : "ONE";
+            request["value"] = "parallelquorum" + to_string(i);
+            requests.push_back(request);
+        }
+        auto results = leader.executeWaitMultipleData(requests, 20);
+        for (auto& result : results) {
+            ASSERT_EQUAL(SToInt(result.methodLine), 200);
+        }
+        ASSERT_EQUAL(leader.readDB("SELECT COUNT(DISTINCT id) FROM test WHERE value LIKE 'parallelquorum%';"), "100");
+        STable status = SParseJSONObject(leader.executeWaitVerifyContent(SData("Status")));
+        ASSERT_EQUAL(status["quorumCommitsInFlight"], "0");
+
+        // At least one follower approved each of these before it was returned, and they've all been told to commit.
+        for (int i : {1, 2}) {
+            string count;
+            for (int retries = 0; retries < 50; retries++) {
+                count = tester->getTester(i).readDB("SELECT COUNT(*) FROM test WHERE value LIKE 'parallelquorum%';");
+                if (count == "100") {
+                    break;
+                }
+                usleep(100'000);
+            }
+            ASSERT_EQUAL(count, "100");
+        }
+    }
+} __ParallelQuorumTest;
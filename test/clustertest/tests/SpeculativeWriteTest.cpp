@@ -0,0 +1,99 @@
+#include <libstuff/SData.h>
+#include <test/clustertest/BedrockClusterTester.h>
+
+struct SpeculativeWriteTest : tpunit::TestFixture {
+    SpeculativeWriteTest()
+        : tpunit::TestFixture("SpeculativeWrite",
+                              BEFORE_CLASS(SpeculativeWriteTest::setup),
+                              AFTER_CLASS(SpeculativeWriteTest::teardown),
+                              TEST(SpeculativeWriteTest::sequential),
+                              TEST(SpeculativeWriteTest::concurrent),
+                              TEST(SpeculativeWriteTest::fromClient)) { }
+
+    BedrockClusterTester* tester = nullptr;
+
+    void setup() {
+        tester = new BedrockClusterTester(ClusterSize::THREE_NODE_CLUSTER, {}, {{"-speculativeWrites", "true"}});
+    }
+
+    void teardown() {
+        delete tester;
+    }
+
+    STable getSpeculationStats(BedrockTester& node) {
+        STable status = SParseJSONObject(node.executeWaitVerifyContent(SData("Status")));
+        return SParseJSONObject(status["speculativeCommands"]);
+    }
+
+    void sequential() {
+        BedrockTester& leader = tester->getTester(0);
+        BedrockTester& follower = tester->getTester(1);
+
+        // `idcollision` reads the highest ID in `test` and inserts the next one. Each request waits for the follower to
+        // have the previous one's commit, so nothing has changed on leader by the time each speculation gets there.
+        string commitCount;
+        for (int i = 0; i < 20; i++) {
+            SData request("idcollision");
+            request["writeConsistency"] = "ASYNC";
+            request["value"] = "sequential" + to_string(i);
+            if (!commitCount.empty()) {
+                request["commitCount"] = commitCount;
+            }
+            auto results = follower.executeWaitMultipleData({request});
+            ASSERT_EQUAL(SToInt(results[0].methodLine), 200);
+            ASSERT_FALSE(results[0].isSet("speculativeCommitted"));
+            commitCount = results[0]["commitCount"];
+            ASSERT_FALSE(commitCount.empty());
+        }
+        ASSERT_EQUAL(leader.readDB("SELECT COUNT(*) FROM test WHERE value LIKE 'sequential%';"), "20");
+
+        // Each node promotes its first write in a while to QUORUM, which the follower won't speculate and leader
+        // commits on the sync thread, so allow one of each. Everything else should have been committed as speculated.
+        uint64_t sent = SToUInt64(getSpeculationStats(follower)["sent"]);
+        uint64_t committed = SToUInt64(getSpeculationStats(leader)["committed"]);
+        ASSERT_GREATER_THAN_EQUAL(sent, 19);
+        ASSERT_GREATER_THAN_EQUAL(committed + 1, sent);
+        ASSERT_EQUAL(getSpeculationStats(leader)["rejected"], "0");
+    }
+
+    void concurrent() {
+        BedrockTester& leader = tester->getTester(0);
+        BedrockTester& follower = tester->getTester(1);
+        uint64_t rejectedBefore = SToUInt64(getSpeculationStats(leader)["rejected"]);
+
+        // These all read the same row, so most of them are stale by the time they reach leader and have to be processed
+        // there instead. Either way, each one has to get its own ID.
+        vector<SData> requests;
+        for (int i = 0; i < 50; i++) {
+            SData request("idcollision");
+            request["writeConsistency"] = "ASYNC";
+            request["value"] = "concurrent" + to_string(i);
+            requests.push_back(request);
+        }
+        auto results = follower.executeWaitMultipleData(requests, 10);
+        for (auto& result : results) {
+            ASSERT_EQUAL(SToInt(result.methodLine), 200);
+        }
+        ASSERT_EQUAL(leader.readDB("SELECT COUNT(DISTINCT id) FROM test WHERE value LIKE 'concurrent%';"), "50");
+        ASSERT_GREATER_THAN(SToUInt64(getSpeculationStats(leader)["rejected"]), rejectedBefore);
+    }
+
+    void fromClient() {
+        BedrockTester& leader = tester->getTester(0);
+        uint64_t committedBefore = SToUInt64(getSpeculationStats(leader)["committed"]);
+
+        // Only followers can send leader a speculated write. From a client, these headers are ignored, and the command
+        // is processed normally.
+        SData request("idcollision");
+        request["writeConsistency"] = "ASYNC";
+        request["value"] = "fromClient";
+        request["speculativeQuery"] = SEncodeBase64("INSERT INTO test VALUES (1000000, 'injected');");
+        request["speculativeTables"] = "";
+        request["speculativeCommitCount"] = "18446744073709551615";
+        auto results = leader.executeWaitMultipleData({request});
+        ASSERT_EQUAL(SToInt(results[0].methodLine), 200);
+        ASSERT_EQUAL(leader.readDB("SELECT COUNT(*) FROM test WHERE value = 'injected';"), "0");
+        ASSERT_EQUAL(leader.readDB("SELECT COUNT(*) FROM test WHERE value = 'fromClient';"), "1");
+        ASSERT_EQUAL(SToUInt64(getSpeculationStats(leader)["committed"]), committedBefore);
+    }
+} __SpeculativeWriteTest;
@@ -559,6 +559,17 @@ bool BedrockTester::waitForState(const string& state, uint64_t timeoutUS)
     return waitForStatusTerm("state", state, timeoutUS);
 }
 
+bool BedrockTester::waitForValue(const string& query, const string& testValue, uint64_t timeoutUS) {
+    uint64_t start = STimeNow();
+    while (STimeNow() < start + timeoutUS) {
+        if (readDB(query) == testValue) {
+            return true;
+        }
+        usleep(100'000);
+    }
+    return false;
+}
+
 int BedrockTester::getPID() const
 {
     return _serverPID;
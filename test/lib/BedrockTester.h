@@ -82,6 +82,10 @@ class BedrockTester {
     // This is just a convenience wrapper around `waitForStatusTerm` looking for the state of the node.
     bool waitForState(const string& state, uint64_t timeoutUS = 60'000'000);
 
+    // Wait for `query`, run with `readDB`, to return `testValue`, for up to `timeoutUS` us. Returns true if it did, or
+    // false if it timed out.
+    bool waitForValue(const string& query, const string& testValue, uint64_t timeoutUS = 60'000'000);
+
     int getPID() const;
 
     string serverName;
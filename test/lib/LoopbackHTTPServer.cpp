@@ -0,0 +1,66 @@
+#include "LoopbackHTTPServer.h"
+
+#include <unistd.h>
+
+#include <test/lib/BedrockTester.h>
+
+LoopbackHTTPServer::LoopbackHTTPServer(bool keepAlive) : port(BedrockTester::ports.getPort()), _keepAlive(keepAlive) {
+    _port = STCPManager::openPort("127.0.0.1:" + to_string(port), 3);
+    _thread = thread(&LoopbackHTTPServer::_run, this);
+}
+
+LoopbackHTTPServer::~LoopbackHTTPServer() {
+    _exit = true;
+    _thread.join();
+    _port = nullptr;
+    BedrockTester::ports.returnPort(port);
+}
+
+void LoopbackHTTPServer::_run() {
+    map<int, SFastBuffer> clients;
+    while (!_exit) {
+        fd_map fdm;
+        SFDset(fdm, _port->s, SREADEVTS);
+        for (auto& client : clients) {
+            SFDset(fdm, client.first, SREADEVTS);
+        }
+        S_poll(fdm, 100'000);
+
+        sockaddr_in addr;
+        int s = S_accept(_port->s, addr, false);
+        if (s > 0) {
+            accepted++;
+            clients.emplace(s, SFastBuffer());
+        }
+
+        for (auto it = clients.begin(); it != clients.end();) {
+            bool alive = S_recvappend(it->first, it->second);
+            SData request;
+            int size = request.deserialize(it->second);
+            if (size) {
+                it->second.consumeFront(size);
+                SData response("HTTP/1.1 200 OK");
+                response["Connection"] = _keepAlive ? "keep-alive" : "close";
+                response.content = "OK";
+                SFastBuffer sendBuffer(response.serialize());
+                S_sendconsume(it->first, sendBuffer);
+                if (!_keepAlive) {
+                    alive = false;
+                }
+            }
+            if (!alive) {
+                ::close(it->first);
+                it = clients.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+    for (auto& client : clients) {
+        ::close(client.first);
+    }
+}
+
+SStandaloneHTTPSManager::Transaction* LoopbackHTTPSManager::send(const string& url, const SData& request) {
+    return _httpsSend(url, request);
+}
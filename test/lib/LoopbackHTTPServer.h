@@ -0,0 +1,28 @@
+#pragma once
+#include <libstuff/libstuff.h>
+#include <libstuff/SHTTPSManager.h>
+
+// A loopback HTTP server for tests that answers every request with `200 OK` and counts the connections it accepts.
+// If `keepAlive` is false, each connection is closed after its first response.
+class LoopbackHTTPServer {
+  public:
+    LoopbackHTTPServer(bool keepAlive);
+    ~LoopbackHTTPServer();
+
+    const uint16_t port;
+    atomic<size_t> accepted = 0;
+
+  private:
+    void _run();
+
+    const bool _keepAlive;
+    unique_ptr<STCPManager::Port> _port;
+    atomic<bool> _exit = false;
+    thread _thread;
+};
+
+// Exposes `_httpsSend` so tests can make requests to a `LoopbackHTTPServer`.
+class LoopbackHTTPSManager : public SStandaloneHTTPSManager {
+  public:
+    Transaction* send(const string& url, const SData& request);
+};
@@ -0,0 +1,43 @@
+#include "SQLiteTestFiles.h"
+
+#include <unistd.h>
+
+#include <sqlitecluster/SQLite.h>
+
+SQLiteTestFiles::~SQLiteTestFiles() {
+    removeAll();
+}
+
+string SQLiteTestFiles::create(const string& prefix, const set<string>& shards) {
+    string name = prefix + "XXXXXX";
+    int fd = mkstemp(name.data());
+    if (fd < 0) {
+        STHROW("500 Couldn't create " + name);
+    }
+    close(fd);
+    _files[name] = shards;
+    return name;
+}
+
+void SQLiteTestFiles::removeAll() {
+    for (const auto& [filename, shards] : _files) {
+        list<string> files = {filename};
+        for (const string& shard : shards) {
+            files.push_back(SQLite::getShardFilename(filename, shard));
+        }
+        for (const string& file : files) {
+            for (const char* suffix : {"", "-wal", "-wal2", "-shm"}) {
+                unlink((file + suffix).c_str());
+            }
+        }
+    }
+    _files.clear();
+}
+
+void SQLiteTestFiles::commit(SQLite& db, const string& query) {
+    db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+    if (!db.writeUnmodified(query) || !db.prepare() || db.commit() != SQLITE_OK) {
+        db.rollback();
+        STHROW("500 Couldn't commit: " + query);
+    }
+}
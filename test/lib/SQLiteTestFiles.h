@@ -0,0 +1,26 @@
+#pragma once
+#include <libstuff/libstuff.h>
+
+class SQLite;
+
+// Temporary database files for tests that open `SQLite` directly, named after a prefix and removed with everything
+// sqlite leaves next to them.
+class SQLiteTestFiles {
+  public:
+    // Removes anything still left from `create`.
+    ~SQLiteTestFiles();
+
+    // Creates an empty file with a unique name starting with `prefix`, and returns its name. The files for `shards` are
+    // removed along with it.
+    string create(const string& prefix, const set<string>& shards = {});
+
+    // Removes every file from `create`, along with its shards' files and any `-wal`, `-wal2`, or `-shm` files.
+    void removeAll();
+
+    // Runs `query` on `db` in a transaction of its own, and throws if it doesn't commit.
+    static void commit(SQLite& db, const string& query);
+
+  private:
+    // Each file from `create`, with its shards.
+    map<string, set<string>> _files;
+};
@@ -0,0 +1,63 @@
+#include <libstuff/libstuff.h>
+#include <BedrockFutureCommitNotifier.h>
+#include <test/lib/tpunit++.hpp>
+
+struct BedrockFutureCommitNotifierTest : tpunit::TestFixture {
+    BedrockFutureCommitNotifierTest()
+    : tpunit::TestFixture("BedrockFutureCommitNotifier",
+                          TEST(BedrockFutureCommitNotifierTest::testNotify),
+                          TEST(BedrockFutureCommitNotifierTest::testAlreadyReached),
+                          TEST(BedrockFutureCommitNotifierTest::testTimeout)) { }
+
+    unique_ptr<BedrockCommand> makeCommand(uint64_t timeoutMS = 0) {
+        SData request("Query");
+        if (timeoutMS) {
+            request["timeout"] = to_string(timeoutMS);
+        }
+        return make_unique<BedrockCommand>(SQLiteCommand(move(request)), nullptr);
+    }
+
+    void testNotify() {
+        BedrockCommandQueue queue;
+        BedrockFutureCommitNotifier notifier(queue);
+        for (uint64_t value : {10, 20, 20, 30}) {
+            auto command = makeCommand();
+            ASSERT_TRUE(notifier.waitFor(value, command));
+            ASSERT_FALSE(command);
+        }
+
+        // Only the commands waiting for commits that have happened are released.
+        notifier.notifyThrough(19);
+        ASSERT_EQUAL(queue.size(), 1);
+        notifier.notifyThrough(20);
+        ASSERT_EQUAL(queue.size(), 3);
+        ASSERT_EQUAL(notifier.size(), 1);
+        notifier.releaseAll();
+        ASSERT_EQUAL(queue.size(), 4);
+        ASSERT_EQUAL(notifier.size(), 0);
+    }
+
+    void testAlreadyReached() {
+        BedrockCommandQueue queue;
+        BedrockFutureCommitNotifier notifier(queue);
+        notifier.notifyThrough(10);
+
+        // A commit that's already happened is never waited for, the caller keeps the command.
+        auto command = makeCommand();
+        ASSERT_FALSE(notifier.waitFor(10, command));
+        ASSERT_TRUE(command);
+        ASSERT_TRUE(notifier.waitFor(11, command));
+    }
+
+    void testTimeout() {
+        BedrockCommandQueue queue;
+        BedrockFutureCommitNotifier notifier(queue);
+        auto shortCommand = makeCommand(1);
+        auto longCommand = makeCommand(60'000);
+        ASSERT_TRUE(notifier.waitFor(10, shortCommand));
+        ASSERT_TRUE(notifier.waitFor(10, longCommand));
+        notifier.releaseTimedOut(STimeNow() + 1'000'000);
+        ASSERT_EQUAL(queue.size(), 1);
+        ASSERT_EQUAL(notifier.size(), 1);
+    }
+} __BedrockFutureCommitNotifierTest;
@@ -0,0 +1,79 @@
+#include <unistd.h>
+
+#include <libstuff/libstuff.h>
+#include <BedrockHTTPSEventLoop.h>
+#include <test/lib/BedrockTester.h>
+#include <test/lib/LoopbackHTTPServer.h>
+#include <test/lib/tpunit++.hpp>
+
+struct BedrockHTTPSEventLoopTest : tpunit::TestFixture {
+    BedrockHTTPSEventLoopTest()
+        : tpunit::TestFixture("BedrockHTTPSEventLoop",
+                              TEST(BedrockHTTPSEventLoopTest::testComplete),
+                              TEST(BedrockHTTPSEventLoopTest::testStop))
+    { }
+
+    unique_ptr<BedrockCommand> makeCommand(LoopbackHTTPSManager& manager, const string& url, int requests) {
+        SData request("test");
+        auto command = make_unique<BedrockCommand>(SQLiteCommand(move(request)), nullptr);
+        for (int i = 0; i < requests; i++) {
+            SData httpRequest("GET / HTTP/1.1");
+            httpRequest["Host"] = "127.0.0.1";
+            command->httpsRequests.push_back(manager.send(url, httpRequest));
+        }
+        return command;
+    }
+
+    void testComplete() {
+        LoopbackHTTPServer server(true);
+        LoopbackHTTPSManager manager;
+        string url = "http://127.0.0.1:" + to_string(server.port) + "/";
+
+        mutex m;
+        condition_variable cv;
+        list<unique_ptr<BedrockCommand>> completed;
+        BedrockHTTPSEventLoop loop([&](unique_ptr<BedrockCommand>&& command) {
+            lock_guard<mutex> lock(m);
+            completed.push_back(move(command));
+            cv.notify_all();
+        });
+
+        // Every command should come back through the callback once all of its requests are done.
+        const size_t commandCount = 100;
+        for (size_t i = 0; i < commandCount; i++) {
+            loop.waitFor(makeCommand(manager, url, 1 + i % 3));
+        }
+        {
+            unique_lock<mutex> lock(m);
+            ASSERT_TRUE(cv.wait_for(lock, chrono::seconds(30), [&]{ return completed.size() == commandCount; }));
+        }
+        ASSERT_EQUAL(loop.size(), 0);
+        for (auto& command : completed) {
+            ASSERT_TRUE(command->areHttpsRequestsComplete());
+            for (auto transaction : command->httpsRequests) {
+                ASSERT_EQUAL(transaction->response, 200);
+            }
+        }
+    }
+
+    void testStop() {
+        // This port accepts connections but never responds, so the request can't complete before we stop.
+        uint16_t port = BedrockTester::ports.getPort();
+        auto listener = STCPManager::openPort("127.0.0.1:" + to_string(port), 3);
+        LoopbackHTTPSManager manager;
+        atomic<int> callbacks = 0;
+        BedrockHTTPSEventLoop loop([&](unique_ptr<BedrockCommand>&& command) {
+            callbacks++;
+        });
+        loop.waitFor(makeCommand(manager, "http://127.0.0.1:" + to_string(port) + "/", 1));
+        usleep(200'000);
+        ASSERT_EQUAL(loop.size(), 1);
+
+        // Stopping destroys the waiting command without calling back.
+        loop.stop();
+        ASSERT_EQUAL(loop.size(), 0);
+        ASSERT_EQUAL(callbacks.load(), 0);
+        listener = nullptr;
+        BedrockTester::ports.returnPort(port);
+    }
+} __BedrockHTTPSEventLoopTest;
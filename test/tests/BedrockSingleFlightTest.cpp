@@ -0,0 +1,80 @@
+#include <libstuff/libstuff.h>
+#include <BedrockCommand.h>
+#include <BedrockSingleFlight.h>
+#include <test/lib/tpunit++.hpp>
+
+struct BedrockSingleFlightTest : tpunit::TestFixture {
+    BedrockSingleFlightTest()
+    : tpunit::TestFixture("BedrockSingleFlight",
+                          TEST(BedrockSingleFlightTest::testKeys),
+                          TEST(BedrockSingleFlightTest::testCoalesce),
+                          TEST(BedrockSingleFlightTest::testNotARead)) { }
+
+    unique_ptr<BedrockCommand> makeCommand(const string& methodLine, const string& name, const string& source = "") {
+        SData request(methodLine);
+        request["name"] = name;
+        if (!source.empty()) {
+            request["_source"] = source;
+        }
+        return make_unique<BedrockCommand>(SQLiteCommand(move(request)), nullptr);
+    }
+
+    void testKeys() {
+        BedrockSingleFlight singleFlight;
+        auto command = makeCommand("ReadCache", "a");
+
+        // Nothing is coalesced until it's enabled.
+        ASSERT_EQUAL(singleFlight.getKey(*command), "");
+        singleFlight.setCommandNames({"ReadCache"});
+        string key = singleFlight.getKey(*command);
+        ASSERT_NOT_EQUAL(key, "");
+
+        // Connection-specific headers don't matter, but everything else does.
+        auto other = makeCommand("ReadCache", "a", "10.0.0.1");
+        ASSERT_EQUAL(singleFlight.getKey(*other), key);
+        ASSERT_NOT_EQUAL(singleFlight.getKey(*makeCommand("ReadCache", "b")), key);
+        ASSERT_EQUAL(singleFlight.getKey(*makeCommand("WriteCache", "a")), "");
+
+        // A command that's already been peeked is never coalesced.
+        other->peekCount = 1;
+        ASSERT_EQUAL(singleFlight.getKey(*other), "");
+    }
+
+    void testCoalesce() {
+        BedrockSingleFlight singleFlight;
+        singleFlight.setCommandNames({"ReadCache"});
+        auto first = makeCommand("ReadCache", "a");
+        auto second = makeCommand("ReadCache", "a");
+        auto third = makeCommand("ReadCache", "a");
+        string key = singleFlight.getKey(*first);
+
+        ASSERT_TRUE(singleFlight.start(key, first));
+        ASSERT_FALSE(singleFlight.start(key, second));
+        ASSERT_FALSE(singleFlight.start(key, third));
+        ASSERT_FALSE(second);
+        auto waiting = singleFlight.finish(key, "ReadCache", true);
+        ASSERT_EQUAL(waiting.size(), 2);
+
+        // Once finished, the next identical command runs on its own.
+        ASSERT_TRUE(singleFlight.start(key, first));
+        singleFlight.finish(key, "ReadCache", true);
+        STable stats = SParseJSONObject(singleFlight.getStatsJSON());
+        ASSERT_EQUAL(stats["executions"], "2");
+        ASSERT_EQUAL(stats["coalesced"], "2");
+        ASSERT_EQUAL(stats["inFlight"], "0");
+    }
+
+    void testNotARead() {
+        BedrockSingleFlight singleFlight;
+        singleFlight.setCommandNames({"ReadCache"});
+        auto first = makeCommand("ReadCache", "a");
+        auto second = makeCommand("ReadCache", "a");
+        string key = singleFlight.getKey(*first);
+        ASSERT_TRUE(singleFlight.start(key, first));
+        ASSERT_FALSE(singleFlight.start(key, second));
+
+        // The waiting command is handed back to be run, and the command is no longer coalesced.
+        ASSERT_EQUAL(singleFlight.finish(key, "ReadCache", false).size(), 1);
+        ASSERT_EQUAL(singleFlight.getKey(*first), "");
+    }
+} __BedrockSingleFlightTest;
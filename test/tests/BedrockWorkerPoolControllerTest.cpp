@@ -0,0 +1,78 @@
+#include <libstuff/libstuff.h>
+#include <BedrockWorkerPoolController.h>
+#include <test/lib/tpunit++.hpp>
+
+struct BedrockWorkerPoolControllerTest : tpunit::TestFixture {
+    BedrockWorkerPoolControllerTest()
+    : tpunit::TestFixture("BedrockWorkerPoolController",
+                          TEST(BedrockWorkerPoolControllerTest::testGrow),
+                          TEST(BedrockWorkerPoolControllerTest::testShrink),
+                          TEST(BedrockWorkerPoolControllerTest::testHysteresis)) { }
+
+    BedrockWorkerPoolController::Sample backlogged() {
+        BedrockWorkerPoolController::Sample sample;
+        sample.workers = 4;
+        sample.busyWorkers = 4;
+        sample.blockedWorkers = 3;
+        sample.queueDepth = 50;
+        sample.averageQueueWaitUS = 100'000;
+        sample.cpuUtilization = 0.95;
+        return sample;
+    }
+
+    BedrockWorkerPoolController::Sample idle() {
+        BedrockWorkerPoolController::Sample sample;
+        sample.workers = 4;
+        sample.busyWorkers = 1;
+        sample.averageQueueWaitUS = 100;
+        sample.cpuUtilization = 0.10;
+        return sample;
+    }
+
+    void testGrow() {
+        // Even with the CPU busy, most workers are blocked, so we should grow, but only after several samples.
+        BedrockWorkerPoolController controller(2, 8);
+        for (int i = 1; i < BedrockWorkerPoolController::GROW_SAMPLES; i++) {
+            ASSERT_EQUAL(controller.evaluate(backlogged()), 0);
+        }
+        ASSERT_EQUAL(controller.evaluate(backlogged()), 1);
+
+        // Never past the maximum.
+        auto sample = backlogged();
+        sample.workers = 8;
+        for (int i = 0; i < BedrockWorkerPoolController::GROW_SAMPLES * 2; i++) {
+            ASSERT_EQUAL(controller.evaluate(sample), 0);
+        }
+
+        // Nothing blocked and the CPU saturated, more threads won't help.
+        sample = backlogged();
+        sample.blockedWorkers = 0;
+        for (int i = 0; i < BedrockWorkerPoolController::GROW_SAMPLES * 2; i++) {
+            ASSERT_EQUAL(controller.evaluate(sample), 0);
+        }
+    }
+
+    void testShrink() {
+        BedrockWorkerPoolController controller(2, 8);
+        for (int i = 1; i < BedrockWorkerPoolController::SHRINK_SAMPLES; i++) {
+            ASSERT_EQUAL(controller.evaluate(idle()), 0);
+        }
+        ASSERT_EQUAL(controller.evaluate(idle()), -1);
+        ASSERT_EQUAL(controller.getState()["lastDecision"], "shrink");
+
+        // Never below the minimum.
+        auto sample = idle();
+        sample.workers = 2;
+        for (int i = 0; i < BedrockWorkerPoolController::SHRINK_SAMPLES * 2; i++) {
+            ASSERT_EQUAL(controller.evaluate(sample), 0);
+        }
+    }
+
+    void testHysteresis() {
+        // Alternating load never holds long enough in either direction to change anything.
+        BedrockWorkerPoolController controller(2, 8);
+        for (int i = 0; i < 100; i++) {
+            ASSERT_EQUAL(controller.evaluate(i % 2 ? backlogged() : idle()), 0);
+        }
+    }
+} __BedrockWorkerPoolControllerTest;
@@ -0,0 +1,156 @@
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <libstuff/libstuff.h>
+#include <libstuff/SDNSCache.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SDNSCacheTest : tpunit::TestFixture {
+    SDNSCacheTest()
+        : tpunit::TestFixture("SDNSCache",
+                              TEST(SDNSCacheTest::testHostsFile),
+                              TEST(SDNSCacheTest::testPositiveTTL),
+                              TEST(SDNSCacheTest::testNegativeTTL),
+                              TEST(SDNSCacheTest::testServeStale),
+                              TEST(SDNSCacheTest::testAsync),
+                              TEST(SDNSCacheTest::testConcurrentMisses),
+                              TEST(SDNSCacheTest::testRawIP))
+    { }
+
+    // A resolver that maps every domain to `ip`, or fails if `ip` is 0, and counts its calls.
+    struct FakeResolver {
+        atomic<uint32_t> ip = 0;
+        atomic<int> calls = 0;
+
+        SDNSCache::Resolver get() {
+            return [this](const string& domain, uint32_t& result) {
+                calls++;
+                result = ip;
+                return ip != 0;
+            };
+        }
+    };
+
+    void testHostsFile() {
+        // `localhost` comes from /etc/hosts, so this works without a DNS server.
+        SDNSCache cache;
+        uint32_t ip = 0;
+        ASSERT_TRUE(cache.lookup("localhost", ip));
+        ASSERT_EQUAL(ip, inet_addr("127.0.0.1"));
+        ASSERT_TRUE(cache.isCached("localhost"));
+        ASSERT_TRUE(cache.lookup("localhost", ip));
+        ASSERT_EQUAL(cache.getResolves(), 1);
+        ASSERT_EQUAL(cache.getHits(), 1);
+    }
+
+    void testPositiveTTL() {
+        FakeResolver resolver;
+        resolver.ip = inet_addr("10.0.0.1");
+        SDNSCache cache(resolver.get(), 200'000, 100'000);
+        uint32_t ip = 0;
+        for (int i = 0; i < 5; i++) {
+            ASSERT_TRUE(cache.lookup("example.test", ip));
+            ASSERT_EQUAL(ip, inet_addr("10.0.0.1"));
+        }
+        ASSERT_EQUAL(resolver.calls.load(), 1);
+
+        // Once the entry expires, we pick up the new address.
+        resolver.ip = inet_addr("10.0.0.2");
+        usleep(300'000);
+        ASSERT_TRUE(cache.lookup("example.test", ip));
+        ASSERT_EQUAL(ip, inet_addr("10.0.0.2"));
+    }
+
+    void testNegativeTTL() {
+        FakeResolver resolver;
+        SDNSCache cache(resolver.get(), 1'000'000, 200'000);
+        uint32_t ip = 0;
+        ASSERT_FALSE(cache.lookup("missing.test", ip));
+        ASSERT_FALSE(cache.lookup("missing.test", ip));
+        ASSERT_EQUAL(resolver.calls.load(), 1);
+
+        // After the negative TTL, we ask again.
+        resolver.ip = inet_addr("10.0.0.3");
+        usleep(300'000);
+        ASSERT_TRUE(cache.lookup("missing.test", ip));
+        ASSERT_EQUAL(ip, inet_addr("10.0.0.3"));
+    }
+
+    void testServeStale() {
+        FakeResolver resolver;
+        resolver.ip = inet_addr("10.0.0.4");
+        SDNSCache cache(resolver.get(), 200'000, 1'000'000);
+        uint32_t ip = 0;
+        ASSERT_TRUE(cache.lookup("flaky.test", ip));
+
+        // If the resolver starts failing, we keep the last address we had.
+        resolver.ip = 0;
+        usleep(300'000);
+        ASSERT_TRUE(cache.lookup("flaky.test", ip));
+        ASSERT_EQUAL(ip, inet_addr("10.0.0.4"));
+    }
+
+    void testAsync() {
+        FakeResolver resolver;
+        resolver.ip = inet_addr("10.0.0.5");
+        SDNSCache cache(resolver.get());
+        ASSERT_FALSE(cache.isCached("async.test"));
+
+        mutex m;
+        condition_variable cv;
+        bool done = false;
+        uint32_t result = 0;
+        cache.resolveAsync("async.test", [&](bool resolved, uint32_t ip) {
+            lock_guard<mutex> lock(m);
+            result = resolved ? ip : 0;
+            done = true;
+            cv.notify_all();
+        });
+        {
+            unique_lock<mutex> lock(m);
+            ASSERT_TRUE(cv.wait_for(lock, chrono::seconds(5), [&]{ return done; }));
+        }
+        ASSERT_EQUAL(result, inet_addr("10.0.0.5"));
+        ASSERT_TRUE(cache.isCached("async.test"));
+
+        // Prefetched domains are resolved in the background.
+        cache.prefetch("prefetch.test");
+        for (int i = 0; i < 50 && !cache.isCached("prefetch.test"); i++) {
+            usleep(100'000);
+        }
+        ASSERT_TRUE(cache.isCached("prefetch.test"));
+        ASSERT_EQUAL(resolver.calls.load(), 2);
+    }
+
+    void testConcurrentMisses() {
+        // A resolver slow enough that both threads miss while it's running.
+        atomic<int> calls = 0;
+        SDNSCache cache([&calls](const string& domain, uint32_t& ip) {
+            calls++;
+            usleep(200'000);
+            ip = inet_addr("10.0.0.6");
+            return true;
+        });
+        uint32_t first = 0;
+        uint32_t second = 0;
+        thread other([&]() {
+            ASSERT_TRUE(cache.lookup("slow.test", second));
+        });
+        ASSERT_TRUE(cache.lookup("slow.test", first));
+        other.join();
+        ASSERT_EQUAL(first, inet_addr("10.0.0.6"));
+        ASSERT_EQUAL(second, inet_addr("10.0.0.6"));
+        ASSERT_EQUAL(calls.load(), 1);
+        ASSERT_EQUAL(cache.getResolves(), 1);
+    }
+
+    void testRawIP() {
+        FakeResolver resolver;
+        SDNSCache cache(resolver.get());
+        uint32_t ip = 0;
+        ASSERT_TRUE(cache.isCached("192.168.1.1"));
+        ASSERT_TRUE(cache.lookup("192.168.1.1", ip));
+        ASSERT_EQUAL(ip, inet_addr("192.168.1.1"));
+        ASSERT_EQUAL(resolver.calls.load(), 0);
+    }
+} __SDNSCacheTest;
@@ -0,0 +1,131 @@
+#include <unistd.h>
+
+#include <libstuff/libstuff.h>
+#include <libstuff/SData.h>
+#include <libstuff/SHTTPSManager.h>
+#include <test/lib/LoopbackHTTPServer.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SHTTPSManagerTest : tpunit::TestFixture {
+    SHTTPSManagerTest()
+        : tpunit::TestFixture("SHTTPSManager",
+                              TEST(SHTTPSManagerTest::testReuse),
+                              TEST(SHTTPSManagerTest::testConnectionClose),
+                              TEST(SHTTPSManagerTest::testMaxIdlePerHost),
+                              TEST(SHTTPSManagerTest::testMaxActivePerHost))
+    { }
+
+    // Polls a transaction until it has a response.
+    void wait(LoopbackHTTPSManager& manager, SStandaloneHTTPSManager::Transaction* transaction) {
+        while (!transaction->response) {
+            fd_map fdm;
+            manager.prePoll(fdm, *transaction);
+            S_poll(fdm, 100'000);
+            uint64_t nextActivity = STimeNow() + 100'000;
+            manager.postPoll(fdm, *transaction, nextActivity, 5'000);
+        }
+    }
+
+    SData makeRequest() {
+        SData request("GET / HTTP/1.1");
+        request["Host"] = "127.0.0.1";
+        return request;
+    }
+
+    void testReuse() {
+        LoopbackHTTPServer server(true);
+        LoopbackHTTPSManager manager;
+        string url = "http://127.0.0.1:" + to_string(server.port) + "/";
+        for (int i = 0; i < 3; i++) {
+            auto transaction = manager.send(url, makeRequest());
+            wait(manager, transaction);
+            ASSERT_EQUAL(transaction->response, 200);
+            manager.closeTransaction(transaction);
+        }
+
+        // All three requests should have gone over the same connection.
+        ASSERT_EQUAL(server.accepted.load(), 1);
+        STable stats = manager.getConnectionStats();
+        ASSERT_EQUAL(stats["newConnections"], "1");
+        ASSERT_EQUAL(stats["poolHits"], "2");
+        ASSERT_EQUAL(stats["idleConnections"], "1");
+    }
+
+    void testConnectionClose() {
+        LoopbackHTTPServer server(false);
+        LoopbackHTTPSManager manager;
+        string url = "http://127.0.0.1:" + to_string(server.port) + "/";
+        for (int i = 0; i < 2; i++) {
+            auto transaction = manager.send(url, makeRequest());
+            wait(manager, transaction);
+            ASSERT_EQUAL(transaction->response, 200);
+            manager.closeTransaction(transaction);
+        }
+
+        // The server closed each connection, so none of them could be reused.
+        ASSERT_EQUAL(server.accepted.load(), 2);
+        STable stats = manager.getConnectionStats();
+        ASSERT_EQUAL(stats["poolHits"], "0");
+        ASSERT_EQUAL(stats["idleConnections"], "0");
+    }
+
+    void testMaxIdlePerHost() {
+        LoopbackHTTPServer server(true);
+        LoopbackHTTPSManager manager;
+        string url = "http://127.0.0.1:" + to_string(server.port) + "/";
+
+        // Run more concurrent transactions than the pool will hold on to.
+        list<SStandaloneHTTPSManager::Transaction*> transactions;
+        for (size_t i = 0; i < SStandaloneHTTPSManager::POOL_MAX_IDLE_PER_HOST + 2; i++) {
+            transactions.push_back(manager.send(url, makeRequest()));
+        }
+        for (auto transaction : transactions) {
+            wait(manager, transaction);
+            ASSERT_EQUAL(transaction->response, 200);
+        }
+        for (auto transaction : transactions) {
+            manager.closeTransaction(transaction);
+        }
+        STable stats = manager.getConnectionStats();
+        ASSERT_EQUAL(stats["idleConnections"], to_string(SStandaloneHTTPSManager::POOL_MAX_IDLE_PER_HOST));
+    }
+
+    void testMaxActivePerHost() {
+        LoopbackHTTPServer server(true);
+        LoopbackHTTPSManager manager;
+        string url = "http://127.0.0.1:" + to_string(server.port) + "/";
+
+        // Open as many transactions as a host is allowed.
+        list<SStandaloneHTTPSManager::Transaction*> transactions;
+        for (size_t i = 0; i < SStandaloneHTTPSManager::POOL_MAX_ACTIVE_PER_HOST; i++) {
+            transactions.push_back(manager.send(url, makeRequest()));
+        }
+        STable stats = manager.getConnectionStats();
+        ASSERT_EQUAL(stats["activeConnections"], to_string(SStandaloneHTTPSManager::POOL_MAX_ACTIVE_PER_HOST));
+
+        // One more fails straight away, without connecting.
+        auto rejected = manager.send(url, makeRequest());
+        ASSERT_EQUAL(rejected->response, 503);
+        ASSERT_FALSE(rejected->s);
+        manager.closeTransaction(rejected);
+        stats = manager.getConnectionStats();
+        ASSERT_EQUAL(stats["activeLimitRejections"], "1");
+        ASSERT_EQUAL(stats["activeConnections"], to_string(SStandaloneHTTPSManager::POOL_MAX_ACTIVE_PER_HOST));
+
+        // Once one finishes, there's room for another, which reuses its connection.
+        wait(manager, transactions.front());
+        manager.closeTransaction(transactions.front());
+        transactions.pop_front();
+        auto next = manager.send(url, makeRequest());
+        ASSERT_TRUE(next->reusedConnection);
+        transactions.push_back(next);
+        for (auto transaction : transactions) {
+            wait(manager, transaction);
+            ASSERT_EQUAL(transaction->response, 200);
+            manager.closeTransaction(transaction);
+        }
+        stats = manager.getConnectionStats();
+        ASSERT_EQUAL(stats["activeConnections"], "0");
+        ASSERT_EQUAL(server.accepted.load(), SStandaloneHTTPSManager::POOL_MAX_ACTIVE_PER_HOST);
+    }
+} __SHTTPSManagerTest;
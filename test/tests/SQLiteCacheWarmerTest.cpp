@@ -0,0 +1,72 @@
+#include <libstuff/libstuff.h>
+#include <sqlitecluster/SQLiteCacheWarmer.h>
+#include <sqlitecluster/SQLitePool.h>
+#include <test/lib/tpunit++.hpp>
+
+#include <unistd.h>
+#include <cstring>
+
+struct SQLiteCacheWarmerTest : tpunit::TestFixture {
+    SQLiteCacheWarmerTest() : tpunit::TestFixture("SQLiteCacheWarmer",
+                                                  AFTER_CLASS(SQLiteCacheWarmerTest::teardown),
+                                                  TEST(SQLiteCacheWarmerTest::testSaveAndWarm)) { }
+
+    char filename[17] = "br_warm_dbXXXXXX";
+
+    void teardown() {
+        unlink(filename);
+        unlink(SQLite::getShardFilename(filename, "cache").c_str());
+        unlink((string(filename) + "-hot").c_str());
+    }
+
+    void testSaveAndWarm() {
+        int fd = mkstemp(filename);
+        close(fd);
+        shared_ptr<SQLitePool> dbPool = make_shared<SQLitePool>(10, filename, 1000000, 5000, 0, "", 0, set<string>{"cache"});
+        SQLite& db = dbPool->getBase();
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        db.write("CREATE TABLE hot (id INTEGER PRIMARY KEY, value TEXT);");
+        db.write("CREATE INDEX hotValue ON hot (value);");
+        db.write("CREATE INDEX hotPartial ON hot (value) WHERE id > 50;");
+        db.write("CREATE TABLE cold (id INTEGER PRIMARY KEY);");
+        db.write("CREATE TABLE \"order\" (id INTEGER PRIMARY KEY, value TEXT);");
+        db.write("CREATE INDEX \"order value\" ON \"order\" (value);");
+        db.write("CREATE TABLE cache.cached (id INTEGER PRIMARY KEY, value TEXT);");
+        db.write("CREATE INDEX cache.cachedValue ON cached (value);");
+        for (int i = 0; i < 100; i++) {
+            db.write("INSERT INTO hot VALUES (" + SQ(i) + ", " + SQ("value" + to_string(i)) + ");");
+        }
+        db.prepare();
+        db.commit();
+
+        // Read `hot` in every transaction and `cold` and `cached` in a few, so that `hot` is sampled more often.
+        for (uint64_t i = 0; i < SQLite::TABLE_READ_SAMPLE_INTERVAL * 4; i++) {
+            db.beginTransaction();
+            db.read("SELECT COUNT(*) FROM hot;");
+            if (i % 3 == 0) {
+                db.read("SELECT COUNT(*) FROM cold;");
+                db.read("SELECT COUNT(*) FROM cached;");
+            }
+            db.rollback();
+        }
+
+        SQLiteCacheWarmer warmer(dbPool, string(filename) + "-hot", 1'000'000);
+        ASSERT_TRUE(warmer.loadTables().empty());
+        warmer.save(db);
+        list<string> tables = warmer.loadTables();
+        ASSERT_FALSE(tables.empty());
+        ASSERT_EQUAL(tables.front(), "main.hot");
+
+        // Each table is saved with the schema it's in.
+        ASSERT_TRUE(find(tables.begin(), tables.end(), "cache.cached") != tables.end());
+
+        // Tables that no longer exist, or are in shards that aren't attached, are skipped rather than failing the
+        // pass, and names that need quoting, partial indexes, and tables in shards are handled.
+        SFileSave(string(filename) + "-hot", "main.dropped\nmissing.hot\nmain.hot\nmain.order\ncache.cached\n");
+        warmer.start();
+        for (int i = 0; i < 100 && warmer.isRunning(); i++) {
+            usleep(10'000);
+        }
+        ASSERT_FALSE(warmer.isRunning());
+    }
+} __SQLiteCacheWarmerTest;
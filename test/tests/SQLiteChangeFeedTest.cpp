@@ -0,0 +1,159 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/lib/SQLiteTestFiles.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLiteChangeFeedTest : tpunit::TestFixture {
+    SQLiteChangeFeedTest() : tpunit::TestFixture("SQLiteChangeFeed",
+                                                 BEFORE(SQLiteChangeFeedTest::setup),
+                                                 AFTER(SQLiteChangeFeedTest::teardown),
+                                                 TEST(SQLiteChangeFeedTest::testChanges),
+                                                 TEST(SQLiteChangeFeedTest::testPaging),
+                                                 TEST(SQLiteChangeFeedTest::testMaxBytes),
+                                                 TEST(SQLiteChangeFeedTest::testIncomplete)) { }
+
+    SQLiteTestFiles files;
+    SQLite* db = nullptr;
+
+    void setup() {
+        db = new SQLite(files.create("br_change_feed_db"), 1000000, 1000, 1);
+        commit("CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT, data BLOB); "
+               "CREATE TABLE other (id INTEGER PRIMARY KEY);");
+    }
+
+    void teardown() {
+        delete db;
+        db = nullptr;
+        files.removeAll();
+    }
+
+    void commit(const string& query) {
+        SQLiteTestFiles::commit(*db, query);
+    }
+
+    // Returns the changes after `afterCommit` as parsed objects.
+    list<STable> get(uint64_t afterCommit, const set<string>& tables = {}, size_t limit = 1000) {
+        list<string> changes;
+        uint64_t throughCommit = 0;
+        list<STable> result;
+        if (db->getChangeFeed().get(afterCommit, tables, limit, changes, throughCommit)) {
+            for (const string& change : changes) {
+                result.push_back(SParseJSONObject(change));
+            }
+        }
+        return result;
+    }
+
+    void testChanges() {
+        const uint64_t start = db->getCommitCount();
+        db->getChangeFeed().setMaxChanges(1000, start);
+        commit("INSERT INTO test VALUES (1, 'one', NULL); INSERT INTO test VALUES (2, 'two', x'0102');");
+        commit("UPDATE test SET value = 'uno' WHERE id = 1;");
+        commit("DELETE FROM test WHERE id = 2; INSERT INTO other VALUES (7);");
+
+        // A row that a transaction adds and removes again isn't a change, and neither is a rolled back transaction.
+        commit("INSERT INTO test VALUES (3, 'three', NULL); DELETE FROM test WHERE id = 3;");
+        db->beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        ASSERT_TRUE(db->writeUnmodified("INSERT INTO test VALUES (4, 'four', NULL);"));
+        db->rollback();
+
+        // The order of the rows within a commit is up to sqlite, so we look each one up.
+        list<STable> changes = get(start);
+        ASSERT_EQUAL(changes.size(), 5);
+        auto find = [&changes](const string& op, const string& id) {
+            for (STable& change : changes) {
+                STable row = SParseJSONObject(change[op == "update" ? "key" : op == "delete" ? "old" : "new"]);
+                if (change["op"] == op && row["id"] == id) {
+                    return change;
+                }
+            }
+            return STable();
+        };
+        STable change = find("insert", "1");
+        ASSERT_EQUAL(change["commitID"], to_string(start + 1));
+        ASSERT_EQUAL(change["table"], "test");
+        ASSERT_EQUAL(SParseJSONObject(change["new"])["value"], "one");
+        ASSERT_EQUAL(SParseJSONObject(find("insert", "2")["new"])["data"], "0102");
+
+        // Updates have the key, and only the columns that changed.
+        change = find("update", "1");
+        ASSERT_EQUAL(change["commitID"], to_string(start + 2));
+        STable newValues = SParseJSONObject(change["new"]);
+        ASSERT_EQUAL(newValues.size(), 1);
+        ASSERT_EQUAL(newValues["value"], "uno");
+        ASSERT_EQUAL(SParseJSONObject(change["old"])["value"], "one");
+        change = find("delete", "2");
+        ASSERT_EQUAL(change["commitID"], to_string(start + 3));
+        ASSERT_EQUAL(SParseJSONObject(change["old"])["value"], "two");
+        ASSERT_EQUAL(find("insert", "7")["table"], "other");
+
+        // Filtered by table, and by where the reader is up to.
+        ASSERT_EQUAL(get(start, {"other"}).size(), 1);
+        ASSERT_EQUAL(get(start + 2).size(), 2);
+        ASSERT_EQUAL(get(start + 5).size(), 0);
+    }
+
+    void testPaging() {
+        const uint64_t start = db->getCommitCount();
+        db->getChangeFeed().setMaxChanges(5, start);
+        commit("INSERT INTO test VALUES (1, 'a', NULL); INSERT INTO test VALUES (2, 'b', NULL);");
+        commit("INSERT INTO test VALUES (3, 'c', NULL); INSERT INTO test VALUES (4, 'd', NULL);");
+
+        // Pages end between commits, and say where to carry on from.
+        list<string> changes;
+        uint64_t throughCommit = 0;
+        ASSERT_TRUE(db->getChangeFeed().get(start, {}, 1, changes, throughCommit));
+        ASSERT_EQUAL(changes.size(), 2);
+        ASSERT_EQUAL(throughCommit, start + 1);
+        changes.clear();
+        ASSERT_TRUE(db->getChangeFeed().get(throughCommit, {}, 1, changes, throughCommit));
+        ASSERT_EQUAL(changes.size(), 2);
+        ASSERT_EQUAL(throughCommit, start + 2);
+
+        // Making room drops whole commits, after which a reader that far behind has to start over.
+        commit("INSERT INTO test VALUES (5, 'e', NULL); INSERT INTO test VALUES (6, 'f', NULL);");
+        changes.clear();
+        ASSERT_FALSE(db->getChangeFeed().get(start, {}, 1000, changes, throughCommit));
+        ASSERT_TRUE(db->getChangeFeed().get(start + 1, {}, 1000, changes, throughCommit));
+        ASSERT_EQUAL(changes.size(), 4);
+        ASSERT_EQUAL(db->getChangeFeed().getStats()["completeAfter"], to_string(start + 1));
+    }
+
+    void testMaxBytes() {
+        const uint64_t start = db->getCommitCount();
+        db->getChangeFeed().setMaxChanges(1000, start);
+        db->getChangeFeed().setMaxBytes(10000);
+
+        // A few large rows are well under the change limit, but over the byte limit, so the oldest commits go.
+        for (int i = 1; i <= 4; i++) {
+            commit("INSERT INTO test VALUES (" + to_string(i) + ", NULL, zeroblob(2000));");
+        }
+        list<string> changes;
+        uint64_t throughCommit = 0;
+        ASSERT_FALSE(db->getChangeFeed().get(start, {}, 1000, changes, throughCommit));
+        ASSERT_TRUE(db->getChangeFeed().get(start + 2, {}, 1000, changes, throughCommit));
+        ASSERT_EQUAL(changes.size(), 2);
+        STable stats = db->getChangeFeed().getStats();
+        ASSERT_EQUAL(stats["completeAfter"], to_string(start + 2));
+        ASSERT_LESS_THAN_EQUAL(SToUInt64(stats["bytes"]), 10000);
+    }
+
+    void testIncomplete() {
+        // A transaction that was already running when the feed was enabled didn't record its changes.
+        db->beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        ASSERT_TRUE(db->writeUnmodified("INSERT INTO test VALUES (1, 'a', NULL);"));
+        const uint64_t start = db->getCommitCount();
+        db->getChangeFeed().setMaxChanges(1000, start);
+        ASSERT_TRUE(db->prepare());
+        ASSERT_EQUAL(db->commit(), SQLITE_OK);
+        commit("INSERT INTO test VALUES (2, 'b', NULL);");
+
+        list<string> changes;
+        uint64_t throughCommit = 0;
+        ASSERT_FALSE(db->getChangeFeed().get(start, {}, 1000, changes, throughCommit));
+        ASSERT_TRUE(db->getChangeFeed().get(start + 1, {}, 1000, changes, throughCommit));
+        ASSERT_EQUAL(changes.size(), 1);
+        ASSERT_EQUAL(throughCommit, start + 2);
+    }
+} __SQLiteChangeFeedTest;
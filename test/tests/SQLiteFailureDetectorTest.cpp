@@ -0,0 +1,85 @@
+#include <libstuff/libstuff.h>
+#include <sqlitecluster/SQLiteFailureDetector.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLiteFailureDetectorTest : tpunit::TestFixture {
+    SQLiteFailureDetectorTest()
+        : tpunit::TestFixture("SQLiteFailureDetector",
+                              TEST(SQLiteFailureDetectorTest::testNotEnoughSamples),
+                              TEST(SQLiteFailureDetectorTest::testSteadyHeartbeats),
+                              TEST(SQLiteFailureDetectorTest::testJitteryHeartbeats),
+                              TEST(SQLiteFailureDetectorTest::testAcceptablePause),
+                              TEST(SQLiteFailureDetectorTest::testReset)) { }
+
+    void testNotEnoughSamples() {
+        SQLiteFailureDetector detector;
+        uint64_t now = 1'000'000'000;
+        for (size_t i = 0; i < SQLiteFailureDetector::MIN_SAMPLES; i++) {
+            detector.heartbeat(now);
+            now += 1'000'000;
+        }
+
+        // Only MIN_SAMPLES - 1 intervals so far, so we don't suspect anything no matter how long it's been.
+        ASSERT_EQUAL(detector.phi(now + 60'000'000), 0);
+    }
+
+    void testSteadyHeartbeats() {
+        SQLiteFailureDetector detector;
+        uint64_t now = 1'000'000'000;
+        for (int i = 0; i < 50; i++) {
+            detector.heartbeat(now);
+            now += 1'000'000;
+        }
+        uint64_t last = now - 1'000'000;
+
+        // On time, there's no suspicion. Suspicion keeps growing the longer the peer is silent, and a few seconds of
+        // silence past the acceptable pause from a peer that's always on time is very suspicious.
+        ASSERT_LESS_THAN(detector.phi(last + 1'000'000), 1);
+        ASSERT_LESS_THAN(detector.phi(last + 7'000'000), detector.phi(last + 8'000'000));
+        ASSERT_GREATER_THAN(detector.phi(last + 10'000'000), 8);
+    }
+
+    void testJitteryHeartbeats() {
+        // Same average interval as above, but alternating between 0.2 and 1.8 seconds.
+        SQLiteFailureDetector steady;
+        SQLiteFailureDetector jittery;
+        uint64_t now = 1'000'000'000;
+        uint64_t jitteryNow = now;
+        for (int i = 0; i < 50; i++) {
+            steady.heartbeat(now);
+            jittery.heartbeat(jitteryNow);
+            now += 1'000'000;
+            jitteryNow += (i % 2) ? 200'000 : 1'800'000;
+        }
+
+        // The same silence is less suspicious from a peer that's known to be irregular.
+        uint64_t steadyLast = now - 1'000'000;
+        uint64_t jitteryLast = jitteryNow - ((49 % 2) ? 200'000 : 1'800'000);
+        ASSERT_LESS_THAN(jittery.phi(jitteryLast + 8'000'000), steady.phi(steadyLast + 8'000'000));
+    }
+
+    void testAcceptablePause() {
+        SQLiteFailureDetector detector;
+        uint64_t now = 1'000'000'000;
+        for (int i = 0; i < 50; i++) {
+            detector.heartbeat(now);
+            now += 1'000'000;
+        }
+        uint64_t last = now - 1'000'000;
+
+        // Even from a peer that's always on time, a pause as long as a busy sync thread might take isn't suspicious.
+        ASSERT_LESS_THAN(detector.phi(last + 1'000'000 + SQLiteFailureDetector::ACCEPTABLE_PAUSE_US), 1);
+    }
+
+    void testReset() {
+        SQLiteFailureDetector detector;
+        uint64_t now = 1'000'000'000;
+        for (int i = 0; i < 50; i++) {
+            detector.heartbeat(now);
+            now += 1'000'000;
+        }
+        ASSERT_GREATER_THAN(detector.phi(now + 10'000'000), 8);
+        detector.reset();
+        ASSERT_EQUAL(detector.phi(now + 10'000'000), 0);
+    }
+} __SQLiteFailureDetectorTest;
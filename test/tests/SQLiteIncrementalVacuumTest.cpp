@@ -0,0 +1,77 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/lib/SQLiteTestFiles.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLiteIncrementalVacuumTest : tpunit::TestFixture {
+    SQLiteIncrementalVacuumTest() : tpunit::TestFixture("SQLiteIncrementalVacuum",
+                                                        AFTER(SQLiteIncrementalVacuumTest::teardown),
+                                                        TEST(SQLiteIncrementalVacuumTest::testIncremental),
+                                                        TEST(SQLiteIncrementalVacuumTest::testNone)) { }
+
+    SQLiteTestFiles files;
+
+    void teardown() {
+        files.removeAll();
+    }
+
+    // Creates a database with the given auto_vacuum mode, which has to be set before anything is written to it.
+    string create(const string& autoVacuum) {
+        const string filename = files.create("br_vacuum_db");
+        sqlite3* db = nullptr;
+        sqlite3_open_v2(filename.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr);
+        SASSERT(!SQuery(db, "", "PRAGMA auto_vacuum = " + autoVacuum + ";"));
+        SASSERT(!SQuery(db, "", "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);"));
+        sqlite3_close_v2(db);
+        return filename;
+    }
+
+    // Fills the test table and then empties it, leaving its pages free.
+    void fillAndEmpty(SQLite& db) {
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        db.write("INSERT INTO test WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c WHERE x < 5000) "
+                 "SELECT x, hex(randomblob(200)) FROM c;");
+        db.prepare();
+        ASSERT_EQUAL(db.commit(), SQLITE_OK);
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        db.write("DELETE FROM test;");
+        db.prepare();
+        ASSERT_EQUAL(db.commit(), SQLITE_OK);
+    }
+
+    void testIncremental() {
+        SQLite db(create("INCREMENTAL"), 1000000, 1000, 1);
+        fillAndEmpty(db);
+        STable before = db.getFreelistStats();
+        ASSERT_EQUAL(before["autoVacuum"], "incremental");
+        ASSERT_GREATER_THAN(SToUInt64(before["freePages"]), 100);
+
+        // Each step frees no more than it's asked to, and the file shrinks by that much.
+        uint64_t freed = 0;
+        ASSERT_TRUE(db.incrementalVacuum(100, freed));
+        ASSERT_EQUAL(freed, 100);
+        STable after = db.getFreelistStats();
+        ASSERT_EQUAL(SToUInt64(after["freePages"]), SToUInt64(before["freePages"]) - 100);
+        ASSERT_EQUAL(SToUInt64(after["pageCount"]), SToUInt64(before["pageCount"]) - 100);
+
+        // And it keeps going until there's nothing left.
+        while (db.incrementalVacuum(100, freed) && freed) {}
+        ASSERT_EQUAL(db.getFreelistStats()["freePages"], "0");
+        ASSERT_EQUAL(db.read("SELECT COUNT(*) FROM test;"), "0");
+    }
+
+    void testNone() {
+        SQLite db(create("NONE"), 1000000, 1000, 1);
+        fillAndEmpty(db);
+        STable before = db.getFreelistStats();
+        ASSERT_EQUAL(before["autoVacuum"], "none");
+        ASSERT_GREATER_THAN(SToUInt64(before["freePages"]), 0);
+
+        // Without auto_vacuum, there's nothing it can free.
+        uint64_t freed = 0;
+        ASSERT_TRUE(db.incrementalVacuum(100, freed));
+        ASSERT_EQUAL(freed, 0);
+        ASSERT_EQUAL(db.getFreelistStats()["pageCount"], before["pageCount"]);
+    }
+} __SQLiteIncrementalVacuumTest;
@@ -0,0 +1,58 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/lib/SQLiteTestFiles.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLiteJournalCompressionTest : tpunit::TestFixture {
+    SQLiteJournalCompressionTest() : tpunit::TestFixture("SQLiteJournalCompression",
+                                                         BEFORE(SQLiteJournalCompressionTest::setup),
+                                                         AFTER(SQLiteJournalCompressionTest::teardown),
+                                                         TEST(SQLiteJournalCompressionTest::test)) { }
+
+    SQLiteTestFiles files;
+    string filename;
+
+    void setup() {
+        filename = files.create("br_journal_compression_db");
+    }
+
+    void teardown() {
+        SQLite::journalCompressionMinBytes = 0;
+        files.removeAll();
+    }
+
+    void test() {
+        // With only the one `journal` table, we know where each commit goes.
+        SQLite db(filename, 1000000, 1000, -1);
+        SQLite::journalCompressionMinBytes = 200;
+        SQLiteTestFiles::commit(db, "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+        const string shortQuery = "INSERT INTO test VALUES (1, 'short');";
+        const string longQuery = "INSERT INTO test VALUES (2, '" + string(5000, 'x') + "');";
+        SQLiteTestFiles::commit(db, shortQuery);
+        const uint64_t shortID = db.getCommitCount();
+        const string hashBefore = db.getCommittedHash();
+        SQLiteTestFiles::commit(db, longQuery);
+        const uint64_t longID = db.getCommitCount();
+
+        // Only the long one is stored compressed, and in far less space.
+        ASSERT_EQUAL(db.read("SELECT typeof(query) FROM journal WHERE id = " + SQ(shortID) + ";"), "text");
+        ASSERT_EQUAL(db.read("SELECT typeof(query) FROM journal WHERE id = " + SQ(longID) + ";"), "blob");
+        ASSERT_LESS_THAN(SToUInt64(db.read("SELECT length(query) FROM journal WHERE id = " + SQ(longID) + ";")), 200);
+
+        // It reads back as the original, which is still what the hash covers.
+        string query, hash;
+        ASSERT_TRUE(db.getCommit(longID, query, hash));
+        ASSERT_EQUAL(query, longQuery);
+        ASSERT_EQUAL(hash, SToHex(SHashSHA1(hashBefore + longQuery)));
+        SQResult commits;
+        ASSERT_TRUE(db.getCommits(shortID, longID, commits));
+        ASSERT_EQUAL(commits.size(), 2);
+        ASSERT_EQUAL(commits[0][1], shortQuery);
+        ASSERT_EQUAL(commits[1][1], longQuery);
+
+        STable stats = SQLite::getJournalCompressionStats();
+        ASSERT_GREATER_THAN(SToUInt64(stats["compressed"]), 0);
+        ASSERT_GREATER_THAN(SToFloat(stats["ratio"]), 10.0);
+    }
+} __SQLiteJournalCompressionTest;
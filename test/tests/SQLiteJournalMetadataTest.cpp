@@ -0,0 +1,84 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/lib/tpunit++.hpp>
+
+#include <unistd.h>
+#include <cstring>
+
+struct SQLiteJournalMetadataTest : tpunit::TestFixture {
+    SQLiteJournalMetadataTest() : tpunit::TestFixture("SQLiteJournalMetadata",
+                                                      BEFORE_CLASS(SQLiteJournalMetadataTest::setup),
+                                                      AFTER_CLASS(SQLiteJournalMetadataTest::teardown),
+                                                      TEST(SQLiteJournalMetadataTest::testTracksJournal),
+                                                      TEST(SQLiteJournalMetadataTest::testStaleMetadata)) { }
+
+    char filename[17] = "br_jmet_dbXXXXXX";
+    list<string> copies;
+    SQLite* db = nullptr;
+
+    void setup() {
+        int fd = mkstemp(filename);
+        close(fd);
+
+        // Three journal tables, and a journal small enough to be truncated.
+        db = new SQLite(filename, 1000000, 20, 1);
+        db->beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        db->write("CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+        db->prepare();
+        db->commit();
+        for (int i = 0; i < 50; i++) {
+            db->beginTransaction();
+            db->write("INSERT INTO test VALUES (" + SQ(i) + ", " + SQ("value" + to_string(i)) + ");");
+            db->prepare();
+            ASSERT_EQUAL(db->commit(), SQLITE_OK);
+        }
+    }
+
+    void teardown() {
+        delete db;
+        unlink(filename);
+        for (const string& copy : copies) {
+            unlink(copy.c_str());
+        }
+    }
+
+    // Makes a copy of the DB under a new name, which gets its own shared data, and so reads its commit count at startup.
+    string copy() {
+        string copyName = string(filename) + "-copy" + to_string(copies.size());
+        copies.push_back(copyName);
+        unlink(copyName.c_str());
+        SASSERT(!SQuery(db->getDBHandle(), "", "VACUUM INTO " + SQ(copyName) + ";"));
+        return copyName;
+    }
+
+    void testTracksJournal() {
+        // Each journal's row matches the journal itself.
+        for (const string journal : {"journal", "journal0000", "journal0001"}) {
+            ASSERT_EQUAL(db->read("SELECT MIN(id) || ',' || MAX(id) FROM " + journal + ";"),
+                         db->read("SELECT minID || ',' || maxID FROM journalMetadata WHERE journal = " + SQ(journal) + ";"));
+        }
+        ASSERT_EQUAL(db->read("SELECT hash FROM journalMetadata WHERE maxID = " + SQ(db->getCommitCount()) + ";"),
+                     db->getCommittedHash());
+
+        SQLite copyDB(copy(), 1000000, 20, 1);
+        ASSERT_EQUAL(copyDB.getCommitCount(), db->getCommitCount());
+        ASSERT_EQUAL(copyDB.getCommittedHash(), db->getCommittedHash());
+    }
+
+    void testStaleMetadata() {
+        // Make the metadata claim an earlier commit than the journals have. This is what happens if a version that
+        // doesn't update it has committed since it was written.
+        string copyName = copy();
+        sqlite3* handle = nullptr;
+        sqlite3_open_v2(copyName.c_str(), &handle, SQLITE_OPEN_READWRITE, nullptr);
+        SQuery(handle, "", "UPDATE journalMetadata SET maxID = maxID - 3;");
+        sqlite3_close_v2(handle);
+
+        // It's detected, and rebuilt.
+        SQLite copyDB(copyName, 1000000, 20, 1);
+        ASSERT_EQUAL(copyDB.getCommitCount(), db->getCommitCount());
+        ASSERT_EQUAL(copyDB.getCommittedHash(), db->getCommittedHash());
+        ASSERT_EQUAL(copyDB.read("SELECT MAX(maxID) FROM journalMetadata;"), to_string(db->getCommitCount()));
+    }
+} __SQLiteJournalMetadataTest;
@@ -30,14 +30,17 @@ class TestServer : public SQLiteServer {
 struct SQLiteNodeTest : tpunit::TestFixture {
     SQLiteNodeTest() : tpunit::TestFixture("SQLiteNode",
                                            AFTER_CLASS(SQLiteNodeTest::teardown),
-                                           TEST(SQLiteNodeTest::testFindSyncPeer)) { }
+                                           TEST(SQLiteNodeTest::testFindSyncPeer),
+                                           TEST(SQLiteNodeTest::testQuorumApprovals)) { }
 
-    // Filename for temp DB.
+    // Filenames for temp DBs.
     char filenameTemplate[17] = "br_sync_dbXXXXXX";
     char filename[17];
+    char quorumFilename[17];
 
     void teardown() {
         unlink(filename);
+        unlink(quorumFilename);
     }
 
     void testFindSyncPeer() {
@@ -119,4 +122,95 @@ struct SQLiteNodeTest : tpunit::TestFixture {
         ASSERT_EQUAL(SQLiteNodeTester::getSyncPeer(testNode), fastest);
     }
 
+    void testQuorumApprovals() {
+        strcpy(quorumFilename, filenameTemplate);
+        int fd = mkstemp(quorumFilename);
+        close(fd);
+        shared_ptr<SQLitePool> dbPool = make_shared<SQLitePool>(10, quorumFilename, 1000000, 5000, 0);
+        TestServer server;
+        string peerList = "host1.fake:15555?nodeName=peer1,host2.fake:16666?nodeName=peer2,host3.fake:17777?nodeName=peer3,host4.fake:18888?nodeName=peer4";
+        SQLiteNode testNode(server, dbPool, "test", "localhost:19998", peerList, 1, 1000000000, "1.0");
+        SQLitePeer* peer1 = testNode._peerList[0];
+        SQLitePeer* peer2 = testNode._peerList[1];
+        SQLitePeer* peer3 = testNode._peerList[2];
+        for (auto peer : testNode._peerList) {
+            peer->subscribed = true;
+        }
+
+        using QuorumResult = SQLiteNode::QuorumResult;
+        map<uint64_t, QuorumResult> results;
+        auto recordResult = [&results](uint64_t commitCount) {
+            return [&results, commitCount](QuorumResult result) { results[commitCount] = result; };
+        };
+        const uint64_t deadline = STimeNow() + 60'000'000;
+
+        // With four full peers, QUORUM needs two approvals and ONE needs one.
+        testNode.startQuorumCommit(10, SQLiteNode::QUORUM, deadline);
+        testNode.startQuorumCommit(11, SQLiteNode::ONE, deadline);
+        testNode.startQuorumCommit(12, SQLiteNode::QUORUM, deadline);
+        testNode.waitForQuorum(10, recordResult(10));
+        testNode.waitForQuorum(11, recordResult(11));
+        ASSERT_EQUAL(testNode.getQuorumCommitsInFlight(), 3);
+
+        testNode._handleQuorumApproval(peer1, 11);
+        ASSERT_EQUAL(results.size(), 1);
+        ASSERT_TRUE(results[11] == QuorumResult::APPROVED);
+
+        // An approval of a later transaction counts for the earlier ones, too.
+        testNode._handleQuorumApproval(peer2, 12);
+        ASSERT_EQUAL(results.size(), 2);
+        ASSERT_TRUE(results[10] == QuorumResult::APPROVED);
+        ASSERT_EQUAL(testNode.getQuorumCommitsInFlight(), 1);
+
+        // A transaction can be approved before anyone's waiting for it.
+        testNode._handleQuorumApproval(peer1, 12);
+        ASSERT_EQUAL(testNode.getQuorumCommitsInFlight(), 0);
+        testNode.waitForQuorum(12, recordResult(12));
+        ASSERT_TRUE(results[12] == QuorumResult::APPROVED);
+
+        // Canceled transactions aren't waited for.
+        testNode.startQuorumCommit(13, SQLiteNode::QUORUM, deadline);
+        testNode.cancelQuorumCommit(13);
+        ASSERT_EQUAL(testNode.getQuorumCommitsInFlight(), 0);
+
+        // And when we stop leading, everything still waiting fails.
+        testNode.startQuorumCommit(14, SQLiteNode::QUORUM, deadline);
+        testNode.waitForQuorum(14, recordResult(14));
+        testNode._handleQuorumApproval(peer1, 14);
+        testNode._failQuorumCommits();
+        ASSERT_EQUAL(results.size(), 4);
+        ASSERT_TRUE(results[14] == QuorumResult::NOT_LEADING);
+        ASSERT_EQUAL(testNode.getQuorumCommitsInFlight(), 0);
+
+        // Two denials leave a QUORUM transaction short, but it fails on the third, when only one follower is left.
+        testNode.startQuorumCommit(15, SQLiteNode::QUORUM, deadline);
+        testNode.waitForQuorum(15, recordResult(15));
+        testNode._handleQuorumDenial(peer1, 15);
+        testNode._handleQuorumDenial(peer2, 15);
+        ASSERT_EQUAL(results.count(15), 0);
+        testNode._handleQuorumDenial(peer3, 15);
+        ASSERT_TRUE(results[15] == QuorumResult::DENIED);
+        ASSERT_EQUAL(testNode.getQuorumCommitsInFlight(), 0);
+
+        // So does one whose followers have dropped off.
+        testNode.startQuorumCommit(16, SQLiteNode::QUORUM, deadline);
+        testNode.waitForQuorum(16, recordResult(16));
+        peer1->subscribed = false;
+        peer2->subscribed = false;
+        testNode._expireQuorumCommits();
+        ASSERT_EQUAL(results.count(16), 0);
+        peer3->subscribed = false;
+        testNode._expireQuorumCommits();
+        ASSERT_TRUE(results[16] == QuorumResult::DENIED);
+
+        // And one that isn't approved by its deadline times out.
+        for (auto peer : testNode._peerList) {
+            peer->subscribed = true;
+        }
+        testNode.startQuorumCommit(17, SQLiteNode::QUORUM, STimeNow() - 1);
+        testNode.waitForQuorum(17, recordResult(17));
+        testNode._expireQuorumCommits();
+        ASSERT_TRUE(results[17] == QuorumResult::TIMED_OUT);
+        ASSERT_EQUAL(testNode.getQuorumCommitsInFlight(), 0);
+    }
 } __SQLiteNodeTest;
@@ -0,0 +1,91 @@
+#include <libstuff/libstuff.h>
+#include <sqlitecluster/SQLitePool.h>
+#include <test/lib/tpunit++.hpp>
+
+#include <unistd.h>
+#include <cstring>
+
+struct SQLitePoolTest : tpunit::TestFixture {
+    SQLitePoolTest() : tpunit::TestFixture("SQLitePool",
+                                           BEFORE_CLASS(SQLitePoolTest::setup),
+                                           AFTER_CLASS(SQLitePoolTest::teardown),
+                                           TEST(SQLitePoolTest::testThreadKeepsHandle),
+                                           TEST(SQLitePoolTest::testKeptHandlesAreShared),
+                                           TEST(SQLitePoolTest::testConcurrentCheckout)) { }
+
+    char filename[17] = "br_pool_dbXXXXXX";
+
+    void setup() {
+        int fd = mkstemp(filename);
+        close(fd);
+    }
+
+    void teardown() {
+        unlink(filename);
+    }
+
+    void testThreadKeepsHandle() {
+        SQLitePool pool(10, filename, 1000000, 5000, 0);
+        size_t first = pool.getIndex();
+        pool.returnToPool(first);
+
+        // We get the same handle back every time.
+        for (int i = 0; i < 10; i++) {
+            size_t index = pool.getIndex();
+            ASSERT_EQUAL(index, first);
+            pool.returnToPool(index);
+        }
+
+        // Until another thread needs it.
+        size_t other = pool.getIndex();
+        thread([&]() {
+            SQLiteScopedHandle dbScope(pool, pool.getIndex());
+            dbScope.db().read("SELECT 1;");
+        }).join();
+        pool.returnToPool(other);
+    }
+
+    void testKeptHandlesAreShared() {
+        // With 2 max DBs, the pool only ever creates one handle, which this thread keeps after returning it. Another
+        // thread has to be able to take it rather than waiting forever.
+        SQLitePool pool(2, filename, 1000000, 5000, 0);
+        size_t index = pool.getIndex();
+        pool.returnToPool(index);
+        size_t otherIndex = SIZE_MAX;
+        thread([&]() {
+            otherIndex = pool.getIndex();
+            pool.returnToPool(otherIndex);
+        }).join();
+        ASSERT_EQUAL(otherIndex, index);
+
+        // That thread exited, which gave the handle back, and we can still get it.
+        size_t again = pool.getIndex();
+        ASSERT_EQUAL(again, index);
+        pool.returnToPool(again);
+    }
+
+    void testConcurrentCheckout() {
+        // More threads than handles, so threads have to wait for each other.
+        SQLitePool pool(5, filename, 1000000, 5000, 0);
+        atomic<int> inUse(0);
+        atomic<int> maxInUse(0);
+        list<thread> threads;
+        for (int i = 0; i < 16; i++) {
+            threads.emplace_back([&]() {
+                for (int j = 0; j < 200; j++) {
+                    size_t index = pool.getIndex();
+                    int current = ++inUse;
+                    int seen = maxInUse;
+                    while (current > seen && !maxInUse.compare_exchange_weak(seen, current)) {}
+                    pool.initializeIndex(index).read("SELECT 1;");
+                    inUse--;
+                    pool.returnToPool(index);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        ASSERT_LESS_THAN_EQUAL(maxInUse.load(), 4);
+    }
+} __SQLitePoolTest;
@@ -0,0 +1,105 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <sqlitecluster/SQLiteRecovery.h>
+#include <test/lib/SQLiteTestFiles.h>
+#include <test/lib/tpunit++.hpp>
+
+#include <unistd.h>
+
+struct SQLiteRecoveryTest : tpunit::TestFixture {
+    SQLiteRecoveryTest() : tpunit::TestFixture("SQLiteRecovery",
+                                               BEFORE(SQLiteRecoveryTest::setup),
+                                               AFTER(SQLiteRecoveryTest::teardown),
+                                               TEST(SQLiteRecoveryTest::testFromDatabase),
+                                               TEST(SQLiteRecoveryTest::testFromDump),
+                                               TEST(SQLiteRecoveryTest::testHashMismatch)) { }
+
+    SQLiteTestFiles files;
+    string sourceName;
+    string backupName;
+
+    // The source has 20 commits, and the backup is a copy of it from after the 5th.
+    void setup() {
+        sourceName = create();
+        backupName = create();
+        unlink(backupName.c_str());
+        SQLite source(sourceName, 1000000, 1000, 1);
+        SQLiteTestFiles::commit(source, "CREATE TABLE test (id INTEGER PRIMARY KEY, value TEXT);");
+        for (int i = 2; i <= 20; i++) {
+            SQLiteTestFiles::commit(source, "INSERT INTO test VALUES (" + SQ(i) + ", " + SQ("value" + to_string(i)) + ");");
+            if (i == 5) {
+                ASSERT_FALSE(SQuery(source.getDBHandle(), "", "VACUUM INTO " + SQ(backupName) + ";"));
+            }
+        }
+    }
+
+    void teardown() {
+        files.removeAll();
+    }
+
+    string create() {
+        return files.create("br_recovery_db");
+    }
+
+    string hashAt(uint64_t commitID) {
+        SQLite source(sourceName, 1000000, 1000, 1);
+        string query, hash;
+        source.getCommit(commitID, query, hash);
+        return hash;
+    }
+
+    void testFromDatabase() {
+        SQLite backup(backupName, 1000000, 1000, 1);
+        ASSERT_EQUAL(backup.getCommitCount(), 5);
+        SQLiteRecovery recovery(sourceName);
+        ASSERT_EQUAL(recovery.getError(), "");
+
+        // Stopping part way leaves the database exactly as the source was then.
+        ASSERT_EQUAL(recovery.replay(backup, 12), 7);
+        ASSERT_EQUAL(recovery.getError(), "");
+        ASSERT_EQUAL(backup.getCommitCount(), 12);
+        ASSERT_EQUAL(backup.getCommittedHash(), hashAt(12));
+        ASSERT_EQUAL(backup.read("SELECT MAX(id) FROM test;"), "12");
+
+        // Asking for more than there is replays what there is, and says so.
+        ASSERT_EQUAL(recovery.replay(backup, 25), 8);
+        ASSERT_TRUE(SContains(recovery.getError(), "doesn't have commit 21"));
+        ASSERT_EQUAL(backup.getCommittedHash(), hashAt(20));
+    }
+
+    void testFromDump() {
+        const string dumpName = create();
+        string error;
+        ASSERT_TRUE(SQLiteRecovery::exportJournal(sourceName, dumpName, 3, error));
+        ASSERT_EQUAL(SParseList(SFileLoad(dumpName), '\n').size(), 18);
+
+        // With no target, it goes to the end of the dump.
+        SQLite backup(backupName, 1000000, 1000, 1);
+        SQLiteRecovery recovery(dumpName);
+        ASSERT_EQUAL(recovery.getError(), "");
+        ASSERT_EQUAL(recovery.replay(backup, 0), 15);
+        ASSERT_EQUAL(recovery.getError(), "");
+        ASSERT_EQUAL(backup.getCommittedHash(), hashAt(20));
+    }
+
+    void testHashMismatch() {
+        {
+            SQLite source(sourceName, 1000000, 1000, 1);
+            for (const string table : {"journal", "journal0000", "journal0001"}) {
+                ASSERT_FALSE(SQuery(source.getDBHandle(), "", "UPDATE " + table + " SET query = "
+                                    "'INSERT INTO test VALUES (9, ''tampered'');' WHERE id = 9;"));
+            }
+        }
+
+        // It stops before the commit that doesn't match, leaving everything before it in place.
+        SQLite backup(backupName, 1000000, 1000, 1);
+        SQLiteRecovery recovery(sourceName);
+        ASSERT_EQUAL(recovery.replay(backup, 20), 3);
+        ASSERT_TRUE(SContains(recovery.getError(), "commit 9 produced hash"));
+        ASSERT_EQUAL(backup.getCommitCount(), 8);
+        ASSERT_EQUAL(backup.getCommittedHash(), hashAt(8));
+        ASSERT_FALSE(backup.insideTransaction());
+        ASSERT_EQUAL(backup.read("SELECT COUNT(*) FROM test WHERE id = 9;"), "0");
+    }
+} __SQLiteRecoveryTest;
@@ -0,0 +1,106 @@
+#include <libstuff/libstuff.h>
+#include <libstuff/SQResult.h>
+#include <sqlitecluster/SQLite.h>
+#include <test/lib/SQLiteTestFiles.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SQLiteShardTest : tpunit::TestFixture {
+    SQLiteShardTest() : tpunit::TestFixture("SQLiteShard",
+                                            AFTER(SQLiteShardTest::teardown),
+                                            TEST(SQLiteShardTest::testPlacement),
+                                            TEST(SQLiteShardTest::testExistingTableStays),
+                                            TEST(SQLiteShardTest::testMarks)) { }
+
+    SQLiteTestFiles files;
+
+    void teardown() {
+        files.removeAll();
+    }
+
+    string create() {
+        return files.create("br_shard_db", {"cache"});
+    }
+
+    void testPlacement() {
+        const string filename = create();
+        SQLite db(filename, 1000000, 1000, 1, "", 0, {"cache"});
+        bool created = false;
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        ASSERT_TRUE(db.verifyTable("cache", "CREATE TABLE cache ( name TEXT NOT NULL PRIMARY KEY, value BLOB NOT NULL )", created, "cache"));
+        ASSERT_TRUE(created);
+        ASSERT_TRUE(db.verifyIndex("cacheValue", "cache", "( value )", false, true));
+
+        // A shard that isn't attached just means the main file.
+        ASSERT_TRUE(db.verifyTable("other", "CREATE TABLE other ( id INTEGER PRIMARY KEY )", created, "missing"));
+        ASSERT_TRUE(db.write("INSERT INTO cache VALUES ('a', 'b');"));
+        ASSERT_TRUE(db.prepare());
+        ASSERT_EQUAL(db.commit(), SQLITE_OK);
+
+        ASSERT_TRUE(SFileExists(SQLite::getShardFilename(db.getFilename(), "cache")));
+        ASSERT_EQUAL(db.read("SELECT COUNT(*) FROM cache.sqlite_master WHERE name IN ('cache', 'cacheValue');"), "2");
+        ASSERT_EQUAL(db.read("SELECT COUNT(*) FROM main.sqlite_master WHERE name IN ('cache', 'cacheValue');"), "0");
+        ASSERT_EQUAL(db.read("SELECT COUNT(*) FROM main.sqlite_master WHERE name = 'other';"), "1");
+        ASSERT_EQUAL(db.read("SELECT value FROM cache WHERE name = 'a';"), "b");
+
+        // The journal stays in the main file, and the table compares equal to its definition.
+        string query, hash;
+        ASSERT_TRUE(db.getCommit(db.getCommitCount(), query, hash));
+        ASSERT_TRUE(SContains(query, "CREATE TABLE cache.cache"));
+        db.beginTransaction();
+        ASSERT_TRUE(db.verifyTable("cache", "CREATE TABLE cache ( name TEXT NOT NULL PRIMARY KEY, value BLOB NOT NULL )", created, "cache"));
+        ASSERT_FALSE(created);
+        ASSERT_TRUE(db.verifyIndex("cacheValue", "cache", "( value )", false));
+        db.rollback();
+
+        // Handles copied from this one have the shard too.
+        SQLite copy(db);
+        ASSERT_EQUAL(copy.read("SELECT value FROM cache WHERE name = 'a';"), "b");
+    }
+
+    void testExistingTableStays() {
+        const string filename = create();
+        {
+            SQLite db(filename, 1000000, 1000, 1);
+            bool created = false;
+            db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+            ASSERT_TRUE(db.verifyTable("cache", "CREATE TABLE cache ( name TEXT NOT NULL PRIMARY KEY, value BLOB NOT NULL )", created));
+            ASSERT_TRUE(db.prepare());
+            ASSERT_EQUAL(db.commit(), SQLITE_OK);
+        }
+
+        // Adding the shard later leaves the table where it is.
+        SQLite db(filename, 1000000, 1000, 1, "", 0, {"cache"});
+        bool created = true;
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        ASSERT_TRUE(db.verifyTable("cache", "CREATE TABLE cache ( name TEXT NOT NULL PRIMARY KEY, value BLOB NOT NULL )", created, "cache"));
+        ASSERT_FALSE(created);
+        ASSERT_TRUE(db.getUncommittedQuery().empty());
+        db.rollback();
+        ASSERT_EQUAL(db.read("SELECT COUNT(*) FROM main.sqlite_master WHERE name = 'cache';"), "1");
+        ASSERT_EQUAL(db.read("SELECT COUNT(*) FROM cache.sqlite_master WHERE name = 'cache';"), "0");
+    }
+
+    void testMarks() {
+        const string filename = create();
+        SQLite db(filename, 1000000, 1000, 1, "", 0, {"cache"});
+        bool created = false;
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        ASSERT_TRUE(db.verifyTable("cache", "CREATE TABLE cache ( name TEXT NOT NULL PRIMARY KEY, value BLOB NOT NULL )", created, "cache"));
+        ASSERT_TRUE(db.prepare());
+        ASSERT_EQUAL(db.commit(), SQLITE_OK);
+        const string shardCommit = to_string(db.getCommitCount());
+
+        // A commit that doesn't touch the shard doesn't move its marks.
+        db.beginTransaction(SQLite::TRANSACTION_TYPE::EXCLUSIVE);
+        ASSERT_TRUE(db.verifyTable("other", "CREATE TABLE other ( id INTEGER PRIMARY KEY )", created));
+        ASSERT_TRUE(db.prepare());
+        ASSERT_EQUAL(db.commit(), SQLITE_OK);
+        ASSERT_EQUAL(db.read("SELECT MAX(commitID) FROM journalShardMarks_cache;"), shardCommit);
+        ASSERT_EQUAL(db.read("SELECT MAX(commitID) FROM cache.journalShardMarks;"), shardCommit);
+        ASSERT_TRUE(SQLite::shardMarksMatch(db.getDBHandle(), "cache"));
+
+        // As if the shard's half of that commit had been lost.
+        ASSERT_FALSE(SQuery(db.getDBHandle(), "", "UPDATE cache.journalShardMarks SET commitID = 0;"));
+        ASSERT_FALSE(SQLite::shardMarksMatch(db.getDBHandle(), "cache"));
+    }
+} __SQLiteShardTest;
@@ -0,0 +1,91 @@
+#include <unistd.h>
+
+#include <libstuff/libstuff.h>
+#include <libstuff/SScheduledPriorityQueue.h>
+#include <BedrockRuntimeHistory.h>
+#include <test/lib/tpunit++.hpp>
+
+struct SScheduledPriorityQueueTest : tpunit::TestFixture {
+    SScheduledPriorityQueueTest()
+    : tpunit::TestFixture("SScheduledPriorityQueue",
+                          TEST(SScheduledPriorityQueueTest::testDefaultOrdering),
+                          TEST(SScheduledPriorityQueueTest::testEarliestDeadlineFirst),
+                          TEST(SScheduledPriorityQueueTest::testRuntimeHistory)) { }
+
+    void testDefaultOrdering() {
+        SScheduledPriorityQueue<int> queue;
+        uint64_t now = STimeNow();
+
+        // Same priority, the older scheduled item comes first regardless of timeout.
+        queue.push(1, 500, now - 2000, now + 10'000'000);
+        queue.push(2, 500, now - 1000, now + 1'000'000);
+
+        // Higher priority always wins.
+        queue.push(3, 750, now - 500, now + 20'000'000);
+
+        ASSERT_EQUAL(queue.get(), 3);
+        ASSERT_EQUAL(queue.get(), 1);
+        ASSERT_EQUAL(queue.get(), 2);
+        ASSERT_TRUE(queue.empty());
+    }
+
+    void testEarliestDeadlineFirst() {
+        SScheduledPriorityQueue<int> queue;
+        queue.setEarliestDeadlineFirst(true);
+        uint64_t now = STimeNow();
+
+        // Within a priority, the item that times out first comes first.
+        queue.push(1, 500, now - 2000, now + 10'000'000);
+        queue.push(2, 500, now - 1000, now + 1'000'000);
+        queue.push(3, 500, now - 1500, now + 5'000'000);
+
+        // Items scheduled in the future are still skipped, even with an earlier deadline.
+        queue.push(4, 500, now + 60'000'000, now + 500'000);
+
+        // Priority still takes precedence over deadline.
+        queue.push(5, 750, now - 500, now + 20'000'000);
+
+        ASSERT_EQUAL(queue.get(), 5);
+        ASSERT_EQUAL(queue.get(), 2);
+        ASSERT_EQUAL(queue.get(), 3);
+        ASSERT_EQUAL(queue.get(), 1);
+        ASSERT_EQUAL(queue.size(), 1ul);
+
+        // Items pushed after some have been taken out are still ordered by deadline.
+        queue.push(6, 500, now - 100, now + 30'000'000);
+        queue.push(7, 500, now - 100, now + 3'000'000);
+        ASSERT_EQUAL(queue.get(), 7);
+        ASSERT_EQUAL(queue.get(), 6);
+        ASSERT_EQUAL(queue.size(), 1ul);
+
+        // An item scheduled in the future is ordered by its deadline once its time comes.
+        queue.clear();
+        now = STimeNow();
+        queue.push(8, 500, now + 100'000, now + 10'000'000);
+        queue.push(9, 500, now - 100, now + 20'000'000);
+        ASSERT_EQUAL(queue.get(), 9);
+        usleep(200'000);
+        queue.push(10, 500, now - 100, now + 30'000'000);
+        ASSERT_EQUAL(queue.get(), 8);
+        ASSERT_EQUAL(queue.get(), 10);
+        ASSERT_TRUE(queue.empty());
+    }
+
+    void testRuntimeHistory() {
+        BedrockRuntimeHistory history;
+
+        // No guess until we've seen enough samples.
+        for (size_t i = 1; i < BedrockRuntimeHistory::MIN_SAMPLES; i++) {
+            history.record("Query", i * 1000);
+        }
+        ASSERT_EQUAL(history.median("Query"), 0ul);
+        ASSERT_EQUAL(history.median("Unknown"), 0ul);
+
+        // Fill the whole window with a known distribution, which also replaces the samples above.
+        for (size_t i = 0; i < BedrockRuntimeHistory::SAMPLES_PER_COMMAND; i++) {
+            history.record("Query", (i % 2) ? 9000 : 1000);
+        }
+        history.record("Query", 9000);
+        ASSERT_EQUAL(history.median("Query"), 9000ul);
+    }
+} __SScheduledPriorityQueueTest;
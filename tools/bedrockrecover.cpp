@@ -0,0 +1,84 @@
+/// bedrock/tools/bedrockrecover.cpp
+/// ================================
+/// Point-in-time recovery: rolls a backup forward to a given commit from a journal, checking the hash of every commit.
+///
+#include <iostream>
+
+#include <libstuff/libstuff.h>
+#include <libstuff/SData.h>
+#include <sqlitecluster/SQLite.h>
+#include <sqlitecluster/SQLiteRecovery.h>
+
+int main(int argc, char* argv[]) {
+    SData args = SParseCommandLine(argc, argv);
+    const bool exporting = args.isSet("-exportJournal");
+    if (args.isSet("-?") || args.isSet("-h") || args.isSet("-help") || !args.isSet("-output") ||
+        (!exporting && (!args.isSet("-backup") || !args.isSet("-journal")))) {
+        cout << "Usage:" << endl;
+        cout << "bedrockrecover -backup <filename> -journal <filename> -output <filename> [-toCommit <id>] [-shards <list>]"
+             << endl;
+        cout << "bedrockrecover -exportJournal <filename> -output <filename> [-fromCommit <id>]" << endl;
+        cout << endl;
+        cout << "-backup <filename>          Database to start from. It's copied to -output, and left as is" << endl;
+        cout << "-journal <filename>         Where to read commits after the backup from: a database, or a dump written "
+                "by -exportJournal"
+             << endl;
+        cout << "-output <filename>          Where to write the recovered database. Must not exist" << endl;
+        cout << "-toCommit <id>              Last commit to replay (default: the last one in -journal)" << endl;
+        cout << "-shards <list>              Shard files the backup has, as given to bedrock with -shards" << endl;
+        cout << "-maxJournalSize <#commits>  Number of commits to keep in the recovered journal (default 1000000)" << endl;
+        cout << "-exportJournal <filename>   Writes the journal of this database to -output, for replaying later" << endl;
+        cout << "-fromCommit <id>            First commit to export (default: the first one in the journal)" << endl;
+        cout << "-v                          Log verbosely" << endl;
+        return 1;
+    }
+
+    SInitialize("recover");
+    SLogLevel(args.isSet("-v") ? LOG_DEBUG : LOG_WARNING);
+
+    string error;
+    if (exporting) {
+        if (!SQLiteRecovery::exportJournal(args["-exportJournal"], args["-output"], args.calcU64("-fromCommit"), error)) {
+            cerr << "Export failed: " << error << endl;
+            return 1;
+        }
+        cout << "Exported journal of " << args["-exportJournal"] << " to " << args["-output"] << endl;
+        return 0;
+    }
+
+    // Never touch the backup itself, so a failed recovery can just be tried again.
+    const string output = args["-output"];
+    const list<string> shardList = SParseList(args["-shards"]);
+    const set<string> shards(shardList.begin(), shardList.end());
+    if (SFileExists(output)) {
+        cerr << output << " already exists" << endl;
+        return 1;
+    }
+    if (!SFileCopy(args["-backup"], output)) {
+        cerr << "Couldn't copy " << args["-backup"] << " to " << output << endl;
+        return 1;
+    }
+    for (const string& shard : shards) {
+        if (!SFileCopy(SQLite::getShardFilename(args["-backup"], shard), SQLite::getShardFilename(output, shard))) {
+            cerr << "Couldn't copy shard " << shard << " of " << args["-backup"] << endl;
+            return 1;
+        }
+    }
+
+    SQLiteRecovery recovery(args["-journal"]);
+    if (!recovery.getError().empty()) {
+        cerr << "Couldn't open journal: " << recovery.getError() << endl;
+        return 1;
+    }
+    SQLite db(output, 1024 * 1024, args.isSet("-maxJournalSize") ? args.calc("-maxJournalSize") : 1'000'000, -1, "", 0,
+              shards);
+    const uint64_t startCommit = db.getCommitCount();
+    const uint64_t replayed = recovery.replay(db, args.calcU64("-toCommit"));
+    cout << "Replayed " << replayed << " commits onto " << output << ", from " << startCommit << " to "
+         << db.getCommitCount() << " (" << db.getCommittedHash() << ")" << endl;
+    if (!recovery.getError().empty()) {
+        cerr << "Recovery stopped: " << recovery.getError() << endl;
+        return 1;
+    }
+    return 0;
+}